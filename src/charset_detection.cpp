@@ -0,0 +1,1033 @@
+// NOTE: This file deliberately doesn't include stdafx.h (and is built without the precompiled header) so that it can
+//       also be built on its own, outside of foobar2000. See the bottom of the file for how to do that.
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+#if defined(_M_X64) || defined(_M_IX86)
+#include <emmintrin.h>
+#include <intrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "charset_detection.h"
+#if !defined(CHARSET_DETECTION_STANDALONE)
+#include "mvtf/mvtf.h"
+#endif
+
+// The score given to each character that some bytes decode to, in a given encoding. Characters that are common in
+// the languages written in that encoding are worth much more than others, so that when some text is valid in several
+// encodings the one in which it "looks right" wins. Characters that are unlikely to appear in lyrics lose points.
+static const int SCORE_INVALID = INT_MIN;       // The bytes can't appear in text in this encoding
+static const int SCORE_LEAD_BYTE = INT_MIN + 1; // The byte is the first of a two-byte character
+static const int SCORE_UNLIKELY = -1;
+static const int SCORE_OTHER = 0;
+static const int SCORE_LIKELY = 1;
+static const int SCORE_COMMON = 4;
+
+// ==========================
+// Single-byte encodings
+// ==========================
+// Each single-byte encoding is described by the class of each of the bytes 0x80-0xFF, which are
+// 'x': undefined, 'p': punctuation, 's': some other symbol, 'L': an uppercase letter, 'l': a lowercase letter,
+// '2'/'3': a lowercase letter that is common/very common (respectively) in the languages written in the encoding and
+// 'U': an uppercase letter that is worth as much as a lowercase one (because it's not an accented Latin letter, which
+//      are rarely uppercase and so would otherwise make text that's written in all-caps look like Latin text).
+struct SingleByteEncoding
+{
+    uint32_t codepage;
+    const char* byte_classes;
+    int mixed_with_ascii_letter; // Added to the score for each of the encoding's letters next to an ASCII letter
+    int after_own_letter;        // Added to the score for each of the encoding's letters that follows another
+};
+
+// NOTE: The order of this list decides ties, which are common between Western & Central European text
+static const SingleByteEncoding SINGLE_BYTE_ENCODINGS[] = {
+    // Accented letters are usually on their own in the middle of a word of (unaccented) ASCII letters
+    { charset::CODEPAGE_WESTERN,
+      "sxplppppspLpLxLx" "xpppppppsslplxlL" "p2ssssspssspssss" "ssssslppssspsss2"
+      "LLLLLLLLLLLLLLLL" "LLLLLLLsLLLLLLL2" "332232232322l322" "l3l3223s22223lll",
+      0,
+      -1 },
+    { charset::CODEPAGE_CENTRAL_EUROPEAN,
+      "sxpxppppxpLpLLLL" "xpppppppxs3p3232" "pssLsLspssLpsssL" "sss3slpps3lpLs23"
+      "LLLLLLLLLLLLLLLL" "LLLLLLLsLLLLLLLl" "l2llll3l323l32l2" "l223l2ls3222l2ls",
+      0,
+      0 },
+    // Cyrillic & Greek words are made up entirely of non-ASCII letters
+    { charset::CODEPAGE_CYRILLIC,
+      "UUp2ppppspUpUUUU" "2pppppppxs2p2222" "pU2UsUspUsUpsssU" "ssU222pp2s2p2U22"
+      "UUUUUUUUUUUUUUUU" "UUUUUUUUUUUUUUUU" "3232232232332332" "3332222222222222",
+      -2,
+      0 },
+    { charset::CODEPAGE_GREEK,
+      "sxp2ppppxpxpxxxx" "xpppppppxsxpxxxx" "psUsssspssxpsssp" "sssss2ppUUUpUsUU"
+      "2UUUUUUUUUUUUUUU" "UUxUUUUUUUUU2222" "2322232223322323" "223332222222222x",
+      -2,
+      0 },
+};
+static const size_t SINGLE_BYTE_ENCODING_COUNT = std::size(SINGLE_BYTE_ENCODINGS);
+
+enum class LetterCase : uint8_t
+{
+    None, // Not a letter
+    AsciiLower,
+    AsciiUpper,
+    Lower,
+    Upper,
+};
+
+static LetterCase get_ascii_letter_case(uint8_t byte)
+{
+    if((byte >= 'a') && (byte <= 'z'))
+    {
+        return LetterCase::AsciiLower;
+    }
+    if((byte >= 'A') && (byte <= 'Z'))
+    {
+        return LetterCase::AsciiUpper;
+    }
+    return LetterCase::None;
+}
+
+static bool is_ascii_letter(LetterCase letter_case)
+{
+    return (letter_case == LetterCase::AsciiLower) || (letter_case == LetterCase::AsciiUpper);
+}
+
+static bool is_lowercase(LetterCase letter_case)
+{
+    return (letter_case == LetterCase::AsciiLower) || (letter_case == LetterCase::Lower);
+}
+
+struct SingleByteScore
+{
+    int64_t score;
+    bool valid;
+    LetterCase previous;
+};
+
+static void score_single_byte(const SingleByteEncoding& encoding, SingleByteScore& state, uint8_t byte)
+{
+    if(byte < 0x80)
+    {
+        const LetterCase letter_case = get_ascii_letter_case(byte);
+        const bool follows_own_letter = (state.previous == LetterCase::Lower) || (state.previous == LetterCase::Upper);
+        if(is_ascii_letter(letter_case) && follows_own_letter)
+        {
+            state.score += encoding.mixed_with_ascii_letter;
+        }
+        state.previous = letter_case;
+        return;
+    }
+
+    const char byte_class = encoding.byte_classes[byte - 0x80];
+    switch(byte_class)
+    {
+        case 'x': state.valid = false; return;
+        case 'p': state.previous = LetterCase::None; return;
+        case 's':
+            state.score += SCORE_UNLIKELY;
+            state.previous = LetterCase::None;
+            return;
+        case '3': state.score += 3; break;
+        case '2': state.score += 2; break;
+        case 'l': state.score += 1; break;
+        case 'U': state.score += 1; break;
+        default: break;
+    }
+
+    const bool is_uppercase = (byte_class == 'L') || (byte_class == 'U');
+    const LetterCase letter_case = is_uppercase ? LetterCase::Upper : LetterCase::Lower;
+    if(is_ascii_letter(state.previous))
+    {
+        state.score += encoding.mixed_with_ascii_letter;
+    }
+    else if((state.previous == LetterCase::Lower) || (state.previous == LetterCase::Upper))
+    {
+        state.score += encoding.after_own_letter;
+    }
+    if((letter_case == LetterCase::Upper) && is_lowercase(state.previous))
+    {
+        state.score += SCORE_UNLIKELY; // Uppercase letters rarely appear in the middle of a word
+    }
+    state.previous = letter_case;
+}
+
+// ==========================
+// Double-byte encodings
+// ==========================
+// The 500 most frequently-used (simplified) Chinese characters, encoded in GBK
+static const uint16_t GBK_COMMON_CHARACTERS[] = {
+    0xB0A2, 0xB0AE, 0xB0B2, 0xB0C9, 0xB0CB, 0xB0D1, 0xB0D7, 0xB0D9, 0xB0EC, 0xB0FC, 0xB1A3, 0xB1A8, 0xB1B1,
+    0xB1B8, 0xB1BB, 0xB1BE, 0xB1C8, 0xB1D8, 0xB1DF, 0xB1E3, 0xB1E4, 0xB1EA, 0xB1ED, 0xB1F0, 0xB1F8, 0xB2A1,
+    0xB2A2, 0xB2BB, 0xB2BC, 0xB2BD, 0xB2BF, 0xB2C5, 0xB2CE, 0xB2E9, 0xB2FA, 0xB3A1, 0xB3A3, 0xB3A4, 0xB3B5,
+    0xB3C6, 0xB3C7, 0xB3C9, 0xB3CC, 0xB3D4, 0xB3D6, 0xB3F6, 0xB3FD, 0xB4A6, 0xB4AB, 0xB4CB, 0xB4CE, 0xB4D3,
+    0xB4E6, 0xB4EF, 0xB4F2, 0xB4F3, 0xB4F8, 0xB4FA, 0xB5A5, 0xB5AB, 0xB5B1, 0xB5B3, 0xB5BC, 0xB5BD, 0xB5C0,
+    0xB5C3, 0xB5C4, 0xB5C8, 0xB5D8, 0xB5DA, 0xB5E3, 0xB5E7, 0xB5F7, 0xB6A8, 0xB6AB, 0xB6AF, 0xB6BC, 0xB6C8,
+    0xB6CF, 0xB6D4, 0xB6E0, 0xB6F8, 0xB6F9, 0xB6FE, 0xB7A2, 0xB7A8, 0xB7B4, 0xB7BD, 0xB7C5, 0xB7C7, 0xB7C9,
+    0xB7D1, 0xB7D6, 0xB7E7, 0xB7F2, 0xB7FE, 0xB8AE, 0xB8B4, 0xB8C3, 0xB8C4, 0xB8C9, 0xB8D0, 0xB8DF, 0xB8E6,
+    0xB8F1, 0xB8F6, 0xB8F7, 0xB8F8, 0xB8F9, 0xB8FC, 0xB9A4, 0xB9A6, 0xB9AB, 0xB9B2, 0xB9C5, 0xB9D8, 0xB9D9,
+    0xB9DB, 0xB9DC, 0xB9E2, 0xB9E3, 0xB9E6, 0xB9FA, 0xB9FB, 0xB9FD, 0xBAA3, 0xBAC3, 0xBAC5, 0xBACD, 0xBACE,
+    0xBACF, 0xBADC, 0xBAEC, 0xBAF2, 0xBAF3, 0xBAF5, 0xBBA8, 0xBBAA, 0xBBAF, 0xBBB0, 0xBBB9, 0xBBD8, 0xBBE1,
+    0xBBEE, 0xBBF0, 0xBBF2, 0xBBF7, 0xBBF9, 0xBBFA, 0xBCAB, 0xBCAF, 0xBCB0, 0xBCB4, 0xBCB6, 0xBCB8, 0xBCBA,
+    0xBCBC, 0xBCC6, 0xBCC7, 0xBCCA, 0xBCD2, 0xBCD3, 0xBCDB, 0xBCE4, 0xBCFB, 0xBCFE, 0xBDA8, 0xBDAB, 0xBDBB,
+    0xBDCC, 0xBDCF, 0xBDD0, 0xBDD3, 0xBDE1, 0xBDE2, 0xBDE7, 0xBDF0, 0xBDF1, 0xBDF6, 0xBDF8, 0xBDFC, 0xBEA1,
+    0xBEAB, 0xBEAD, 0xBEBF, 0xBEC5, 0xBECD, 0xBED6, 0xBEDD, 0xBEDF, 0xBEF5, 0xBEF6, 0xBFAA, 0xBFB4, 0xBFBC,
+    0xBFC6, 0xBFC9, 0xBFD5, 0xBFDA, 0xBFEC, 0xBFF6, 0xC0AD, 0xC0B4, 0xC0CF, 0xC0E0, 0xC0EB, 0xC0ED, 0xC0EE,
+    0xC0EF, 0xC0FA, 0xC0FB, 0xC1A2, 0xC1A6, 0xC1AA, 0xC1AC, 0xC1BD, 0xC1BF, 0xC1CB, 0xC1D0, 0xC1D6, 0xC1EC,
+    0xC1ED, 0xC1EE, 0xC1F7, 0xC1F9, 0xC2B7, 0xC2DB, 0xC2DE, 0xC2E4, 0xC2ED, 0xC2F0, 0xC2FA, 0xC3B4, 0xC3BB,
+    0xC3BF, 0xC3C0, 0xC3C5, 0xC3C7, 0xC3E6, 0xC3F1, 0xC3F7, 0xC3FB, 0xC3FC, 0xC4BF, 0xC4C7, 0xC4CF, 0xC4D1,
+    0xC4D8, 0xC4DA, 0xC4DC, 0xC4E3, 0xC4EA, 0xC4EE, 0xC5A9, 0xC5AE, 0xC6AC, 0xC6B7, 0xC6BD, 0xC6DA, 0xC6E4,
+    0xC6F0, 0xC6F3, 0xC6F7, 0xC6F8, 0xC7B0, 0xC7BF, 0xC7D0, 0xC7D2, 0xC7D7, 0xC7E0, 0xC7E1, 0xC7E5, 0xC7E9,
+    0xC7EB, 0xC7F3, 0xC7F8, 0xC8A1, 0xC8A5, 0xC8A8, 0xC8AB, 0xC8B4, 0xC8B7, 0xC8BB, 0xC8C3, 0xC8CB, 0xC8CE,
+    0xC8CF, 0xC8D5, 0xC8DD, 0xC8E7, 0xC8EB, 0xC8FD, 0xC9AB, 0xC9BD, 0xC9CC, 0xC9CF, 0xC9D9, 0xC9E7, 0xC9E8,
+    0xC9ED, 0xC9EE, 0xC9F1, 0xC9F9, 0xC9FA, 0xCAA6, 0xCAA7, 0xCAAE, 0xCAAF, 0xCAB1, 0xCAB2, 0xCAB5, 0xCAB6,
+    0xCAB7, 0xCAB9, 0xCABC, 0xCABD, 0xCABE, 0xCABF, 0xCAC0, 0xCAC2, 0xCAC6, 0xCAC7, 0xCAD0, 0xCAD3, 0xCAD5,
+    0xCAD6, 0xCAD7, 0xCADC, 0xCAE9, 0xCAF5, 0xCAFD, 0xCBAE, 0xCBB5, 0xCBBC, 0xCBBE, 0xCBC0, 0xCBC4, 0xCBC6,
+    0xCBE3, 0xCBE4, 0xCBE6, 0xCBF9, 0xCBFB, 0xCBFC, 0xCBFD, 0xCCA8, 0xCCAB, 0xCCB8, 0xCCD8, 0xCCE1, 0xCCE2,
+    0xCCE5, 0xCCEC, 0xCCF5, 0xCCFD, 0xCDA8, 0xCDAC, 0xCDB3, 0xCDB7, 0xCDBB, 0xCDBC, 0xCDC5, 0xCDC6, 0xCDE2,
+    0xCDEA, 0xCDF2, 0xCDF5, 0xCDF9, 0xCDFB, 0xCEAA, 0xCEAF, 0xCEB4, 0xCEBB, 0xCEC4, 0xCECA, 0xCED2, 0xCEDE,
+    0xCEE4, 0xCEE5, 0xCEEF, 0xCEF1, 0xCEF7, 0xCFA2, 0xCFA3, 0xCFB5, 0xCFC2, 0xCFC8, 0xCFD4, 0xCFD6, 0xCFDF,
+    0xCFE0, 0xCFEB, 0xCFEC, 0xCFF1, 0xCFF2, 0xCFF3, 0xCFFB, 0xD0A1, 0xD0A6, 0xD0A9, 0xD0B4, 0xD0C2, 0xD0C4,
+    0xD0C5, 0xD0CE, 0xD0D0, 0xD0D4, 0xD0E8, 0xD0EB, 0xD0ED, 0xD1A1, 0xD1A7, 0xD1C7, 0xD1D0, 0xD1D4, 0xD1DB,
+    0xD1F9, 0xD2AA, 0xD2B2, 0xD2B5, 0xD2BB, 0xD2BD, 0xD2D1, 0xD2D4, 0xD2D7, 0xD2E2, 0xD2E5, 0xD2E9, 0xD2F2,
+    0xD2FD, 0xD3A2, 0xD3A6, 0xD3B0, 0xD3C3, 0xD3C9, 0xD3D0, 0xD3D6, 0xD3DA, 0xD3EB, 0xD3EF, 0xD4AA, 0xD4AD,
+    0xD4B1, 0xD4B6, 0xD4BA, 0xD4BC, 0xD4BD, 0xD4C2, 0xD4CB, 0xD4D9, 0xD4DA, 0xD4E7, 0xD4EC, 0xD4F2, 0xD4F5,
+    0xD4F6, 0xD4F8, 0xD5B9, 0xD5C5, 0xD5D2, 0xD5D5, 0xD5DF, 0xD5E2, 0xD5E6, 0xD5F9, 0xD5FB, 0xD5FD, 0xD6A4,
+    0xD6A7, 0xD6AA, 0xD6AE, 0xD6B1, 0xD6B8, 0xD6BB, 0xD6C1, 0xD6CA, 0xD6CE, 0xD6D0, 0xD6D6, 0xD6D8, 0xD6DA,
+    0xD6DC, 0xD6F7, 0xD7A1, 0xD7A2, 0xD7A8, 0xD7AA, 0xD7B0, 0xD7BC, 0xD7C5, 0xD7CA, 0xD7D3, 0xD7D4, 0xD7D6,
+    0xD7DC, 0xD7DF, 0xD7E9, 0xD7EE, 0xD7F6, 0xD7F7,
+};
+
+// The 500 most frequently-used (traditional) Chinese characters, encoded in Big5
+static const uint16_t BIG5_COMMON_CHARACTERS[] = {
+    0xA440, 0xA445, 0xA446, 0xA447, 0xA448, 0xA449, 0xA44A, 0xA44B, 0xA44C, 0xA44F, 0xA451, 0xA453, 0xA454,
+    0xA455, 0xA457, 0xA45C, 0xA45D, 0xA45F, 0xA466, 0xA468, 0xA46A, 0xA46B, 0xA46C, 0xA470, 0xA473, 0xA475,
+    0xA476, 0xA477, 0xA47A, 0xA47E, 0xA4A3, 0xA4A4, 0xA4A7, 0xA4AD, 0xA4B0, 0xA4B5, 0xA4B8, 0xA4BA, 0xA4BB,
+    0xA4BD, 0xA4C0, 0xA4C1, 0xA4C6, 0xA4CE, 0xA4CF, 0xA4D1, 0xA4D2, 0xA4D3, 0xA4D6, 0xA4DE, 0xA4DF, 0xA4E2,
+    0xA4E4, 0xA4E5, 0xA4E8, 0xA4E9, 0xA4EB, 0xA4F1, 0xA4F4, 0xA4F5, 0xA4F9, 0xA4FD, 0xA540, 0xA542, 0xA544,
+    0xA547, 0xA548, 0xA54C, 0xA54E, 0xA54F, 0xA558, 0xA55B, 0xA55C, 0xA55D, 0xA55F, 0xA568, 0xA569, 0xA56A,
+    0xA571, 0xA573, 0xA574, 0xA575, 0xA576, 0xA578, 0xA57C, 0xA57E, 0xA5A2, 0xA5A6, 0xA5AB, 0xA5AC, 0xA5AD,
+    0xA5B2, 0xA5B4, 0xA5BB, 0xA5BC, 0xA5BF, 0xA5C1, 0xA5CD, 0xA5CE, 0xA5D1, 0xA5D5, 0xA5D8, 0xA5DB, 0xA5DC,
+    0xA5DF, 0xA5E6, 0xA5F3, 0xA5F4, 0xA5F8, 0xA5FA, 0xA5FD, 0xA5FE, 0xA640, 0xA641, 0xA643, 0xA650, 0xA655,
+    0xA656, 0xA657, 0xA658, 0xA659, 0xA65A, 0xA65D, 0xA65E, 0xA661, 0xA662, 0xA668, 0xA66E, 0xA66F, 0xA670,
+    0xA672, 0xA673, 0xA677, 0xA67D, 0xA67E, 0xA6A1, 0xA6A8, 0xA6AC, 0xA6AD, 0xA6B3, 0xA6B8, 0xA6B9, 0xA6BA,
+    0xA6CA, 0xA6D1, 0xA6D2, 0xA6D3, 0xA6DB, 0xA6DC, 0xA6E2, 0xA6E6, 0xA6E8, 0xA6EC, 0xA6ED, 0xA6F3, 0xA6FC,
+    0xA6FD, 0xA740, 0xA741, 0xA74C, 0xA74F, 0xA751, 0xA759, 0xA761, 0xA769, 0xA776, 0xA7B9, 0xA7BD, 0xA7C6,
+    0xA7CE, 0xA7D6, 0xA7DA, 0xA7DE, 0xA7E2, 0xA7E4, 0xA7EF, 0xA7F3, 0xA7F5, 0xA842, 0xA843, 0xA844, 0xA84D,
+    0xA853, 0xA873, 0xA874, 0xA8A3, 0xA8A5, 0xA8AB, 0xA8AD, 0xA8AE, 0xA8BA, 0xA8BD, 0xA8C6, 0xA8C7, 0xA8C8,
+    0xA8CF, 0xA8D3, 0xA8E2, 0xA8E3, 0xA8E4, 0xA8EC, 0xA8FA, 0xA8FC, 0xA94D, 0xA94F, 0xA950, 0xA952, 0xA965,
+    0xA96C, 0xA977, 0xA978, 0xA9B2, 0xA9B9, 0xA9C0, 0xA9CA, 0xA9CE, 0xA9D2, 0xA9D4, 0xA9F1, 0xA9F6, 0xA9FA,
+    0xAA41, 0xAA46, 0xAA47, 0xAA4C, 0xAA5A, 0xAA60, 0xAA6B, 0xAA70, 0xAA76, 0xAAA7, 0xAAAB, 0xAABA, 0xAABD,
+    0xAABE, 0xAAC0, 0xAAC5, 0xAACC, 0xAAE1, 0xAAED, 0xAAF1, 0xAAF7, 0xAAF8, 0xAAF9, 0xAAFC, 0xAB43, 0xAB44,
+    0xAB48, 0xAB4B, 0xAB4F, 0xAB65, 0xAB68, 0xAB6E, 0xAB6F, 0xAB7E, 0xABB0, 0xABD7, 0xABD8, 0xABDC, 0xABE4,
+    0xABE7, 0xABF9, 0xABFC, 0xAC4F, 0xAC64, 0xAC79, 0xACA1, 0xACB0, 0xACC9, 0xACDB, 0xACDD, 0xACE3, 0xACEC,
+    0xACF0, 0xACF5, 0xACF9, 0xACFC, 0xAD5E, 0xAD6E, 0xAD70, 0xADAB, 0xADB1, 0xADB7, 0xADB8, 0xADBA, 0xADCC,
+    0xADD3, 0xADD4, 0xADE3, 0xADEC, 0xADFB, 0xAE61, 0xAE65, 0xAE69, 0xAE76, 0xAEA7, 0xAEC9, 0xAED1, 0xAEDA,
+    0xAEE6, 0xAEF8, 0xAEFC, 0xAF53, 0xAF66, 0xAF75, 0xAFAB, 0xAFBA, 0xAFC5, 0xAFE0, 0xB04F, 0xB05F, 0xB07C,
+    0xB0A3, 0xB0A8, 0xB0AA, 0xB0B5, 0xB0C8, 0xB0CA, 0xB0CF, 0xB0D1, 0xB0D3, 0xB0DD, 0xB0EA, 0xB0F2, 0xB14D,
+    0xB14E, 0xB160, 0xB161, 0xB169, 0xB16A, 0xB16F, 0xB171, 0xB1A1, 0xB1B5, 0xB1C0, 0xB1D0, 0xB1E6, 0xB1F8,
+    0xB24D, 0xB260, 0xB27A, 0xB27B, 0xB2A3, 0xB2B3, 0xB2B4, 0xB2C4, 0xB2CE, 0xB2D5, 0xB342, 0xB34E, 0xB351,
+    0xB357, 0xB35C, 0xB35D, 0xB36F, 0xB371, 0xB373, 0xB379, 0xB3A1, 0xB3A3, 0xB3C6, 0xB3CC, 0xB3E6, 0xB3F5,
+    0xB3F8, 0xB44E, 0xB4A3, 0xB4BF, 0xB4C1, 0xB54C, 0xB54D, 0xB56F, 0xB57B, 0xB5A5, 0xB5B2, 0xB5B9, 0xB5D8,
+    0xB5DB, 0xB5F8, 0xB648, 0xB64F, 0xB656, 0xB669, 0xB671, 0xB67D, 0xB6A1, 0xB6B0, 0xB6B7, 0xB6C7, 0xB6C8,
+    0xB6D5, 0xB6DC, 0xB74E, 0xB750, 0xB751, 0xB752, 0xB773, 0xB77C, 0xB77E, 0xB7D3, 0xB7ED, 0xB867, 0xB871,
+    0xB8A8, 0xB8B9, 0xB8CB, 0xB8D1, 0xB8D3, 0xB8DC, 0xB8EA, 0xB8F4, 0xB8FB, 0xB941, 0xB942, 0xB944, 0xB946,
+    0xB94C, 0xB971, 0xB9B3, 0xB9CE, 0xB9CF, 0xB9EA, 0xB9EF, 0xBAA1, 0xBAC9, 0xBAD9, 0xBADE, 0xBAE2, 0xBAEB,
+    0xBB79, 0xBB7B, 0xBBA1, 0xBBB4, 0xBBB7, 0xBBDA, 0xBBDD, 0xBBE2, 0xBC57, 0xBC67, 0xBC73, 0xBC76, 0xBCC6,
+    0xBCCB, 0xBCD0, 0xBD75, 0xBDCD, 0xBDD0, 0xBDD5, 0xBDD7, 0xBDE8, 0xBEB9, 0xBEC7, 0xBEC9, 0xBEE3, 0xBEFA,
+    0xBFCB, 0xBFEC, 0xBFEF, 0xC048, 0xC059, 0xC0B3, 0xC0BB, 0xC160, 0xC16E, 0xC170, 0xC1D9, 0xC1F6, 0xC249,
+    0xC25F, 0xC2E0, 0xC2E5, 0xC344, 0xC3B9, 0xC3D1, 0xC3D2, 0xC3E4, 0xC3F6, 0xC3F8, 0xC3FE, 0xC4B1, 0xC4B3,
+    0xC554, 0xC576, 0xC5DC, 0xC5E3, 0xC5FD, 0xC65B, 0xC945, 0xC94F, 0xC961, 0xC9B2, 0xC9F3, 0xCA5E, 0xCCE5,
+    0xCE60, 0xCFFA, 0xD0DE, 0xD575, 0xD6C3, 0xDACC,
+};
+
+// The 301 most frequently-used Hangul syllables, encoded in EUC-KR
+static const uint16_t EUCKR_COMMON_CHARACTERS[] = {
+    0xB0A1, 0xB0A2, 0xB0A3, 0xB0B0, 0xB0B3, 0xB0C5, 0xB0C7, 0xB0C9, 0xB0CD, 0xB0D4, 0xB0DA, 0xB0E1, 0xB0E6,
+    0xB0ED, 0xB0F7, 0xB0F8, 0xB0FC, 0xB1B8, 0xB1D7, 0xB1DD, 0xB1E2, 0xB1E6, 0xB1EE, 0xB2DE, 0xB3AA, 0xB3AD,
+    0xB3AF, 0xB3BB, 0xB3C4, 0xB3C9, 0xB3CA, 0xB3D7, 0xB4AB, 0xB4C2, 0xB4CF, 0xB4D9, 0xB4DC, 0xB4E7, 0xB4EB,
+    0xB4F5, 0xB4F8, 0xB5A5, 0xB5B5, 0xB5BF, 0xB5C7, 0xB5CE, 0xB5E5, 0xB5E9, 0xB5ED, 0xB6A7, 0xB6B0, 0xB6C7,
+    0xB6F3, 0xB6F7, 0xB6FB, 0xB7A1, 0xB7B1, 0xB7B3, 0xB7B8, 0xB7C1, 0xB7C2, 0xB7C8, 0xB7CE, 0xB8A3, 0xB8A5,
+    0xB8A6, 0xB8A7, 0xB8AE, 0xB8B1, 0xB8B6, 0xB8B8, 0xB8BB, 0xB8BE, 0xB8E9, 0xB8ED, 0xB8F0, 0xB8F8, 0xB9AB,
+    0xB9AE, 0xB9B0, 0xB9B9, 0xB9CC, 0xB9D7, 0xB9D9, 0xB9DB, 0xB9DD, 0xB9DE, 0xB9DF, 0xB9E0, 0xB9E3, 0xB9E6,
+    0xB9F6, 0xB9F8, 0xB9FA, 0xBAAE, 0xBAAF, 0xBAB0, 0xBAB8, 0xBAB9, 0xBABB, 0xBABD, 0xBAC1, 0xBACE, 0xBAD0,
+    0xBAF1, 0xBAFB, 0xBAFC, 0xBBD3, 0xBBE7, 0xBBF3, 0xBBF5, 0xBBF6, 0xBBFD, 0xBCAD, 0xBCAE, 0xBCB1, 0xBCB6,
+    0xBCBA, 0xBCBC, 0xBCD2, 0xBCD3, 0xBCD5, 0xBCF6, 0xBCFB, 0xBDAC, 0xBDBA, 0xBDBD, 0xBDC0, 0xBDC3, 0xBDC4,
+    0xBDC5, 0xBDC7, 0xBEB2, 0xBEBE, 0xBEC6, 0xBEC7, 0xBEC8, 0xBECB, 0xBED5, 0xBED6, 0xBEDF, 0xBEE0, 0xBEE7,
+    0xBEEA, 0xBEEE, 0xBEF3, 0xBEF6, 0xBEF7, 0xBEF8, 0xBEFA, 0xBFA1, 0xBFA3, 0xBFA4, 0xBFA9, 0xBFAC, 0xBFAD,
+    0xBFB4, 0xBFB5, 0xBFB7, 0xBFB9, 0xBFC0, 0xBFCA, 0xBFCD, 0xBFCF, 0xBFD4, 0xBFD6, 0xBFDC, 0xBFE4, 0xBFE5,
+    0xBFEB, 0xBFEC, 0xBFEE, 0xBFEF, 0xBFF2, 0xBFF4, 0xBFF6, 0xBFF8, 0xBFFC, 0xC0A7, 0xC0AF, 0xC0BA, 0xC0BB,
+    0xC0BD, 0xC0C0, 0xC0C7, 0xC0CC, 0xC0CE, 0xC0CF, 0xC0D4, 0xC0D6, 0xC0D8, 0xC0DA, 0xC0DB, 0xC0DD, 0xC0DF,
+    0xC0E1, 0xC0E2, 0xC0E5, 0xC0FA, 0xC0FB, 0xC0FC, 0xC0FD, 0xC1A1, 0xC1A4, 0xC1A6, 0xC1A8, 0xC1AE, 0xC1B3,
+    0xC1B6, 0xC1BB, 0xC1C1, 0xC1D2, 0xC1D6, 0xC1D7, 0xC1D8, 0xC1D9, 0xC1DF, 0xC1E0, 0xC1F1, 0xC1F5, 0xC1F6,
+    0xC1F8, 0xC1FD, 0xC1FE, 0xC2A5, 0xC2B0, 0xC3A3, 0xC3A4, 0xC3A5, 0xC3B3, 0xC3B5, 0xC3BB, 0xC3CA, 0xC3DF,
+    0xC3E2, 0xC3E3, 0xC3E6, 0xC3EB, 0xC4A1, 0xC4A3, 0xC4A5, 0xC4AE, 0xC4BF, 0xC4D1, 0xC4DA, 0xC5A9, 0xC5AB,
+    0xC5B0, 0xC5B8, 0xC5BB, 0xC5CD, 0xC5D7, 0xC5D9, 0xC5E4, 0xC5E5, 0xC5EB, 0xC6AE, 0xC6AF, 0xC6B0, 0xC6C4,
+    0xC6C7, 0xC6ED, 0xC6F2, 0xC6F7, 0xC6F8, 0xC7A5, 0xC7B0, 0xC7C1, 0xC7C7, 0xC7CA, 0xC7CE, 0xC7CF, 0xC7D0,
+    0xC7D1, 0xC7D2, 0xC7D4, 0xC7D5, 0xC7D7, 0xC7D8, 0xC7DF, 0xC7E0, 0xC7E2, 0xC7E3, 0xC7EC, 0xC7F6, 0xC8A3,
+    0xC8A5, 0xC8A6, 0xC8AD, 0xC8AF, 0xC8B0, 0xC8B2, 0xC8B8, 0xC8C4, 0xC8CE, 0xC8D6, 0xC8E7, 0xC8EA, 0xC8F1,
+    0xC8F7, 0xC8FB,
+};
+
+static bool is_common_character(const uint16_t* begin, const uint16_t* end, uint8_t lead, uint8_t trail)
+{
+    return std::binary_search(begin, end, uint16_t((lead << 8) | trail));
+}
+
+static int score_gbk_byte(uint8_t byte)
+{
+    if(byte == 0x80)
+    {
+        return SCORE_UNLIKELY; // The Euro sign
+    }
+    return (byte == 0xFF) ? SCORE_INVALID : SCORE_LEAD_BYTE;
+}
+
+static int score_gbk_pair(uint8_t lead, uint8_t trail)
+{
+    if((trail < 0x40) || (trail == 0x7F) || (trail == 0xFF))
+    {
+        return SCORE_INVALID;
+    }
+    if(is_common_character(std::begin(GBK_COMMON_CHARACTERS), std::end(GBK_COMMON_CHARACTERS), lead, trail))
+    {
+        return SCORE_COMMON;
+    }
+
+    const bool is_gb2312_hanzi = (lead >= 0xB0) && (lead <= 0xF7) && (trail >= 0xA1);
+    const bool is_punctuation = ((lead == 0xA1) || (lead == 0xA3)) && (trail >= 0xA1);
+    return (is_gb2312_hanzi || is_punctuation) ? SCORE_LIKELY : SCORE_OTHER;
+}
+
+static int score_big5_byte(uint8_t byte)
+{
+    return ((byte == 0x80) || (byte == 0xFF)) ? SCORE_INVALID : SCORE_LEAD_BYTE;
+}
+
+static int score_big5_pair(uint8_t lead, uint8_t trail)
+{
+    if(!(((trail >= 0x40) && (trail <= 0x7E)) || ((trail >= 0xA1) && (trail <= 0xFE))))
+    {
+        return SCORE_INVALID;
+    }
+    if(is_common_character(std::begin(BIG5_COMMON_CHARACTERS), std::end(BIG5_COMMON_CHARACTERS), lead, trail))
+    {
+        return SCORE_COMMON;
+    }
+
+    const uint16_t code = uint16_t((lead << 8) | trail);
+    const bool is_frequent_hanzi = (code >= 0xA440) && (code <= 0xC67E);
+    const bool is_punctuation = (lead == 0xA1);
+    return (is_frequent_hanzi || is_punctuation) ? SCORE_LIKELY : SCORE_OTHER;
+}
+
+static int score_euckr_byte(uint8_t byte)
+{
+    return ((byte == 0x80) || (byte == 0xFF)) ? SCORE_INVALID : SCORE_LEAD_BYTE;
+}
+
+// NOTE: Codepage 949 is actually Unified Hangul Code, which extends EUC-KR with the (rarely-used) Hangul syllables
+//       that EUC-KR can't encode, using trail bytes that EUC-KR doesn't use.
+static int score_euckr_pair(uint8_t lead, uint8_t trail)
+{
+    if(!(((trail >= 0x41) && (trail <= 0x5A)) || ((trail >= 0x61) && (trail <= 0x7A)) || (trail >= 0x81))
+       || (trail == 0xFF))
+    {
+        return SCORE_INVALID;
+    }
+    if(is_common_character(std::begin(EUCKR_COMMON_CHARACTERS), std::end(EUCKR_COMMON_CHARACTERS), lead, trail))
+    {
+        return SCORE_COMMON;
+    }
+
+    const bool is_hangul = (lead >= 0xB0) && (lead <= 0xC8) && (trail >= 0xA1);
+    const bool is_punctuation = ((lead == 0xA1) || (lead == 0xA3)) && (trail >= 0xA1);
+    return (is_hangul || is_punctuation) ? SCORE_LIKELY : SCORE_OTHER;
+}
+
+static int score_shiftjis_byte(uint8_t byte)
+{
+    if((byte >= 0xA1) && (byte <= 0xDF))
+    {
+        return SCORE_UNLIKELY; // Half-width katakana
+    }
+    const bool is_lead = ((byte >= 0x81) && (byte <= 0x9F)) || ((byte >= 0xE0) && (byte <= 0xFC));
+    return is_lead ? SCORE_LEAD_BYTE : SCORE_INVALID;
+}
+
+// NOTE: Japanese text is mostly made up of kana, so we don't need a list of common kanji to recognise it
+static int score_shiftjis_pair(uint8_t lead, uint8_t trail)
+{
+    if((trail < 0x40) || (trail == 0x7F) || (trail > 0xFC))
+    {
+        return SCORE_INVALID;
+    }
+
+    const bool is_hiragana = (lead == 0x82) && (trail >= 0x9F) && (trail <= 0xF1);
+    const bool is_katakana = (lead == 0x83) && (trail <= 0x96);
+    if(is_hiragana || is_katakana)
+    {
+        return SCORE_COMMON;
+    }
+
+    const uint16_t code = uint16_t((lead << 8) | trail);
+    const bool is_level1_kanji = (code >= 0x889F) && (code <= 0x9872);
+    const bool is_punctuation = (lead == 0x81);
+    return (is_level1_kanji || is_punctuation) ? SCORE_LIKELY : SCORE_OTHER;
+}
+
+struct DoubleByteEncoding
+{
+    uint32_t codepage;
+    int (*score_byte)(uint8_t byte); // The score of a non-ASCII byte that does not follow a lead byte
+    int (*score_pair)(uint8_t lead, uint8_t trail);
+};
+
+static const DoubleByteEncoding DOUBLE_BYTE_ENCODINGS[] = {
+    { charset::CODEPAGE_GBK, score_gbk_byte, score_gbk_pair },
+    { charset::CODEPAGE_SHIFT_JIS, score_shiftjis_byte, score_shiftjis_pair },
+    { charset::CODEPAGE_BIG5, score_big5_byte, score_big5_pair },
+    { charset::CODEPAGE_EUC_KR, score_euckr_byte, score_euckr_pair },
+};
+static const size_t DOUBLE_BYTE_ENCODING_COUNT = std::size(DOUBLE_BYTE_ENCODINGS);
+
+struct DoubleByteScore
+{
+    int64_t score;
+    bool valid;
+    uint8_t lead_byte; // The first byte of the current character, if we're part-way through a two-byte character
+};
+
+static void score_double_byte(const DoubleByteEncoding& encoding, DoubleByteScore& state, uint8_t byte)
+{
+    int score = SCORE_OTHER;
+    if(state.lead_byte != 0)
+    {
+        score = encoding.score_pair(state.lead_byte, byte);
+        state.lead_byte = 0;
+
+        // NOTE: Most of these encodings allow ASCII letters as trail bytes, so a single-byte symbol followed by a
+        //       letter (e.g the apostrophe in "don't" in Windows-1252) is also a valid double-byte character.
+        //       Real text rarely has such characters other than the common ones, so they count against the encoding.
+        const bool is_ascii_letter_trail = (get_ascii_letter_case(byte) != LetterCase::None);
+        if((score != SCORE_INVALID) && (score < SCORE_COMMON) && is_ascii_letter_trail)
+        {
+            score = SCORE_UNLIKELY;
+        }
+    }
+    else if(byte >= 0x80)
+    {
+        score = encoding.score_byte(byte);
+        if(score == SCORE_LEAD_BYTE)
+        {
+            state.lead_byte = byte;
+            return;
+        }
+    }
+
+    if(score == SCORE_INVALID)
+    {
+        state.valid = false;
+    }
+    else
+    {
+        state.score += score;
+    }
+}
+
+// ==========================
+// Unicode encodings
+// ==========================
+// Validates UTF-8 one byte at a time, rejecting overlong encodings, surrogates and code points above U+10FFFF
+struct Utf8Validator
+{
+    int remaining; // The number of continuation bytes still to come in the current sequence
+    uint8_t lower; // The range of values allowed for the next continuation byte
+    uint8_t upper;
+    bool valid;
+
+    void add(uint8_t byte)
+    {
+        if(remaining > 0)
+        {
+            valid &= (byte >= lower) && (byte <= upper);
+            lower = 0x80;
+            upper = 0xBF;
+            remaining--;
+            return;
+        }
+
+        lower = 0x80;
+        upper = 0xBF;
+        if(byte < 0x80)
+        {
+            remaining = 0;
+        }
+        else if((byte >= 0xC2) && (byte <= 0xDF))
+        {
+            remaining = 1;
+        }
+        else if((byte >= 0xE0) && (byte <= 0xEF))
+        {
+            remaining = 2;
+            lower = (byte == 0xE0) ? 0xA0 : 0x80;
+            upper = (byte == 0xED) ? 0x9F : 0xBF;
+        }
+        else if((byte >= 0xF0) && (byte <= 0xF4))
+        {
+            remaining = 3;
+            lower = (byte == 0xF0) ? 0x90 : 0x80;
+            upper = (byte == 0xF4) ? 0x8F : 0xBF;
+        }
+        else
+        {
+            valid = false;
+        }
+    }
+};
+
+// ==========================
+// Detection
+// ==========================
+// Returns the number of leading bytes of the given text that are ASCII characters other than null, which tells
+// us how much of the text we can skip past without looking at each byte individually. Lyrics are mostly ASCII
+// (if only because of the timestamps), so this is the difference between looking at a few bytes at a time and many.
+static size_t count_leading_plain_ascii(const uint8_t* text, size_t length)
+{
+    size_t index = 0;
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+    const __m128i null = _mm_setzero_si128();
+    while(index + sizeof(__m128i) <= length)
+    {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + index));
+        const int stop_mask = _mm_movemask_epi8(chunk) | _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, null));
+        if(stop_mask != 0)
+        {
+#if defined(_M_X64) || defined(_M_IX86)
+            unsigned long first_stop = 0;
+            _BitScanForward(&first_stop, static_cast<unsigned long>(stop_mask));
+            return index + first_stop;
+#else
+            return index + size_t(__builtin_ctz(static_cast<unsigned int>(stop_mask)));
+#endif
+        }
+        index += sizeof(__m128i);
+    }
+#else
+    const uint64_t low_bits = 0x0101010101010101ull;
+    const uint64_t high_bits = 0x8080808080808080ull;
+    while(index + sizeof(uint64_t) <= length)
+    {
+        uint64_t chunk = 0;
+        memcpy(&chunk, text + index, sizeof(chunk));
+        const uint64_t has_null = (chunk - low_bits) & ~chunk & high_bits;
+        if(((chunk & high_bits) != 0) || (has_null != 0))
+        {
+            break;
+        }
+        index += sizeof(uint64_t);
+    }
+#endif
+
+    while((index < length) && (text[index] != 0) && (text[index] < 0x80))
+    {
+        index++;
+    }
+    return index;
+}
+
+struct UnicodeStatistics
+{
+    Utf8Validator utf8;
+    size_t even_nulls; // The number of null bytes at even & odd offsets, which are common in UTF-16 text
+    size_t odd_nulls;
+};
+
+static UnicodeStatistics get_unicode_statistics(const uint8_t* text, size_t length)
+{
+    UnicodeStatistics stats = {};
+    stats.utf8.valid = true;
+
+    size_t index = 0;
+    while(index < length)
+    {
+        if(stats.utf8.remaining == 0)
+        {
+            index += count_leading_plain_ascii(text + index, length - index);
+            if(index == length)
+            {
+                break;
+            }
+        }
+
+        const uint8_t byte = text[index];
+        if(byte == 0)
+        {
+            ((index % 2 == 0) ? stats.even_nulls : stats.odd_nulls)++;
+        }
+        stats.utf8.add(byte);
+        index++;
+    }
+    return stats;
+}
+
+struct LegacyScores
+{
+    SingleByteScore single_byte[SINGLE_BYTE_ENCODING_COUNT];
+    DoubleByteScore double_byte[DOUBLE_BYTE_ENCODING_COUNT];
+
+    // Returns true if we're part-way through a character (or a word, in a single-byte encoding whose score
+    // depends on the letters in each word) in any of the encodings that the text is still valid in
+    bool is_mid_character() const
+    {
+        for(const DoubleByteScore& state : double_byte)
+        {
+            if(state.valid && (state.lead_byte != 0))
+            {
+                return true;
+            }
+        }
+        for(const SingleByteScore& state : single_byte)
+        {
+            if(state.valid && ((state.previous == LetterCase::Lower) || (state.previous == LetterCase::Upper)))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+static LegacyScores get_legacy_scores(const uint8_t* text, size_t length)
+{
+    LegacyScores scores = {};
+    for(SingleByteScore& state : scores.single_byte)
+    {
+        state.valid = true;
+    }
+    for(DoubleByteScore& state : scores.double_byte)
+    {
+        state.valid = true;
+    }
+
+    size_t index = 0;
+    while(index < length)
+    {
+        if(!scores.is_mid_character())
+        {
+            // NOTE: A run of ASCII characters doesn't change the score in any encoding, only which (if any) ASCII
+            //       letter the next character follows.
+            const size_t ascii_length = count_leading_plain_ascii(text + index, length - index);
+            if(ascii_length > 0)
+            {
+                index += ascii_length;
+                const LetterCase letter_case = get_ascii_letter_case(text[index - 1]);
+                for(SingleByteScore& state : scores.single_byte)
+                {
+                    state.previous = letter_case;
+                }
+                continue;
+            }
+        }
+
+        const uint8_t byte = text[index];
+        for(size_t i = 0; i < SINGLE_BYTE_ENCODING_COUNT; i++)
+        {
+            if(scores.single_byte[i].valid)
+            {
+                score_single_byte(SINGLE_BYTE_ENCODINGS[i], scores.single_byte[i], byte);
+            }
+        }
+        for(size_t i = 0; i < DOUBLE_BYTE_ENCODING_COUNT; i++)
+        {
+            if(scores.double_byte[i].valid)
+            {
+                score_double_byte(DOUBLE_BYTE_ENCODINGS[i], scores.double_byte[i], byte);
+            }
+        }
+        index++;
+    }
+    return scores;
+}
+
+charset::Detection charset::detect(const uint8_t* text, size_t length)
+{
+    if((length >= 2) && (text[0] == 0xFF) && (text[1] == 0xFE))
+    {
+        return { CODEPAGE_UTF16LE, 2, CODEPAGE_UNKNOWN };
+    }
+    if((length >= 2) && (text[0] == 0xFE) && (text[1] == 0xFF))
+    {
+        return { CODEPAGE_UTF16BE, 2, CODEPAGE_UNKNOWN };
+    }
+    const bool has_utf8_bom = (length >= 3) && (text[0] == 0xEF) && (text[1] == 0xBB) && (text[2] == 0xBF);
+    const size_t bom_length = has_utf8_bom ? 3 : 0;
+
+    // NOTE: Text in any of the other encodings never contains null bytes, but most UTF-16 text (without a byte-order
+    //       mark) has lots of them, because every ASCII character has a null byte as either its first or second byte.
+    const UnicodeStatistics unicode_stats = get_unicode_statistics(text + bom_length, length - bom_length);
+    const size_t null_count = unicode_stats.even_nulls + unicode_stats.odd_nulls;
+    if(!has_utf8_bom && (length % 2 == 0) && (null_count > 0) && (null_count >= length / 16))
+    {
+        const bool is_little_endian = (unicode_stats.odd_nulls >= unicode_stats.even_nulls);
+        return { is_little_endian ? CODEPAGE_UTF16LE : CODEPAGE_UTF16BE, 0, CODEPAGE_UNKNOWN };
+    }
+    if(unicode_stats.utf8.valid && (unicode_stats.utf8.remaining == 0))
+    {
+        return { CODEPAGE_UTF8, bom_length, CODEPAGE_UNKNOWN };
+    }
+
+    // NOTE: We compare the encodings in the order that they're listed, so ties go to the earlier encodings.
+    //       Text that contains only punctuation & symbols (e.g "smart" quotes in otherwise-ASCII text) has no score
+    //       in any encoding, but is still more likely to be in the first valid encoding than anything else.
+    const LegacyScores scores = get_legacy_scores(text + bom_length, length - bom_length);
+    Detection result = { CODEPAGE_UNKNOWN, bom_length, CODEPAGE_UNKNOWN };
+    int64_t best_score = 0;
+    int64_t next_best_score = 0;
+    const auto add_candidate = [&](uint32_t codepage, int64_t score)
+    {
+        if((result.codepage == CODEPAGE_UNKNOWN) || (score > best_score))
+        {
+            result.next_best_codepage = result.codepage;
+            next_best_score = best_score;
+            result.codepage = codepage;
+            best_score = score;
+        }
+        else if((result.next_best_codepage == CODEPAGE_UNKNOWN) || (score > next_best_score))
+        {
+            result.next_best_codepage = codepage;
+            next_best_score = score;
+        }
+    };
+    for(size_t i = 0; i < SINGLE_BYTE_ENCODING_COUNT; i++)
+    {
+        if(scores.single_byte[i].valid)
+        {
+            add_candidate(SINGLE_BYTE_ENCODINGS[i].codepage, scores.single_byte[i].score);
+        }
+    }
+    for(size_t i = 0; i < DOUBLE_BYTE_ENCODING_COUNT; i++)
+    {
+        if(scores.double_byte[i].valid)
+        {
+            add_candidate(DOUBLE_BYTE_ENCODINGS[i].codepage, scores.double_byte[i].score);
+        }
+    }
+    return result;
+}
+
+// ============
+// Tests
+// ============
+// The detector can be built & run on its own (on any platform) to measure its accuracy & speed, e.g:
+// g++ -std=c++17 -O2 -DCHARSET_DETECTION_STANDALONE src/charset_detection.cpp -o charset_detection
+#if MVTF_TESTS_ENABLED || defined(CHARSET_DETECTION_STANDALONE)
+struct CorpusSample
+{
+    const char* language;
+    uint32_t codepage;
+    const char* text;
+};
+
+// Short snippets of (made-up) lyrics, in each of the encodings that we can detect
+static const CorpusSample CORPUS[] = {
+    { "Simplified Chinese", charset::CODEPAGE_GBK,
+      "[ti:\xD2\xB9\xBF\xD5]\n[00:05.00]\xD2\xB9\xBF\xD5\xD6\xD0\xD7\xEE\xC1\xC1\xB5\xC4\xB5\xC6\xA3\xAC\xD5"
+      "\xD5\xC1\xC1\xC1\xCB\xBB\xD8\xBC\xD2\xB5\xC4\xC2\xB7\n[00:10.20]\xC4\xE3\xB5\xC4\xD0\xA6\xC8\xDD\xCA\xC7"
+      "\xCE\xD2\xD0\xC4\xC0\xEF\xD3\xC0\xD4\xB6\xB5\xC4\xCE\xC2\xC5\xAF\n[00:15.40]\xCA\xB1\xBC\xE4\xB9\xFD\xC8"
+      "\xA5\xC1\xCB\xA3\xAC\xBF\xC9\xCA\xC7\xB0\xAE\xBB\xB9\xC3\xBB\xD3\xD0\xD7\xDF\xD4\xB6\n" },
+    { "Simplified Chinese", charset::CODEPAGE_GBK,
+      "[00:12.30]\xCE\xD2\xC3\xC7\xD2\xBB\xC6\xF0\xD7\xDF\xB9\xFD\xB4\xBA\xCC\xEC\xB5\xC4\xD0\xA1\xC2\xB7\n[00:"
+      "16.80]\xB7\xE7\xB4\xB5\xD7\xC5\xC4\xE3\xB5\xC4\xCD\xB7\xB7\xA2\xA3\xAC\xCE\xD2\xCF\xEB\xC6\xF0\xC4\xC7"
+      "\xC4\xEA\xCF\xC4\xCC\xEC\n[00:21.50]\xB2\xBB\xD2\xAA\xCB\xB5\xD4\xD9\xBC\xFB\xA3\xAC\xCE\xD2\xBB\xE1\xD2"
+      "\xBB\xD6\xB1\xD4\xDA\xD5\xE2\xC0\xEF\xB5\xC8\xC4\xE3\n" },
+    { "Traditional Chinese", charset::CODEPAGE_BIG5,
+      "[00:12.30]\xA7\xDA\xAD\xCC\xA4@\xB0_\xA8\xAB\xB9L\xACK\xA4\xD1\xAA\xBA\xA4p\xB8\xF4\n[00:16.80]\xAD\xB7"
+      "\xA7j\xB5\xDB\xA7" "A\xAA\xBA\xC0Y\xBEv\xA1" "A\xA7\xDA\xB7Q\xB0_\xA8\xBA\xA6~\xAEL\xA4\xD1\n[00:21.50]"
+      "\xA4\xA3\xADn\xBB\xA1\xA6" "A\xA8\xA3\xA1" "A\xA7\xDA\xB7|\xA4@\xAA\xBD\xA6" "b\xB3o\xB8\xCC\xB5\xA5\xA7"
+      "A\n" },
+    { "Traditional Chinese", charset::CODEPAGE_BIG5,
+      "[00:03.00]\xAB" "B\xB0\xB1\xA4" "F\xA5H\xAB\xE1\xA1" "A\xAB\xB0\xA5\xAB\xAA\xBA\xBFO\xA5\xFA\xBA" "C\xBA"
+      "C\xABG\xB0_\n[00:08.50]\xA7\xDA\xA7\xE2\xAB\xE4\xA9\xC0\xBCg\xA6" "b\xABH\xB8\xCC\xA1" "A\xB1H\xB5\xB9"
+      "\xBB\xB7\xA4\xE8\xAA\xBA\xA7" "A\n[00:14.00]\xA6p\xAAG\xA6\xB3\xA4@\xA4\xD1\xA7" "A\xA6^\xA8\xD3\xA1" "A"
+      "\xBD\xD0\xB0O\xB1o\xB3o\xAD\xBA\xBAq\n" },
+    { "Japanese", charset::CODEPAGE_SHIFT_JIS,
+      "[00:10.00]\x8CN\x82\xC6\x95\xE0\x82\xA2\x82\xBD\x8B" "A\x82\xE8\x93\xB9\x82\xF0\x8D\xA1\x82\xE0\x8Ao\x82"
+      "\xA6\x82\xC4\x82\xA2\x82\xE9\n[00:15.20]\x96\xE9\x8B\xF3\x82\xC9\x8C\xF5\x82\xE9\x90\xAF\x82\xBD\x82\xBF"
+      "\x82\xAA\x97" "D\x82\xB5\x82\xAD\x8F\xCE\x82\xC1\x82\xC4\x82\xBD\n[00:20.40]\x82\xB3\x82\xE6\x82\xC8\x82"
+      "\xE7\x82\xCD\x8C\xBE\x82\xED\x82\xC8\x82\xA2\x82\xC5\x81" "A\x82\xDC\x82\xBD\x89\xEF\x82\xA6\x82\xE9\x82"
+      "\xA9\x82\xE7\n" },
+    { "Japanese", charset::CODEPAGE_SHIFT_JIS,
+      "[00:02.00]\x8Ft\x82\xCC\x95\x97\x82\xAA\x90\x81\x82\xA2\x82\xC4\x81" "A\x8D\xF7\x82\xCC\x89\xD4\x82\xD1"
+      "\x82\xE7\x82\xAA\x95\x91\x82\xA4\n[00:07.30]\x82\xA0\x82\xCC\x93\xFA\x82\xCC\x96\xF1\x91\xA9\x82\xF0\x82"
+      "\xB8\x82\xC1\x82\xC6\x8B\xB9\x82\xC9\x82\xB5\x82\xDC\x82\xC1\x82\xC4\x82\xE9\n[00:12.60]\x82\xA0\x82\xE8"
+      "\x82\xAA\x82\xC6\x82\xA4\x81" "A\x91\xE5\x8D" "D\x82\xAB\x82\xBE\x82\xE6\n" },
+    { "Korean", charset::CODEPAGE_EUC_KR,
+      "[00:11.00]\xB3\xCA\xBF\xCD \xC7\xD4\xB2\xB2 \xB0\xC8\xB4\xF8 \xB1\xD7 \xB1\xE6\xC0\xBB \xBE\xC6\xC1\xF7"
+      "\xB5\xB5 \xB1\xE2\xBE\xEF\xC7\xD8\n[00:15.50]\xB9\xE3\xC7\xCF\xB4\xC3\xC0\xC7 \xBA\xB0\xB5\xE9\xC0\xCC "
+      "\xBF\xEC\xB8\xAE\xB8\xA6 \xBA\xF1\xC3\xDF\xB0\xED \xC0\xD6\xBE\xEE\n[00:20.00]\xBB\xE7\xB6\xFB\xC7\xD1"
+      "\xB4\xD9\xB4\xC2 \xB8\xBB\xC0\xBB \xC0\xCC\xC1\xA6\xBE\xDF \xC0\xFC\xC7\xCF\xB0\xED \xBD\xCD\xBE\xEE\n" },
+    { "Korean", charset::CODEPAGE_EUC_KR,
+      "[00:04.00]\xBA\xF1\xB0\xA1 \xB3\xBB\xB8\xAE\xB4\xC2 \xB3\xAF\xC0\xCC\xB8\xE9 \xB3\xD7 \xBB\xFD\xB0\xA2"
+      "\xC0\xCC \xB3\xAA\n[00:09.00]\xBF\xEC\xB8\xAE\xC0\xC7 \xC3\xDF\xBE\xEF\xC0\xBA \xBF\xA9\xC0\xFC\xC8\xF7 "
+      "\xB3\xBB \xB8\xB6\xC0\xBD\xBC\xD3\xBF\xA1 \xC0\xD6\xBE\xEE\n[00:14.00]\xB4\xD9\xBD\xC3 \xB8\xB8\xB3\xAF "
+      "\xBC\xF6 \xC0\xD6\xC0\xBB\xB1\xEE\n" },
+    { "Russian", charset::CODEPAGE_CYRILLIC,
+      "[00:10.00]\xCC\xFB \xF8\xEB\xE8 \xF1 \xF2\xEE\xE1\xEE\xE9 \xEF\xEE \xF2\xE8\xF5\xEE\xE9 \xF3\xEB\xE8\xF6"
+      "\xE5 \xED\xEE\xF7\xED\xEE\xE9\n[00:14.50]\xC8 \xE7\xE2\xB8\xE7\xE4\xFB \xEF\xE0\xE4\xE0\xEB\xE8 \xE2 "
+      "\xF5\xEE\xEB\xEE\xE4\xED\xF3\xFE \xF2\xF0\xE0\xE2\xF3\n[00:19.00]\xDF \xEF\xEE\xEC\xED\xFE \xEA\xE0\xE6"
+      "\xE4\xEE\xE5 \xF1\xEB\xEE\xE2\xEE, \xEA\xE0\xE6\xE4\xFB\xE9 \xE2\xE7\xE3\xEB\xFF\xE4\n" },
+    { "Russian", charset::CODEPAGE_CYRILLIC,
+      "[00:05.00]\xC7\xE8\xEC\xE0 \xEF\xF0\xE8\xF8\xEB\xE0, \xE8 \xF1\xED\xE5\xE3 \xF3\xEA\xF0\xFB\xEB \xE2\xE5"
+      "\xF1\xFC \xE3\xEE\xF0\xEE\xE4\n[00:09.20]\xC0 \xFF \xE2\xF1\xB8 \xE6\xE4\xF3 \xF2\xE5\xE1\xFF \xF3 \xF1"
+      "\xF2\xE0\xF0\xEE\xE3\xEE \xEE\xEA\xED\xE0\n" },
+    { "Ukrainian", charset::CODEPAGE_CYRILLIC,
+      "[00:06.00]\xDF \xF7\xE5\xEA\xE0\xFE \xED\xE0 \xF2\xE5\xE1\xE5 \xE1\xB3\xEB\xFF \xF1\xF2\xE0\xF0\xEE\xBF "
+      "\xF0\xB3\xF7\xEA\xE8\n[00:10.00]\xD2\xE2\xEE\xBF \xEE\xF7\xB3 \xF1\xE2\xB3\xF2\xFF\xF2\xFC, \xEC\xEE\xE2"
+      " \xE7\xEE\xF0\xB3 \xE2\xED\xEE\xF7\xB3\n" },
+    { "French", charset::CODEPAGE_WESTERN,
+      "[00:09.00]Je marchais seul dans la rue, il \xE9tait d\xE9j\xE0 tard\n[00:13.00]Les \xE9toiles brillaient"
+      " comme des souvenirs d'\xE9t\xE9\n[00:17.50]Mon c\x9Cur bat \xE0 la m\xEAme chanson\n" },
+    { "German", charset::CODEPAGE_WESTERN,
+      "[00:08.00]Wir gingen \xFC" "ber die Br\xFC" "cke in der k\xFChlen Nacht\n[00:12.00]Ich h\xF6re deine Sti"
+      "mme, sie klingt so sch\xF6n\n[00:16.00]F\xFCr immer bleibt dieser Moment in mir\n" },
+    { "Spanish", charset::CODEPAGE_WESTERN,
+      "[00:07.00]\xBF" "D\xF3nde est\xE1s, mi amor? La noche es fr\xED" "a\n[00:11.00]Sue\xF1o con tu sonrisa y"
+      " la canci\xF3n que cant\xE1" "bamos\n[00:15.00]\xA1No me olvides nunca, ni\xF1" "a!\n" },
+    { "Portuguese", charset::CODEPAGE_WESTERN,
+      "[00:06.00]N\xE3o sei dizer adeus, meu cora\xE7\xE3o est\xE1 aqui\n[00:10.00]A saudade \xE9 uma can\xE7"
+      "\xE3o que n\xE3o tem fim\n" },
+    { "English", charset::CODEPAGE_WESTERN,
+      "[00:04.00]I don\x92t know why you\x92re leaving \x96 \x93stay\x94, I said\x85\n[00:08.00]It\x92s only th"
+      "e rain\n" },
+    { "English", charset::CODEPAGE_WESTERN, "I don\x92t know why you say goodbye" },
+    { "English", charset::CODEPAGE_WESTERN,
+      "[00:01.00]I can\x92t stop thinking of you\n[00:04.00]It\x92s late and the streets are empty\n[00:08.00]"
+      "Let\x92s go home\n" },
+    { "English", charset::CODEPAGE_WESTERN,
+      "[00:02.00]\x93" "Don\x92t go\x94\x85 I whispered\n[00:05.00]\x91Round and round\x92 we go\n" },
+    { "Polish", charset::CODEPAGE_CENTRAL_EUROPEAN,
+      "[00:05.00]Szli\x9Cmy razem przez miasto, gdy zapada\xB3 zmrok\n[00:09.00]Pami\xEAtam ka\xBF" "de s\xB3ow"
+      "o, kt\xF3re powiedzia\xB3" "a\x9C\n[00:13.00]Nie odchod\x9F, zosta\xF1 ze mn\xB9 jeszcze chwil\xEA\n" },
+    { "Czech", charset::CODEPAGE_CENTRAL_EUROPEAN,
+      "[00:05.00]\x8Ali jsme spolu noc\xED, hv\xECzdy nad n\xE1mi z\xE1\xF8ily\n[00:09.00]Po\xF8\xE1" "d sly"
+      "\x9A\xEDm tv\xF9j hlas, kdy\x9E venku pr\x9A\xED\n[00:13.00]Neodch\xE1zej, z\xF9sta\xF2 se mnou je\x9At"
+      "\xEC chv\xEDli\n" },
+    { "Japanese", charset::CODEPAGE_UTF8,
+      "[00:10.00]\xE5\x90\x9B\xE3\x81\xA8\xE6\xAD\xA9\xE3\x81\x84\xE3\x81\x9F\xE5\xB8\xB0\xE3\x82\x8A\xE9\x81"
+      "\x93\xE3\x82\x92\xE4\xBB\x8A\xE3\x82\x82\xE8\xA6\x9A\xE3\x81\x88\xE3\x81\xA6\xE3\x81\x84\xE3\x82\x8B\n[0"
+      "0:15.20]\xE5\xA4\x9C\xE7\xA9\xBA\xE3\x81\xAB\xE5\x85\x89\xE3\x82\x8B\xE6\x98\x9F\xE3\x81\x9F\xE3\x81\xA1"
+      "\xE3\x81\x8C\xE5\x84\xAA\xE3\x81\x97\xE3\x81\x8F\xE7\xAC\x91\xE3\x81\xA3\xE3\x81\xA6\xE3\x81\x9F\n" },
+    { "Russian", charset::CODEPAGE_UTF8,
+      "[00:05.00]\xD0\x97\xD0\xB8\xD0\xBC\xD0\xB0 \xD0\xBF\xD1\x80\xD0\xB8\xD1\x88\xD0\xBB\xD0\xB0, \xD0\xB8 "
+      "\xD1\x81\xD0\xBD\xD0\xB5\xD0\xB3 \xD1\x83\xD0\xBA\xD1\x80\xD1\x8B\xD0\xBB \xD0\xB2\xD0\xB5\xD1\x81\xD1"
+      "\x8C \xD0\xB3\xD0\xBE\xD1\x80\xD0\xBE\xD0\xB4\n[00:09.20]\xD0\x90 \xD1\x8F \xD0\xB2\xD1\x81\xD1\x91 \xD0"
+      "\xB6\xD0\xB4\xD1\x83 \xD1\x82\xD0\xB5\xD0\xB1\xD1\x8F \xD1\x83 \xD1\x81\xD1\x82\xD0\xB0\xD1\x80\xD0\xBE"
+      "\xD0\xB3\xD0\xBE \xD0\xBE\xD0\xBA\xD0\xBD\xD0\xB0\n" },
+    { "French", charset::CODEPAGE_UTF8,
+      "[00:13.00]Les \xC3\xA9toiles brillaient comme des souvenirs d'\xC3\xA9t\xC3\xA9\n[00:17.50]Mon c\xC5\x93"
+      "ur bat \xC3\xA0 la m\xC3\xAAme chanson\n" },
+    { "Greek", charset::CODEPAGE_GREEK,
+      "[00:06.00]\xD0\xE5\xF1\xF0\xE1\xF4\xEF\xFD\xF3\xE1\xEC\xE5 \xEC\xE1\xE6\xDF \xF3\xF4\xEF\xED \xDE\xF3"
+      "\xF5\xF7\xEF \xE4\xF1\xFC\xEC\xEF\n[00:10.00]\xD4\xE1 \xE1\xF3\xF4\xDD\xF1\xE9\xE1 \xDD\xEB\xE1\xEC\xF0"
+      "\xE1\xED \xF0\xDC\xED\xF9 \xE1\xF0\xFC \xF4\xE7 \xE8\xDC\xEB\xE1\xF3\xF3\xE1\n[00:14.00]\xCC\xE7 \xF6"
+      "\xFD\xE3\xE5\xE9\xF2, \xEC\xE5\xDF\xED\xE5 \xEB\xDF\xE3\xEF \xE1\xEA\xFC\xEC\xE1 \xEC\xE1\xE6\xDF \xEC"
+      "\xEF\xF5\n" },
+};
+
+static bool is_detected_correctly(const CorpusSample& sample, size_t max_length)
+{
+    const size_t length = std::min(strlen(sample.text), max_length);
+    return charset::detect(reinterpret_cast<const uint8_t*>(sample.text), length).codepage == sample.codepage;
+}
+
+// Prints how many of the corpus samples are detected correctly, given only the first few bytes of each of them
+static void print_accuracy()
+{
+    for(size_t max_length : { size_t(32), size_t(64), size_t(128), SIZE_MAX })
+    {
+        size_t correct_count = 0;
+        for(const CorpusSample& sample : CORPUS)
+        {
+            correct_count += is_detected_correctly(sample, max_length) ? 1 : 0;
+        }
+
+        const std::string length_str = (max_length == SIZE_MAX) ? "all" : std::to_string(max_length);
+        printf("Detected %zu/%zu samples correctly from %s bytes\n",
+               correct_count,
+               std::size(CORPUS),
+               length_str.c_str());
+    }
+}
+
+static void print_throughput()
+{
+    std::vector<std::pair<std::string, std::string>> inputs;
+    for(const CorpusSample& sample : CORPUS)
+    {
+        std::string text;
+        while(text.length() < 1024 * 1024)
+        {
+            text += sample.text;
+        }
+        inputs.emplace_back(std::string(sample.language) + " (" + std::to_string(sample.codepage) + ")", text);
+    }
+
+    for(const auto& [name, input] : inputs)
+    {
+        const int iterations = 16;
+        const auto start = std::chrono::steady_clock::now();
+        uint32_t codepage = 0;
+        for(int i = 0; i < iterations; i++)
+        {
+            codepage += charset::detect(reinterpret_cast<const uint8_t*>(input.data()), input.length()).codepage;
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        const double throughput = (double(input.length()) * double(iterations)) / (1024.0 * 1024.0 * elapsed.count());
+        printf("%-32s %8.1fMB/s (%u)\n", name.c_str(), throughput, codepage / iterations);
+    }
+}
+#endif
+
+#if MVTF_TESTS_ENABLED
+MVTF_TEST(charset_detects_the_encoding_of_every_corpus_sample)
+{
+    for(const CorpusSample& sample : CORPUS)
+    {
+        CHECK(is_detected_correctly(sample, SIZE_MAX));
+    }
+}
+
+MVTF_TEST(charset_detection_does_not_depend_on_how_the_text_is_aligned)
+{
+    for(const CorpusSample& sample : CORPUS)
+    {
+        for(size_t padding = 0; padding <= 16; padding++)
+        {
+            const std::string text = std::string(padding, ' ') + sample.text;
+            const charset::Detection detection = charset::detect(reinterpret_cast<const uint8_t*>(text.data()),
+                                                                 text.length());
+            CHECK(detection.codepage == sample.codepage);
+        }
+    }
+}
+
+static std::string encode_utf16(std::u16string_view text, bool big_endian, bool with_byte_order_mark)
+{
+    std::string output;
+    if(with_byte_order_mark)
+    {
+        output += big_endian ? "\xFE\xFF" : "\xFF\xFE";
+    }
+    for(char16_t c : text)
+    {
+        const char high = char(c >> 8);
+        const char low = char(c & 0xFF);
+        output += big_endian ? high : low;
+        output += big_endian ? low : high;
+    }
+    return output;
+}
+
+MVTF_TEST(charset_detects_utf16_with_or_without_a_byte_order_mark)
+{
+    const std::u16string_view text = u"[00:01.00]\u541B\u3068\u6B69\u3044\u305F\n[00:03.50]Hello again\n";
+    for(bool big_endian : { false, true })
+    {
+        for(bool with_bom : { false, true })
+        {
+            const std::string bytes = encode_utf16(text, big_endian, with_bom);
+            const charset::Detection detection = charset::detect(reinterpret_cast<const uint8_t*>(bytes.data()),
+                                                                 bytes.length());
+            CHECK(detection.codepage == (big_endian ? charset::CODEPAGE_UTF16BE : charset::CODEPAGE_UTF16LE));
+            CHECK(detection.byte_order_mark_length == (with_bom ? 2 : 0));
+        }
+    }
+}
+
+MVTF_TEST(charset_detects_utf8_with_a_byte_order_mark)
+{
+    const std::string_view text = "\xEF\xBB\xBF[00:01.00]\xE3\x81\x82\xF0\x9F\x8E\xB5\n";
+    const charset::Detection detection = charset::detect(reinterpret_cast<const uint8_t*>(text.data()), text.length());
+    ASSERT(detection.codepage == charset::CODEPAGE_UTF8);
+    ASSERT(detection.byte_order_mark_length == 3);
+}
+
+MVTF_TEST(charset_does_not_detect_invalid_utf8_as_utf8)
+{
+    const std::string_view invalid_texts[] = {
+        "[00:01.00]over\xC0\xAFlong",         // An overlong encoding of '/'
+        "[00:01.00]over\xE0\x80\xAFlong",     // Another overlong encoding of '/'
+        "[00:01.00]sur\xED\xA0\x80rogate",    // A UTF-16 surrogate
+        "[00:01.00]too\xF4\x90\x80\x80large", // U+110000
+        "[00:01.00]lonely\x80trail",          // A continuation byte with no lead
+        "[00:01.00]truncated\xE3\x81",        // A sequence cut off by the end of the text
+    };
+    for(std::string_view text : invalid_texts)
+    {
+        const charset::Detection detection = charset::detect(reinterpret_cast<const uint8_t*>(text.data()),
+                                                             text.length());
+        CHECK(detection.codepage != charset::CODEPAGE_UTF8);
+    }
+}
+
+MVTF_TEST(charset_suggests_the_next_best_encoding_for_text_that_is_valid_in_several)
+{
+    // NOTE: The last character is cut off after its first byte, which Win32 will refuse to convert from GBK
+    const std::string_view text = "[00:01.00]\xD2\xB9\xBF\xD5\xD6\xD0\xD7\xEE\xC1\xC1\xB5\xC4\xB5";
+    const charset::Detection detection = charset::detect(reinterpret_cast<const uint8_t*>(text.data()), text.length());
+    ASSERT(detection.codepage == charset::CODEPAGE_GBK);
+    ASSERT(detection.next_best_codepage != charset::CODEPAGE_UNKNOWN);
+    ASSERT(detection.next_best_codepage != charset::CODEPAGE_GBK);
+}
+
+MVTF_TEST(charset_detects_ascii_as_utf8)
+{
+    const std::string_view text = "[ar:Someone]\n[00:01.00]Just some plain old ASCII text\n";
+    ASSERT(charset::detect(reinterpret_cast<const uint8_t*>(text.data()), text.length()).codepage
+           == charset::CODEPAGE_UTF8);
+}
+
+// Measures how quickly we can detect the encoding of large amounts of text, and how accurately we can detect the
+// encoding of the corpus samples when given only their first few bytes.
+// This only runs if OPENLYRICS_CHARSET_BENCHMARK is set.
+MVTF_TEST(charset_benchmark_detection)
+{
+    if(getenv("OPENLYRICS_CHARSET_BENCHMARK") == nullptr)
+    {
+        return;
+    }
+    print_accuracy();
+    print_throughput();
+}
+#endif
+
+#if defined(CHARSET_DETECTION_STANDALONE)
+int main()
+{
+    print_accuracy();
+    print_throughput();
+
+    int failure_count = 0;
+    for(const CorpusSample& sample : CORPUS)
+    {
+        const charset::Detection detection = charset::detect(reinterpret_cast<const uint8_t*>(sample.text),
+                                                             strlen(sample.text));
+        if(detection.codepage != sample.codepage)
+        {
+            printf("Detected %s text (%u) as %u\n", sample.language, sample.codepage, detection.codepage);
+            failure_count++;
+        }
+    }
+    return (failure_count == 0) ? 0 : 1;
+}
+#endif
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Guesses the character encoding of some text in a single pass over it, without any help from the OS.
+// Text that starts with a byte-order mark is in the encoding that the mark indicates, text with many null bytes is
+// UTF-16 and text that is valid UTF-8 is UTF-8. Any other text is scored against each of the legacy encodings that
+// lyrics are commonly saved in, by how often its bytes (or pairs of bytes) decode to characters that are common in
+// the languages written in that encoding, and is assumed to be in whichever encoding scores highest.
+// NOTE: This only depends on the standard library, so that it can be built & tested on its own (and on any platform).
+namespace charset
+{
+    // Encodings are identified by their Windows codepage IDs, so that they can be passed straight to Win32 functions
+    constexpr uint32_t CODEPAGE_UNKNOWN = 0; // The same as CP_ACP, the system's default legacy codepage
+    constexpr uint32_t CODEPAGE_UTF8 = 65001;
+    constexpr uint32_t CODEPAGE_UTF16LE = 1200;
+    constexpr uint32_t CODEPAGE_UTF16BE = 1201;
+    constexpr uint32_t CODEPAGE_SHIFT_JIS = 932;
+    constexpr uint32_t CODEPAGE_GBK = 936;
+    constexpr uint32_t CODEPAGE_EUC_KR = 949;
+    constexpr uint32_t CODEPAGE_BIG5 = 950;
+    constexpr uint32_t CODEPAGE_CENTRAL_EUROPEAN = 1250;
+    constexpr uint32_t CODEPAGE_CYRILLIC = 1251;
+    constexpr uint32_t CODEPAGE_WESTERN = 1252;
+    constexpr uint32_t CODEPAGE_GREEK = 1253;
+
+    struct Detection
+    {
+        uint32_t codepage;
+        size_t byte_order_mark_length; // The number of bytes at the start of the text that are a byte-order mark
+
+        // The legacy encoding that scored second-highest, if the text is in a legacy encoding and is valid in more
+        // than one of them. Worth trying if the text turns out not to be valid in the detected encoding after all.
+        uint32_t next_best_codepage;
+    };
+
+    Detection detect(const uint8_t* text, size_t length);
+}
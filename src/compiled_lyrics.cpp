@@ -0,0 +1,589 @@
+#include "stdafx.h"
+
+#include "compiled_lyrics.h"
+#include "hash_utils.h"
+#include "logging.h"
+#include "mvtf/mvtf.h"
+#include "preferences.h"
+
+// clang-format off
+static const GUID GUID_ADVCONFIG_COMPILE_LOCAL_LYRICS = { 0x6a0c2f51, 0x93b4, 0x4e8d, { 0xb2, 0x7e, 0x15, 0xc8, 0x4d, 0x60, 0xe9, 0x3a } };
+// clang-format on
+
+static advconfig_checkbox_factory g_advconfig_compile_local_lyrics("Keep compiled copies of local lyrics files",
+                                                                   GUID_ADVCONFIG_COMPILE_LOCAL_LYRICS,
+                                                                   GUID_ADVCONFIG_BRANCH,
+                                                                   2.0,
+                                                                   true);
+
+// A compiled file consists of this header, followed by a LineRecord for each line, a TagRecord for each tag,
+// the text of all of the lines, the text of all of the tags and then the path of the source file (so that we can tell
+// when the source file no longer exists). Each record refers to its text by the index of its first character (in the
+// line or tag text respectively) and its length.
+// NOTE: The line text is stored as TCHARs so that it can be copied straight into each line, which means that
+//       compiled files are only readable by builds with the same TCHAR. They are never shared between machines.
+static const uint32_t COMPILED_FILE_MAGIC = 0x4C434C4F; // "OLCL"
+static const uint32_t COMPILED_FILE_VERSION = 2;
+
+struct FileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t source_modified; // The modification time of the source file when it was compiled
+    uint64_t source_size;     // The size (in bytes) of the source file when it was compiled
+    uint64_t checksum;        // The checksum of the whole file, computed with this field set to zero
+    double timestamp_offset;
+    uint32_t line_count;
+    uint32_t tag_count;
+    uint32_t line_text_length; // The total number of TCHARs of line text
+    uint32_t tag_text_length;  // The total number of bytes of (UTF-8) tag text
+    uint32_t source_path_length;
+    uint32_t padding; // Always zero, so that no part of the header (which is checksummed) is left uninitialised
+};
+
+struct LineRecord
+{
+    double timestamp;
+    uint32_t text_start;
+    uint32_t text_length;
+};
+
+struct TagRecord
+{
+    uint32_t text_start;
+    uint32_t text_length;
+};
+
+struct FileLayout
+{
+    uint64_t lines_offset;
+    uint64_t tags_offset;
+    uint64_t line_text_offset;
+    uint64_t tag_text_offset;
+    uint64_t source_path_offset;
+    uint64_t total_size;
+};
+
+static FileLayout get_file_layout(const FileHeader& header)
+{
+    FileLayout layout = {};
+    layout.lines_offset = sizeof(FileHeader);
+    layout.tags_offset = layout.lines_offset + (uint64_t(header.line_count) * sizeof(LineRecord));
+    layout.line_text_offset = layout.tags_offset + (uint64_t(header.tag_count) * sizeof(TagRecord));
+    layout.tag_text_offset = layout.line_text_offset + (uint64_t(header.line_text_length) * sizeof(TCHAR));
+    layout.source_path_offset = layout.tag_text_offset + header.tag_text_length;
+    layout.total_size = layout.source_path_offset + header.source_path_length;
+    return layout;
+}
+
+static uint64_t compute_checksum(FileHeader header, const uint8_t* data, size_t data_length)
+{
+    header.checksum = 0;
+    const uint8_t* header_bytes = reinterpret_cast<const uint8_t*>(&header);
+
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for(size_t i = 0; i < sizeof(FileHeader); i++)
+    {
+        hash ^= uint64_t(header_bytes[i]);
+        hash *= 1099511628211ull;
+    }
+    for(size_t i = sizeof(FileHeader); i < data_length; i++)
+    {
+        hash ^= uint64_t(data[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Returns the compiled file contents for the given lyrics, or an empty buffer if they're too big to be compiled
+static std::vector<uint8_t> serialise(std::string_view source_path,
+                                      t_filetimestamp source_modified,
+                                      uint64_t source_size,
+                                      const LyricData& lyrics)
+{
+    uint64_t line_text_length = 0;
+    for(const LyricDataLine& line : lyrics.lines)
+    {
+        line_text_length += line.text.length();
+    }
+    uint64_t tag_text_length = 0;
+    for(const std::string& tag : lyrics.tags)
+    {
+        tag_text_length += tag.length();
+    }
+    if((lyrics.lines.size() > UINT32_MAX) || (lyrics.tags.size() > UINT32_MAX) || (line_text_length > UINT32_MAX)
+       || (tag_text_length > UINT32_MAX) || (source_path.length() > UINT32_MAX))
+    {
+        return {};
+    }
+
+    FileHeader header = {};
+    header.magic = COMPILED_FILE_MAGIC;
+    header.version = COMPILED_FILE_VERSION;
+    header.source_modified = source_modified;
+    header.source_size = source_size;
+    header.timestamp_offset = lyrics.timestamp_offset;
+    header.line_count = uint32_t(lyrics.lines.size());
+    header.tag_count = uint32_t(lyrics.tags.size());
+    header.line_text_length = uint32_t(line_text_length);
+    header.tag_text_length = uint32_t(tag_text_length);
+    header.source_path_length = uint32_t(source_path.length());
+
+    const FileLayout layout = get_file_layout(header);
+    std::vector<uint8_t> output(size_t(layout.total_size));
+
+    uint32_t line_text_start = 0;
+    uint8_t* line_record_ptr = output.data() + layout.lines_offset;
+    uint8_t* line_text_ptr = output.data() + layout.line_text_offset;
+    for(const LyricDataLine& line : lyrics.lines)
+    {
+        const LineRecord record = { line.timestamp, line_text_start, uint32_t(line.text.length()) };
+        memcpy(line_record_ptr, &record, sizeof(record));
+        memcpy(line_text_ptr + (line_text_start * sizeof(TCHAR)), line.text.data(), line.text.length() * sizeof(TCHAR));
+        line_record_ptr += sizeof(record);
+        line_text_start += record.text_length;
+    }
+
+    uint32_t tag_text_start = 0;
+    uint8_t* tag_record_ptr = output.data() + layout.tags_offset;
+    uint8_t* tag_text_ptr = output.data() + layout.tag_text_offset;
+    for(const std::string& tag : lyrics.tags)
+    {
+        const TagRecord record = { tag_text_start, uint32_t(tag.length()) };
+        memcpy(tag_record_ptr, &record, sizeof(record));
+        memcpy(tag_text_ptr + tag_text_start, tag.data(), tag.length());
+        tag_record_ptr += sizeof(record);
+        tag_text_start += record.text_length;
+    }
+
+    memcpy(output.data() + layout.source_path_offset, source_path.data(), source_path.length());
+
+    header.checksum = compute_checksum(header, output.data(), output.size());
+    memcpy(output.data(), &header, sizeof(header));
+    return output;
+}
+
+// Returns the header of the given compiled file, if it is a compiled file that we can read
+static std::optional<FileHeader> read_header(const uint8_t* data, size_t data_length)
+{
+    if(data_length < sizeof(FileHeader))
+    {
+        return {};
+    }
+
+    FileHeader header = {};
+    memcpy(&header, data, sizeof(header));
+    if((header.magic != COMPILED_FILE_MAGIC) || (header.version != COMPILED_FILE_VERSION))
+    {
+        LOG_INFO("Ignoring compiled lyrics with unsupported version %u", header.version);
+        return {};
+    }
+
+    const FileLayout layout = get_file_layout(header);
+    if((layout.total_size != data_length)
+       || (header.checksum != compute_checksum(header, data, data_length)))
+    {
+        LOG_WARN("Ignoring corrupted compiled lyrics");
+        return {};
+    }
+    return header;
+}
+
+static std::optional<LyricData> deserialise(const LyricDataCommon& metadata,
+                                            const uint8_t* data,
+                                            size_t data_length,
+                                            t_filetimestamp source_modified,
+                                            uint64_t source_size)
+{
+    const std::optional<FileHeader> maybe_header = read_header(data, data_length);
+    if(!maybe_header.has_value())
+    {
+        return {};
+    }
+
+    const FileHeader& header = maybe_header.value();
+    if((header.source_modified != source_modified) || (header.source_size != source_size))
+    {
+        LOG_INFO("Ignoring compiled lyrics because the source file has been modified since they were compiled");
+        return {};
+    }
+
+    const FileLayout layout = get_file_layout(header);
+
+    const TCHAR* line_text = reinterpret_cast<const TCHAR*>(data + layout.line_text_offset);
+    LyricData result(metadata);
+    result.timestamp_offset = header.timestamp_offset;
+    result.lines.reserve(header.line_count);
+    for(uint32_t line_index = 0; line_index < header.line_count; line_index++)
+    {
+        LineRecord record = {};
+        memcpy(&record, data + layout.lines_offset + (line_index * sizeof(LineRecord)), sizeof(record));
+        if(uint64_t(record.text_start) + record.text_length > header.line_text_length)
+        {
+            LOG_WARN("Ignoring compiled lyrics with out-of-bounds line text");
+            return {};
+        }
+        result.lines.push_back({ std::tstring(line_text + record.text_start, record.text_length), record.timestamp });
+    }
+
+    const char* tag_text = reinterpret_cast<const char*>(data + layout.tag_text_offset);
+    result.tags.reserve(header.tag_count);
+    for(uint32_t tag_index = 0; tag_index < header.tag_count; tag_index++)
+    {
+        TagRecord record = {};
+        memcpy(&record, data + layout.tags_offset + (tag_index * sizeof(TagRecord)), sizeof(record));
+        if(uint64_t(record.text_start) + record.text_length > header.tag_text_length)
+        {
+            LOG_WARN("Ignoring compiled lyrics with out-of-bounds tag text");
+            return {};
+        }
+        result.tags.emplace_back(tag_text + record.text_start, record.text_length);
+    }
+    return result;
+}
+
+// Returns the path of the source file that the given compiled file was compiled from, if it is one that we can read
+static std::optional<std::string> read_source_path(const uint8_t* data, size_t data_length)
+{
+    const std::optional<FileHeader> header = read_header(data, data_length);
+    if(!header.has_value())
+    {
+        return {};
+    }
+
+    const FileLayout layout = get_file_layout(header.value());
+    return std::string(reinterpret_cast<const char*>(data + layout.source_path_offset), header->source_path_length);
+}
+
+static std::optional<std::tstring> get_compiled_directory()
+{
+    pfc::string8 profile_path;
+    if(!filesystem::g_get_native_path(core_api::get_profile_path(), profile_path))
+    {
+        LOG_WARN("Failed to get the native path of the profile directory");
+        return {};
+    }
+    return to_tstring(profile_path) + _T("\\openlyrics-compiled");
+}
+
+// Compiled files are named after (half of) the hash of the path of their source file
+static std::optional<std::tstring> get_compiled_file_path(std::string_view source_path)
+{
+    const std::optional<std::tstring> directory = get_compiled_directory();
+    if(!directory.has_value())
+    {
+        return {};
+    }
+
+    Sha256Context ctx;
+    ctx.add_data((const uint8_t*)source_path.data(), source_path.length());
+    uint8_t hash[32] = {};
+    ctx.finalise(hash);
+
+    const std::string file_name = pfc::format_hexdump(hash, sizeof(hash) / 2, "").get_ptr();
+    return directory.value() + _T("\\") + to_tstring(file_name) + _T(".bin");
+}
+
+bool compiled_lyrics::is_enabled()
+{
+    return g_advconfig_compile_local_lyrics.get();
+}
+
+std::optional<LyricData> compiled_lyrics::load(const LyricDataCommon& metadata,
+                                               std::string_view source_path,
+                                               t_filetimestamp source_modified,
+                                               uint64_t source_size)
+{
+    const std::optional<std::tstring> compiled_path = get_compiled_file_path(source_path);
+    if(!compiled_path.has_value())
+    {
+        return {};
+    }
+
+    // NOTE: We allow the file to be deleted while we have it open so that a new compiled copy can replace it
+    HANDLE file = CreateFile(compiled_path->c_str(),
+                             GENERIC_READ,
+                             FILE_SHARE_READ | FILE_SHARE_DELETE,
+                             nullptr,
+                             OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL,
+                             nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        return {}; // This source file has not been compiled yet
+    }
+
+    std::optional<LyricData> result;
+    LARGE_INTEGER file_size = {};
+    if(GetFileSizeEx(file, &file_size) && (file_size.QuadPart >= LONGLONG(sizeof(FileHeader))))
+    {
+        HANDLE mapping = CreateFileMapping(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if(mapping != nullptr)
+        {
+            const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            if(view != nullptr)
+            {
+                result = deserialise(metadata,
+                                     static_cast<const uint8_t*>(view),
+                                     size_t(file_size.QuadPart),
+                                     source_modified,
+                                     source_size);
+                UnmapViewOfFile(view);
+            }
+            CloseHandle(mapping);
+        }
+    }
+    CloseHandle(file);
+
+    if(result.has_value())
+    {
+        LOG_INFO("Loaded compiled lyrics for %s", std::string(source_path).c_str());
+    }
+    return result;
+}
+
+void compiled_lyrics::store(std::string_view source_path,
+                            t_filetimestamp source_modified,
+                            uint64_t source_size,
+                            const LyricData& lyrics)
+{
+    const std::optional<std::tstring> compiled_path = get_compiled_file_path(source_path);
+    const std::vector<uint8_t> bytes = serialise(source_path, source_modified, source_size, lyrics);
+    if(!compiled_path.has_value() || bytes.empty() || (bytes.size() > MAXDWORD))
+    {
+        return;
+    }
+
+    const std::tstring directory = compiled_path->substr(0, compiled_path->find_last_of(_T('\\')));
+    CreateDirectory(directory.c_str(), nullptr); // Fails harmlessly if the directory already exists
+
+    // NOTE: We write a temporary file and then move it into place so that nobody ever loads a partially-written file
+    const std::tstring temp_path = compiled_path.value() + _T(".tmp");
+    HANDLE file = CreateFile(temp_path.c_str(),
+                             GENERIC_WRITE,
+                             0,
+                             nullptr,
+                             CREATE_ALWAYS,
+                             FILE_ATTRIBUTE_NORMAL,
+                             nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        LOG_WARN("Failed to create compiled lyrics file for %s: %d", std::string(source_path).c_str(), GetLastError());
+        return;
+    }
+
+    DWORD bytes_written = 0;
+    const bool written = WriteFile(file, bytes.data(), DWORD(bytes.size()), &bytes_written, nullptr)
+                         && (bytes_written == bytes.size());
+    CloseHandle(file);
+    if(!written)
+    {
+        LOG_WARN("Failed to write compiled lyrics file for %s: %d", std::string(source_path).c_str(), GetLastError());
+        DeleteFile(temp_path.c_str());
+        return;
+    }
+
+    if(!MoveFileEx(temp_path.c_str(), compiled_path->c_str(), MOVEFILE_REPLACE_EXISTING))
+    {
+        // NOTE: We can't replace the existing compiled copy while another thread has it mapped (or open) to load it.
+        //       That's expected every now and then and does no harm, we'll just store it again next time.
+        const DWORD error = GetLastError();
+        if((error == ERROR_ACCESS_DENIED) || (error == ERROR_SHARING_VIOLATION) || (error == ERROR_USER_MAPPED_FILE))
+        {
+            LOG_INFO("Not storing compiled lyrics for %s because they are in use", std::string(source_path).c_str());
+        }
+        else
+        {
+            LOG_WARN("Failed to store compiled lyrics file for %s: %d", std::string(source_path).c_str(), error);
+        }
+        DeleteFile(temp_path.c_str());
+        return;
+    }
+    LOG_INFO("Stored compiled lyrics for %s", std::string(source_path).c_str());
+}
+
+// Returns true if the given file in the compiled directory is no longer needed
+static bool is_stale_compiled_file(const std::tstring& path, const WIN32_FIND_DATA& find_data, abort_callback& abort)
+{
+    // NOTE: Temporary files only exist for a moment while a compiled copy is being stored, so any that are older than
+    //       that were left behind when storing was interrupted (e.g because foobar2000 crashed).
+    const std::tstring_view name = find_data.cFileName;
+    const std::tstring_view temp_extension = _T(".tmp");
+    if((name.length() >= temp_extension.length())
+       && (name.substr(name.length() - temp_extension.length()) == temp_extension))
+    {
+        const t_filetimestamp modified = (t_filetimestamp(find_data.ftLastWriteTime.dwHighDateTime) << 32)
+                                         | find_data.ftLastWriteTime.dwLowDateTime;
+        return modified + system_time_periods::day < filetimestamp_from_system_timer();
+    }
+
+    if(!compiled_lyrics::is_enabled())
+    {
+        return true;
+    }
+
+    HANDLE file = CreateFile(path.c_str(),
+                             GENERIC_READ,
+                             FILE_SHARE_READ | FILE_SHARE_DELETE,
+                             nullptr,
+                             OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL,
+                             nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    std::optional<std::string> source_path;
+    LARGE_INTEGER file_size = {};
+    if(GetFileSizeEx(file, &file_size) && (file_size.QuadPart <= LONGLONG(MAXDWORD)))
+    {
+        std::vector<uint8_t> bytes(size_t(file_size.QuadPart));
+        DWORD bytes_read = 0;
+        if(ReadFile(file, bytes.data(), DWORD(bytes.size()), &bytes_read, nullptr) && (bytes_read == bytes.size()))
+        {
+            source_path = read_source_path(bytes.data(), bytes.size());
+        }
+    }
+    CloseHandle(file);
+
+    if(!source_path.has_value())
+    {
+        return true; // Compiled by an older version, or corrupted
+    }
+
+    try
+    {
+        return !filesystem::g_exists(source_path->c_str(), abort);
+    }
+    catch(const std::exception& e)
+    {
+        LOG_INFO("Failed to check whether %s still exists: %s", source_path->c_str(), e.what());
+        return false;
+    }
+}
+
+// Deletes the compiled copies of source files that no longer exist (or all of them if compiled copies have been
+// turned off), so that the compiled directory doesn't keep growing forever as lyrics files are renamed or deleted.
+static void prune_compiled_files()
+{
+    const std::optional<std::tstring> directory = get_compiled_directory();
+    if(!directory.has_value())
+    {
+        return;
+    }
+
+    WIN32_FIND_DATA find_data = {};
+    const std::tstring pattern = directory.value() + _T("\\*");
+    HANDLE find = FindFirstFile(pattern.c_str(), &find_data);
+    if(find == INVALID_HANDLE_VALUE)
+    {
+        return; // Nothing has been compiled yet
+    }
+
+    // NOTE: This runs via fb2k::splitTask, which prevents foobar2000 from closing until it completes, so we make
+    //       sure to stop as soon as foobar2000 starts shutting down.
+    abort_callback& abort = fb2k::mainAborter();
+    size_t removed_count = 0;
+    do
+    {
+        if((find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+        {
+            continue;
+        }
+
+        const std::tstring path = directory.value() + _T("\\") + find_data.cFileName;
+        if(is_stale_compiled_file(path, find_data, abort) && DeleteFile(path.c_str()))
+        {
+            removed_count++;
+        }
+    } while(!abort.is_aborting() && FindNextFile(find, &find_data));
+    FindClose(find);
+
+    if(removed_count > 0)
+    {
+        LOG_INFO("Removed %zu stale compiled lyrics files", removed_count);
+    }
+}
+
+static void prune_compiled_files_on_init()
+{
+    fb2k::splitTask(prune_compiled_files);
+}
+FB2K_RUN_ON_INIT(prune_compiled_files_on_init)
+
+// ============
+// Tests
+// ============
+#if MVTF_TESTS_ENABLED
+static LyricData make_compilable_lyrics()
+{
+    LyricData lyrics = {};
+    lyrics.tags = { "[ar:Some Artist]", "[offset:+250]" };
+    lyrics.lines = {
+        { _T("First line"), 1.5 },
+        { _T(""), 2.25 },
+        { _T("Third line"), 3.0 },
+        { _T("Untimed"), DBL_MAX },
+    };
+    lyrics.timestamp_offset = 0.25;
+    return lyrics;
+}
+
+MVTF_TEST(compiledlyrics_loading_gives_the_lyrics_that_were_compiled)
+{
+    const LyricData input = make_compilable_lyrics();
+    const std::vector<uint8_t> bytes = serialise("some/path.lrc", 1234, 56, input);
+
+    LyricDataCommon metadata = {};
+    metadata.source_path = "some/path.lrc";
+    const std::optional<LyricData> output = deserialise(metadata, bytes.data(), bytes.size(), 1234, 56);
+    ASSERT(output.has_value());
+    ASSERT(output->source_path == metadata.source_path);
+    ASSERT(output->tags == input.tags);
+    ASSERT(output->timestamp_offset == input.timestamp_offset);
+    ASSERT(output->lines.size() == input.lines.size());
+    for(size_t i = 0; i < input.lines.size(); i++)
+    {
+        ASSERT(output->lines[i].text == input.lines[i].text);
+        ASSERT(output->lines[i].timestamp == input.lines[i].timestamp);
+    }
+}
+
+MVTF_TEST(compiledlyrics_empty_lyrics_can_be_compiled)
+{
+    const std::vector<uint8_t> bytes = serialise("some/path.lrc", 1, 0, LyricData());
+    const std::optional<LyricData> output = deserialise({}, bytes.data(), bytes.size(), 1, 0);
+    ASSERT(output.has_value());
+    ASSERT(output->lines.empty());
+    ASSERT(output->tags.empty());
+}
+
+MVTF_TEST(compiledlyrics_are_not_loaded_if_the_source_file_has_changed)
+{
+    const std::vector<uint8_t> bytes = serialise("some/path.lrc", 1234, 56, make_compilable_lyrics());
+    ASSERT(!deserialise({}, bytes.data(), bytes.size(), 1235, 56).has_value());
+    ASSERT(!deserialise({}, bytes.data(), bytes.size(), 1234, 57).has_value());
+}
+
+MVTF_TEST(compiledlyrics_are_not_loaded_if_they_are_corrupted)
+{
+    const std::vector<uint8_t> bytes = serialise("some/path.lrc", 1234, 56, make_compilable_lyrics());
+    for(size_t i = 0; i < bytes.size(); i++)
+    {
+        std::vector<uint8_t> corrupted = bytes;
+        corrupted[i] ^= 0x10;
+        ASSERT(!deserialise({}, corrupted.data(), corrupted.size(), 1234, 56).has_value());
+    }
+    ASSERT(!deserialise({}, bytes.data(), bytes.size() - 1, 1234, 56).has_value());
+    ASSERT(!deserialise({}, bytes.data(), sizeof(FileHeader) - 1, 1234, 56).has_value());
+}
+
+MVTF_TEST(compiledlyrics_remember_the_path_of_their_source_file)
+{
+    const std::vector<uint8_t> bytes = serialise("C:\\lyrics\\some path.lrc", 1234, 56, make_compilable_lyrics());
+    const std::optional<std::string> source_path = read_source_path(bytes.data(), bytes.size());
+    ASSERT(source_path == "C:\\lyrics\\some path.lrc");
+}
+#endif
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "lyric_data.h"
+
+// Lyrics from local files, stored after they have been decoded & parsed so that the next time they are needed they
+// can be loaded straight into a LyricData without decoding or parsing them again. Each source file gets a compiled
+// copy of its own in the profile directory, holding the line timestamps & text in a binary form that we read through
+// a memory-mapping. A compiled copy is only used while the source file has the same modification time and size as it
+// did when the copy was made, so editing the source file (in any program) causes it to be compiled again. Copies of
+// source files that no longer exist are deleted each time foobar2000 starts.
+namespace compiled_lyrics
+{
+    bool is_enabled();
+
+    // Returns the lyrics compiled from the given source file, if it has not changed since they were compiled
+    std::optional<LyricData> load(const LyricDataCommon& metadata,
+                                  std::string_view source_path,
+                                  t_filetimestamp source_modified,
+                                  uint64_t source_size);
+
+    // Stores a compiled copy of the lyrics that were parsed from the given source file
+    void store(std::string_view source_path,
+               t_filetimestamp source_modified,
+               uint64_t source_size,
+               const LyricData& lyrics);
+}
@@ -11,12 +11,19 @@
 
 // clang-format off: GUIDs should be one line
 extern const GUID GUID_PREFERENCES_PAGE_ROOT = { 0x29e96cfa, 0xab67, 0x4793, { 0xa1, 0xc3, 0xef, 0xc3, 0xa, 0xbc, 0x8b, 0x74 } };
+extern const GUID GUID_ADVCONFIG_BRANCH = { 0x8f6f370e, 0x65f3, 0x4d94, { 0x86, 0x76, 0xaf, 0x5f, 0x9c, 0x46, 0x1f, 0xb7 } };
 
 static const GUID GUID_CFG_DEBUG_LOGS_ENABLED = { 0x57920cbe, 0xa27, 0x4fad, { 0x92, 0xc, 0x2b, 0x61, 0x3b, 0xf9, 0xd6, 0x13 } };
 // clang-format on
 
 static cfg_auto_bool cfg_debug_logs_enabled(GUID_CFG_DEBUG_LOGS_ENABLED, IDC_DEBUG_LOGS_ENABLED, false);
 
+// The branch of the advanced preferences that holds all of our advanced settings
+static advconfig_branch_factory g_advconfig_branch("OpenLyrics",
+                                                   GUID_ADVCONFIG_BRANCH,
+                                                   advconfig_branch::guid_branch_tools,
+                                                   0.0);
+
 static cfg_auto_property* g_root_auto_properties[] = {
     &cfg_debug_logs_enabled,
 };
@@ -18,6 +18,9 @@ static const GUID GUID_CFG_SEARCH_EXCLUDE_TRAILING_BRACKETS = { 0x2cbdf6c3, 0xdb
 static const GUID GUID_CFG_SEARCH_SKIP_FILTER = { 0x4c6e3dac, 0xb668, 0x4056, { 0x8c, 0xb7, 0x52, 0x89, 0x1a, 0x57, 0x1f, 0x3a } };
 static const GUID GUID_CFG_SEARCH_PREFERRED_LYRIC_TYPE = { 0x66b4edf6, 0x7995, 0x4d52, { 0xa9, 0xa, 0x12, 0xdf, 0xf7, 0xa, 0x11, 0xa2 } };
 static const GUID GUID_CFG_SEARCH_WITHOUT_LYRIC_PANELS = { 0x3d29b9eb, 0x4454, 0x4798, { 0x9b, 0x33, 0x4b, 0xb5, 0xbf, 0x44, 0x4a, 0x7f } };
+static const GUID GUID_CFG_SEARCH_SOURCES_CONCURRENTLY = { 0x5a0e6f0d, 0x8b2c, 0x4e61, { 0xa4, 0x17, 0x3c, 0x9d, 0x62, 0xf1, 0x0b, 0x5e } };
+static const GUID GUID_CFG_SEARCH_CACHE_REMOTE_RESULTS = { 0xc41f7e2a, 0x63d9, 0x4b07, { 0x8e, 0x15, 0x9f, 0x2a, 0xd0, 0x47, 0x6c, 0x31 } };
+static const GUID GUID_CFG_SEARCH_PREFETCH_TRACK_COUNT = { 0x7d3b91e4, 0x2a6f, 0x4c88, { 0xb9, 0x0e, 0x54, 0xc1, 0x3f, 0x8a, 0x27, 0xd6 } };
 // clang-format on
 
 static cfg_auto_combo_option<LyricType> preferred_lyric_type_options[] = { { _T("Synced"), LyricType::Synced },
@@ -37,12 +40,24 @@ static cfg_auto_combo<LyricType, 2> cfg_search_preferred_lyric_type(GUID_CFG_SEA
 static cfg_auto_bool cfg_search_without_lyric_panels(GUID_CFG_SEARCH_WITHOUT_LYRIC_PANELS,
                                                      IDC_SEARCH_WITHOUT_PANELS,
                                                      false);
+static cfg_auto_bool cfg_search_sources_concurrently(GUID_CFG_SEARCH_SOURCES_CONCURRENTLY,
+                                                     IDC_SEARCH_SOURCES_CONCURRENTLY,
+                                                     false);
+static cfg_auto_bool cfg_search_cache_remote_results(GUID_CFG_SEARCH_CACHE_REMOTE_RESULTS,
+                                                     IDC_SEARCH_CACHE_REMOTE_RESULTS,
+                                                     true);
+static cfg_auto_int cfg_search_prefetch_track_count(GUID_CFG_SEARCH_PREFETCH_TRACK_COUNT,
+                                                    IDC_SEARCH_PREFETCH_COUNT,
+                                                    1);
 
 static cfg_auto_property* g_searching_auto_properties[] = {
     &cfg_search_exclude_trailing_brackets,
     &cfg_search_skip_filter,
     &cfg_search_preferred_lyric_type,
     &cfg_search_without_lyric_panels,
+    &cfg_search_sources_concurrently,
+    &cfg_search_cache_remote_results,
+    &cfg_search_prefetch_track_count,
 };
 
 bool preferences::searching::exclude_trailing_brackets()
@@ -65,6 +80,22 @@ bool preferences::searching::should_search_without_panels()
     return cfg_search_without_lyric_panels.get_value();
 }
 
+bool preferences::searching::search_sources_concurrently()
+{
+    return cfg_search_sources_concurrently.get_value();
+}
+
+bool preferences::searching::cache_remote_results()
+{
+    return cfg_search_cache_remote_results.get_value();
+}
+
+int preferences::searching::prefetch_track_count()
+{
+    const int max_prefetch_tracks = 10; // Arbitrarily selected, to avoid flooding sources with requests
+    return std::clamp(int(cfg_search_prefetch_track_count.get_value()), 0, max_prefetch_tracks);
+}
+
 bool preferences::searching::raw::is_skip_filter_default()
 {
     return (cfg_search_skip_filter.get_stringview() == cfg_search_skip_filter.get_default());
@@ -91,6 +122,9 @@ public:
     MSG_WM_INITDIALOG(OnInitDialog)
     COMMAND_HANDLER_EX(IDC_SEARCH_EXCLUDE_BRACKETS, BN_CLICKED, OnUIChange)
     COMMAND_HANDLER_EX(IDC_SEARCH_WITHOUT_PANELS, BN_CLICKED, OnUIChange)
+    COMMAND_HANDLER_EX(IDC_SEARCH_SOURCES_CONCURRENTLY, BN_CLICKED, OnUIChange)
+    COMMAND_HANDLER_EX(IDC_SEARCH_CACHE_REMOTE_RESULTS, BN_CLICKED, OnUIChange)
+    COMMAND_HANDLER_EX(IDC_SEARCH_PREFETCH_COUNT, EN_CHANGE, OnUIChange)
     COMMAND_HANDLER_EX(IDC_SEARCHING_EXCLUDE_HELP, BN_CLICKED, OnSearchingBracketExcludeHelpClicked)
     COMMAND_HANDLER_EX(IDC_SEARCH_PREFERRED_TYPE, CBN_SELCHANGE, OnUIChange)
     COMMAND_HANDLER_EX(IDC_SEARCH_SKIP_FILTER_STR, EN_CHANGE, OnSkipFilterFormatChange)
@@ -8,6 +8,7 @@
 
 #include "logging.h"
 #include "preferences.h"
+#include "source_health.h"
 #include "sources/lyric_source.h"
 #include "ui_util.h"
 #include "win32_util.h"
@@ -116,6 +117,7 @@ private:
     void OnActiveSourceSelect(UINT, int, CWindow);
     void OnInactiveSourceSelect(UINT, int, CWindow);
 
+    void SourceStatusUpdate(int list_id);
     void SourceListInitialise();
     void SourceListResetFromSaved();
     void SourceListResetToDefault();
@@ -334,6 +336,8 @@ void PreferencesSearchSources::OnActiveSourceSelect(UINT, int, CWindow)
     CWindow move_down_btn = GetDlgItem(IDC_SOURCE_MOVE_DOWN_BTN);
     assert(move_down_btn != nullptr);
     move_down_btn.EnableWindow((select_index != LB_ERR) && (select_index + 1 != item_count));
+
+    SourceStatusUpdate(IDC_ACTIVE_SOURCE_LIST);
 }
 
 void PreferencesSearchSources::OnInactiveSourceSelect(UINT, int, CWindow)
@@ -353,6 +357,25 @@ void PreferencesSearchSources::OnInactiveSourceSelect(UINT, int, CWindow)
     assert(move_down_btn != nullptr);
     move_up_btn.EnableWindow(FALSE);
     move_down_btn.EnableWindow(FALSE);
+
+    SourceStatusUpdate(IDC_INACTIVE_SOURCE_LIST);
+}
+
+void PreferencesSearchSources::SourceStatusUpdate(int list_id)
+{
+    LRESULT select_index = SendDlgItemMessage(list_id, LB_GETCURSEL, 0, 0);
+    if(select_index == LB_ERR)
+    {
+        return; // No selection
+    }
+
+    LRESULT select_data = SendDlgItemMessage(list_id, LB_GETITEMDATA, select_index, 0);
+    assert(select_data != LB_ERR);
+    const GUID* source_id = (const GUID*)select_data;
+    assert(source_id != nullptr);
+
+    const std::string status = source_health::describe_source(*source_id);
+    SetDlgItemText(IDC_SOURCE_STATUS, to_tstring(status).c_str());
 }
 
 void PreferencesSearchSources::reset()
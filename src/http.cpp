@@ -1,138 +1,1306 @@
 #include "stdafx.h"
 
+#include <chrono>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <winhttp.h>
+
 #define CURL_STATICLIB
 #include "curl/curl.h"
 #include "curl/multi.h"
 #include "http.h"
+#include "http_cache.h"
+#include "http_fixtures.h"
 #include "logging.h"
+#include "mvtf/mvtf.h"
 #include "openlyrics_version.h" // Defines OPENLYRICS_VERSION
+#include "preferences.h"
+#include "source_health.h"
+#include "win32_util.h"
+#include "work_scheduler.h"
 
-static void on_init()
+bool http::Result::is_success() const
 {
-    CURLcode result = curl_global_init(CURL_GLOBAL_DEFAULT);
-    if(result != 0)
+    return completed_successfully && (response_status < 300);
+}
+
+using RateLimitClock = std::chrono::steady_clock;
+
+// NOTE: We don't trust servers to tell us the truth about how large their responses are,
+//       so we never allocate more than this up-front, no matter what they say.
+static const size_t MAX_PRESIZED_BODY_BYTES = 16 * 1024 * 1024;
+
+// A token bucket that allows short bursts of requests but limits the sustained rate of requests
+// to a single site. If the site tells us that we're sending too many requests (or that it is overloaded)
+// then we stop sending requests entirely for a while, backing off further each time it happens.
+class SiteRateLimit
+{
+public:
+    SiteRateLimit(RateLimitClock::time_point now)
+        : m_tokens(MAX_TOKENS)
+        , m_last_refill(now)
+        , m_blocked_until(now)
+        , m_consecutive_backoffs(0)
     {
-        LOG_WARN("Failed to initial global libcurl state: %s", curl_easy_strerror(result));
     }
+
+    // Takes a token if one is available, otherwise returns how long to wait before trying again.
+    // NOTE: Some tokens are reserved for urgent requests (that someone is waiting on), so that background work like
+    //       a bulk search can't use them all up and leave the search for the playing track waiting behind it.
+    RateLimitClock::duration try_take(RateLimitClock::time_point now, bool is_urgent)
+    {
+        if(now < m_blocked_until)
+        {
+            return m_blocked_until - now;
+        }
+
+        const std::chrono::duration<double> since_refill = now - m_last_refill;
+        m_tokens = std::min(MAX_TOKENS, m_tokens + since_refill.count() * TOKENS_PER_SECOND);
+        m_last_refill = now;
+        const double tokens_required = is_urgent ? 1.0 : (1.0 + RESERVED_URGENT_TOKENS);
+        if(m_tokens >= tokens_required)
+        {
+            m_tokens -= 1.0;
+            return RateLimitClock::duration::zero();
+        }
+
+        const std::chrono::duration<double> until_next_token((tokens_required - m_tokens) / TOKENS_PER_SECOND);
+        return std::chrono::duration_cast<RateLimitClock::duration>(until_next_token);
+    }
+
+    void back_off(RateLimitClock::time_point now, std::optional<std::chrono::seconds> retry_after)
+    {
+        // NOTE: We always wait at least as long as the exponential backoff, even if the site asked for less
+        const std::chrono::seconds initial_backoff(5);
+        const std::chrono::seconds max_backoff(10 * 60);
+        std::chrono::seconds backoff = initial_backoff * (1 << std::min(m_consecutive_backoffs, 7));
+        if(retry_after.has_value() && (retry_after.value() > backoff))
+        {
+            backoff = retry_after.value();
+        }
+        backoff = std::min(backoff, max_backoff);
+
+        m_blocked_until = std::max(m_blocked_until, now + backoff);
+        m_tokens = 0.0;
+        m_consecutive_backoffs++;
+    }
+
+    void reset_backoff()
+    {
+        m_consecutive_backoffs = 0;
+    }
+
+private:
+    static constexpr double TOKENS_PER_SECOND = 0.5;
+    static constexpr double MAX_TOKENS = 5.0;
+    static constexpr double RESERVED_URGENT_TOKENS = 2.0;
+
+    double m_tokens;
+    RateLimitClock::time_point m_last_refill;
+    RateLimitClock::time_point m_blocked_until;
+    int m_consecutive_backoffs;
+};
+
+static std::mutex g_rate_limit_mutex;
+static std::unordered_map<std::string, SiteRateLimit> g_site_rate_limits;
+
+// Returns the part of the URL's host name that identifies the site being requested.
+// e.g: "https://c.y.qq.com/lyric" -> "qq.com" or "http://artist.bandcamp.com/track/title" -> "bandcamp.com"
+static std::string get_rate_limit_site(std::string_view url)
+{
+    const size_t scheme_end = url.find("://");
+    if(scheme_end != std::string_view::npos)
+    {
+        url.remove_prefix(scheme_end + 3);
+    }
+
+    const size_t host_end = url.find_first_of(":/?#");
+    std::string_view host = url.substr(0, host_end);
+
+    const size_t last_dot = host.rfind('.');
+    if((last_dot != std::string_view::npos) && (last_dot > 0))
+    {
+        const size_t second_last_dot = host.rfind('.', last_dot - 1);
+        if(second_last_dot != std::string_view::npos)
+        {
+            host.remove_prefix(second_last_dot + 1);
+        }
+    }
+    return std::string(host);
 }
 
-static void on_quit()
+// Returns true if the current thread is making requests that someone is waiting on. Requests that aren't made on
+// behalf of any scheduled work at all (e.g submitting metrics) are also treated as urgent, to be safe.
+static bool is_urgent_request()
 {
-    curl_global_cleanup();
+    const std::optional<WorkPriority> priority = work_scheduler::current_priority();
+    return !priority.has_value() || (priority.value() == WorkPriority::NowPlaying)
+           || (priority.value() == WorkPriority::Manual);
 }
 
-FB2K_ON_INIT_STAGE(on_init, init_stages::before_library_init);
-FB2K_RUN_ON_QUIT(on_quit);
+static void wait_for_rate_limit(const std::string& site, abort_callback& abort)
+{
+    const bool is_urgent = is_urgent_request();
+    while(true)
+    {
+        RateLimitClock::duration wait_time;
+        {
+            std::lock_guard lock(g_rate_limit_mutex);
+            const RateLimitClock::time_point now = RateLimitClock::now();
+            auto iter = g_site_rate_limits.try_emplace(site, now).first;
+            wait_time = iter->second.try_take(now, is_urgent);
+        }
 
-bool http::Result::is_success() const
+        if(wait_time <= RateLimitClock::duration::zero())
+        {
+            return;
+        }
+        const std::chrono::duration<double> wait_seconds = wait_time;
+        abort.sleep(wait_seconds.count());
+    }
+}
+
+static void report_response_status(const std::string& site,
+                                   long status,
+                                   std::optional<std::chrono::seconds> retry_after)
 {
-    return completed_successfully && (response_status < 300);
+    std::lock_guard lock(g_rate_limit_mutex);
+    const RateLimitClock::time_point now = RateLimitClock::now();
+    auto iter = g_site_rate_limits.try_emplace(site, now).first;
+    if((status == 429) || (status == 503))
+    {
+        LOG_WARN("Received HTTP %d from %s, backing off before making further requests", int(status), site.c_str());
+        iter->second.back_off(now, retry_after);
+    }
+    else if((status >= 200) && (status < 300))
+    {
+        iter->second.reset_backoff();
+    }
+}
+
+static std::chrono::milliseconds get_request_timeout()
+{
+    const std::optional<GUID> source_id = source_health::current_request_source();
+    if(source_id.has_value())
+    {
+        return source_health::request_timeout(source_id.value());
+    }
+    return std::chrono::seconds(30);
+}
+
+// clang-format off
+static const GUID GUID_ADVCONFIG_DNS_CACHE_SECONDS = { 0x59605a91, 0xc6db, 0x4ab9, { 0x89, 0x17, 0x5a, 0xf7, 0x97, 0xdf, 0x50, 0x98 } };
+static const GUID GUID_ADVCONFIG_SESSION_CACHE_MINUTES = { 0xd3658036, 0x4f78, 0x4056, { 0xa6, 0xd0, 0xc3, 0x76, 0x01, 0xfc, 0x87, 0x24 } };
+static const GUID GUID_ADVCONFIG_PROXY = { 0xff053287, 0x4212, 0x4fd4, { 0xb3, 0x80, 0xf4, 0x49, 0x5f, 0x34, 0xd9, 0x75 } };
+// clang-format on
+
+static advconfig_integer_factory g_advconfig_dns_cache_seconds("Remember DNS lookups for (seconds)",
+                                                               GUID_ADVCONFIG_DNS_CACHE_SECONDS,
+                                                               GUID_ADVCONFIG_BRANCH,
+                                                               0.0,
+                                                               300,
+                                                               0,
+                                                               24 * 60 * 60);
+static advconfig_integer_factory g_advconfig_session_cache_minutes("Remember cookies and TLS sessions for (minutes)",
+                                                                   GUID_ADVCONFIG_SESSION_CACHE_MINUTES,
+                                                                   GUID_ADVCONFIG_BRANCH,
+                                                                   1.0,
+                                                                   60,
+                                                                   0,
+                                                                   24 * 60);
+static advconfig_string_factory g_advconfig_proxy("Send requests through proxy (leave blank to use the system proxy)",
+                                                  GUID_ADVCONFIG_PROXY,
+                                                  GUID_ADVCONFIG_BRANCH,
+                                                  2.0,
+                                                  "");
+
+// The proxy that a request should be sent through, as the values for CURLOPT_PROXY and CURLOPT_NOPROXY
+struct ProxyConfig
+{
+    std::string proxy;    // Empty to connect directly
+    std::string no_proxy; // Comma-separated hosts that should be connected to directly, even if a proxy is set
+};
+
+// Calls `on_entry` with each of the entries in a list of proxies (or of hosts that bypass the proxy) from the
+// Windows proxy settings, which may be separated by semicolons or whitespace.
+template<typename TCallback>
+static void for_each_proxy_list_entry(std::string_view list, TCallback on_entry)
+{
+    size_t start = 0;
+    while(start < list.length())
+    {
+        const size_t end = std::min(list.find_first_of("; \t\r\n", start), list.length());
+        const std::string_view entry = list.substr(start, end - start);
+        if(!entry.empty())
+        {
+            on_entry(entry);
+        }
+        start = end + 1;
+    }
+}
+
+// Picks the proxy for the given URL scheme out of the proxy list from the Windows proxy settings. That list is
+// either a single proxy for every scheme (e.g "proxy:8080") or one per scheme (e.g "http=proxy:80;https=proxy:443"),
+// in which case a SOCKS proxy is used for any scheme that doesn't have its own.
+static std::string select_proxy_for_scheme(std::string_view proxy_list, std::string_view scheme)
+{
+    std::optional<std::string> result;
+    std::string socks_proxy;
+    for_each_proxy_list_entry(proxy_list,
+                              [&result, &socks_proxy, scheme](std::string_view entry)
+                              {
+                                  const size_t equals_index = entry.find('=');
+                                  if(equals_index == std::string_view::npos)
+                                  {
+                                      result.emplace(entry);
+                                      return;
+                                  }
+
+                                  const std::string_view entry_scheme = entry.substr(0, equals_index);
+                                  const std::string_view entry_proxy = entry.substr(equals_index + 1);
+                                  if(!result.has_value() && (entry_scheme == scheme))
+                                  {
+                                      result.emplace(entry_proxy);
+                                  }
+                                  else if(entry_scheme == "socks")
+                                  {
+                                      socks_proxy = std::string("socks4://") + std::string(entry_proxy);
+                                  }
+                              });
+    return result.value_or(socks_proxy);
+}
+
+// Converts the proxy bypass list from the Windows proxy settings (e.g "<local>;*.example.com") into a list of hosts
+// for CURLOPT_NOPROXY. Windows allows wildcards anywhere in a host but curl only matches whole domains (including
+// their subdomains), so we drop any entries that curl can't express.
+static std::string convert_proxy_bypass_list(std::string_view bypass_list)
+{
+    std::string result;
+    for_each_proxy_list_entry(bypass_list,
+                              [&result](std::string_view entry)
+                              {
+                                  if(entry == "<local>")
+                                  {
+                                      entry = "localhost,127.0.0.1,::1";
+                                  }
+                                  else if((entry.length() > 2) && (entry.substr(0, 2) == "*."))
+                                  {
+                                      entry.remove_prefix(2);
+                                  }
+
+                                  if(entry.find('*') == std::string_view::npos)
+                                  {
+                                      result += result.empty() ? "" : ",";
+                                      result += entry;
+                                  }
+                              });
+    return result;
+}
+
+struct SystemProxySettings
+{
+    std::string proxy_list;
+    std::string bypass_list;
+};
+
+static SystemProxySettings read_system_proxy_settings()
+{
+    WINHTTP_CURRENT_USER_IE_PROXY_CONFIG ie_config = {};
+    if(!WinHttpGetIEProxyConfigForCurrentUser(&ie_config))
+    {
+        LOG_INFO("Failed to read the system proxy settings, requests will connect directly: %d", GetLastError());
+        return {};
+    }
+
+    SystemProxySettings result = {};
+    if(ie_config.lpszProxy != nullptr)
+    {
+        result.proxy_list = from_tstring(std::wstring_view(ie_config.lpszProxy));
+        GlobalFree(ie_config.lpszProxy);
+    }
+    if(ie_config.lpszProxyBypass != nullptr)
+    {
+        result.bypass_list = from_tstring(std::wstring_view(ie_config.lpszProxyBypass));
+        GlobalFree(ie_config.lpszProxyBypass);
+    }
+    if(ie_config.lpszAutoConfigUrl != nullptr)
+    {
+        GlobalFree(ie_config.lpszAutoConfigUrl);
+    }
+    return result;
 }
 
-static size_t write_callback(void* contents, size_t size, size_t nmemb, std::string* userp)
+// Returns the proxy that the given URL should be requested through. Requests go through the proxy set in our own
+// advanced preferences if there is one, and otherwise follow the (static) proxy settings of the system.
+// NOTE: We can't read foobar2000's own proxy settings, and we don't support proxy auto-config scripts.
+static ProxyConfig get_proxy_config(std::string_view url)
 {
-    size_t content_len = size * nmemb;
-    userp->append(static_cast<char*>(contents), content_len);
-    return content_len;
+    const pfc::string8 configured_proxy = g_advconfig_proxy.get();
+    if(!configured_proxy.is_empty())
+    {
+        return { std::string(configured_proxy.c_str()), {} };
+    }
+
+    // NOTE: The system settings rarely change, so we don't read them again for every request
+    static std::mutex settings_mutex;
+    static std::optional<SystemProxySettings> settings;
+    static std::chrono::steady_clock::time_point settings_read_at;
+    SystemProxySettings current_settings;
+    {
+        std::lock_guard lock(settings_mutex);
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if(!settings.has_value() || (now - settings_read_at > std::chrono::minutes(1)))
+        {
+            settings = read_system_proxy_settings();
+            settings_read_at = now;
+        }
+        current_settings = settings.value();
+    }
+
+    const std::string_view scheme = url.substr(0, url.find("://"));
+    return { select_proxy_for_scheme(current_settings.proxy_list, scheme),
+             convert_proxy_bypass_list(current_settings.bypass_list) };
 }
 
-http::Result http::get_http2(const std::string& url, abort_callback& abort)
+// DNS lookups, TLS sessions and cookies that are shared between all curl requests, so that requests to a host
+// that we've contacted recently can skip straight to sending the request. Once it reaches the configured lifetime
+// the whole lot is replaced with a fresh one, so that we don't hold on to stale cookies or sessions forever.
+class CurlSharedState
 {
-    CURLM* multi = curl_multi_init();
-    if(multi == nullptr)
+public:
+    CurlSharedState()
+        : m_share(curl_share_init())
+        , m_created_at(std::chrono::steady_clock::now())
+        , m_locks()
+    {
+        if(m_share == nullptr)
+        {
+            return;
+        }
+
+        curl_share_setopt(m_share, CURLSHOPT_LOCKFUNC, lock);
+        curl_share_setopt(m_share, CURLSHOPT_UNLOCKFUNC, unlock);
+        curl_share_setopt(m_share, CURLSHOPT_USERDATA, this);
+        curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+        curl_share_setopt(m_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_COOKIE);
+    }
+    ~CurlSharedState()
+    {
+        if(m_share != nullptr)
+        {
+            curl_share_cleanup(m_share);
+        }
+    }
+    CurlSharedState(const CurlSharedState& other) = delete;
+    CurlSharedState& operator=(const CurlSharedState& other) = delete;
+
+    CURLSH* handle() const
+    {
+        return m_share;
+    }
+
+    bool is_older_than(std::chrono::minutes lifetime) const
+    {
+        return (std::chrono::steady_clock::now() - m_created_at) >= lifetime;
+    }
+
+    // Records that the given site has set a cookie, which the cookie engine will now send with every later request
+    // to that site (until this state is replaced).
+    void add_site_with_cookies(const std::string& site)
+    {
+        std::lock_guard lock(m_sites_with_cookies_mutex);
+        m_sites_with_cookies.insert(site);
+    }
+
+    bool has_cookies_for_site(const std::string& site)
+    {
+        std::lock_guard lock(m_sites_with_cookies_mutex);
+        return m_sites_with_cookies.find(site) != m_sites_with_cookies.end();
+    }
+
+private:
+    static void lock(CURL* /*handle*/, curl_lock_data data, curl_lock_access /*access*/, void* userptr)
+    {
+        static_cast<CurlSharedState*>(userptr)->m_locks[data].lock();
+    }
+
+    static void unlock(CURL* /*handle*/, curl_lock_data data, void* userptr)
+    {
+        static_cast<CurlSharedState*>(userptr)->m_locks[data].unlock();
+    }
+
+    CURLSH* const m_share;
+    const std::chrono::steady_clock::time_point m_created_at;
+    std::mutex m_locks[CURL_LOCK_DATA_LAST];
+
+    std::mutex m_sites_with_cookies_mutex;
+    std::unordered_set<std::string> m_sites_with_cookies;
+};
+
+struct CurlRequestOptions
+{
+    // NOTE: This only exists so that we can benchmark against the old behaviour of connecting for every request
+    bool reuse_connections = true;
+
+    std::vector<std::string> headers; // Extra request headers, e.g: "If-None-Match: <etag>"
+    std::optional<std::string> post_body; // If set, the request is a POST with this body (which may be empty)
+    http::BodyChunkCallback on_body_chunk;
+};
+
+struct CurlResponse
+{
+    http::Result result;
+    std::optional<std::chrono::seconds> retry_after;
+    http_cache::ResponseHeaders cache_headers;
+    bool stopped_early = false; // True if the body callback asked us to stop downloading the response
+    bool set_cookies = false;   // True if the response (or any redirect on the way to it) set a cookie
+    bool timed_out = false;     // True if we gave up on the request because it took longer than its timeout
+};
+
+// A single long-lived curl multi handle that all curl requests are made through, driven by its own I/O thread.
+// Keeping the multi handle around means that its connection cache (and with it DNS lookups and TLS handshakes)
+// is reused across requests, and concurrent HTTP/2 requests to the same host share a single multiplexed connection.
+class CurlClient
+{
+public:
+    CurlClient()
+        : m_mutex()
+        , m_started()
+        , m_io_thread()
+        , m_multi(nullptr)
+        , m_stopping(false)
+        , m_pending_adds()
+        , m_pending_cancels()
+        , m_idle_handles()
+        , m_shared_state()
+    {
+    }
+
+    struct Transfer;
+
+    // Starts making a request in the background. Any number of requests may be in progress at once.
+    // The response must be collected with `wait`.
+    std::shared_ptr<Transfer> begin(const std::string& url, const CurlRequestOptions& options)
+    {
+        std::call_once(m_started, [this]() { start(); });
+
+        auto transfer = std::make_shared<Transfer>();
+        if(m_multi == nullptr)
+        {
+            transfer->fail("Failed to initialise curl-multi handle");
+            return transfer;
+        }
+
+        transfer->easy = acquire_easy_handle();
+        if(transfer->easy == nullptr)
+        {
+            transfer->fail("Failed to initialise curl-easy handle");
+            return transfer;
+        }
+
+        // NOTE: The transfer holds on to the shared state (even if it gets replaced in the meantime) because
+        //       curl requires that a share handle outlives every easy handle that uses it.
+        transfer->shared_state = get_shared_state();
+
+        CURL* curl = transfer->easy;
+        curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, transfer->error_message);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
+        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
+        curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, long(get_request_timeout().count()));
+        curl_easy_setopt(curl, CURLOPT_USERAGENT, "foo_openlyrics/" OPENLYRICS_VERSION);
+
+        const ProxyConfig proxy = get_proxy_config(url);
+        if(!proxy.proxy.empty())
+        {
+            curl_easy_setopt(curl, CURLOPT_PROXY, proxy.proxy.c_str());
+            curl_easy_setopt(curl, CURLOPT_NOPROXY, proxy.no_proxy.c_str());
+        }
+
+        // Force HTTP/2, and if there is already a connection to this host being set up then wait to find out if
+        // we can multiplex over it rather than opening another connection of our own.
+        curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2_0);
+        curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+        if(!options.reuse_connections)
+        {
+            curl_easy_setopt(curl, CURLOPT_FRESH_CONNECT, 1L);
+            curl_easy_setopt(curl, CURLOPT_FORBID_REUSE, 1L);
+        }
+
+        // NOTE: The cookie engine is always enabled so that cookies set by a redirect are sent to where it leads
+        //       (some sites redirect back to the same URL until we send the cookies they asked us to set).
+        //       Without shared state, we clear any cookies left on a reused handle by whatever request used it last.
+        curl_easy_setopt(curl, CURLOPT_DNS_CACHE_TIMEOUT, long(g_advconfig_dns_cache_seconds.get()));
+        curl_easy_setopt(curl, CURLOPT_COOKIEFILE, ""); // Enables the (in-memory) cookie engine
+        if(transfer->shared_state != nullptr)
+        {
+            curl_easy_setopt(curl, CURLOPT_SHARE, transfer->shared_state->handle());
+        }
+        else
+        {
+            curl_easy_setopt(curl, CURLOPT_COOKIELIST, "ALL");
+        }
+
+        for(const std::string& header : options.headers)
+        {
+            transfer->headers = curl_slist_append(transfer->headers, header.c_str());
+        }
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, transfer->headers);
+
+        if(options.post_body.has_value())
+        {
+            transfer->post_body = options.post_body.value();
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, curl_off_t(transfer->post_body.size()));
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, transfer->post_body.c_str());
+        }
+
+        transfer->on_body_chunk = options.on_body_chunk;
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_body);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, transfer.get());
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+
+        {
+            std::lock_guard lock(m_mutex);
+            if(m_stopping)
+            {
+                curl_easy_cleanup(transfer->easy);
+                curl_slist_free_all(transfer->headers);
+                transfer->easy = nullptr;
+                transfer->headers = nullptr;
+                transfer->shared_state.reset();
+                transfer->fail("Shutting down");
+                return transfer;
+            }
+            m_pending_adds.push_back(transfer);
+        }
+        curl_multi_wakeup(m_multi);
+        return transfer;
+    }
+
+    // Waits for a request started with `begin` to complete and returns its response.
+    // If the abort callback is triggered first then the request is cancelled.
+    CurlResponse wait(const std::shared_ptr<Transfer>& transfer, abort_callback& abort)
+    {
+        if(transfer->easy == nullptr)
+        {
+            return std::move(transfer->response); // The request failed before it could be started
+        }
+
+        try
+        {
+            abort.waitForEvent(transfer->done);
+        }
+        catch(...)
+        {
+            {
+                std::lock_guard lock(m_mutex);
+                m_pending_cancels.push_back(transfer);
+            }
+            curl_multi_wakeup(m_multi);
+
+            // NOTE: We need to wait for the I/O thread to stop using the transfer before we can reuse its handle
+            transfer->done.wait_for(-1);
+            release_transfer(*transfer);
+
+            CurlResponse response = {};
+            response.result.error_message = "Aborted";
+            return response;
+        }
+
+        release_transfer(*transfer);
+        return std::move(transfer->response);
+    }
+
+    CurlResponse perform(const std::string& url, abort_callback& abort, const CurlRequestOptions& options)
+    {
+        return wait(begin(url, options), abort);
+    }
+
+    // Returns true if requests to the given site may be sent with cookies that were set by an earlier response
+    bool site_has_cookies(const std::string& site)
+    {
+        std::lock_guard lock(m_mutex);
+        return (m_shared_state != nullptr) && m_shared_state->has_cookies_for_site(site);
+    }
+
+    void add_site_with_cookies(const std::string& site)
+    {
+        std::lock_guard lock(m_mutex);
+        if(m_shared_state != nullptr)
+        {
+            m_shared_state->add_site_with_cookies(site);
+        }
+    }
+
+    void stop()
     {
-        Result result = {};
-        result.error_message = "Failed to initialise curl-multi handle";
-        return result;
+        {
+            std::lock_guard lock(m_mutex);
+            if(!m_io_thread.joinable())
+            {
+                return;
+            }
+            m_stopping = true;
+        }
+        curl_multi_wakeup(m_multi);
+        m_io_thread.join();
+
+        std::lock_guard lock(m_mutex);
+        for(CURL* easy : m_idle_handles)
+        {
+            curl_easy_cleanup(easy);
+        }
+        m_idle_handles.clear();
+        m_shared_state.reset();
+        curl_multi_cleanup(m_multi);
+        m_multi = nullptr;
     }
 
-    CURL* curl = curl_easy_init();
-    if(curl == nullptr)
+private:
+    struct Transfer
+    {
+        CURL* easy = nullptr;
+        std::shared_ptr<CurlSharedState> shared_state;
+        curl_slist* headers = nullptr;
+        std::string post_body;
+        http::BodyChunkCallback on_body_chunk;
+        char error_message[CURL_ERROR_SIZE] = {};
+        CurlResponse response;
+        pfc::event done;
+
+        void fail(const char* message)
+        {
+            response.result.error_message = message;
+            done.set_state(true);
+        }
+    };
+
+    static constexpr size_t MAX_IDLE_HANDLES = 8;
+    static constexpr long MAX_CACHED_CONNECTIONS = 16;
+
+    // NOTE: curl shortens this as necessary to service its own timers, so it only limits how long we sleep when
+    //       nothing at all is happening. Everything that needs our attention wakes us up explicitly.
+    static constexpr int MAX_POLL_TIMEOUT_MS = 60'000;
+
+    void start()
     {
-        curl_multi_cleanup(multi);
+        m_multi = curl_multi_init();
+        if(m_multi == nullptr)
+        {
+            LOG_WARN("Failed to initialise shared curl-multi handle");
+            return;
+        }
+        curl_multi_setopt(m_multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+        curl_multi_setopt(m_multi, CURLMOPT_MAXCONNECTS, MAX_CACHED_CONNECTIONS);
 
-        Result result = {};
-        result.error_message = "Failed to initialise curl-easy handle";
-        return result;
+        std::lock_guard lock(m_mutex);
+        m_io_thread = std::thread([this]() { run_io_thread(); });
     }
 
-    char error_message[CURL_ERROR_SIZE] = {};
-    curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, error_message);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
-    curl_easy_setopt(curl, CURLOPT_USERAGENT, "foo_openlyrics/" OPENLYRICS_VERSION);
+    CURL* acquire_easy_handle()
+    {
+        {
+            std::lock_guard lock(m_mutex);
+            if(!m_idle_handles.empty())
+            {
+                CURL* easy = m_idle_handles.back();
+                m_idle_handles.pop_back();
+                curl_easy_reset(easy);
+                return easy;
+            }
+        }
+        return curl_easy_init();
+    }
 
-    // Force HTTP/2
-    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2_0);
+    std::shared_ptr<CurlSharedState> get_shared_state()
+    {
+        const std::chrono::minutes lifetime(g_advconfig_session_cache_minutes.get());
+        if(lifetime.count() == 0)
+        {
+            return nullptr;
+        }
 
-    Result result = {};
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &result.response_content);
-    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        std::lock_guard lock(m_mutex);
+        if((m_shared_state == nullptr) || m_shared_state->is_older_than(lifetime))
+        {
+            m_shared_state = std::make_shared<CurlSharedState>();
+            if(m_shared_state->handle() == nullptr)
+            {
+                LOG_WARN("Failed to initialise curl-share handle, requests will not share DNS, TLS or cookie data");
+                m_shared_state.reset();
+            }
+        }
+        return m_shared_state;
+    }
 
-    const CURLMcode add_result = curl_multi_add_handle(multi, curl);
-    if(add_result != CURLM_OK)
+    void release_transfer(Transfer& transfer)
     {
-        curl_easy_cleanup(curl);
-        curl_multi_cleanup(multi);
-        result.error_message = curl_multi_strerror(add_result);
-        return result;
+        CURL* easy = transfer.easy;
+        if(transfer.shared_state != nullptr)
+        {
+            curl_easy_setopt(easy, CURLOPT_SHARE, nullptr);
+            transfer.shared_state.reset();
+        }
+        curl_easy_setopt(easy, CURLOPT_HTTPHEADER, nullptr);
+        curl_slist_free_all(transfer.headers);
+        transfer.headers = nullptr;
+
+        std::lock_guard lock(m_mutex);
+        if(m_stopping || (m_idle_handles.size() >= MAX_IDLE_HANDLES))
+        {
+            curl_easy_cleanup(easy);
+        }
+        else
+        {
+            m_idle_handles.push_back(easy);
+        }
     }
 
-    int num_running_handles = 1;
-    while((num_running_handles > 0) && !abort.is_aborting())
+    // NOTE: This is called on the I/O thread
+    static size_t write_body(char* contents, size_t size, size_t nmemb, void* userdata)
     {
-        const CURLMcode perform_result = curl_multi_perform(multi, &num_running_handles);
-        if(perform_result != CURLM_OK)
+        Transfer* transfer = static_cast<Transfer*>(userdata);
+        std::string& body = transfer->response.result.response_content;
+        const size_t content_len = size * nmemb;
+
+        // If the server told us how large the body is then allocate space for all of it up-front, rather than
+        // reallocating repeatedly as large pages arrive.
+        if(body.empty())
         {
-            LOG_WARN("Failed to perform request activity on curl multi handle: %s. Aborting request.",
-                     curl_multi_strerror(perform_result));
-            break;
+            curl_off_t expected_length = -1;
+            if((curl_easy_getinfo(transfer->easy, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &expected_length) == CURLE_OK)
+               && (expected_length > 0) && (expected_length <= curl_off_t(MAX_PRESIZED_BODY_BYTES)))
+            {
+                body.reserve(size_t(expected_length));
+            }
         }
+        body.append(contents, content_len);
 
-        // Wait for socket activity for up to 2ms, will return immediately if there are no handles to wait for
-        const CURLMcode wait_result = curl_multi_wait(multi, nullptr, 0, 2, nullptr);
-        if(wait_result != CURLM_OK)
+        if(transfer->on_body_chunk && !transfer->on_body_chunk(std::string_view(contents, content_len)))
         {
-            LOG_WARN("Failed to wait for activity on curl multi handle: %s. Aborting request.",
-                     curl_multi_strerror(wait_result));
-            break;
+            transfer->response.stopped_early = true;
+            return 0; // Returning anything other than the number of bytes given to us makes curl stop the transfer
         }
+        return content_len;
     }
 
-    int msgs_remaining = 0;
-    const CURLMsg* msg = curl_multi_info_read(multi, &msgs_remaining);
-    if((msg != nullptr) && (msg->msg == CURLMSG_DONE))
+    static std::string get_response_header(CURL* easy, const char* name)
     {
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &result.response_status);
+        // NOTE: Request -1 is the last request made, so after following redirects this is the final response
+        curl_header* header = nullptr;
+        if(curl_easy_header(easy, name, 0, CURLH_HEADER, -1, &header) != CURLHE_OK)
+        {
+            return {};
+        }
+        return header->value;
+    }
+
+    static void finish(std::unordered_map<CURL*, std::shared_ptr<Transfer>>& active,
+                       CURLM* multi,
+                       CURL* easy,
+                       CURLcode curl_error)
+    {
+        const auto iter = active.find(easy);
+        if(iter == active.end())
+        {
+            return;
+        }
+        std::shared_ptr<Transfer> transfer = iter->second;
+        active.erase(iter);
+        curl_multi_remove_handle(multi, easy);
+
+        http::Result& result = transfer->response.result;
+        curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &result.response_status);
+        curl_off_t retry_after_sec = 0;
+        if((curl_easy_getinfo(easy, CURLINFO_RETRY_AFTER, &retry_after_sec) == CURLE_OK) && (retry_after_sec > 0))
+        {
+            transfer->response.retry_after = std::chrono::seconds(retry_after_sec);
+        }
+
+        transfer->response.cache_headers.cache_control = get_response_header(easy, "Cache-Control");
+        transfer->response.cache_headers.etag = get_response_header(easy, "ETag");
+        transfer->response.cache_headers.last_modified = get_response_header(easy, "Last-Modified");
+
+        long redirect_count = 0;
+        curl_easy_getinfo(easy, CURLINFO_REDIRECT_COUNT, &redirect_count);
+        for(long request_index = 0; request_index <= redirect_count; request_index++)
+        {
+            curl_header* header = nullptr;
+            if(curl_easy_header(easy, "Set-Cookie", 0, CURLH_HEADER, int(request_index), &header) == CURLHE_OK)
+            {
+                transfer->response.set_cookies = true;
+            }
+        }
 
-        const CURLcode curl_error = msg->data.result;
+        if(transfer->response.stopped_early)
+        {
+            curl_error = CURLE_OK;
+            transfer->error_message[0] = '\0';
+        }
         result.completed_successfully = (curl_error == CURLE_OK);
-        if(error_message[0] != '\0')
+        transfer->response.timed_out = (curl_error == CURLE_OPERATION_TIMEDOUT);
+        if(transfer->error_message[0] != '\0')
         {
-            result.error_message = error_message;
+            result.error_message = transfer->error_message;
         }
         else if(curl_error != CURLE_OK)
         {
             result.error_message = curl_easy_strerror(curl_error);
         }
+        transfer->done.set_state(true);
     }
-    else if(!abort.is_aborting())
+
+    void run_io_thread()
     {
-        if(msg == nullptr)
+        // NOTE: The multi handle (and every easy handle that has been added to it) is only ever used on this thread
+        std::unordered_map<CURL*, std::shared_ptr<Transfer>> active;
+
+        std::unique_lock lock(m_mutex);
+        while(true)
         {
-            LOG_WARN("Received unexpected info read result from curl: Null message");
+            if(m_stopping)
+            {
+                break;
+            }
+
+            std::vector<std::shared_ptr<Transfer>> adds = std::move(m_pending_adds);
+            std::vector<std::shared_ptr<Transfer>> cancels = std::move(m_pending_cancels);
+            m_pending_adds.clear();
+            m_pending_cancels.clear();
+            lock.unlock();
+
+            for(std::shared_ptr<Transfer>& transfer : adds)
+            {
+                const CURLMcode add_result = curl_multi_add_handle(m_multi, transfer->easy);
+                if(add_result != CURLM_OK)
+                {
+                    transfer->response.result.error_message = curl_multi_strerror(add_result);
+                    transfer->done.set_state(true);
+                    continue;
+                }
+                active.emplace(transfer->easy, std::move(transfer));
+            }
+            for(const std::shared_ptr<Transfer>& transfer : cancels)
+            {
+                finish(active, m_multi, transfer->easy, CURLE_ABORTED_BY_CALLBACK);
+            }
+
+            int num_running_handles = 0;
+            const CURLMcode perform_result = curl_multi_perform(m_multi, &num_running_handles);
+            if(perform_result != CURLM_OK)
+            {
+                LOG_WARN("Failed to perform request activity on curl multi handle: %s",
+                         curl_multi_strerror(perform_result));
+            }
+
+            int msgs_remaining = 0;
+            while(const CURLMsg* msg = curl_multi_info_read(m_multi, &msgs_remaining))
+            {
+                if(msg->msg == CURLMSG_DONE)
+                {
+                    finish(active, m_multi, msg->easy_handle, msg->data.result);
+                }
+                else
+                {
+                    LOG_WARN("Received unexpected info read result from curl: Message type %d", int(msg->msg));
+                }
+            }
+
+            // Sleep until there is socket activity, one of curl's own timers (e.g for request timeouts) expires, or
+            // we are woken up because a request was added or cancelled. Unlike curl_multi_wait, this keeps waiting
+            // even when there are no requests in progress, so an idle client costs nothing.
+            const CURLMcode poll_result = curl_multi_poll(m_multi, nullptr, 0, MAX_POLL_TIMEOUT_MS, nullptr);
+            if(poll_result != CURLM_OK)
+            {
+                LOG_WARN("Failed to wait for activity on curl multi handle: %s", curl_multi_strerror(poll_result));
+            }
+            lock.lock();
         }
-        else
+
+        // NOTE: Anything still in progress at this point is abandoned, but we still need to release whoever is
+        //       waiting for it to finish.
+        for(std::shared_ptr<Transfer>& transfer : m_pending_adds)
+        {
+            transfer->done.set_state(true);
+        }
+        m_pending_adds.clear();
+        m_pending_cancels.clear();
+        lock.unlock();
+
+        while(!active.empty())
         {
-            LOG_WARN("Received unexpected info read result from curl: Message type %d", int(msg->msg));
+            finish(active, m_multi, active.begin()->first, CURLE_ABORTED_BY_CALLBACK);
         }
     }
 
-    curl_multi_remove_handle(multi, curl);
-    curl_easy_cleanup(curl);
-    curl_multi_cleanup(multi);
-    return result;
+    std::mutex m_mutex;
+    std::once_flag m_started;
+    std::thread m_io_thread;
+    CURLM* m_multi;
+    bool m_stopping;
+    std::vector<std::shared_ptr<Transfer>> m_pending_adds;
+    std::vector<std::shared_ptr<Transfer>> m_pending_cancels;
+    std::vector<CURL*> m_idle_handles;
+    std::shared_ptr<CurlSharedState> m_shared_state;
+};
+static CurlClient g_curl_client;
+
+static void on_init()
+{
+    CURLcode result = curl_global_init(CURL_GLOBAL_DEFAULT);
+    if(result != 0)
+    {
+        LOG_WARN("Failed to initial global libcurl state: %s", curl_easy_strerror(result));
+    }
+}
+
+static void on_quit()
+{
+    g_curl_client.stop();
+    curl_global_cleanup();
+}
+
+FB2K_ON_INIT_STAGE(on_init, init_stages::before_library_init);
+FB2K_RUN_ON_QUIT(on_quit);
+
+// A request that has been started, or that could be answered from the cache without making a request at all
+struct PendingRequest
+{
+    std::string url;
+    std::string site;
+    bool cacheable;
+    bool record; // If true, the response gets written to the fixture directory (see http_fixtures.h)
+    std::string_view method;
+    std::string post_body; // Only kept if the response is to be recorded
+    std::optional<http_cache::CachedResponse> cached;
+    std::optional<http::Result> result; // Set if the request has already been answered (or failed to start)
+    std::shared_ptr<CurlClient::Transfer> transfer;
+    RateLimitClock::time_point start_time;
+};
+
+static PendingRequest begin_request(const std::string& url,
+                                    std::optional<std::string> post_body,
+                                    abort_callback& abort,
+                                    const http::RequestOptions& options)
+{
+    PendingRequest request = {};
+    request.url = url;
+    request.site = get_rate_limit_site(url);
+    request.method = post_body.has_value() ? "POST" : "GET";
+
+    // NOTE: The cache would hide requests from being recorded, and replayed requests don't need it
+    const http_fixtures::Mode fixture_mode = http_fixtures::get_mode();
+    if(fixture_mode == http_fixtures::Mode::Replay)
+    {
+        request.result = http_fixtures::replay(request.method, url, post_body.value_or(std::string()));
+        return request;
+    }
+    request.record = (fixture_mode == http_fixtures::Mode::Record);
+    // NOTE: Responses are cached by URL alone, so we can't use the cache for sites that have given us cookies
+    //       because the response we get could depend on the cookies that get sent with the request.
+    request.cacheable = options.allow_caching && !post_body.has_value() && !request.record
+                        && !g_curl_client.site_has_cookies(request.site);
+    if(request.record)
+    {
+        request.post_body = post_body.value_or(std::string());
+    }
+
+    CurlRequestOptions curl_options = {};
+    curl_options.headers = options.headers;
+    curl_options.post_body = std::move(post_body);
+    curl_options.on_body_chunk = options.on_body_chunk;
+
+    if(request.cacheable)
+    {
+        request.cached = http_cache::get(url);
+    }
+    if(request.cached.has_value())
+    {
+        if(request.cached->is_fresh)
+        {
+            request.result = { true, 200, request.cached->body, {} };
+            return request;
+        }
+
+        if(!request.cached->etag.empty())
+        {
+            curl_options.headers.push_back("If-None-Match: " + request.cached->etag);
+        }
+        if(!request.cached->last_modified.empty())
+        {
+            curl_options.headers.push_back("If-Modified-Since: " + request.cached->last_modified);
+        }
+    }
+
+    try
+    {
+        wait_for_rate_limit(request.site, abort);
+    }
+    catch(const exception_aborted&)
+    {
+        request.result = { false, 0, {}, "Aborted" };
+        return request;
+    }
+
+    request.start_time = RateLimitClock::now();
+    request.transfer = g_curl_client.begin(url, curl_options);
+    return request;
+}
+
+static void record_request_outcome(RateLimitClock::time_point start_time, const CurlResponse& response)
+{
+    const std::optional<GUID> source_id = source_health::current_request_source();
+    if(!source_id.has_value())
+    {
+        return;
+    }
+
+    source_health::RequestOutcome outcome = source_health::RequestOutcome::Succeeded;
+    if(response.timed_out)
+    {
+        outcome = source_health::RequestOutcome::TimedOut;
+    }
+    else if(!response.result.completed_successfully || (response.result.response_status >= 500))
+    {
+        outcome = source_health::RequestOutcome::Failed;
+    }
+
+    const auto latency = std::chrono::duration_cast<std::chrono::milliseconds>(RateLimitClock::now() - start_time);
+    source_health::record_request(source_id.value(), latency, outcome);
+}
+
+static http::Result finish_request(PendingRequest& request, abort_callback& abort)
+{
+    if(request.result.has_value())
+    {
+        return std::move(request.result.value());
+    }
+
+    CurlResponse response = g_curl_client.wait(request.transfer, abort);
+    http::Result& result = response.result;
+    if(abort.is_aborting())
+    {
+        return std::move(result);
+    }
+
+    report_response_status(request.site, result.response_status, response.retry_after);
+    record_request_outcome(request.start_time, response);
+    if(response.set_cookies)
+    {
+        g_curl_client.add_site_with_cookies(request.site);
+    }
+
+    if(result.completed_successfully && (result.response_status == 304) && request.cached.has_value())
+    {
+        const std::optional<std::string> body = http_cache::revalidated(request.url,
+                                                                        request.site,
+                                                                        response.cache_headers);
+        return { true, 200, body.value_or(request.cached->body), {} };
+    }
+
+    // NOTE: If we stopped downloading the body early then we don't have the whole response, so we can't cache it.
+    //       Responses that set cookies are likely to be personalised, or to differ from what we'll get once we
+    //       send those cookies back, so we don't cache them either.
+    if(request.cacheable && result.is_success() && !response.stopped_early && !response.set_cookies)
+    {
+        http_cache::put(request.url, request.site, response.cache_headers, result.response_content);
+    }
+
+    if(result.completed_successfully && !result.is_success() && result.error_message.empty())
+    {
+        result.error_message = "HTTP error " + std::to_string(result.response_status);
+    }
+
+    if(request.record && result.completed_successfully)
+    {
+        http_fixtures::record(request.method, request.url, request.post_body, result);
+    }
+    return std::move(result);
+}
+
+http::Result http::get(const std::string& url, abort_callback& abort, const RequestOptions& options)
+{
+    PendingRequest request = begin_request(url, {}, abort, options);
+    return finish_request(request, abort);
+}
+
+std::vector<http::Result> http::get_many(const std::vector<std::string>& urls,
+                                         abort_callback& abort,
+                                         const RequestOptions& options)
+{
+    std::vector<PendingRequest> requests;
+    requests.reserve(urls.size());
+    for(const std::string& url : urls)
+    {
+        requests.push_back(begin_request(url, {}, abort, options));
+    }
+
+    std::vector<Result> results;
+    results.reserve(urls.size());
+    for(PendingRequest& request : requests)
+    {
+        results.push_back(finish_request(request, abort));
+    }
+    return results;
+}
+
+http::Result http::post(const std::string& url,
+                        std::string_view body,
+                        abort_callback& abort,
+                        const RequestOptions& options)
+{
+    PendingRequest request = begin_request(url, std::string(body), abort, options);
+    return finish_request(request, abort);
+}
+
+// ============
+// Tests
+// ============
+#if MVTF_TESTS_ENABLED
+MVTF_TEST(http_rate_limit_site_ignores_subdomains_ports_and_paths)
+{
+    ASSERT(get_rate_limit_site("https://lrclib.net/api/search?q=x") == "lrclib.net");
+    ASSERT(get_rate_limit_site("http://c.y.qq.com/lyric/fcgi-bin/") == "qq.com");
+    ASSERT(get_rate_limit_site("http://artist.bandcamp.com/track/title") == "bandcamp.com");
+    ASSERT(get_rate_limit_site("https://www.metal-archives.com:443/search") == "metal-archives.com");
+    ASSERT(get_rate_limit_site("localhost/test") == "localhost");
+}
+
+MVTF_TEST(http_proxy_is_selected_by_url_scheme)
+{
+    ASSERT(select_proxy_for_scheme("proxy.example.com:8080", "https") == "proxy.example.com:8080");
+    ASSERT(select_proxy_for_scheme("http=web:80;https=secure:443", "https") == "secure:443");
+    ASSERT(select_proxy_for_scheme("http=web:80 https=secure:443", "http") == "web:80");
+    ASSERT(select_proxy_for_scheme("http=web:80;socks=socks:1080", "https") == "socks4://socks:1080");
+    ASSERT(select_proxy_for_scheme("ftp=files:21", "https").empty());
+    ASSERT(select_proxy_for_scheme("", "https").empty());
+}
+
+MVTF_TEST(http_proxy_bypass_list_is_converted_for_curl)
+{
+    ASSERT(convert_proxy_bypass_list("<local>") == "localhost,127.0.0.1,::1");
+    ASSERT(convert_proxy_bypass_list("*.example.com; intranet;10.*") == "example.com,intranet");
+    ASSERT(convert_proxy_bypass_list("").empty());
+}
+
+MVTF_TEST(http_rate_limit_allows_a_burst_of_requests_then_limits_the_rate)
+{
+    const RateLimitClock::time_point start = RateLimitClock::now();
+    SiteRateLimit limit(start);
+    for(int i = 0; i < 5; i++)
+    {
+        ASSERT(limit.try_take(start, true) == RateLimitClock::duration::zero());
+    }
+
+    const RateLimitClock::duration wait = limit.try_take(start, true);
+    ASSERT(wait > std::chrono::seconds(1));
+    ASSERT(wait <= std::chrono::seconds(2));
+    ASSERT(limit.try_take(start + wait, true) == RateLimitClock::duration::zero());
+}
+
+MVTF_TEST(http_rate_limit_keeps_tokens_free_for_urgent_requests)
+{
+    const RateLimitClock::time_point start = RateLimitClock::now();
+    SiteRateLimit limit(start);
+    for(int i = 0; i < 3; i++)
+    {
+        ASSERT(limit.try_take(start, false) == RateLimitClock::duration::zero());
+    }
+
+    const RateLimitClock::duration background_wait = limit.try_take(start, false);
+    ASSERT(background_wait > std::chrono::seconds(1));
+    ASSERT(background_wait <= std::chrono::seconds(2));
+    ASSERT(limit.try_take(start, true) == RateLimitClock::duration::zero());
+    ASSERT(limit.try_take(start, true) == RateLimitClock::duration::zero());
+    ASSERT(limit.try_take(start, true) > RateLimitClock::duration::zero());
+}
+
+MVTF_TEST(http_rate_limit_backs_off_exponentially_after_being_throttled)
+{
+    const RateLimitClock::time_point start = RateLimitClock::now();
+    SiteRateLimit limit(start);
+    limit.back_off(start, {});
+    ASSERT(limit.try_take(start, true) == std::chrono::seconds(5));
+
+    const RateLimitClock::time_point second_start = start + std::chrono::seconds(5);
+    limit.back_off(second_start, {});
+    ASSERT(limit.try_take(second_start, true) == std::chrono::seconds(10));
+
+    limit.reset_backoff();
+    const RateLimitClock::time_point third_start = second_start + std::chrono::seconds(10);
+    limit.back_off(third_start, std::chrono::seconds(30));
+    ASSERT(limit.try_take(third_start, true) == std::chrono::seconds(30));
+}
+
+// Compares the latency of repeated requests made over reused connections against making a new connection for every
+// request (which is what we used to do). This only runs if OPENLYRICS_HTTP_BENCHMARK_URL is set, and should point
+// at a local stand-in server that supports HTTPS and HTTP/2 with a certificate trusted by the system
+// (e.g nghttpd or caddy serving a small static file).
+MVTF_TEST(http_benchmark_repeated_requests_to_a_local_server)
+{
+    char url[1024] = {};
+    const DWORD url_length = GetEnvironmentVariableA("OPENLYRICS_HTTP_BENCHMARK_URL", url, sizeof(url));
+    if((url_length == 0) || (url_length >= sizeof(url)))
+    {
+        return;
+    }
+
+    const int requests_per_thread = 50;
+    const auto measure = [&url, requests_per_thread](bool reuse_connections, int thread_count)
+    {
+        CurlRequestOptions options = {};
+        options.reuse_connections = reuse_connections;
+
+        std::mutex latencies_mutex;
+        std::vector<double> latencies_ms;
+        std::vector<std::thread> threads;
+        for(int thread_index = 0; thread_index < thread_count; thread_index++)
+        {
+            threads.emplace_back(
+                [&]()
+                {
+                    for(int i = 0; i < requests_per_thread; i++)
+                    {
+                        const auto start = std::chrono::steady_clock::now();
+                        const CurlResponse response = g_curl_client.perform(url, fb2k::noAbort, options);
+                        const std::chrono::duration<double, std::milli> latency = std::chrono::steady_clock::now()
+                                                                                  - start;
+                        if(!response.result.is_success())
+                        {
+                            continue;
+                        }
+
+                        std::lock_guard lock(latencies_mutex);
+                        latencies_ms.push_back(latency.count());
+                    }
+                });
+        }
+        for(std::thread& thread : threads)
+        {
+            thread.join();
+        }
+
+        std::sort(latencies_ms.begin(), latencies_ms.end());
+        return latencies_ms;
+    };
+    const auto percentile = [](const std::vector<double>& sorted_values, double fraction)
+    { return sorted_values[size_t(fraction * double(sorted_values.size() - 1))]; };
+
+    for(int thread_count : { 1, 8 })
+    {
+        for(bool reuse_connections : { false, true })
+        {
+            const std::vector<double> latencies_ms = measure(reuse_connections, thread_count);
+            ASSERT(latencies_ms.size() == size_t(requests_per_thread * thread_count));
+            LOG_INFO("HTTP benchmark with %d concurrent requests and %s: p50=%.2fms, p99=%.2fms",
+                     thread_count,
+                     reuse_connections ? "connection reuse" : "a new connection for every request",
+                     percentile(latencies_ms, 0.5),
+                     percentile(latencies_ms, 0.99));
+        }
+    }
 }
+#endif
@@ -1,10 +1,9 @@
 #pragma once
-#include <string>
+#include "stdafx.h"
 
-namespace foobar2000_io
-{
-    class abort_callback;
-}
+#include <functional>
+#include <string>
+#include <vector>
 
 namespace http
 {
@@ -18,5 +17,40 @@ namespace http
         bool is_success() const;
     };
 
-    Result get_http2(const std::string& url, foobar2000_io::abort_callback& abort);
+    // Called with each chunk of a response body as it arrives (in addition to the chunk being added to the full
+    // response body as usual). Returning false stops downloading the rest of the body, for callers that have already
+    // found what they were looking for.
+    // NOTE: This is called on the thread that runs all requests, so it must be quick.
+    using BodyChunkCallback = std::function<bool(std::string_view chunk)>;
+
+    struct RequestOptions
+    {
+        std::vector<std::string> headers; // Extra request headers, e.g: "Referer: https://example.com"
+
+        // Must be cleared for requests whose URL contains anything that should not be written to disk (e.g a user's
+        // API token), or whose response depends on the request headers (since responses are cached by URL alone).
+        // Responses from sites that have set cookies (which are then sent with later requests) are never cached.
+        bool allow_caching = true;
+
+        BodyChunkCallback on_body_chunk;
+    };
+
+    // All requests are made by a single client with one connection pool, so requests to a host that was recently
+    // contacted reuse the existing connection (multiplexing concurrent requests over it with HTTP/2).
+    // Every request waits until the site being requested permits another request (sites that respond with HTTP 429
+    // or 503 are sent no further requests for a while). GET responses are cached (see http_cache.h).
+    // None of these throw. A request is cancelled immediately if the abort callback is triggered, in which case it
+    // returns a result that did not complete successfully.
+    Result get(const std::string& url, abort_callback& abort, const RequestOptions& options = {});
+
+    // Makes GET requests to all of the given URLs at the same time and returns their results in the same order
+    std::vector<Result> get_many(const std::vector<std::string>& urls,
+                                 abort_callback& abort,
+                                 const RequestOptions& options = {});
+
+    // Makes a POST request with the given body (which may be empty). Set the body's Content-Type in the headers.
+    Result post(const std::string& url,
+                std::string_view body,
+                abort_callback& abort,
+                const RequestOptions& options = {});
 }
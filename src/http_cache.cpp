@@ -0,0 +1,422 @@
+#include "stdafx.h"
+
+#include <charconv>
+
+#include "http_cache.h"
+#include "logging.h"
+#include "mvtf/mvtf.h"
+#include "persistent_lru_cache.h"
+#include "preferences.h"
+#include "string_split.h"
+#include "tag_util.h"
+
+// NOTE: This must be incremented whenever the layout of the cache file changes.
+//       Cache files with any other version are discarded when loading.
+static const uint32_t CACHE_FILE_VERSION = 1;
+
+// The maximum (approximate) number of bytes of responses that we'll keep in the cache
+static const size_t CACHE_MAX_TOTAL_BYTES = 32 * 1024 * 1024;
+
+// Responses larger than this are never cached, so that a single large page can't evict everything else
+static const size_t CACHE_MAX_ENTRY_BYTES = 2 * 1024 * 1024;
+
+// How long we consider responses to be fresh for sites that send no Cache-Control header at all.
+// These are all sites that serve lyrics pages, which very rarely change once they've been published.
+// NOTE: AZLyrics is deliberately absent because we stop downloading its pages as soon as we've found the lyrics,
+//       so we never have a whole page to cache.
+struct SiteCachePolicy
+{
+    std::string_view site; // As identified for rate-limiting (see http.cpp), so without any subdomains
+    t_filetimestamp fresh_lifetime;
+};
+static const SiteCachePolicy SITE_CACHE_POLICIES[] = {
+    { "bandcamp.com", system_time_periods::day },
+    { "darklyrics.com", system_time_periods::day },
+    { "letras.com", system_time_periods::day },
+    { "lyricfind.com", system_time_periods::day },
+    { "lyricsify.com", system_time_periods::day },
+    { "metal-archives.com", system_time_periods::day },
+    { "songlyrics.com", system_time_periods::day },
+};
+
+// Returns how long a response with the given headers remains fresh, or nothing if it should not be cached at all
+static std::optional<t_filetimestamp> get_fresh_lifetime(std::string_view site,
+                                                         const http_cache::ResponseHeaders& headers)
+{
+    if(headers.cache_control.empty())
+    {
+        for(const SiteCachePolicy& policy : SITE_CACHE_POLICIES)
+        {
+            if(policy.site == site)
+            {
+                return policy.fresh_lifetime;
+            }
+        }
+    }
+
+    std::string cache_control = headers.cache_control;
+    std::transform(cache_control.begin(),
+                   cache_control.end(),
+                   cache_control.begin(),
+                   [](char c) { return ((c >= 'A') && (c <= 'Z')) ? char(c - 'A' + 'a') : c; });
+
+    t_filetimestamp lifetime = 0;
+    bool must_revalidate = false;
+    string_split split(cache_control, ",");
+    while(!split.reached_the_end())
+    {
+        const std::string_view directive = trim_surrounding_whitespace(split.next());
+        if(directive == "no-store")
+        {
+            return {};
+        }
+        else if(directive == "no-cache")
+        {
+            must_revalidate = true;
+        }
+        else if(directive.starts_with("max-age="))
+        {
+            const std::string_view value = directive.substr(8);
+            uint32_t max_age_sec = 0;
+            const auto [ptr, err] = std::from_chars(value.data(), value.data() + value.size(), max_age_sec);
+            if((err == std::errc()) && (ptr != value.data()))
+            {
+                lifetime = t_filetimestamp(max_age_sec) * system_time_periods::second;
+            }
+        }
+    }
+
+    if(must_revalidate)
+    {
+        lifetime = 0;
+    }
+
+    // NOTE: A response that is never fresh is still worth keeping if we can revalidate it, because then we only
+    //       need to download it again if it has changed.
+    const bool can_revalidate = !headers.etag.empty() || !headers.last_modified.empty();
+    if((lifetime == 0) && !can_revalidate)
+    {
+        return {};
+    }
+    return lifetime;
+}
+
+struct CacheEntry
+{
+    std::string key; // The request URL
+    std::string etag;
+    std::string last_modified;
+    t_filetimestamp expiry_time;
+    std::string body;
+};
+
+static size_t compute_entry_size(const CacheEntry& entry)
+{
+    return sizeof(CacheEntry) + entry.key.size() + entry.etag.size() + entry.last_modified.size() + entry.body.size();
+}
+
+static bool can_revalidate(const CacheEntry& entry)
+{
+    return !entry.etag.empty() || !entry.last_modified.empty();
+}
+
+static void write_entry(stream_writer_formatter<false>& output, const CacheEntry& entry)
+{
+    persistent_lru_cache::write_string(output, entry.key);
+    persistent_lru_cache::write_string(output, entry.etag);
+    persistent_lru_cache::write_string(output, entry.last_modified);
+    output << entry.expiry_time;
+    persistent_lru_cache::write_string(output, entry.body);
+}
+
+static CacheEntry read_entry(stream_reader_formatter_simple_ref<false>& input)
+{
+    CacheEntry entry = {};
+    entry.key = persistent_lru_cache::read_string(input);
+    entry.etag = persistent_lru_cache::read_string(input);
+    entry.last_modified = persistent_lru_cache::read_string(input);
+    input >> entry.expiry_time;
+    entry.body = persistent_lru_cache::read_string(input);
+    return entry;
+}
+
+static bool is_worth_loading(const CacheEntry& entry, t_filetimestamp now)
+{
+    return (entry.expiry_time > now) || can_revalidate(entry);
+}
+
+static const PersistentLruCache<CacheEntry>::Config CACHE_CONFIG = {
+    "openlyrics-http-cache.bin",
+    "HTTP cache",
+    CACHE_FILE_VERSION,
+    CACHE_MAX_TOTAL_BYTES,
+    compute_entry_size,
+    write_entry,
+    read_entry,
+    is_worth_loading,
+};
+
+class ResponseCache : public PersistentLruCache<CacheEntry>
+{
+public:
+    ResponseCache()
+        : PersistentLruCache(CACHE_CONFIG)
+    {
+    }
+
+    std::optional<http_cache::CachedResponse> get(const std::string& url, t_filetimestamp now)
+    {
+        const CacheEntry* entry = find(url);
+        if(entry == nullptr)
+        {
+            return {};
+        }
+
+        const bool is_fresh = (now < entry->expiry_time);
+        if(!is_fresh && !can_revalidate(*entry))
+        {
+            remove(url);
+            return {};
+        }
+
+        mark_used(url);
+
+        http_cache::CachedResponse result = {};
+        result.body = entry->body;
+        result.etag = entry->etag;
+        result.last_modified = entry->last_modified;
+        result.is_fresh = is_fresh;
+        return result;
+    }
+
+    // Returns the updated entry, or null if there is no entry for the given URL
+    const CacheEntry* refresh(const std::string& url, t_filetimestamp expiry_time)
+    {
+        CacheEntry* entry = find(url);
+        if(entry == nullptr)
+        {
+            return nullptr;
+        }
+
+        entry->expiry_time = expiry_time;
+        mark_dirty();
+        return entry;
+    }
+};
+
+struct CacheStats
+{
+    uint64_t lookups;
+    uint64_t fresh_hits;  // Lookups that were answered from the cache without making any request
+    uint64_t revalidated; // Lookups that were answered from the cache after the server confirmed it was unchanged
+    uint64_t stored;      // Responses that were added to the cache
+};
+
+static std::mutex g_cache_mutex;
+static ResponseCache g_cache;
+static CacheStats g_stats = {};
+
+static void save_cache_on_quit()
+{
+    std::lock_guard lock(g_cache_mutex);
+    if(g_stats.lookups > 0)
+    {
+        const uint64_t hits = g_stats.fresh_hits + g_stats.revalidated;
+        LOG_INFO("HTTP cache: %d hits (%d revalidated) and %d misses from %d lookups, %d responses stored, %d evicted",
+                 int(hits),
+                 int(g_stats.revalidated),
+                 int(g_stats.lookups - hits),
+                 int(g_stats.lookups),
+                 int(g_stats.stored),
+                 int(g_cache.eviction_count()));
+    }
+    g_cache.save();
+}
+FB2K_RUN_ON_QUIT(save_cache_on_quit);
+
+std::optional<http_cache::CachedResponse> http_cache::get(const std::string& url)
+{
+    if(!preferences::searching::cache_remote_results())
+    {
+        return {};
+    }
+
+    std::lock_guard lock(g_cache_mutex);
+    g_cache.load_if_required();
+    g_stats.lookups++;
+    std::optional<CachedResponse> result = g_cache.get(url, filetimestamp_from_system_timer());
+    if(result.has_value() && result->is_fresh)
+    {
+        g_stats.fresh_hits++;
+    }
+    return result;
+}
+
+void http_cache::put(const std::string& url, std::string_view site, const ResponseHeaders& headers, std::string body)
+{
+    if(!preferences::searching::cache_remote_results())
+    {
+        return;
+    }
+
+    const std::optional<t_filetimestamp> lifetime = get_fresh_lifetime(site, headers);
+    if(!lifetime.has_value() || (body.size() > CACHE_MAX_ENTRY_BYTES))
+    {
+        return;
+    }
+
+    CacheEntry entry = {};
+    entry.key = url;
+    entry.etag = headers.etag;
+    entry.last_modified = headers.last_modified;
+    entry.expiry_time = filetimestamp_from_system_timer() + lifetime.value();
+    entry.body = std::move(body);
+
+    std::lock_guard lock(g_cache_mutex);
+    g_cache.load_if_required();
+    g_cache.put(std::move(entry));
+    g_stats.stored++;
+}
+
+std::optional<std::string> http_cache::revalidated(const std::string& url,
+                                                   std::string_view site,
+                                                   const ResponseHeaders& headers)
+{
+    // NOTE: A 304 response need not repeat all of the caching headers from the original response, in which case
+    //       we assume that they haven't changed.
+    const std::optional<t_filetimestamp> lifetime = get_fresh_lifetime(site, headers);
+    const t_filetimestamp expiry_time = filetimestamp_from_system_timer() + lifetime.value_or(0);
+
+    std::lock_guard lock(g_cache_mutex);
+    g_cache.load_if_required();
+    const CacheEntry* entry = g_cache.refresh(url, expiry_time);
+    if(entry == nullptr)
+    {
+        return {};
+    }
+
+    g_stats.revalidated++;
+    return entry->body;
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+#if MVTF_TESTS_ENABLED
+static CacheEntry make_test_entry(std::string url, t_filetimestamp expiry_time, std::string etag, size_t body_size)
+{
+    CacheEntry entry = {};
+    entry.key = std::move(url);
+    entry.etag = std::move(etag);
+    entry.expiry_time = expiry_time;
+    entry.body = std::string(body_size, 'x');
+    return entry;
+}
+
+MVTF_TEST(httpcache_fresh_lifetime_honours_cache_control)
+{
+    const t_filetimestamp second = system_time_periods::second;
+    CHECK(get_fresh_lifetime("lrclib.net", { "max-age=60", "", "" }) == 60 * second);
+    CHECK(get_fresh_lifetime("lrclib.net", { "public, Max-Age=60", "", "" }) == 60 * second);
+    CHECK(!get_fresh_lifetime("lrclib.net", { "max-age=60, no-store", "\"abc\"", "" }).has_value());
+    CHECK(!get_fresh_lifetime("lrclib.net", { "no-cache", "", "" }).has_value());
+    CHECK(get_fresh_lifetime("lrclib.net", { "no-cache, max-age=60", "\"abc\"", "" }) == t_filetimestamp(0));
+    CHECK(get_fresh_lifetime("lrclib.net", { "", "", "Wed, 21 Oct 2015 07:28:00 GMT" }) == t_filetimestamp(0));
+    CHECK(!get_fresh_lifetime("lrclib.net", { "", "", "" }).has_value());
+}
+
+MVTF_TEST(httpcache_site_policy_only_applies_when_there_is_no_cache_control)
+{
+    CHECK(get_fresh_lifetime("darklyrics.com", { "", "", "" }) == system_time_periods::day);
+    CHECK(!get_fresh_lifetime("darklyrics.com", { "no-store", "", "" }).has_value());
+    CHECK(get_fresh_lifetime("darklyrics.com", { "max-age=5", "", "" }) == 5 * system_time_periods::second);
+}
+
+MVTF_TEST(httpcache_stale_entries_are_returned_for_revalidation_only_if_they_have_a_validator)
+{
+    ResponseCache cache;
+    cache.put(make_test_entry("with_etag", 100, "\"abc\"", 10));
+    cache.put(make_test_entry("without_etag", 100, "", 10));
+
+    const std::optional<http_cache::CachedResponse> fresh = cache.get("with_etag", 50);
+    ASSERT(fresh.has_value());
+    CHECK(fresh->is_fresh);
+
+    const std::optional<http_cache::CachedResponse> stale = cache.get("with_etag", 150);
+    ASSERT(stale.has_value());
+    CHECK(!stale->is_fresh);
+    CHECK(stale->etag == "\"abc\"");
+
+    CHECK(!cache.get("without_etag", 150).has_value());
+    CHECK(cache.size() == 1);
+
+    ASSERT(cache.refresh("with_etag", 200) != nullptr);
+    CHECK(cache.get("with_etag", 150)->is_fresh);
+}
+
+MVTF_TEST(httpcache_evicts_least_recently_used_entries_once_full)
+{
+    const size_t body_size = CACHE_MAX_TOTAL_BYTES / 3;
+    ResponseCache cache;
+    cache.put(make_test_entry("a", 100, "", body_size));
+    cache.put(make_test_entry("b", 100, "", body_size));
+    CHECK(cache.get("a", 0).has_value()); // Make a more-recently-used than b
+    cache.put(make_test_entry("c", 100, "", body_size));
+
+    CHECK(cache.size() == 2);
+    CHECK(cache.eviction_count() == 1);
+    CHECK(cache.get("a", 0).has_value());
+    CHECK(!cache.get("b", 0).has_value());
+    CHECK(cache.get("c", 0).has_value());
+    CHECK(cache.total_bytes() <= CACHE_MAX_TOTAL_BYTES);
+}
+
+MVTF_TEST(httpcache_roundtrips_through_serialisation)
+{
+    ResponseCache cache;
+    cache.put(make_test_entry("old", 100, "", 10));
+    cache.put(make_test_entry("stale", 100, "\"abc\"", 20));
+    cache.put(make_test_entry("new", 300, "", 30));
+
+    stream_writer_formatter_simple<false> writer;
+    cache.write(writer);
+    CHECK(!cache.is_dirty());
+
+    ResponseCache loaded;
+    stream_reader_formatter_simple<false> reader(writer.m_buffer.get_ptr(), writer.m_buffer.get_size());
+    loaded.read(reader, 200);
+
+    CHECK(loaded.size() == 2);
+    CHECK(!loaded.get("old", 200).has_value());
+    const std::optional<http_cache::CachedResponse> stale = loaded.get("stale", 200);
+    ASSERT(stale.has_value());
+    CHECK(!stale->is_fresh);
+    CHECK(stale->body.size() == 20);
+    const std::optional<http_cache::CachedResponse> fresh = loaded.get("new", 200);
+    ASSERT(fresh.has_value());
+    CHECK(fresh->is_fresh);
+    CHECK(fresh->body == std::string(30, 'x'));
+}
+
+MVTF_TEST(httpcache_rejects_a_truncated_file_without_allocating_the_sizes_it_contains)
+{
+    ResponseCache cache;
+    cache.put(make_test_entry("url", 100, "", 1000));
+
+    stream_writer_formatter_simple<false> writer;
+    cache.write(writer);
+
+    bool threw = false;
+    try
+    {
+        ResponseCache loaded;
+        stream_reader_formatter_simple<false> reader(writer.m_buffer.get_ptr(), writer.m_buffer.get_size() - 500);
+        loaded.read(reader, 0);
+    }
+    catch(const exception_io_data&)
+    {
+        threw = true;
+    }
+    CHECK(threw);
+}
+#endif
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "stdafx.h"
+
+// A cache of the responses to HTTP GET requests, so that repeating a request (e.g for a manual search, or to check
+// for an existing copy before uploading lyrics) does not download the same response again. A response is reused
+// without making any request at all for as long as the server said it would remain fresh (or for as long as our own
+// policy allows, for sites that send no caching headers). After that it is revalidated with a conditional request,
+// which only downloads the response again if it has changed. Responses are held in memory (evicting the
+// least-recently-used entries first) and written to a file in the profile directory on exit.
+namespace http_cache
+{
+    // The caching-related headers of a response
+    struct ResponseHeaders
+    {
+        std::string cache_control;
+        std::string etag;
+        std::string last_modified;
+    };
+
+    struct CachedResponse
+    {
+        std::string body;
+        std::string etag;
+        std::string last_modified;
+        bool is_fresh; // If false, the response must be revalidated with the server before it can be used
+    };
+
+    std::optional<CachedResponse> get(const std::string& url);
+
+    // Stores a successful response, if its headers (or our policy for the given site) allow it to be cached
+    void put(const std::string& url, std::string_view site, const ResponseHeaders& headers, std::string body);
+
+    // Marks the cached response for the given URL as fresh again, after the server confirmed (with a 304 response)
+    // that it has not changed. Returns the cached response body.
+    std::optional<std::string> revalidated(const std::string& url,
+                                           std::string_view site,
+                                           const ResponseHeaders& headers);
+}
@@ -0,0 +1,188 @@
+#include "stdafx.h"
+
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+
+#include "hash_utils.h"
+#include "http_fixtures.h"
+#include "logging.h"
+#include "mvtf/mvtf.h"
+
+struct FixtureConfig
+{
+    http_fixtures::Mode mode;
+    std::filesystem::path directory;
+};
+
+static std::optional<std::filesystem::path> get_directory_from_environment(const wchar_t* variable_name)
+{
+    wchar_t path[MAX_PATH] = {};
+    const DWORD path_length = GetEnvironmentVariableW(variable_name, path, MAX_PATH);
+    if((path_length == 0) || (path_length >= MAX_PATH))
+    {
+        return {};
+    }
+    return std::filesystem::path(path);
+}
+
+static FixtureConfig read_config_from_environment()
+{
+    // NOTE: Replay takes priority so that we never send requests to the real sites when asked to replay
+    const std::optional<std::filesystem::path> replay_dir = get_directory_from_environment(
+        L"OPENLYRICS_HTTP_REPLAY_DIR");
+    if(replay_dir.has_value())
+    {
+        LOG_INFO("Replaying recorded HTTP responses from %s", replay_dir->string().c_str());
+        return { http_fixtures::Mode::Replay, replay_dir.value() };
+    }
+
+    const std::optional<std::filesystem::path> record_dir = get_directory_from_environment(
+        L"OPENLYRICS_HTTP_RECORD_DIR");
+    if(record_dir.has_value())
+    {
+        LOG_INFO("Recording HTTP responses to %s", record_dir->string().c_str());
+        return { http_fixtures::Mode::Record, record_dir.value() };
+    }
+
+    return { http_fixtures::Mode::Disabled, {} };
+}
+
+static const FixtureConfig& get_config()
+{
+    static const FixtureConfig config = read_config_from_environment();
+    return config;
+}
+
+static std::string get_fixture_file_name(std::string_view method, const std::string& url, std::string_view body)
+{
+    Sha256Context ctx;
+    ctx.add_data((const uint8_t*)method.data(), method.length());
+    ctx.add_data((const uint8_t*)" ", 1);
+    ctx.add_data((const uint8_t*)url.data(), url.length());
+    ctx.add_data((const uint8_t*)"\n", 1);
+    ctx.add_data((const uint8_t*)body.data(), body.length());
+
+    uint8_t hash[32] = {};
+    ctx.finalise(hash);
+
+    // NOTE: Half of the hash is plenty to tell apart the few hundred requests in a typical set of fixtures
+    return std::string(pfc::format_hexdump(hash, sizeof(hash) / 2, "").get_ptr()) + ".txt";
+}
+
+// Each fixture file starts with the request method & URL (purely so that people can tell which is which),
+// followed by the response status on the next line and then the response body.
+static bool write_fixture(const std::filesystem::path& path,
+                          std::string_view method,
+                          const std::string& url,
+                          const http::Result& result)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << method << ' ' << url << '\n' << result.response_status << '\n';
+    file.write(result.response_content.data(), std::streamsize(result.response_content.size()));
+    return bool(file);
+}
+
+static std::optional<http::Result> read_fixture(const std::filesystem::path& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::string request_line;
+    std::string status_line;
+    if(!std::getline(file, request_line) || !std::getline(file, status_line))
+    {
+        return {};
+    }
+
+    http::Result result = { true, std::strtol(status_line.c_str(), nullptr, 10), {}, {} };
+    result.response_content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    if(!result.is_success())
+    {
+        result.error_message = "HTTP error " + std::to_string(result.response_status);
+    }
+    return result;
+}
+
+http_fixtures::Mode http_fixtures::get_mode()
+{
+    return get_config().mode;
+}
+
+// NOTE: Recorded responses are kept in memory once they have been read so that replaying a response many times
+//       (e.g when benchmarking) measures the work done by the caller, rather than the time taken to read files.
+static std::mutex g_replay_mutex;
+static std::unordered_map<std::string, std::optional<http::Result>> g_replayed_responses;
+
+http::Result http_fixtures::replay(std::string_view method, const std::string& url, std::string_view body)
+{
+    const FixtureConfig& config = get_config();
+    assert(config.mode == Mode::Replay);
+
+    const std::string file_name = get_fixture_file_name(method, url, body);
+    std::lock_guard lock(g_replay_mutex);
+    auto iter = g_replayed_responses.find(file_name);
+    if(iter == g_replayed_responses.end())
+    {
+        iter = g_replayed_responses.emplace(file_name, read_fixture(config.directory / file_name)).first;
+    }
+
+    if(!iter->second.has_value())
+    {
+        LOG_WARN("No response was recorded for %s request to %s", std::string(method).c_str(), url.c_str());
+        return { false, 0, {}, "No recorded response" };
+    }
+    return iter->second.value();
+}
+
+static std::mutex g_record_mutex;
+
+void http_fixtures::record(std::string_view method,
+                           const std::string& url,
+                           std::string_view body,
+                           const http::Result& result)
+{
+    const FixtureConfig& config = get_config();
+    assert(config.mode == Mode::Record);
+
+    const std::filesystem::path path = config.directory / get_fixture_file_name(method, url, body);
+    std::lock_guard lock(g_record_mutex);
+    if(!write_fixture(path, method, url, result))
+    {
+        LOG_WARN("Failed to record response from %s to %s", url.c_str(), path.string().c_str());
+    }
+}
+
+// ============
+// Tests
+// ============
+#if MVTF_TESTS_ENABLED
+MVTF_TEST(http_fixtures_name_requests_by_method_url_and_body)
+{
+    const std::string url = "https://lrclib.net/api/publish";
+    const std::string name = get_fixture_file_name("POST", url, "{}");
+    ASSERT(name == get_fixture_file_name("POST", url, "{}"));
+    ASSERT(name != get_fixture_file_name("GET", url, "{}"));
+    ASSERT(name != get_fixture_file_name("POST", url, "{ }"));
+    ASSERT(name != get_fixture_file_name("POST", "https://lrclib.net/api/get", "{}"));
+}
+
+MVTF_TEST(http_fixtures_replay_the_response_that_was_recorded)
+{
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "openlyrics_test_fixture.txt";
+    const http::Result recorded = { true, 404, "line1\nline2\r\n\n", {} };
+    ASSERT(write_fixture(path, "GET", "https://example.com/lyrics", recorded));
+
+    const std::optional<http::Result> replayed = read_fixture(path);
+    std::filesystem::remove(path);
+    ASSERT(replayed.has_value());
+    ASSERT(replayed->completed_successfully);
+    ASSERT(replayed->response_status == 404);
+    ASSERT(replayed->response_content == recorded.response_content);
+    ASSERT(!replayed->error_message.empty());
+}
+
+MVTF_TEST(http_fixtures_have_no_response_for_requests_that_were_never_recorded)
+{
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "openlyrics_missing_fixture.txt";
+    ASSERT(!read_fixture(path).has_value());
+}
+#endif
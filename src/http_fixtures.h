@@ -0,0 +1,29 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "http.h"
+
+// Records the responses to all of the requests that we make to files in a directory, or answers requests with
+// previously-recorded responses from such a directory instead of sending them at all. This lets us benchmark and
+// regression-test the handling of responses from each source without depending on (or bothering) the real sites.
+// Recording is enabled by setting the OPENLYRICS_HTTP_RECORD_DIR environment variable and replaying by setting
+// OPENLYRICS_HTTP_REPLAY_DIR, in each case to the path of an existing directory.
+// NOTE: Recorded requests and responses are written out exactly as they were sent, including any tokens they contain.
+namespace http_fixtures
+{
+    enum class Mode
+    {
+        Disabled,
+        Record,
+        Replay
+    };
+    Mode get_mode();
+
+    // Returns the recorded response to the given request. Requests for which no response was recorded fail, rather
+    // than being sent to the real site. Must only be called in replay mode.
+    http::Result replay(std::string_view method, const std::string& url, std::string_view body);
+
+    // Writes the response to the given request to the fixture directory. Must only be called in record mode.
+    void record(std::string_view method, const std::string& url, std::string_view body, const http::Result& result);
+}
@@ -7,6 +7,11 @@ LyricDataRaw::LyricDataRaw(LyricDataCommon common)
 {
 }
 
+bool LyricDataRaw::IsEmpty() const
+{
+    return text_bytes.empty() && (parsed == nullptr);
+}
+
 LyricData::LyricData(LyricDataCommon common)
     : LyricDataCommon(common)
 {
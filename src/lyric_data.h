@@ -1,11 +1,14 @@
 #pragma once
 
 #include <guiddef.h>
+#include <memory>
 #include <string>
 
 #include "preferences.h"
 #include "win32_util.h"
 
+struct LyricData;
+
 struct LyricDataCommon
 {
     GUID source_id; // The source from which the lyrics were retrieved
@@ -24,9 +27,13 @@ struct LyricDataRaw : public LyricDataCommon
                            // during searching.
     LyricType type; // The type of lyrics known to be contained in this text
     std::vector<uint8_t> text_bytes; // The raw bytes for the lyrics text, in an unspecified encoding
+    std::shared_ptr<const LyricData> parsed; // The lyrics already parsed by the source (if any), in which case
+                                             // `text_bytes` might be empty. Used only temporarily during searching.
 
     LyricDataRaw() = default;
     explicit LyricDataRaw(LyricDataCommon common);
+
+    bool IsEmpty() const;
 };
 
 // Parsed lyric data
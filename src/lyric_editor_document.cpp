@@ -0,0 +1,344 @@
+#include "stdafx.h"
+
+#include "lyric_editor_document.h"
+#include "mvtf/mvtf.h"
+#include "test_util.h"
+#include "win32_util.h"
+
+// Returns the number of characters in the line that starts at the given index, including its line ending.
+// Lines are split in the same places as they are by `parsers::lrc::parse`.
+static size_t get_line_length(std::tstring_view text, size_t start)
+{
+    size_t end = start;
+    while((end < text.length()) && (text[end] != _T('\0')) && (text[end] != _T('\n')) && (text[end] != _T('\r')))
+    {
+        end++;
+    }
+
+    if((end + 1 < text.length()) && (text[end] == _T('\r')) && (text[end + 1] == _T('\n')))
+    {
+        return end + 2 - start;
+    }
+    return std::min(end + 1, text.length()) - start;
+}
+
+static std::tstring_view trim_line_ending(std::tstring_view line)
+{
+    while(!line.empty() && ((line.back() == _T('\0')) || (line.back() == _T('\n')) || (line.back() == _T('\r'))))
+    {
+        line.remove_suffix(1);
+    }
+    return line;
+}
+
+static uint64_t hash_text(std::tstring_view text)
+{
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ull;
+    for(TCHAR c : text)
+    {
+        hash ^= uint64_t(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Combines the hashes of two consecutive lines, such that the result depends on the order of the lines
+static uint64_t hash_pair(uint64_t previous_hash, uint64_t hash)
+{
+    uint64_t result = (previous_hash * 0x9E3779B97F4A7C15ull) + hash;
+    result = (result ^ (result >> 30)) * 0xBF58476D1CE4E5B9ull;
+    result = (result ^ (result >> 27)) * 0x94D049BB133111EBull;
+    return result ^ (result >> 31);
+}
+
+LyricEditorDocument::LyricEditorDocument(std::tstring_view text)
+    : m_hash(0)
+    , m_saved_hash(0)
+{
+    update(text);
+    mark_saved();
+}
+
+size_t LyricEditorDocument::update(std::tstring_view new_text)
+{
+    // NOTE: The edit control does not tell us which part of its text changed, so we find the part that differs by
+    //       comparing against the previous text from both ends. This is just a comparison of the text in place,
+    //       everything else (splitting, hashing and parsing) is only done for the lines in the part that changed.
+    const size_t old_length = m_text.length();
+    const size_t new_length = new_text.length();
+    const size_t max_common_length = std::min(old_length, new_length);
+    const size_t common_prefix = size_t(
+        std::mismatch(m_text.begin(), m_text.begin() + max_common_length, new_text.begin()).first - m_text.begin());
+    if((common_prefix == old_length) && (old_length == new_length))
+    {
+        return 0;
+    }
+    const size_t common_suffix = size_t(std::mismatch(m_text.rbegin(),
+                                                      m_text.rbegin() + (max_common_length - common_prefix),
+                                                      new_text.rbegin())
+                                            .first
+                                        - m_text.rbegin());
+
+    // NOTE: We start from the line containing the character just before the change, because a change at the very
+    //       start of a line can change where the previous line ends (e.g by inserting a '\n' just after a '\r').
+    //       We stop after the line containing the first character after the change. The line endings of that line
+    //       and of the lines after it are unchanged, so the rest of the lines still start in the same places.
+    const size_t first_line = (common_prefix == 0) ? 0 : find_line(common_prefix - 1);
+    const size_t end_line = std::min(find_line(old_length - common_suffix) + 1, m_lines.size());
+    const size_t region_start = (first_line < end_line) ? m_lines[first_line].start : 0;
+    const size_t old_region_end = (first_line < end_line) ? (m_lines[end_line - 1].start + m_lines[end_line - 1].length)
+                                                          : 0;
+    const size_t new_region_end = (old_region_end + new_length) - old_length;
+
+    std::vector<Line> new_lines;
+    std::vector<parsers::lrc::ParsedLine> new_parsed_lines;
+    size_t line_start = region_start;
+    while(line_start < new_region_end)
+    {
+        const size_t line_length = get_line_length(new_text, line_start);
+        const std::tstring_view line = new_text.substr(line_start, line_length);
+        new_lines.push_back({ line_start, line_length, hash_text(line) });
+        new_parsed_lines.push_back(parsers::lrc::parse_line(from_tstring(trim_line_ending(line))));
+        line_start += line_length;
+    }
+    assert(line_start == new_region_end);
+
+    m_hash -= hash_line_pairs(first_line, std::min(end_line + 1, m_lines.size()));
+    m_lines.erase(m_lines.begin() + first_line, m_lines.begin() + end_line);
+    m_lines.insert(m_lines.begin() + first_line, new_lines.begin(), new_lines.end());
+    m_parsed_lines.erase(m_parsed_lines.begin() + first_line, m_parsed_lines.begin() + end_line);
+    m_parsed_lines.insert(m_parsed_lines.begin() + first_line,
+                          std::make_move_iterator(new_parsed_lines.begin()),
+                          std::make_move_iterator(new_parsed_lines.end()));
+    for(size_t i = first_line + new_lines.size(); i < m_lines.size(); i++)
+    {
+        m_lines[i].start = (m_lines[i].start + new_length) - old_length;
+    }
+    m_hash += hash_line_pairs(first_line, std::min(first_line + new_lines.size() + 1, m_lines.size()));
+
+    const size_t changed_start = common_prefix;
+    const size_t old_changed_length = old_length - common_suffix - common_prefix;
+    const size_t new_changed_length = new_length - common_suffix - common_prefix;
+    m_text.replace(changed_start, old_changed_length, new_text.substr(changed_start, new_changed_length));
+    assert(m_text.length() == new_length);
+    return new_lines.size();
+}
+
+const std::tstring& LyricEditorDocument::get_text() const
+{
+    return m_text;
+}
+
+const std::tstring& LyricEditorDocument::get_saved_text() const
+{
+    return m_saved_text;
+}
+
+bool LyricEditorDocument::has_changed_since_saved() const
+{
+    if((m_hash != m_saved_hash) || (m_text.length() != m_saved_text.length()))
+    {
+        return true;
+    }
+
+    // NOTE: Matching hashes almost always mean that the text really is the same (e.g because an edit was undone),
+    //       but we check to be sure so that a hash collision can never cause us to discard somebody's edits.
+    return m_text != m_saved_text;
+}
+
+void LyricEditorDocument::mark_saved()
+{
+    m_saved_text = m_text;
+    m_saved_hash = m_hash;
+}
+
+double LyricEditorDocument::get_timestamp_offset() const
+{
+    return parsers::lrc::get_timestamp_offset(m_parsed_lines);
+}
+
+LyricData LyricEditorDocument::get_lyrics(const LyricDataCommon& metadata) const
+{
+    return parsers::lrc::combine_lines(metadata, m_parsed_lines);
+}
+
+// Returns the index of the line that contains the character at the given index,
+// or the number of lines if the index is past the end of the text.
+size_t LyricEditorDocument::find_line(size_t char_index) const
+{
+    if(char_index >= m_text.length())
+    {
+        return m_lines.size();
+    }
+
+    const auto line_after = std::upper_bound(m_lines.begin(),
+                                             m_lines.end(),
+                                             char_index,
+                                             [](size_t index, const Line& line) { return index < line.start; });
+    assert(line_after != m_lines.begin());
+    return size_t(line_after - m_lines.begin()) - 1;
+}
+
+// Returns the sum of the hashes of each of the given lines paired with the line before it.
+// The hash of the whole document is the sum of these pairs for every line, so when a line changes only the pairs that
+// include it need to be removed from (and then added back into) the document hash.
+uint64_t LyricEditorDocument::hash_line_pairs(size_t begin_line, size_t end_line) const
+{
+    uint64_t result = 0;
+    for(size_t i = begin_line; i < end_line; i++)
+    {
+        const uint64_t previous_hash = (i == 0) ? 0 : m_lines[i - 1].hash;
+        result += hash_pair(previous_hash, m_lines[i].hash);
+    }
+    return result;
+}
+
+// ============
+// Tests
+// ============
+#if MVTF_TESTS_ENABLED
+static std::tstring make_long_lyrics_text(int line_count)
+{
+    std::tstring result = _T("[ar:Artist]\r\n[ti:Title]\r\n[offset:-150]\r\n\r\n");
+    for(int i = 0; i < line_count; i++)
+    {
+        result += to_tstring(parsers::lrc::print_timestamp(double(i) * 2.5));
+        result += _T("This is line number ") + to_tstring(std::to_string(i)) + _T(" of some lyrics\r\n");
+    }
+    return result;
+}
+
+MVTF_TEST(editordoc_gives_the_same_lyrics_as_parsing_all_of_the_text_after_each_edit)
+{
+    const std::tstring_view snippets[] = {
+        _T("\r"),
+        _T("\n"),
+        _T("\r\n"),
+        _T("\r\n\r\n[00:03.00]"),
+        _T("[00:01.50]"),
+        _T("[ar:x]"),
+        _T("[offset:250]"),
+        _T("chorus"),
+        _T(" "),
+        _T("\uFEFF"),
+    };
+    const size_t snippet_count = sizeof(snippets) / sizeof(snippets[0]);
+
+    std::tstring text = make_long_lyrics_text(20);
+    LyricEditorDocument document(text);
+    uint32_t random_state = 12345;
+    const auto next_random = [&random_state](size_t limit)
+    {
+        random_state = random_state * 1664525 + 1013904223;
+        return size_t(random_state >> 8) % (limit + 1);
+    };
+
+    for(int i = 0; i < 500; i++)
+    {
+        const size_t position = next_random(text.length());
+        const size_t erase_length = std::min(next_random(4), text.length() - position);
+        text.erase(position, erase_length);
+        if(next_random(2) != 0)
+        {
+            text.insert(position, snippets[next_random(snippet_count - 1)]);
+        }
+
+        document.update(text);
+        ASSERT(document.get_text() == text);
+
+        const LyricData expected = parsers::lrc::parse({}, from_tstring(text));
+        CHECK(lyrics_are_identical(document.get_lyrics({}), expected));
+        CHECK(document.get_timestamp_offset() == expected.timestamp_offset);
+    }
+}
+
+MVTF_TEST(editordoc_only_parses_the_lines_that_changed)
+{
+    std::tstring text = make_long_lyrics_text(2000);
+    LyricEditorDocument document(text);
+    const size_t middle = text.length() / 2;
+
+    text.insert(middle, _T("x"));
+    CHECK(document.update(text) <= 2);
+
+    text.insert(middle, _T("\r\n"));
+    CHECK(document.update(text) <= 3);
+
+    text.erase(middle, 3);
+    CHECK(document.update(text) <= 2);
+
+    CHECK(document.update(text) == 0);
+}
+
+MVTF_TEST(editordoc_has_not_changed_after_an_edit_is_undone)
+{
+    const std::tstring original = make_long_lyrics_text(100);
+    LyricEditorDocument document(original);
+    CHECK(!document.has_changed_since_saved());
+
+    std::tstring edited = original;
+    edited.insert(edited.length() / 2, _T("[00:12.34]"));
+    document.update(edited);
+    CHECK(document.has_changed_since_saved());
+
+    document.update(original);
+    CHECK(!document.has_changed_since_saved());
+
+    document.update(edited);
+    document.mark_saved();
+    CHECK(!document.has_changed_since_saved());
+    CHECK(document.get_saved_text() == edited);
+}
+
+MVTF_TEST(editordoc_has_changed_when_lines_are_reordered)
+{
+    LyricEditorDocument document(_T("[00:01.00]a\r\n[00:02.00]b\r\n"));
+    document.update(_T("[00:02.00]b\r\n[00:01.00]a\r\n"));
+    CHECK(document.has_changed_since_saved());
+}
+
+// Compares the time taken to keep the editor's lyrics up to date as somebody types into a long set of lyrics, against
+// the time taken to parse all of the text after every change. This only runs if OPENLYRICS_LRC_BENCHMARK is set.
+MVTF_TEST(editordoc_benchmark_editing_long_lyrics)
+{
+    if(GetEnvironmentVariableA("OPENLYRICS_LRC_BENCHMARK", nullptr, 0) == 0)
+    {
+        return;
+    }
+
+    const int edit_count = 200;
+    const std::tstring original = make_long_lyrics_text(2000);
+    const auto measure_ms = [edit_count, &original](auto on_edit)
+    {
+        std::tstring text = original;
+        return measure_average_ms(edit_count,
+                                  [&text, &on_edit]()
+                                  {
+                                      text.insert(text.length() / 2, _T("x"));
+                                      on_edit(text);
+                                  });
+    };
+
+    const double full_parse_ms = measure_ms(
+        [&original](const std::tstring& text)
+        {
+            const bool changed = (text != original);
+            const LyricData parsed = parsers::lrc::parse({}, from_tstring(text));
+            return changed && (parsed.timestamp_offset != 0.0);
+        });
+
+    LyricEditorDocument document(original);
+    const double incremental_ms = measure_ms(
+        [&document](const std::tstring& text)
+        {
+            document.update(text);
+            return document.has_changed_since_saved() && (document.get_timestamp_offset() != 0.0);
+        });
+
+    printf("Editing %zu characters of lyrics: %.3fms per edit parsing everything, %.3fms per edit incrementally\n",
+           original.length(),
+           full_parse_ms,
+           incremental_ms);
+}
+#endif
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "lyric_data.h"
+#include "parsers.h"
+
+// The text in the lyric editor, split into lines that are each parsed (as LRC) on their own. Each change to the text
+// only splits, hashes & parses the lines that it touched, so the cost of an edit does not grow with the length of the
+// lyrics. The document also keeps a hash of all of its lines, which is updated one line at a time, so that we can
+// tell whether the text has changed since it was last saved without comparing it to the saved text.
+class LyricEditorDocument
+{
+public:
+    explicit LyricEditorDocument(std::tstring_view text);
+
+    // Updates the document to contain the given text. Only the lines in the part of the text that differs from the
+    // previous text are parsed again. Returns the number of lines that were parsed.
+    size_t update(std::tstring_view new_text);
+
+    const std::tstring& get_text() const;
+    const std::tstring& get_saved_text() const;
+    bool has_changed_since_saved() const;
+    void mark_saved();
+
+    double get_timestamp_offset() const;
+    LyricData get_lyrics(const LyricDataCommon& metadata) const;
+
+private:
+    struct Line
+    {
+        size_t start;  // The index of the first character of the line in the document text
+        size_t length; // The number of characters in the line, including its line ending
+        uint64_t hash;
+    };
+
+    size_t find_line(size_t char_index) const;
+    uint64_t hash_line_pairs(size_t begin_line, size_t end_line) const;
+
+    std::tstring m_text;
+    std::vector<Line> m_lines;
+    std::vector<parsers::lrc::ParsedLine> m_parsed_lines;
+    uint64_t m_hash;
+
+    std::tstring m_saved_text;
+    uint64_t m_saved_hash;
+};
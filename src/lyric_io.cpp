@@ -1,5 +1,9 @@
 #include "stdafx.h"
 
+#include <functional>
+#include <unordered_map>
+
+#include "charset_detection.h"
 #include "logging.h"
 #include "lyric_auto_edit.h"
 #include "lyric_data.h"
@@ -8,6 +12,8 @@
 #include "metrics.h"
 #include "mvtf/mvtf.h"
 #include "parsers.h"
+#include "search_result_cache.h"
+#include "source_health.h"
 #include "sources/lyric_source.h"
 #include "tag_util.h"
 #include "ui_hooks.h"
@@ -122,98 +128,86 @@ static void ensure_windows_newlines(std::string& str)
     }
 }
 
-static std::string decode_to_utf8(const std::vector<uint8_t> text_bytes)
+// Converts UTF-16 text to UTF-8, replacing any invalid characters (e.g unpaired surrogates) rather than failing
+static std::string utf16_to_utf8(std::wstring_view wide)
 {
-    const auto GetLastErrorString = []() -> const char*
+    if(wide.empty())
     {
-        DWORD error = GetLastError();
-        static char errorMsgBuffer[4096];
-        FormatMessageA(FORMAT_MESSAGE_FROM_SYSTEM, nullptr, error, 0, errorMsgBuffer, sizeof(errorMsgBuffer), nullptr);
-        return errorMsgBuffer;
-    };
+        return std::string();
+    }
 
+    std::vector<char> narrow_tmp;
+    size_t narrow_bytes = wide_to_narrow_string(CP_UTF8, wide, narrow_tmp);
+    if(narrow_bytes <= 0)
+    {
+        LOG_WARN("Failed to convert UTF-16 to UTF-8, replacing invalid characters instead: %d", GetLastError());
+        narrow_bytes = wide_to_narrow_string(CP_UTF8, wide, narrow_tmp, true);
+    }
+    return (narrow_bytes > 0) ? std::string(narrow_tmp.data(), narrow_bytes) : std::string();
+}
+
+static std::string decode_to_utf8(const std::vector<uint8_t> text_bytes)
+{
     assert(text_bytes.size() < INT_MAX);
-    int utf8success = MultiByteToWideChar(CP_UTF8,
-                                          MB_ERR_INVALID_CHARS,
-                                          (const char*)text_bytes.data(),
-                                          (int)text_bytes.size(),
-                                          nullptr,
-                                          0);
-    if(utf8success > 0)
+    const charset::Detection detected = charset::detect(text_bytes.data(), text_bytes.size());
+    const uint8_t* text = text_bytes.data() + detected.byte_order_mark_length;
+    const size_t text_length = text_bytes.size() - detected.byte_order_mark_length;
+
+    if(detected.codepage == charset::CODEPAGE_UTF8)
     {
         // The input bytes are already valid UTF8, so we don't need to do any converting back-and-forth with wide chars
         LOG_INFO("Loaded lyrics already form a valid UTF-8 sequence");
-        return std::string((const char*)text_bytes.data(), text_bytes.size());
+        return std::string((const char*)text, text_length);
     }
 
-    std::vector<char> narrow_tmp;
     std::vector<WCHAR> wide_tmp;
-
-    constexpr size_t wchar_per_byte = sizeof(wchar_t) / sizeof(uint8_t);
-    const std::wstring_view bytes_as_widestr = std::wstring_view((const wchar_t*)text_bytes.data(),
-                                                                 text_bytes.size() / wchar_per_byte);
-    size_t narrow_bytes = wide_to_narrow_string(CP_UTF8, bytes_as_widestr, narrow_tmp);
-    if(narrow_bytes > 0)
+    if((detected.codepage == charset::CODEPAGE_UTF16LE) || (detected.codepage == charset::CODEPAGE_UTF16BE))
     {
-        LOG_INFO("Successfully converted %d bytes of UTF-16 into UTF-8", narrow_bytes);
-        const std::string result = std::string(narrow_tmp.data(), narrow_bytes);
-        return result;
-    }
+        const size_t wide_length = text_length / sizeof(wchar_t);
+        wide_tmp.resize(wide_length);
+        memcpy(wide_tmp.data(), text, wide_length * sizeof(wchar_t));
+        if(detected.codepage == charset::CODEPAGE_UTF16BE)
+        {
+            for(WCHAR& c : wide_tmp)
+            {
+                c = WCHAR((c << 8) | (c >> 8));
+            }
+        }
 
-    // clang-format off: Don't put each of these on their own line
-    UINT codepages[] = { CP_ACP, CP_OEMCP,
-        037, 437, 500, 708, 709, 710, 720, 737, 775, 850, 852, 855, 857, 858, 860,
-        861, 862, 863, 864, 865, 866, 869, 870, 874, 875, 932, 936, 949, 950, 1026,
-        1047, 1140, 1141, 1142, 1143, 1144, 1145, 1146, 1147, 1148, 1149, 1200, 1201,
-        1250, 1251, 1252, 1253, 1254, 1255, 1256, 1257, 1258, 1361, 10000, 10001, 10002,
-        10003, 10004, 10005, 10006, 10007, 10008, 10010, 10017, 10021, 10029, 10079, 10081,
-        10082, 12000, 12001, 20000, 20001, 20002, 20003, 20004, 20005, 20105, 20106, 20107,
-        20108, 20127, 20261, 20269, 20273, 20277, 20278, 20280, 20284, 20285, 20290, 20297,
-        20420, 20423, 20424, 20833, 20838, 20866, 20871, 20880, 20905, 20924, 20932, 20936,
-        20949, 21025, 21027, 21866, 28591, 28592, 28593, 28594, 28595, 28596, 28597, 28598,
-        28599, 28603, 28605, 29001, 38598, 50930, 50931, 50933, 50935, 50936, 50937, 50939,
-        51932, 51936, 51949, 51950, 52936, 54936
-    };
-    // clang-format on
+        LOG_INFO("Converting %zu bytes of UTF-16 into UTF-8", text_length);
+        return utf16_to_utf8(std::wstring_view(wide_tmp.data(), wide_length));
+    }
 
-    for(UINT cp : codepages)
+    // NOTE: Detection can't rule out every encoding in which the text is invalid (e.g text that is cut off part-way
+    //       through a double-byte character is still most likely to be in that double-byte encoding), so if the text
+    //       turns out not to be valid in the detected codepage then we try the next best one. If that fails too then
+    //       we fall back to the current locale's codepage, replacing any characters that aren't valid in it, so that
+    //       we always end up with *some* text rather than none at all.
+    const std::string_view narrow_str((const char*)text, text_length);
+    for(UINT codepage : { detected.codepage, detected.next_best_codepage })
     {
-        CPINFOEXA info = {};
-        GetCPInfoExA(cp, 0, &info);
-        const char* current_locale_str = (GetACP() == cp) ? " (current locale code page)" : "";
-
-        const std::string_view narrow_str((const char*)text_bytes.data(), text_bytes.size());
-        size_t utf16_chars = narrow_to_wide_string(cp, narrow_str, wide_tmp);
-        if(utf16_chars <= 0)
+        if(codepage == charset::CODEPAGE_UNKNOWN)
         {
-            LOG_WARN("Failed to convert to codepage %u/%s%s: %d/%s",
-                     cp,
-                     info.CodePageName,
-                     current_locale_str,
-                     GetLastError(),
-                     GetLastErrorString());
             continue;
         }
-        LOG_INFO("Successfully converted %d chars to UTF-16 using codepage %s%s",
-                 utf16_chars,
-                 info.CodePageName,
-                 current_locale_str);
-
-        const std::wstring_view wide_str = std::wstring_view(wide_tmp.data(), utf16_chars);
-        size_t utf8_bytes = wide_to_narrow_string(CP_UTF8, wide_str, narrow_tmp);
-        if(utf8_bytes <= 0)
+
+        const size_t utf16_chars = narrow_to_wide_string(codepage, narrow_str, wide_tmp);
+        if(utf16_chars > 0)
         {
-            LOG_WARN("Failed to convert wide string back to UTF8: %d/%s", GetLastError(), GetLastErrorString());
-            continue;
+            LOG_INFO("Converting %zu bytes from detected codepage %u into UTF-8", text_length, codepage);
+            return utf16_to_utf8(std::wstring_view(wide_tmp.data(), utf16_chars));
         }
-
-        LOG_INFO("Successfully converted %d bytes back into UTF-8", utf8_bytes);
-        const std::string result = std::string(narrow_tmp.data(), utf8_bytes);
-        return result;
+        LOG_INFO("Failed to convert lyric bytes from detected codepage %u: %d", codepage, GetLastError());
     }
 
-    LOG_WARN("Failed to convert lyric bytes to UTF-8 after exhausting all available source encodings");
-    return "";
+    LOG_WARN("Failed to detect the encoding of the loaded lyrics, falling back to the current locale codepage");
+    const size_t utf16_chars = narrow_to_wide_string(CP_ACP, narrow_str, wide_tmp, true);
+    if(utf16_chars <= 0)
+    {
+        LOG_WARN("Failed to convert lyric bytes from the current locale codepage: %d", GetLastError());
+        return "";
+    }
+    return utf16_to_utf8(std::wstring_view(wide_tmp.data(), utf16_chars));
 }
 
 static std::string decode_raw_lyric_bytes_to_text(const LyricDataRaw& raw)
@@ -228,6 +222,15 @@ static std::string decode_raw_lyric_bytes_to_text(const LyricDataRaw& raw)
     return text;
 }
 
+LyricData io::parse_raw_lyrics(const LyricDataRaw& raw)
+{
+    if(raw.parsed != nullptr)
+    {
+        return *raw.parsed;
+    }
+    return parsers::lrc::parse(raw, decode_raw_lyric_bytes_to_text(raw));
+}
+
 static void sort_source_results(std::vector<LyricDataRaw>& results,
                                 std::string_view artist,
                                 std::string_view album,
@@ -279,7 +282,613 @@ static void sort_source_results(std::vector<LyricDataRaw>& results,
     std::stable_sort(results.begin(), results.end(), compare_search_results);
 }
 
-static void internal_search_for_lyrics(LyricSearchHandle& handle, bool local_only)
+// Tracks the remote requests that are currently in progress, so that identical requests made at the same time
+// (for example by the autosearch and a bulk search of the album that is playing) can share a single request
+// to the source instead of each sending their own.
+template<typename T>
+class InFlightRequests
+{
+public:
+    // Runs the given request, unless an identical request is already in progress in which case we wait for that
+    // one to finish and return its result instead.
+    template<typename Request>
+    T run(const std::string& key, abort_callback& abort, Request&& request)
+    {
+        std::shared_ptr<Flight> flight;
+        bool is_first = false;
+        {
+            std::lock_guard lock(m_mutex);
+            auto iter = m_flights.find(key);
+            if(iter == m_flights.end())
+            {
+                flight = std::make_shared<Flight>();
+                m_flights.emplace(key, flight);
+                is_first = true;
+            }
+            else
+            {
+                flight = iter->second;
+            }
+        }
+
+        if(!is_first)
+        {
+            abort.waitForEvent(flight->done);
+            if(flight->result.has_value())
+            {
+                return flight->result.value();
+            }
+
+            // NOTE: If the original request failed (or was aborted by whoever started it) then we don't know what
+            //       the answer is, so we just make the request ourselves.
+            return request();
+        }
+
+        try
+        {
+            T result = request();
+            finish(key, *flight, result);
+            return result;
+        }
+        catch(...)
+        {
+            finish(key, *flight, std::nullopt);
+            throw;
+        }
+    }
+
+private:
+    struct Flight
+    {
+        pfc::event done;
+        std::optional<T> result; // Only set if the request completed successfully
+    };
+
+    void finish(const std::string& key, Flight& flight, std::optional<T> result)
+    {
+        {
+            std::lock_guard lock(m_mutex);
+            m_flights.erase(key);
+        }
+        flight.result = std::move(result);
+        flight.done.set_state(true);
+    }
+
+    std::mutex m_mutex;
+    std::unordered_map<std::string, std::shared_ptr<Flight>> m_flights;
+};
+static InFlightRequests<std::vector<LyricDataRaw>> g_in_flight_searches;
+static InFlightRequests<std::optional<LyricDataRaw>> g_in_flight_lookups;
+
+struct RemoteSearchResults
+{
+    std::vector<LyricDataRaw> results;
+    bool from_cache; // True if the results were those of an earlier search, rather than being requested just now
+};
+
+// Searches the given remote source, re-using the results of an identical earlier search if they are still cached.
+// Returns nothing if the source was not searched at all because it has recently stopped responding.
+static std::optional<RemoteSearchResults> search_remote_source(LyricSourceRemote& source,
+                                                               const LyricSearchParams& params,
+                                                               abort_callback& abort)
+{
+    const bool use_cache = preferences::searching::cache_remote_results();
+    if(use_cache)
+    {
+        std::optional<std::vector<LyricDataRaw>> cached_results = search_result_cache::get_search(source, params);
+        if(cached_results.has_value())
+        {
+            const std::string friendly_name = from_tstring(source.friendly_name());
+            LOG_INFO("Using %d cached search results from %s", int(cached_results->size()), friendly_name.c_str());
+            return RemoteSearchResults { std::move(cached_results.value()), true };
+        }
+    }
+
+    if(source_health::should_skip_source(source.id()))
+    {
+        const std::string friendly_name = from_tstring(source.friendly_name());
+        LOG_INFO("%s has recently stopped responding to requests, skipping...", friendly_name.c_str());
+        return {};
+    }
+
+    const std::string key = search_result_cache::search_key(source, params);
+    std::vector<LyricDataRaw> search_results = g_in_flight_searches.run(
+        key,
+        abort,
+        [&source, &params, &abort, use_cache]()
+        {
+            source_health::RequestScope request_scope(source.id());
+            std::vector<LyricDataRaw> results = source.search(params, abort);
+            if(use_cache)
+            {
+                search_result_cache::put_search(source, params, results);
+            }
+            return results;
+        });
+    return RemoteSearchResults { std::move(search_results), false };
+}
+
+// Looks up the given search result, re-using the result of an identical earlier lookup if it is still cached
+static bool lookup_source(LyricSourceBase& source, LyricDataRaw& data, abort_callback& abort)
+{
+    LyricSourceRemote* remote_source = dynamic_cast<LyricSourceRemote*>(&source);
+    const bool use_cache = (remote_source != nullptr) && preferences::searching::cache_remote_results();
+    if(use_cache)
+    {
+        std::optional<LyricDataRaw> cached_result = search_result_cache::get_lookup(*remote_source, data.lookup_id);
+        if(cached_result.has_value())
+        {
+            const std::string friendly_name = from_tstring(source.friendly_name());
+            LOG_INFO("Using cached lookup result from %s", friendly_name.c_str());
+            data = std::move(cached_result.value());
+            return true;
+        }
+    }
+
+    const std::string lookup_id = data.lookup_id; // Lookup is allowed to modify the lookup ID
+    const auto lookup = [&source, &data, &abort, remote_source, use_cache, &lookup_id]() -> std::optional<LyricDataRaw>
+    {
+        std::optional<source_health::RequestScope> request_scope;
+        if(remote_source != nullptr)
+        {
+            request_scope.emplace(source.id());
+        }
+
+        LyricDataRaw result = data;
+        const bool lyrics_found = source.lookup(result, abort);
+        if(!lyrics_found)
+        {
+            return {};
+        }
+
+        if(use_cache)
+        {
+            search_result_cache::put_lookup(*remote_source, lookup_id, result);
+        }
+        return result;
+    };
+
+    // NOTE: Only remote lookups are worth sharing, local sources just read the lyrics from disk
+    std::optional<LyricDataRaw> result;
+    if(remote_source != nullptr)
+    {
+        result = g_in_flight_lookups.run(search_result_cache::lookup_key(*remote_source, lookup_id), abort, lookup);
+    }
+    else
+    {
+        result = lookup();
+    }
+
+    if(!result.has_value())
+    {
+        return false;
+    }
+    data = std::move(result.value());
+    return true;
+}
+
+// Runs a set of tasks at the same time and picks the most desirable one that wins. Less desirable tasks are aborted as
+// soon as a more desirable one wins, so the winner is always the same as it would have been if we had run the tasks
+// one after another (from most to least desirable) and stopped at the first one that won.
+template<typename T>
+class PriorityRace
+{
+public:
+    using Task = std::function<T(abort_callback&)>;
+
+    PriorityRace()
+        : m_state(std::make_shared<State>())
+    {
+    }
+
+    // Adds a task to the race. Tasks must be added in order from most to least desirable.
+    void add_task(Task task)
+    {
+        auto entrant = std::make_unique<Entrant>();
+        entrant->task = std::move(task);
+        entrant->started = false;
+        m_state->entrants.push_back(std::move(entrant));
+    }
+
+    // Adds an entrant that doesn't need to run at all because its result is already known
+    void add_result(T result)
+    {
+        auto entrant = std::make_unique<Entrant>();
+        entrant->result.emplace(std::move(result));
+        entrant->started = true;
+        m_state->entrants.push_back(std::move(entrant));
+    }
+
+    // Runs the tasks (no more than `max_concurrent` of them at once) and returns the index of the winner, or nothing
+    // if none of them won. `is_winner` is called with the index and result of each entrant in order until it accepts
+    // one. If a task throws before any more desirable task has won then that exception is rethrown, and if the parent
+    // is aborted then this throws exception_aborted. Either way all of the remaining tasks are aborted first.
+    template<typename TIsWinner>
+    std::optional<size_t> run(size_t max_concurrent, abort_callback& parent_abort, TIsWinner is_winner)
+    {
+        State& state = *m_state;
+        const std::optional<WorkPriority> priority = work_scheduler::current_priority();
+
+        // All entrants before this index have completed without winning
+        size_t first_undecided = 0;
+        while(true)
+        {
+            {
+                std::lock_guard lock(state.mutex);
+                state.entrant_completed.set_state(false);
+
+                // Walk the entrants in order. The first one that has not yet completed blocks all less desirable
+                // entrants from winning, since it might still win itself.
+                for(; first_undecided < state.entrants.size(); first_undecided++)
+                {
+                    Entrant& entrant = *state.entrants[first_undecided];
+                    if(entrant.error)
+                    {
+                        abort_entrants_from(first_undecided + 1);
+                        std::rethrow_exception(entrant.error);
+                    }
+                    if(!entrant.result.has_value())
+                    {
+                        break;
+                    }
+                    if(is_winner(first_undecided, entrant.result.value()))
+                    {
+                        abort_entrants_from(first_undecided + 1);
+                        return first_undecided;
+                    }
+                }
+
+                if(first_undecided >= state.entrants.size())
+                {
+                    return {};
+                }
+
+                // Keep the most desirable entrants that have not completed yet running
+                size_t running_count = 0;
+                for(size_t i = first_undecided; i < state.entrants.size(); i++)
+                {
+                    Entrant& entrant = *state.entrants[i];
+                    if(!entrant.started && (running_count < max_concurrent))
+                    {
+                        start(i, priority);
+                    }
+                    if(entrant.started && !entrant.is_complete())
+                    {
+                        running_count++;
+                    }
+                }
+            }
+
+            try
+            {
+                parent_abort.waitForEvent(state.entrant_completed);
+            }
+            catch(const exception_aborted&)
+            {
+                std::lock_guard lock(state.mutex);
+                abort_entrants_from(0);
+                throw;
+            }
+        }
+    }
+
+    // Calls `callback` with the index and result of each entrant that has completed successfully so far
+    template<typename TCallback>
+    void for_each_result(TCallback callback)
+    {
+        std::lock_guard lock(m_state->mutex);
+        for(size_t i = 0; i < m_state->entrants.size(); i++)
+        {
+            const Entrant& entrant = *m_state->entrants[i];
+            if(entrant.result.has_value())
+            {
+                callback(i, entrant.result.value());
+            }
+        }
+    }
+
+    // Takes the result of the given entrant, which must have completed successfully
+    T take_result(size_t index)
+    {
+        std::lock_guard lock(m_state->mutex);
+        return std::move(m_state->entrants[index]->result.value());
+    }
+
+private:
+    struct Entrant
+    {
+        Task task;
+        abort_callback_impl abort;
+        std::optional<T> result;  // Set once the entrant has completed successfully
+        std::exception_ptr error; // Set if the task threw, in which case we don't know if it would have won
+        bool started;
+
+        bool is_complete() const
+        {
+            return result.has_value() || error;
+        }
+    };
+
+    // NOTE: The race state is shared with the tasks (rather than belonging to the race itself) because we do not
+    //       wait for aborted tasks to finish before returning.
+    struct State
+    {
+        std::mutex mutex;
+        pfc::event entrant_completed;
+        std::vector<std::unique_ptr<Entrant>> entrants; // Ordered from most to least desirable
+    };
+
+    // Must be called with the state mutex held
+    void start(size_t index, std::optional<WorkPriority> priority)
+    {
+        m_state->entrants[index]->started = true;
+        fb2k::splitTask(
+            [state = m_state, index, priority]()
+            {
+                work_scheduler::PriorityScope priority_scope(priority);
+                Entrant& entrant = *state->entrants[index];
+                std::optional<T> result;
+                std::exception_ptr error;
+                try
+                {
+                    result.emplace(entrant.task(entrant.abort));
+                }
+                catch(...)
+                {
+                    error = std::current_exception();
+                }
+
+                std::lock_guard lock(state->mutex);
+                entrant.result = std::move(result);
+                entrant.error = error;
+                state->entrant_completed.set_state(true);
+            });
+    }
+
+    // Must be called with the state mutex held
+    void abort_entrants_from(size_t first_index)
+    {
+        for(size_t i = first_index; i < m_state->entrants.size(); i++)
+        {
+            m_state->entrants[i]->abort.abort();
+        }
+    }
+
+    std::shared_ptr<State> m_state;
+};
+
+// The number of search results from a single source that we will look up at the same time. Most of the time the
+// first result is the one we want, but when it turns out to be empty or instrumental we would otherwise have to
+// wait for another full round trip to the source for each of the results after it.
+static constexpr size_t MAX_CONCURRENT_LOOKUPS_PER_SOURCE = 3;
+
+// Looks up the given (sorted) search results and returns the most desirable one that contains lyrics.
+// Up to MAX_CONCURRENT_LOOKUPS_PER_SOURCE lookups are run speculatively at the same time, and less desirable lookups
+// are aborted as soon as a more desirable one succeeds, so the result is always the same as it would have been if
+// we had looked up each result one after another.
+static LyricDataRaw race_lookups_for_lyrics(LyricSourceBase& source,
+                                            std::vector<LyricDataRaw> candidates,
+                                            abort_callback& parent_abort)
+{
+    const std::string friendly_name = from_tstring(source.friendly_name());
+
+    std::vector<bool> needs_lookup;
+    needs_lookup.reserve(candidates.size());
+    PriorityRace<std::optional<LyricDataRaw>> race;
+    for(LyricDataRaw& candidate : candidates)
+    {
+        // Results that already contain their lyrics don't need to be looked up at all
+        needs_lookup.push_back(!candidate.lookup_id.empty());
+        if(!needs_lookup.back())
+        {
+            race.add_result(std::move(candidate));
+            continue;
+        }
+
+        race.add_task(
+            [source = &source, data = std::move(candidate)](abort_callback& abort) -> std::optional<LyricDataRaw>
+            {
+                LyricDataRaw result = data;
+                if(!lookup_source(*source, result, abort))
+                {
+                    return {};
+                }
+                return result;
+            });
+    }
+
+    const auto is_winner = [&friendly_name, &needs_lookup](size_t index, const std::optional<LyricDataRaw>& result)
+    {
+        if(!result.has_value())
+        {
+            LOG_INFO("Look up for lyrics from source %s returned an empty result, ignoring...", friendly_name.c_str());
+            return false;
+        }
+
+        if(result->IsEmpty())
+        {
+            if(needs_lookup[index])
+            {
+                LOG_INFO("Received empty successful lookup from source: %s", friendly_name.c_str());
+            }
+            else
+            {
+                LOG_INFO("Source %s returned an empty lyric, skipping...", friendly_name.c_str());
+            }
+            return false;
+        }
+
+        if(needs_lookup[index])
+        {
+            LOG_INFO("Successfully looked-up lyrics from source: %s", friendly_name.c_str());
+        }
+        else
+        {
+            LOG_INFO("Successfully retrieved lyrics from source: %s", friendly_name.c_str());
+        }
+        return true;
+    };
+
+    const std::optional<size_t> winner = race.run(MAX_CONCURRENT_LOOKUPS_PER_SOURCE, parent_abort, is_winner);
+    if(!winner.has_value())
+    {
+        return {};
+    }
+    return std::move(race.take_result(winner.value()).value());
+}
+
+struct SourceSearchResult
+{
+    LyricDataRaw lyrics;
+    bool errored; // True if the search could not be completed, in which case we don't know if the source has lyrics
+    bool skipped; // True if the source was not searched because it has recently stopped responding
+};
+
+// Searches a single source for lyrics, including any lookup required for search results to be usable.
+// Returns the first acceptable result from that source, or an empty result if none of them were acceptable.
+static SourceSearchResult search_source_for_lyrics(LyricSourceBase* source,
+                                                   metadb_handle_ptr track,
+                                                   const metadb_v2_rec_t& track_info,
+                                                   abort_callback& abort)
+{
+    const std::string tag_artist = track_metadata(track_info, "artist");
+    const std::string tag_album = track_metadata(track_info, "album");
+    const std::string tag_title = track_metadata(track_info, "title");
+    const std::string friendly_name = from_tstring(source->friendly_name());
+    LyricSourceRemote* remote_source = dynamic_cast<LyricSourceRemote*>(source);
+    const LyricSearchParams params(track_info);
+
+    LyricDataRaw lyric_data_raw = {};
+    bool errored = false;
+    bool results_from_cache = false;
+    try
+    {
+        abort.check();
+        std::vector<LyricDataRaw> search_results;
+        if(remote_source != nullptr)
+        {
+            std::optional<RemoteSearchResults> remote_results = search_remote_source(*remote_source, params, abort);
+            if(!remote_results.has_value())
+            {
+                return { {}, false, true };
+            }
+            search_results = std::move(remote_results->results);
+            results_from_cache = remote_results->from_cache;
+        }
+        else
+        {
+            search_results = source->search(track, track_info, abort);
+        }
+        sort_source_results(search_results,
+                            tag_artist,
+                            tag_album,
+                            tag_title,
+                            preferences::searching::preferred_lyric_type());
+
+        std::vector<LyricDataRaw> candidates;
+        for(LyricDataRaw& result : search_results)
+        {
+            // NOTE: Some sources don't return an album so we ignore album data if the source didn't give us any.
+            //       Similarly, the local tag data might not contain an album, in which case we shouldn't reject
+            //       candidates because they have non-empty album data.
+            bool tag_match = (result.album.empty() || tag_album.empty() || tag_values_match(tag_album, result.album))
+                             && tag_values_match(tag_artist, result.artist)
+                             && tag_values_match(tag_title, result.title);
+            if(!tag_match)
+            {
+                LOG_INFO("Rejected %s search result for tag mismatch: Local track has %s/%s/%s while search result "
+                         "has %s/%s/%s",
+                         friendly_name.c_str(),
+                         tag_artist.c_str(),
+                         tag_album.c_str(),
+                         tag_title.c_str(),
+                         result.artist.c_str(),
+                         result.album.c_str(),
+                         result.title.c_str());
+                continue;
+            }
+
+            assert(result.source_id == source->id());
+            candidates.push_back(std::move(result));
+        }
+
+        abort.check();
+        lyric_data_raw = race_lookups_for_lyrics(*source, std::move(candidates), abort);
+    }
+    catch(const exception_aborted&)
+    {
+        // NOTE: This isn't an error, we were just told to stop (usually because a higher-priority source already
+        //       found lyrics). We still don't know if this source has lyrics though.
+        LOG_INFO("Search of %s was aborted", friendly_name.c_str());
+        errored = true;
+    }
+    catch(const std::exception& e)
+    {
+        LOG_ERROR("Error while searching %s: %s", friendly_name.c_str(), e.what());
+        errored = true;
+    }
+    catch(...)
+    {
+        LOG_ERROR("Error of unrecognised type while searching %s", friendly_name.c_str());
+        errored = true;
+    }
+
+    if(lyric_data_raw.IsEmpty())
+    {
+        LOG_INFO("Failed to retrieve lyrics from source: %s", friendly_name.c_str());
+
+        // NOTE: If the search results came from the cache then they might refer to lookup IDs that are no longer
+        //       valid on the source, so we drop them to make sure that we'll search the source again next time.
+        if((remote_source != nullptr) && results_from_cache && !abort.is_aborting())
+        {
+            search_result_cache::forget_search(*remote_source, params);
+        }
+    }
+    return { std::move(lyric_data_raw), errored, false };
+}
+
+// Searches all of the given sources at the same time and returns the result from the highest-priority source
+// that found anything. Lower-priority sources are aborted as soon as a higher-priority source finds lyrics,
+// so the result is always the same as it would have been if we had searched the sources one after another.
+// The IDs of any sources that completed their search without finding anything are added to `missed_sources`.
+static LyricDataRaw race_sources_for_lyrics(LyricSearchHandle& handle,
+                                            const std::vector<LyricSourceBase*>& sources,
+                                            std::vector<GUID>& missed_sources)
+{
+    if(sources.empty())
+    {
+        return {};
+    }
+
+    PriorityRace<SourceSearchResult> race;
+    for(LyricSourceBase* source : sources)
+    {
+        race.add_task([source, track = handle.get_track(), track_info = handle.get_track_info()](abort_callback& abort)
+                      { return search_source_for_lyrics(source, track, track_info, abort); });
+    }
+
+    const std::optional<size_t> winner = race.run(sources.size(),
+                                                  handle.get_checked_abort(),
+                                                  [](size_t /*index*/, const SourceSearchResult& result)
+                                                  { return !result.lyrics.IsEmpty(); });
+
+    race.for_each_result(
+        [&sources, &missed_sources](size_t index, const SourceSearchResult& result)
+        {
+            if(!result.errored && !result.skipped && result.lyrics.IsEmpty())
+            {
+                missed_sources.push_back(sources[index]->id());
+            }
+        });
+
+    if(!winner.has_value())
+    {
+        return {};
+    }
+    return std::move(race.take_result(winner.value()).lyrics);
+}
+
+static void internal_search_for_lyrics(LyricSearchHandle& handle, bool local_only, bool ignore_search_avoidance)
 {
     handle.set_started();
     const std::string tag_artist = track_metadata(handle.get_track_info(), "artist");
@@ -299,7 +908,13 @@ static void internal_search_for_lyrics(LyricSearchHandle& handle, bool local_onl
         LOG_INFO("No identifying metadata tags are available for this track, reverting to a local-only search");
     }
 
-    LyricDataRaw lyric_data_raw = {};
+    std::vector<GUID> sources_to_skip;
+    if(!local_only && !ignore_search_avoidance)
+    {
+        sources_to_skip = search_avoidance_sources_to_skip(handle.get_track_info());
+    }
+
+    std::vector<LyricSourceBase*> sources_to_search;
     for(GUID source_id : preferences::searching::active_sources())
     {
         LyricSourceBase* source = LyricSourceBase::get(source_id);
@@ -310,144 +925,185 @@ static void internal_search_for_lyrics(LyricSearchHandle& handle, bool local_onl
             continue;
         }
 
-        std::string friendly_name = from_tstring(source->friendly_name());
         if(local_only && !source->is_local())
         {
+            std::string friendly_name = from_tstring(source->friendly_name());
             LOG_INFO("Current search is only considering local sources and %s is not marked as local, skipping...",
                      friendly_name.c_str());
             continue;
         }
-        handle.set_progress("Searching " + friendly_name + "...");
 
+        if(!source->is_local()
+           && (std::find(sources_to_skip.begin(), sources_to_skip.end(), source_id) != sources_to_skip.end()))
+        {
+            std::string friendly_name = from_tstring(source->friendly_name());
+            LOG_INFO("%s recently failed to find lyrics for this track, skipping...", friendly_name.c_str());
+            continue;
+        }
+        sources_to_search.push_back(source);
+    }
+
+    LyricDataRaw lyric_data_raw = {};
+    std::vector<GUID> missed_remote_sources;
+    if(preferences::searching::search_sources_concurrently())
+    {
         try
         {
-            if(!source->is_local())
+            // Local sources are fast and free, so we search them first and only race the remote sources that have
+            // a higher priority than the best local result. This avoids sending requests to every remote source
+            // every time we play a track that already has lyrics saved.
+            std::vector<LyricSourceBase*> local_sources;
+            for(LyricSourceBase* source : sources_to_search)
             {
-                handle.set_remote_source_searched();
+                if(source->is_local())
+                {
+                    local_sources.push_back(source);
+                }
             }
-            std::vector<LyricDataRaw> search_results = source->search(handle.get_track(),
-                                                                      handle.get_track_info(),
-                                                                      handle.get_checked_abort());
-            sort_source_results(search_results,
-                                tag_artist,
-                                tag_album,
-                                tag_title,
-                                preferences::searching::preferred_lyric_type());
-
-            for(LyricDataRaw& result : search_results)
+
+            handle.set_progress("Searching local sources...");
+            std::vector<GUID> missed_local_sources;
+            lyric_data_raw = race_sources_for_lyrics(handle, local_sources, missed_local_sources);
+
+            std::vector<LyricSourceBase*> remote_sources;
+            for(LyricSourceBase* source : sources_to_search)
             {
-                // NOTE: Some sources don't return an album so we ignore album data if the source didn't give us any.
-                //       Similarly, the local tag data might not contain an album, in which case we shouldn't reject
-                //       candidates because they have non-empty album data.
-                bool tag_match = (result.album.empty() || tag_album.empty()
-                                  || tag_values_match(tag_album, result.album))
-                                 && tag_values_match(tag_artist, result.artist)
-                                 && tag_values_match(tag_title, result.title);
-                if(!tag_match)
+                if(!lyric_data_raw.IsEmpty() && (source->id() == lyric_data_raw.source_id))
                 {
-                    LOG_INFO("Rejected %s search result for tag mismatch: Local track has %s/%s/%s while search result "
-                             "has %s/%s/%s",
-                             friendly_name.c_str(),
-                             tag_artist.c_str(),
-                             tag_album.c_str(),
-                             tag_title.c_str(),
-                             result.artist.c_str(),
-                             result.album.c_str(),
-                             result.title.c_str());
-                    continue;
+                    break; // All remaining sources have a lower priority than the local result we already have
                 }
-
-                assert(result.source_id == source_id);
-                if(result.lookup_id.empty())
+                if(!source->is_local())
                 {
-                    if(result.text_bytes.empty())
-                    {
-                        LOG_INFO("Source %s returned an empty lyric, skipping...", friendly_name.c_str());
-                    }
-                    else
-                    {
-                        lyric_data_raw = std::move(result);
-                        LOG_INFO("Successfully retrieved lyrics from source: %s", friendly_name.c_str());
-                        break;
-                    }
+                    remote_sources.push_back(source);
                 }
-                else
+            }
+
+            if(!remote_sources.empty())
+            {
+                handle.set_remote_source_searched();
+                handle.set_progress("Searching " + std::to_string(remote_sources.size()) + " sources...");
+                LyricDataRaw remote_data_raw = race_sources_for_lyrics(handle, remote_sources, missed_remote_sources);
+                if(!remote_data_raw.IsEmpty())
                 {
-                    bool lyrics_found = source->lookup(result, handle.get_checked_abort());
-                    if(lyrics_found)
-                    {
-                        if(result.text_bytes.empty())
-                        {
-                            LOG_INFO("Received empty successful lookup from source: %s", friendly_name.c_str());
-                        }
-                        else
-                        {
-                            lyric_data_raw = std::move(result);
-                            LOG_INFO("Successfully looked-up lyrics from source: %s", friendly_name.c_str());
-                            break;
-                        }
-                    }
-                    else
-                    {
-                        LOG_INFO("Look up for lyrics from source %s returned an empty result, ignoring...",
-                                 friendly_name.c_str());
-                    }
+                    lyric_data_raw = std::move(remote_data_raw);
                 }
             }
         }
-        catch(const std::exception& e)
+        catch(const exception_aborted&)
         {
-            LOG_ERROR("Error while searching %s: %s", friendly_name.c_str(), e.what());
+            // NOTE: An aborted search didn't fail, we just stopped looking
         }
-        catch(...)
+        catch(const std::exception& e)
         {
-            LOG_ERROR("Error of unrecognised type while searching %s", friendly_name.c_str());
+            LOG_ERROR("Error while searching sources concurrently: %s", e.what());
         }
-
-        if(!lyric_data_raw.text_bytes.empty())
+    }
+    else
+    {
+        for(LyricSourceBase* source : sources_to_search)
         {
-            break;
+            std::string friendly_name = from_tstring(source->friendly_name());
+            handle.set_progress("Searching " + friendly_name + "...");
+
+            if(!source->is_local())
+            {
+                handle.set_remote_source_searched();
+            }
+
+            try
+            {
+                SourceSearchResult result = search_source_for_lyrics(source,
+                                                                     handle.get_track(),
+                                                                     handle.get_track_info(),
+                                                                     handle.get_checked_abort());
+                lyric_data_raw = std::move(result.lyrics);
+                if(!source->is_local() && !result.errored && !result.skipped && lyric_data_raw.IsEmpty())
+                {
+                    missed_remote_sources.push_back(source->id());
+                }
+            }
+            catch(const std::exception& e)
+            {
+                LOG_ERROR("Error while searching %s: %s", friendly_name.c_str(), e.what());
+            }
+
+            if(!lyric_data_raw.IsEmpty())
+            {
+                break;
+            }
         }
-        LOG_INFO("Failed to retrieve lyrics from source: %s", friendly_name.c_str());
     }
 
     LOG_INFO("Parsing lyrics text...");
     handle.set_progress("Parsing...");
 
-    LyricData lyric_data = parsers::lrc::parse(lyric_data_raw, decode_raw_lyric_bytes_to_text(lyric_data_raw));
+    LyricData lyric_data = io::parse_raw_lyrics(lyric_data_raw);
     if(lyric_data.IsEmpty())
     {
-        if(!local_only)
+        // NOTE: A search that was aborted part-way through didn't really fail, we just stopped looking.
+        //       Similarly if every remote source was skipped (or failed to respond) then none of them actually told
+        //       us that they don't have lyrics for this track, so we don't count that as a failure either.
+        if(!local_only && !handle.is_aborting() && !missed_remote_sources.empty())
         {
-            search_avoidance_log_search_failure(handle.get_track_info());
+            search_avoidance_log_search_failure(handle.get_track_info(), missed_remote_sources);
         }
         handle.set_complete();
     }
     else
     {
-        // Clear here so that we will continue searching even if auto-save is disabled and the user doesn't save
-        clear_search_avoidance(handle.get_track_info());
+        // Reset here so that we will continue searching even if auto-save is disabled and the user doesn't save
+        search_avoidance_log_search_success(handle.get_track_info(), missed_remote_sources, lyric_data.source_id);
         handle.set_result(std::move(lyric_data), true);
     }
     LOG_INFO("Lyric loading complete");
 }
 
-void io::search_for_lyrics(LyricSearchHandle& handle, bool local_only)
+work_scheduler::WorkId io::search_for_lyrics(LyricSearchHandle& handle,
+                                             WorkPriority priority,
+                                             bool local_only,
+                                             bool ignore_search_avoidance)
 {
     if(track_is_remote(handle.get_track()))
     {
         metrics::log_searched_for_lyrics_for_a_remote_track();
     }
 
-    fb2k::splitTask([&handle, local_only]() { internal_search_for_lyrics(handle, local_only); });
+    // NOTE: The individual sources are still searched on their own tasks (see race_sources_for_lyrics) rather than
+    //       being submitted to the scheduler, because this task waits for them and if they were queued behind other
+    //       searches that are doing the same then none of them would ever finish.
+    return work_scheduler::submit(priority,
+                                  [&handle, local_only, ignore_search_avoidance]()
+                                  { internal_search_for_lyrics(handle, local_only, ignore_search_avoidance); });
 }
 
+void io::search_for_local_lyrics_inline(LyricSearchHandle& handle)
+{
+    if(track_is_remote(handle.get_track()))
+    {
+        metrics::log_searched_for_lyrics_for_a_remote_track();
+    }
+    internal_search_for_lyrics(handle, true, false);
+}
+
+// State shared by all of the per-source tasks of a single custom search. The tasks report their results directly
+// to the search handle as they find them, and whichever task finishes last marks the search as complete.
+struct AllLyricsSearch
+{
+    AllLyricsSearch(LyricSearchParams search_params, size_t source_count)
+        : params(std::move(search_params))
+        , remaining_sources(source_count)
+    {
+    }
+
+    const LyricSearchParams params;
+    std::atomic<size_t> remaining_sources;
+};
+
 static void internal_search_for_all_lyrics_from_source(LyricSearchHandle& handle,
                                                        LyricSourceBase* source,
                                                        const LyricSearchParams& params)
 {
     std::string friendly_name = from_tstring(source->friendly_name());
-    handle.set_started();
 
     try
     {
@@ -464,38 +1120,32 @@ static void internal_search_for_all_lyrics_from_source(LyricSearchHandle& handle
             if(remote_source == nullptr)
             {
                 LOG_ERROR("Bad LyricSourceRemote cast for: %s", friendly_name.c_str());
-                handle.set_complete();
                 return;
             }
 
-            search_results = remote_source->search(params, handle.get_checked_abort());
+            std::optional<RemoteSearchResults> remote_results = search_remote_source(*remote_source,
+                                                                                     params,
+                                                                                     handle.get_checked_abort());
+            if(!remote_results.has_value())
+            {
+                return;
+            }
+            search_results = std::move(remote_results->results);
         }
 
         for(LyricDataRaw& result : search_results)
         {
             assert(result.source_id == source->id());
 
-            std::optional<std::string> lyric;
-            if(result.lookup_id.empty())
+            bool lyrics_found = !result.IsEmpty();
+            if(!result.lookup_id.empty())
             {
-                if(!result.text_bytes.empty())
-                {
-                    lyric = decode_raw_lyric_bytes_to_text(result);
-                }
-            }
-            else
-            {
-                bool lyrics_found = source->lookup(result, handle.get_checked_abort());
-                if(lyrics_found && !result.text_bytes.empty())
-                {
-                    lyric = decode_raw_lyric_bytes_to_text(result);
-                }
+                lyrics_found = lookup_source(*source, result, handle.get_checked_abort()) && !result.IsEmpty();
             }
 
-            if(lyric.has_value())
+            if(lyrics_found)
             {
-                LyricData parsed_lyrics = parsers::lrc::parse(result, lyric.value());
-                handle.set_result(std::move(parsed_lyrics), false);
+                handle.set_result(io::parse_raw_lyrics(result), false);
             }
         }
     }
@@ -507,33 +1157,15 @@ static void internal_search_for_all_lyrics_from_source(LyricSearchHandle& handle
     {
         LOG_ERROR("Error of unrecognised type while searching %s", friendly_name.c_str());
     }
-
-    handle.set_complete();
 }
 
-static void internal_search_for_all_lyrics(LyricSearchHandle& handle,
-                                           std::string artist,
-                                           std::string album,
-                                           std::string title)
+void io::search_for_all_lyrics(LyricSearchHandle& handle, std::string artist, std::string album, std::string title)
 {
     LOG_INFO("Searching for lyrics using custom parameters...");
     assert(handle.get_type() != LyricUpdate::Type::AutoSearch);
-    handle.set_started();
-
-    // NOTE: This is only ever used in this function as a const&,
-    //       and by definition this function only returns after all the search tasks have completed.
-    //       So it's safe for those tasks to reference this from other threads without
-    //       worrying about mutating shared state or this reference's lifetime expiring.
-    const LyricSearchParams params(std::move(artist), std::move(album), std::move(title), {}); // No duration
 
-    // NOTE: It is crucial that this is a std::list so that inserting new items or removing old ones
-    //       does not re-allocate the entire list and invalidate earlier pointers. We pass references
-    //       to these handles into the search task and so they need to remain valid for the task's
-    //       entire lifetime or we'll get weird random-memory bugs.
-    std::list<LyricSearchHandle> source_handles;
-
-    std::vector<GUID> all_source_ids = LyricSourceBase::get_all_ids();
-    for(GUID source_id : all_source_ids)
+    std::vector<LyricSourceBase*> sources;
+    for(GUID source_id : LyricSourceBase::get_all_ids())
     {
         LyricSourceBase* source = LyricSourceBase::get(source_id);
         assert(source != nullptr);
@@ -542,54 +1174,38 @@ static void internal_search_for_all_lyrics(LyricSearchHandle& handle,
             LOG_WARN("Attempt to search unrecognised lyric source, ignoring...");
             continue;
         }
-
-        source_handles.emplace_back(handle.get_type(),
-                                    handle.get_track(),
-                                    handle.get_track_info(),
-                                    handle.get_checked_abort());
-        LyricSearchHandle& src_handle = source_handles.back();
-
-        fb2k::splitTask([&src_handle, source, &params]()
-                        { internal_search_for_all_lyrics_from_source(src_handle, source, params); });
+        sources.push_back(source);
     }
 
-    while(!source_handles.empty())
+    handle.set_started();
+    if(sources.empty())
     {
-        for(auto iter = source_handles.begin(); iter != source_handles.end(); /*omitted*/)
-        {
-            LyricSearchHandle& src_handle = *iter;
-
-            bool is_complete = src_handle.wait_for_complete(100);
-            // It's critically important that we wait for update handle completion above,
-            // *then* check for any pending results, *then* erase the handle if it is actually complete.
-            // If not, we could get a result while in the wait for completion and then if we immediately
-            // erase it without checking and passing out results, we'll sometimes miss passing valid
-            // search results out to the UI (in a manner dependent on the relative thread executions).
+        handle.set_complete();
+        return;
+    }
 
-            while(src_handle.has_result())
+    // NOTE: There is no task waiting on all the sources to finish. Instead every source task reports its results
+    //       straight to the handle (so they reach the UI as soon as they're available) and the last one to finish
+    //       completes the search. The handle will not be destroyed before that happens because its destructor
+    //       waits for completion.
+    LyricSearchParams params(std::move(artist), std::move(album), std::move(title), {}); // No duration
+    auto search = std::make_shared<AllLyricsSearch>(std::move(params), sources.size());
+    for(LyricSourceBase* source : sources)
+    {
+        work_scheduler::submit(
+            WorkPriority::Manual,
+            [&handle, source, search]()
             {
-                handle.set_result(src_handle.get_result(), false);
-            }
+                internal_search_for_all_lyrics_from_source(handle, source, search->params);
 
-            if(is_complete)
-            {
-                iter = source_handles.erase(iter);
-            }
-            else
-            {
-                iter++;
-            }
-        }
+                const size_t sources_remaining = --search->remaining_sources;
+                if(sources_remaining == 0)
+                {
+                    LOG_INFO("Finished loading lyrics from a custom search");
+                    handle.set_complete();
+                }
+            });
     }
-
-    handle.set_complete();
-    LOG_INFO("Finished loading lyrics from a custom search");
-}
-
-void io::search_for_all_lyrics(LyricSearchHandle& handle, std::string artist, std::string album, std::string title)
-{
-    fb2k::splitTask([&handle, artist, album, title]()
-                    { internal_search_for_all_lyrics(handle, artist, album, title); });
 }
 
 static bool should_lyric_update_be_saved(bool loaded_from_local_src,
@@ -665,6 +1281,8 @@ static void try_publish_update(LyricData lyrics, const metadb_v2_rec_t& track_in
             continue;
         }
 
+        // NOTE: We wait out the upload delay on a separate task, so that it doesn't hold up one of the scheduler's
+        //       workers for a whole minute, and only submit the upload itself to the scheduler.
         fb2k::splitTask(
             [lyrics, remote_src, params = LyricSearchParams(track_info)]()
             {
@@ -680,22 +1298,36 @@ static void try_publish_update(LyricData lyrics, const metadb_v2_rec_t& track_in
                                  params.artist.c_str());
                         return;
                     }
-
-                    std::vector<LyricDataRaw> existing_lyrics = remote_src->search(params, fb2k::mainAborter());
-                    if(!existing_lyrics.empty())
-                    {
-                        // For now we only upload if the source doesn't have *any* lyrics for this track
-                        // TODO: Check if its the same sort of lyrics (IE upload lrc if we only have unsynced)
-                        return;
-                    }
-
-                    remote_src->upload(lyrics, fb2k::mainAborter());
-                    metrics::log_used_lyric_upload();
                 }
                 catch(std::exception& ex)
                 {
                     LOG_WARN("Aborting lyric upload due to exception: %s", ex.what());
+                    return;
                 }
+
+                work_scheduler::submit(
+                    WorkPriority::Upload,
+                    [lyrics, remote_src, params]()
+                    {
+                        try
+                        {
+                            std::vector<LyricDataRaw> existing_lyrics = remote_src->search(params,
+                                                                                           fb2k::mainAborter());
+                            if(!existing_lyrics.empty())
+                            {
+                                // For now we only upload if the source doesn't have *any* lyrics for this track
+                                // TODO: Check if its the same sort of lyrics (IE upload lrc if we only have unsynced)
+                                return;
+                            }
+
+                            remote_src->upload(lyrics, fb2k::mainAborter());
+                            metrics::log_used_lyric_upload();
+                        }
+                        catch(std::exception& ex)
+                        {
+                            LOG_WARN("Aborting lyric upload due to exception: %s", ex.what());
+                        }
+                    });
             });
     }
 }
@@ -799,6 +1431,31 @@ bool io::delete_saved_lyrics(metadb_handle_ptr track, const LyricData& lyrics)
     }
 }
 
+static VOID CALLBACK abort_search_on_parent_abort(PVOID context, BOOLEAN /*timed_out*/)
+{
+    abort_callback_impl* search_abort = static_cast<abort_callback_impl*>(context);
+    search_abort->abort();
+}
+
+// Arranges for the given search abort callback to be aborted when the parent is, returning the handle of the wait
+// that does so (which must be unregistered before the search abort callback is destroyed).
+static HANDLE link_search_abort_to_parent(abort_callback_impl& search_abort, abort_callback& parent_abort)
+{
+    HANDLE wait_handle = nullptr;
+    const BOOL wait_registered = RegisterWaitForSingleObject(&wait_handle,
+                                                             parent_abort.get_abort_event(),
+                                                             abort_search_on_parent_abort,
+                                                             &search_abort,
+                                                             INFINITE,
+                                                             WT_EXECUTEONLYONCE);
+    if(!wait_registered)
+    {
+        LOG_WARN("Failed to link search abort to its parent: %d", int(GetLastError()));
+        return nullptr;
+    }
+    return wait_handle;
+}
+
 LyricSearchHandle::LyricSearchHandle(LyricUpdate::Type type,
                                      metadb_handle_ptr track,
                                      metadb_v2_rec_t track_info,
@@ -808,11 +1465,14 @@ LyricSearchHandle::LyricSearchHandle(LyricUpdate::Type type,
     , m_type(type)
     , m_mutex({})
     , m_lyrics()
-    , m_abort(abort)
+    , m_parent_abort(abort)
+    , m_abort()
+    , m_parent_abort_wait(nullptr)
     , m_complete(nullptr)
     , m_status(Status::Created)
     , m_progress()
     , m_searched_remote_sources(false)
+    , m_update_callback()
 {
     assert(type != LyricUpdate::Type::Unknown); // Caller must specify a valid type
     assert(type != LyricUpdate::Type::Edit); // Caller cannot specify a non-search type for a search handle
@@ -820,6 +1480,7 @@ LyricSearchHandle::LyricSearchHandle(LyricUpdate::Type type,
     InitializeCriticalSection(&m_mutex);
     m_complete = CreateEvent(nullptr, TRUE, FALSE, nullptr);
     assert(m_complete != nullptr);
+    m_parent_abort_wait = link_search_abort_to_parent(m_abort, m_parent_abort);
 }
 
 LyricSearchHandle::LyricSearchHandle(LyricSearchHandle&& other)
@@ -827,11 +1488,14 @@ LyricSearchHandle::LyricSearchHandle(LyricSearchHandle&& other)
     , m_type(other.m_type)
     , m_mutex()
     , m_lyrics(std::move(other.m_lyrics))
-    , m_abort(other.m_abort)
+    , m_parent_abort(other.m_parent_abort)
+    , m_abort()
+    , m_parent_abort_wait(nullptr)
     , m_complete(nullptr)
     , m_status(other.m_status)
     , m_progress(std::move(other.m_progress))
     , m_searched_remote_sources(other.m_searched_remote_sources)
+    , m_update_callback(std::move(other.m_update_callback))
 {
     other.m_status = Status::Closed;
     InitializeCriticalSection(&m_mutex);
@@ -843,6 +1507,12 @@ LyricSearchHandle::LyricSearchHandle(LyricSearchHandle&& other)
         other.set_complete();
     }
     assert(m_complete != nullptr);
+
+    if(other.m_abort.is_aborting())
+    {
+        m_abort.abort();
+    }
+    m_parent_abort_wait = link_search_abort_to_parent(m_abort, m_parent_abort);
 }
 
 LyricSearchHandle::~LyricSearchHandle()
@@ -855,6 +1525,10 @@ LyricSearchHandle::~LyricSearchHandle()
 
         wait_result = WaitForSingleObject(m_complete, 30'000);
     }
+    if(m_parent_abort_wait != nullptr)
+    {
+        UnregisterWaitEx(m_parent_abort_wait, INVALID_HANDLE_VALUE); // Waits for the callback to finish if it's running
+    }
     CloseHandle(m_complete);
     DeleteCriticalSection(&m_mutex);
 }
@@ -918,10 +1592,22 @@ LyricData LyricSearchHandle::get_result()
 
 abort_callback& LyricSearchHandle::get_checked_abort()
 {
+    // NOTE: If we failed to link our abort to the parent then we at least still notice parent aborts here
+    m_parent_abort.check();
     m_abort.check();
     return m_abort;
 }
 
+bool LyricSearchHandle::is_aborting()
+{
+    return m_abort.is_aborting() || m_parent_abort.is_aborting();
+}
+
+void LyricSearchHandle::cancel()
+{
+    m_abort.abort();
+}
+
 metadb_handle_ptr LyricSearchHandle::get_track()
 {
     return m_track;
@@ -932,6 +1618,13 @@ const metadb_v2_rec_t& LyricSearchHandle::get_track_info()
     return m_track_info;
 }
 
+void LyricSearchHandle::set_update_callback(std::function<void()> callback)
+{
+    EnterCriticalSection(&m_mutex);
+    m_update_callback = std::move(callback);
+    LeaveCriticalSection(&m_mutex);
+}
+
 void LyricSearchHandle::set_started()
 {
     EnterCriticalSection(&m_mutex);
@@ -970,9 +1663,16 @@ void LyricSearchHandle::set_result(LyricData&& data, bool final_result)
         BOOL complete_success = SetEvent(m_complete);
         assert(complete_success);
     }
+    // NOTE: We take a copy of the callback because once the completion event has been set, the handle may be
+    //       destroyed as soon as we release the lock.
+    const std::function<void()> callback = m_update_callback;
     LeaveCriticalSection(&m_mutex);
 
     repaint_all_lyric_panels();
+    if(callback)
+    {
+        callback();
+    }
 }
 
 void LyricSearchHandle::set_complete()
@@ -991,7 +1691,13 @@ void LyricSearchHandle::set_complete()
     BOOL complete_success = SetEvent(m_complete);
     assert(complete_success);
 
+    const std::function<void()> callback = m_update_callback;
     LeaveCriticalSection(&m_mutex);
+
+    if(callback)
+    {
+        callback();
+    }
 }
 
 // ============
@@ -1190,4 +1896,84 @@ MVTF_TEST(saving_only_save_unsynced_autosearch_results_with_save_strategy_onlyun
     ASSERT(!save_synced);
     ASSERT(save_unsynced);
 }
+
+MVTF_TEST(inflight_requests_run_the_request_again_once_the_previous_one_has_finished)
+{
+    InFlightRequests<int> requests;
+    int request_count = 0;
+    const auto request = [&request_count]() { return ++request_count; };
+
+    const int first = requests.run("key", fb2k::noAbort, request);
+    const int second = requests.run("key", fb2k::noAbort, request);
+    ASSERT(first == 1);
+    ASSERT(second == 2);
+}
+
+MVTF_TEST(inflight_requests_dont_remember_failed_requests)
+{
+    InFlightRequests<int> requests;
+    bool threw = false;
+    try
+    {
+        requests.run("key", fb2k::noAbort, []() -> int { throw std::runtime_error("test"); });
+    }
+    catch(const std::runtime_error&)
+    {
+        threw = true;
+    }
+
+    const int result = requests.run("key", fb2k::noAbort, []() { return 42; });
+    ASSERT(threw);
+    ASSERT(result == 42);
+}
+
+MVTF_TEST(priority_race_picks_the_most_desirable_winner_even_if_it_finishes_last)
+{
+    auto less_desirable_done = std::make_shared<pfc::event>();
+    PriorityRace<int> race;
+    race.add_task(
+        [less_desirable_done](abort_callback& abort)
+        {
+            abort.waitForEvent(*less_desirable_done, 5.0);
+            return 1;
+        });
+    race.add_task(
+        [less_desirable_done](abort_callback& /*abort*/)
+        {
+            less_desirable_done->set_state(true);
+            return 2;
+        });
+
+    const std::optional<size_t> winner = race.run(2, fb2k::noAbort, [](size_t, int) { return true; });
+    ASSERT(less_desirable_done->is_set());
+    ASSERT(winner == 0);
+    ASSERT(race.take_result(0) == 1);
+}
+
+MVTF_TEST(priority_race_aborts_less_desirable_tasks_once_one_wins)
+{
+    auto loser_started = std::make_shared<pfc::event>();
+    auto loser_finished = std::make_shared<pfc::event>();
+    auto loser_was_aborted = std::make_shared<std::atomic<bool>>(false);
+    PriorityRace<int> race;
+    race.add_task(
+        [loser_started](abort_callback& abort)
+        {
+            abort.waitForEvent(*loser_started, 5.0);
+            return 1;
+        });
+    race.add_task(
+        [loser_started, loser_finished, loser_was_aborted](abort_callback& abort)
+        {
+            loser_started->set_state(true);
+            *loser_was_aborted = !abort.sleep_ex(5.0);
+            loser_finished->set_state(true);
+            return 2;
+        });
+
+    const std::optional<size_t> winner = race.run(2, fb2k::noAbort, [](size_t, int) { return true; });
+    ASSERT(winner == 0);
+    ASSERT(loser_finished->wait_for(5.0));
+    ASSERT(*loser_was_aborted);
+}
 #endif
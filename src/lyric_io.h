@@ -3,6 +3,7 @@
 #include "stdafx.h"
 
 #include "lyric_data.h"
+#include "work_scheduler.h"
 
 struct LyricUpdate
 {
@@ -42,9 +43,19 @@ public:
     LyricData get_result();
 
     abort_callback& get_checked_abort(); // Checks the abort flag (so it might throw) and returns it
+    bool is_aborting();
+
+    // Aborts this search (but not any other search sharing the same parent abort callback).
+    // The search still completes as usual once it notices, so the handle must be kept alive until then.
+    void cancel();
     metadb_handle_ptr get_track();
     const metadb_v2_rec_t& get_track_info();
 
+    // Sets a function to be called whenever a new result becomes available or the search completes.
+    // NOTE: The callback is invoked on whichever thread updated the handle (usually a background search thread),
+    //       so it should do little more than notify whoever is waiting on the search.
+    void set_update_callback(std::function<void()> callback);
+
     void set_started();
     void set_progress(std::string_view value);
     void set_remote_source_searched();
@@ -67,20 +78,35 @@ private:
 
     CRITICAL_SECTION m_mutex;
     std::vector<LyricData> m_lyrics;
-    abort_callback& m_abort;
+    abort_callback& m_parent_abort;
+    abort_callback_impl m_abort; // Aborted when either the parent is aborted or this search is cancelled
+    HANDLE m_parent_abort_wait;
     HANDLE m_complete;
     Status m_status;
     std::string m_progress;
     bool m_searched_remote_sources;
+    std::function<void()> m_update_callback;
 };
 
 namespace io
 {
-    void search_for_lyrics(LyricSearchHandle& handle, bool local_only);
+    // Returns the scheduler ID of the search, with which its priority can be changed until it starts
+    work_scheduler::WorkId search_for_lyrics(LyricSearchHandle& handle,
+                                             WorkPriority priority,
+                                             bool local_only,
+                                             bool ignore_search_avoidance);
+
+    // Searches only the local sources, on the calling thread, so the search is complete by the time this returns.
+    // NOTE: Local-only searches are quick, so callers that would block waiting for the result anyway should use this
+    //       rather than queueing the search behind whatever else the scheduler's workers are busy with.
+    void search_for_local_lyrics_inline(LyricSearchHandle& handle);
     void search_for_all_lyrics(LyricSearchHandle& handle, std::string artist, std::string album, std::string title);
 
     std::optional<LyricData> process_available_lyric_update(LyricUpdate update);
 
+    // Decodes & parses the lyrics returned by a source (or returns the lyrics that the source already parsed)
+    LyricData parse_raw_lyrics(const LyricDataRaw& raw);
+
     // Updates the lyric data with the ID of the source used for saving, as well as the persistence path.
     // Returns a success flag
     bool save_lyrics(metadb_handle_ptr track,
@@ -9,13 +9,35 @@
 #include "lyric_search.h"
 #include "metadb_index_search_avoidance.h"
 #include "metrics.h"
+#include "preferences.h"
 #include "tag_util.h"
 #include "ui_hooks.h"
 
+// The maximum number of autosearches (including prefetches and searches that have been cancelled but not yet
+// noticed) that may run at the same time. Further searches wait for one of these to finish before starting.
+static constexpr size_t MAX_CONCURRENT_AUTOSEARCHES = 3;
+
 struct SearchTracker
 {
     std::unique_ptr<LyricSearchHandle> handle;
     SearchAvoidanceReason avoidance_reason;
+    bool is_prefetch; // Prefetch results are processed in the background instead of being announced
+    work_scheduler::WorkId work_id;
+};
+
+struct PendingPrefetch
+{
+    metadb_handle_ptr track;
+    metadb_v2_rec_t track_info;
+};
+
+struct PendingAutosearch
+{
+    metadb_handle_ptr track;
+    metadb_v2_rec_t track_info;
+    SearchAvoidanceReason avoidance_reason;
+    bool local_only;
+    bool ignore_search_avoidance;
 };
 
 class LyricAutosearchManager : public initquit, private play_callback
@@ -37,11 +59,22 @@ private:
     void on_volume_change(float /*new_volume*/) override {}
 
     void initiate_search(metadb_handle_ptr track, metadb_v2_rec_t track_info, bool ignore_search_avoidance);
+    void start_search(PendingAutosearch search);
+    void start_pending_search();
+    void cancel_searches();
+    void queue_prefetch_searches();
+    void cancel_prefetch_searches();
+    void start_next_prefetch_search();
     void check_for_available_updates();
+    void watch_search_handle(LyricSearchHandle& handle);
     std::optional<std::string> get_progress_message();
 
     metadb_handle_ptr m_last_played_track;
     std::vector<SearchTracker> m_search_handles;
+    std::optional<PendingAutosearch> m_pending_search; // Waiting for a free slot to start searching
+    std::vector<PendingPrefetch> m_pending_prefetches; // Ordered by how soon the track is expected to play
+    std::vector<metadb_handle_ptr> m_prefetched_tracks; // Tracks that have already been prefetched, oldest first
+    std::vector<metadb_handle_ptr> m_prefetch_misses; // Prefetched tracks for which no lyrics were found
     std::mutex m_handle_mutex;
 
     friend void initiate_lyrics_autosearch(metadb_handle_ptr, metadb_v2_rec_t, bool);
@@ -75,16 +108,6 @@ void LyricAutosearchManager::on_init()
                                                     flag_on_playback_new_track | flag_on_playback_stop
                                                         | flag_on_playback_dynamic_info_track,
                                                     false);
-
-    fb2k::splitTask(
-        [this]()
-        {
-            while(!fb2k::mainAborter().is_aborting())
-            {
-                check_for_available_updates();
-                Sleep(50);
-            }
-        });
 }
 
 void LyricAutosearchManager::on_quit()
@@ -92,8 +115,17 @@ void LyricAutosearchManager::on_quit()
     play_callback_manager::get()->unregister_callback(this);
 }
 
+void LyricAutosearchManager::watch_search_handle(LyricSearchHandle& handle)
+{
+    // NOTE: Searches run in the background and we get notified (on the search thread) whenever one of them
+    //       has a result or completes. We just bounce that over to the main thread, where all results are processed.
+    handle.set_update_callback([this]() { fb2k::inMainThread([this]() { check_for_available_updates(); }); });
+}
+
 void LyricAutosearchManager::check_for_available_updates()
 {
+    core_api::ensure_main_thread();
+
     const auto is_search_complete = [this](const SearchTracker& tracker)
     {
         const std::unique_ptr<LyricSearchHandle>& handle = tracker.handle;
@@ -107,10 +139,26 @@ void LyricAutosearchManager::check_for_available_updates()
                                    handle->get_track(),
                                    handle->get_track_info(),
                                    handle->get_type() };
-            announce_lyric_update(std::move(update));
+            if(tracker.is_prefetch)
+            {
+                // NOTE: Prefetched lyrics are not displayed (the track isn't playing yet), but we process them
+                //       now so that they get saved (if configured to do so). If they aren't saved then the search
+                //       when the track starts will still be fast because the results will be in the search cache.
+                io::process_available_lyric_update(std::move(update));
+            }
+            else
+            {
+                announce_lyric_update(std::move(update));
+            }
+        }
+
+        if(tracker.is_prefetch && didnt_find_anything && !handle->is_aborting())
+        {
+            m_prefetch_misses.push_back(handle->get_track());
         }
 
-        if(didnt_find_anything && (tracker.avoidance_reason != SearchAvoidanceReason::Allowed))
+        if(didnt_find_anything && !tracker.is_prefetch && !handle->is_aborting()
+           && (tracker.avoidance_reason != SearchAvoidanceReason::Allowed))
         {
             announce_lyric_search_avoided(tracker.handle->get_track(), tracker.avoidance_reason);
         }
@@ -120,9 +168,190 @@ void LyricAutosearchManager::check_for_available_updates()
     m_handle_mutex.lock();
     auto new_end = std::remove_if(m_search_handles.begin(), m_search_handles.end(), is_search_complete);
     m_search_handles.erase(new_end, m_search_handles.end());
+    start_pending_search();
+    start_next_prefetch_search();
     m_handle_mutex.unlock();
 }
 
+static std::vector<metadb_handle_ptr> get_upcoming_tracks(size_t max_track_count)
+{
+    core_api::ensure_main_thread();
+    std::vector<metadb_handle_ptr> result;
+    service_ptr_t<playlist_manager> playlist = playlist_manager::get();
+
+    pfc::list_t<t_playback_queue_item> queue;
+    playlist->queue_get_contents(queue);
+    for(size_t i = 0; (i < queue.get_count()) && (result.size() < max_track_count); i++)
+    {
+        result.push_back(queue[i].m_handle);
+    }
+
+    // NOTE: We can only know which playlist item will play next if the playback order is "Default",
+    //       which is always the first playback order.
+    const bool is_default_order = (playlist->playback_order_get_active() == 0);
+    size_t playlist_index = 0;
+    size_t item_index = 0;
+    if(is_default_order && playlist->get_playing_item_location(&playlist_index, &item_index))
+    {
+        const size_t item_count = playlist->playlist_get_item_count(playlist_index);
+        for(size_t i = item_index + 1; (i < item_count) && (result.size() < max_track_count); i++)
+        {
+            result.push_back(playlist->playlist_get_item_handle(playlist_index, i));
+        }
+    }
+
+    return result;
+}
+
+void LyricAutosearchManager::queue_prefetch_searches()
+{
+    core_api::ensure_main_thread();
+    const int prefetch_count = preferences::searching::prefetch_track_count();
+    if(prefetch_count <= 0)
+    {
+        cancel_prefetch_searches();
+        return;
+    }
+
+    std::vector<PendingPrefetch> prefetches;
+    const std::vector<metadb_handle_ptr> upcoming_tracks = get_upcoming_tracks(size_t(prefetch_count));
+    for(const metadb_handle_ptr& track : upcoming_tracks)
+    {
+        // NOTE: We apply the same restrictions here as we do when a track starts playing
+        if(track_is_remote(track) || !track_exists_on_filesystem(track))
+        {
+            continue;
+        }
+
+        metadb_v2_rec_t track_info = get_full_metadata(track);
+        const SearchAvoidanceReason avoid_reason = search_avoidance_allows_search(track, track_info);
+        if(avoid_reason != SearchAvoidanceReason::Allowed)
+        {
+            LOG_INFO("Skipping prefetch for upcoming track: %s", search_avoid_reason_to_string(avoid_reason));
+            continue;
+        }
+        prefetches.push_back({ track, std::move(track_info) });
+    }
+
+    const auto is_upcoming = [&upcoming_tracks](const metadb_handle_ptr& track)
+    { return std::find(upcoming_tracks.begin(), upcoming_tracks.end(), track) != upcoming_tracks.end(); };
+
+    std::lock_guard lock(m_handle_mutex);
+    for(SearchTracker& tracker : m_search_handles)
+    {
+        if(tracker.is_prefetch && !is_upcoming(tracker.handle->get_track()))
+        {
+            tracker.handle->cancel();
+        }
+    }
+
+    m_pending_prefetches.clear();
+    for(PendingPrefetch& prefetch : prefetches)
+    {
+        const bool already_prefetched = (std::find(m_prefetched_tracks.begin(),
+                                                   m_prefetched_tracks.end(),
+                                                   prefetch.track)
+                                         != m_prefetched_tracks.end());
+        if(!already_prefetched)
+        {
+            m_pending_prefetches.push_back(std::move(prefetch));
+        }
+    }
+    start_next_prefetch_search();
+}
+
+void LyricAutosearchManager::cancel_prefetch_searches()
+{
+    std::lock_guard lock(m_handle_mutex);
+    m_pending_prefetches.clear();
+    for(SearchTracker& tracker : m_search_handles)
+    {
+        if(tracker.is_prefetch)
+        {
+            tracker.handle->cancel();
+        }
+    }
+}
+
+// Cancels all autosearches (other than prefetches), because they are for a track that is no longer playing.
+// NOTE: The caller must hold m_handle_mutex
+void LyricAutosearchManager::cancel_searches()
+{
+    m_pending_search.reset();
+    for(SearchTracker& tracker : m_search_handles)
+    {
+        if(!tracker.is_prefetch && !tracker.handle->is_aborting())
+        {
+            LOG_INFO("Cancelling superseded lyric search");
+            tracker.handle->cancel();
+        }
+    }
+}
+
+// NOTE: The caller must hold m_handle_mutex
+void LyricAutosearchManager::start_next_prefetch_search()
+{
+    // Prefetching is a low-priority background task, so we only ever run one prefetch search at a time,
+    // and only when there are no other searches in progress (which would be for the track that is playing now).
+    if(m_pending_prefetches.empty() || !m_search_handles.empty())
+    {
+        return;
+    }
+
+    PendingPrefetch prefetch = std::move(m_pending_prefetches.front());
+    m_pending_prefetches.erase(m_pending_prefetches.begin());
+
+    // NOTE: We only keep a limited record of prefetched tracks, since we only need to prevent duplicate prefetches
+    //       of the tracks that are coming up soon.
+    const size_t max_prefetch_history = 64;
+    m_prefetched_tracks.push_back(prefetch.track);
+    if(m_prefetched_tracks.size() > max_prefetch_history)
+    {
+        m_prefetched_tracks.erase(m_prefetched_tracks.begin());
+    }
+    if(m_prefetch_misses.size() > max_prefetch_history)
+    {
+        m_prefetch_misses.erase(m_prefetch_misses.begin());
+    }
+
+    LOG_INFO("Prefetching lyrics for upcoming track...");
+    auto handle = std::make_unique<LyricSearchHandle>(LyricUpdate::Type::AutoSearch,
+                                                      prefetch.track,
+                                                      std::move(prefetch.track_info),
+                                                      fb2k::mainAborter());
+    watch_search_handle(*handle);
+    const work_scheduler::WorkId work_id = io::search_for_lyrics(*handle, WorkPriority::Prefetch, false, false);
+    m_search_handles.push_back({ std::move(handle), SearchAvoidanceReason::Allowed, true, work_id });
+}
+
+// NOTE: The caller must hold m_handle_mutex
+void LyricAutosearchManager::start_search(PendingAutosearch search)
+{
+    auto handle = std::make_unique<LyricSearchHandle>(LyricUpdate::Type::AutoSearch,
+                                                      search.track,
+                                                      std::move(search.track_info),
+                                                      fb2k::mainAborter());
+    watch_search_handle(*handle);
+    const work_scheduler::WorkId work_id = io::search_for_lyrics(*handle,
+                                                                 WorkPriority::NowPlaying,
+                                                                 search.local_only,
+                                                                 search.ignore_search_avoidance);
+    m_search_handles.push_back({ std::move(handle), search.avoidance_reason, false, work_id });
+}
+
+// NOTE: The caller must hold m_handle_mutex
+void LyricAutosearchManager::start_pending_search()
+{
+    if(!m_pending_search.has_value() || (m_search_handles.size() >= MAX_CONCURRENT_AUTOSEARCHES))
+    {
+        return;
+    }
+
+    PendingAutosearch search = std::move(m_pending_search.value());
+    m_pending_search.reset();
+    start_search(std::move(search));
+}
+
 void LyricAutosearchManager::initiate_search(metadb_handle_ptr track,
                                              metadb_v2_rec_t track_info,
                                              bool ignore_search_avoidance)
@@ -130,7 +359,7 @@ void LyricAutosearchManager::initiate_search(metadb_handle_ptr track,
     const SearchAvoidanceReason avoid_reason = ignore_search_avoidance
                                                    ? SearchAvoidanceReason::Allowed
                                                    : search_avoidance_allows_search(track, track_info);
-    const bool search_local_only = (avoid_reason != SearchAvoidanceReason::Allowed);
+    bool search_local_only = (avoid_reason != SearchAvoidanceReason::Allowed);
     // NOTE: We also track a generation counter that increments every time you change the search config
     //       so that if you don't find lyrics with some active sources and then add more, it'll search
     //       again at least once, possibly finding something if there are new active sources.
@@ -140,14 +369,63 @@ void LyricAutosearchManager::initiate_search(metadb_handle_ptr track,
                  search_avoid_reason_to_string(avoid_reason));
     }
 
-    auto handle = std::make_unique<LyricSearchHandle>(LyricUpdate::Type::AutoSearch,
-                                                      track,
-                                                      track_info,
-                                                      fb2k::mainAborter());
-    io::search_for_lyrics(*handle, search_local_only);
-
     m_handle_mutex.lock();
-    m_search_handles.push_back({ std::move(handle), avoid_reason });
+    m_pending_prefetches.erase(std::remove_if(m_pending_prefetches.begin(),
+                                              m_pending_prefetches.end(),
+                                              [&track](const PendingPrefetch& prefetch)
+                                              { return prefetch.track == track; }),
+                               m_pending_prefetches.end());
+
+    // Whatever we were searching for before is no longer what the user wants to see, so stop spending network
+    // requests (and the processing time to parse their responses) on it.
+    cancel_searches();
+
+    if(!ignore_search_avoidance)
+    {
+        // If we're already prefetching lyrics for this track then just start treating that as the search for
+        // the now-playing track, rather than starting the whole search all over again.
+        for(SearchTracker& tracker : m_search_handles)
+        {
+            if(tracker.is_prefetch && (tracker.handle->get_track() == track) && !tracker.handle->is_aborting())
+            {
+                LOG_INFO("Lyrics for this track are already being prefetched, using the prefetch search result");
+                tracker.is_prefetch = false;
+                tracker.avoidance_reason = avoid_reason;
+
+                // NOTE: Prefetches are the lowest-priority searches, so if this one hasn't started yet then it could
+                //       be waiting behind all sorts of other work. It is now the search for the playing track though.
+                if(work_scheduler::reprioritise(tracker.work_id, WorkPriority::NowPlaying))
+                {
+                    LOG_INFO("Moved the queued prefetch search up to now-playing priority");
+                }
+                m_handle_mutex.unlock();
+                return;
+            }
+        }
+
+        // If we only just prefetched this track and found nothing then there's no point asking the remote sources
+        // again, but we still want to check local sources in case the user has added lyrics in the meantime.
+        const auto prefetch_miss_iter = std::find(m_prefetch_misses.begin(), m_prefetch_misses.end(), track);
+        if(prefetch_miss_iter != m_prefetch_misses.end())
+        {
+            LOG_INFO("Prefetching lyrics for this track recently found nothing, skipping remote sources");
+            m_prefetch_misses.erase(prefetch_miss_iter);
+            search_local_only = true;
+        }
+    }
+
+    PendingAutosearch search
+        = { track, std::move(track_info), avoid_reason, search_local_only, ignore_search_avoidance };
+    if(m_search_handles.size() >= MAX_CONCURRENT_AUTOSEARCHES)
+    {
+        // NOTE: Only the most recent search is kept waiting, any earlier one was superseded by this one
+        LOG_INFO("Waiting for %d earlier searches to stop before searching", int(m_search_handles.size()));
+        m_pending_search = std::move(search);
+    }
+    else
+    {
+        start_search(std::move(search));
+    }
     m_handle_mutex.unlock();
 
     if(IsIconic(core_api::get_main_window()) || (avoid_reason == SearchAvoidanceReason::NoVisiblePanels))
@@ -167,11 +445,16 @@ std::optional<std::string> LyricAutosearchManager::get_progress_message()
     if(has_now_playing)
     {
         std::lock_guard lock(m_handle_mutex);
+        if(m_pending_search.has_value() && (m_pending_search->track == now_playing))
+        {
+            return "Waiting to search...";
+        }
+
         for(const SearchTracker& tracker : m_search_handles)
         {
             assert(tracker.handle != nullptr);
             if((tracker.handle->get_type() == LyricUpdate::Type::AutoSearch)
-               && (tracker.handle->get_track() == now_playing))
+               && (tracker.handle->get_track() == now_playing) && !tracker.handle->is_aborting())
             {
                 return tracker.handle->get_progress();
             }
@@ -205,6 +488,7 @@ void LyricAutosearchManager::on_playback_new_track(metadb_handle_ptr track)
     }
 
     initiate_search(track, get_full_metadata(track), false);
+    queue_prefetch_searches();
 }
 
 void LyricAutosearchManager::on_playback_dynamic_info_track(const file_info& info)
@@ -232,5 +516,9 @@ void LyricAutosearchManager::on_playback_stop(play_control::t_stop_reason reason
     if(reason != play_control::t_stop_reason::stop_reason_starting_another)
     {
         m_last_played_track = nullptr; // Unset this so we do search when the next track is played
+        cancel_prefetch_searches();
+
+        std::lock_guard lock(m_handle_mutex);
+        cancel_searches();
     }
 }
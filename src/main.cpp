@@ -27,6 +27,31 @@ namespace
         // out += "Version " OPENLYRICS_VERSION " (" __DATE__ "):\n"
         // "\n";
         out += "Version " OPENLYRICS_VERSION " (" __DATE__ "):\n"
+               "- Add an option to search all active sources at the same time\n"
+               "- Remember search results from remote sources between sessions\n"
+               "- Temporarily skip remote sources that recently failed to find a track\n"
+               "- Search ahead for lyrics for upcoming tracks in the queue or playlist\n"
+               "- Stop checking for search results in the background when not searching\n"
+               "- Show manual search results as soon as each source finds them\n"
+               "- Share requests to remote sources between identical concurrent searches\n"
+               "- Search for multiple tracks at once in bulk searches\n"
+               "  - Requests to each site are rate-limited\n"
+               "- Adapt request timeouts to how quickly each source responds\n"
+               "- Skip sources that stop responding\n"
+               "- Show how each source has been responding on the search sources page\n"
+               "- Look up several search results from a source at once\n"
+               "- Stop searching for tracks that are skipped before their search finishes\n"
+               "- Prioritise searching for the playing track over other background work\n"
+               "- Reuse connections to metal-archives.com between requests\n"
+               "- Share DNS lookups, TLS sessions and cookies between curl requests\n"
+               "- Stop downloading AZLyrics pages once the lyrics have been found\n"
+               "- Cache responses from remote sources, re-downloading only what changed\n"
+               "- Make all requests to remote sources through one shared HTTP client\n"
+               "- Parse LRC lyrics faster, especially very large or malformed ones\n"
+               "- Open and save long synced lyrics in the editor faster\n"
+               "- Keep the lyric editor responsive while editing long lyrics\n"
+               "- Load local lyrics files faster by keeping compiled copies of them\n"
+               "- Detect the encoding of lyrics that aren't UTF-8 more reliably\n"
                "- Fix auto-search triggering for missing local files\n"
                "\n";
         out += "Version 1.13 (2026-01-17):\n"
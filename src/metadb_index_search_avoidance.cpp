@@ -4,6 +4,7 @@
 
 #include "logging.h"
 #include "lyric_metadb_index_client.h"
+#include "mvtf/mvtf.h"
 #include "preferences.h"
 #include "ui_hooks.h"
 
@@ -20,20 +21,34 @@ enum AvoidanceFlags : uint32_t
     MarkedInstrumental = 1 << 0,
 };
 
+// A record of a single source failing to find lyrics for a track
+struct lyric_source_miss
+{
+    GUID source_id;
+    uint32_t consecutive_misses;
+    t_filetimestamp last_miss_time;
+};
+
 struct lyric_search_avoidance
 {
     // Struct versions:
     // v1: 20 bytes
     // v2: 24 bytes
+    // v3: 32 bytes + 28 bytes per source miss. Prefixed with an explicit version number (since it is variable-size)
     int failed_searches;
     t_filetimestamp first_fail_time;
     uint64_t search_config_generation;
     uint32_t flags; // Added in v2
+    std::vector<lyric_source_miss> source_misses; // Added in v3
 };
 
+// NOTE: This is far more than the number of sources that we have, it's just here to bound the record size.
+static const uint32_t MAX_RECORDED_SOURCE_MISSES = 32;
+static const uint32_t SEARCH_AVOIDANCE_V3 = 3;
+
 static lyric_search_avoidance load_search_avoidance(const metadb_v2_rec_t& track_info)
 {
-    char data_buffer[512] = {};
+    char data_buffer[1024] = {};
 
     auto meta_index = metadb_index_manager::get();
     metadb_index_hash our_index_hash = lyric_metadb_index_client::hash_handle(track_info);
@@ -65,6 +80,32 @@ static lyric_search_avoidance load_search_avoidance(const metadb_v2_rec_t& track
             reader >> result.search_config_generation;
             reader >> result.flags;
         }
+        else
+        {
+            uint32_t version = 0;
+            reader >> version;
+            if(version != SEARCH_AVOIDANCE_V3)
+            {
+                LOG_WARN("Unrecognised search-avoidance info version %u, ignoring...", version);
+                return {};
+            }
+
+            reader >> result.failed_searches;
+            reader >> result.first_fail_time;
+            reader >> result.search_config_generation;
+            reader >> result.flags;
+
+            uint32_t source_miss_count = 0;
+            reader >> source_miss_count;
+            source_miss_count = std::min(source_miss_count, MAX_RECORDED_SOURCE_MISSES);
+            result.source_misses.resize(source_miss_count);
+            for(lyric_source_miss& miss : result.source_misses)
+            {
+                reader >> miss.source_id;
+                reader >> miss.consecutive_misses;
+                reader >> miss.last_miss_time;
+            }
+        }
         return result;
     }
     catch(const std::exception& ex)
@@ -133,11 +174,22 @@ static void save_search_avoidance(const metadb_v2_rec_t& track_info, lyric_searc
     auto meta_index = metadb_index_manager::get();
     metadb_index_hash our_index_hash = lyric_metadb_index_client::hash_handle(track_info);
 
+    const uint32_t source_miss_count = uint32_t(
+        std::min(avoidance.source_misses.size(), size_t(MAX_RECORDED_SOURCE_MISSES)));
+
     stream_writer_formatter_simple<false> writer;
+    writer << SEARCH_AVOIDANCE_V3;
     writer << avoidance.failed_searches;
     writer << avoidance.first_fail_time;
     writer << avoidance.search_config_generation;
     writer << avoidance.flags;
+    writer << source_miss_count;
+    for(uint32_t i = 0; i < source_miss_count; i++)
+    {
+        writer << avoidance.source_misses[i].source_id;
+        writer << avoidance.source_misses[i].consecutive_misses;
+        writer << avoidance.source_misses[i].last_miss_time;
+    }
 
     meta_index->set_user_data(GUID_METADBINDEX_LYRIC_HISTORY,
                               our_index_hash,
@@ -145,13 +197,82 @@ static void save_search_avoidance(const metadb_v2_rec_t& track_info, lyric_searc
                               writer.m_buffer.get_size());
 }
 
-void search_avoidance_log_search_failure(const metadb_v2_rec_t& track_info)
+// Returns the length of time for which we should avoid searching a source after it has missed the given number of
+// times in a row. This doubles with every miss, from 1 day after the first miss up to a maximum of 64 days.
+static t_filetimestamp source_miss_backoff_period(uint32_t consecutive_misses)
+{
+    const uint32_t doublings = std::min(std::max(consecutive_misses, 1u) - 1, 6u);
+    return system_time_periods::day << doublings;
+}
+
+// NOTE: A source that missed might find the track once the source configuration has changed (e.g because the
+//       source's settings were changed), so misses are only relevant to the generation they were recorded in.
+static void record_source_misses(lyric_search_avoidance& avoidance,
+                                 const std::vector<GUID>& missed_sources,
+                                 uint64_t config_generation,
+                                 t_filetimestamp now)
 {
+    if(avoidance.search_config_generation != config_generation)
+    {
+        avoidance.source_misses.clear();
+        avoidance.search_config_generation = config_generation;
+    }
+
+    for(const GUID& source_id : missed_sources)
+    {
+        auto iter = std::find_if(avoidance.source_misses.begin(),
+                                 avoidance.source_misses.end(),
+                                 [&source_id](const lyric_source_miss& miss) { return miss.source_id == source_id; });
+        if(iter == avoidance.source_misses.end())
+        {
+            avoidance.source_misses.push_back({ source_id, 0, 0 });
+            iter = std::prev(avoidance.source_misses.end());
+        }
+
+        if(iter->consecutive_misses < UINT32_MAX)
+        {
+            iter->consecutive_misses++;
+        }
+        iter->last_miss_time = now;
+    }
+}
+
+static std::vector<GUID> sources_to_skip(const lyric_search_avoidance& avoidance,
+                                         uint64_t config_generation,
+                                         t_filetimestamp now)
+{
+    std::vector<GUID> result;
+    if(avoidance.search_config_generation != config_generation)
+    {
+        return result;
+    }
+
+    for(const lyric_source_miss& miss : avoidance.source_misses)
+    {
+        if(now < miss.last_miss_time + source_miss_backoff_period(miss.consecutive_misses))
+        {
+            result.push_back(miss.source_id);
+        }
+    }
+    return result;
+}
+
+std::vector<GUID> search_avoidance_sources_to_skip(const metadb_v2_rec_t& track_info)
+{
+    return sources_to_skip(load_search_avoidance(track_info),
+                           preferences::searching::source_config_generation(),
+                           filetimestamp_from_system_timer());
+}
+
+void search_avoidance_log_search_failure(const metadb_v2_rec_t& track_info, const std::vector<GUID>& missed_sources)
+{
+    const uint64_t config_generation = preferences::searching::source_config_generation();
+    const t_filetimestamp now = filetimestamp_from_system_timer();
     lyric_search_avoidance avoidance = load_search_avoidance(track_info);
-    avoidance.search_config_generation = preferences::searching::source_config_generation();
+    record_source_misses(avoidance, missed_sources, config_generation, now);
     if(avoidance.first_fail_time == 0)
     {
-        avoidance.first_fail_time = filetimestamp_from_system_timer();
+        avoidance.first_fail_time = now;
     }
     if(avoidance.failed_searches < INT_MAX)
     {
@@ -160,6 +281,36 @@ void search_avoidance_log_search_failure(const metadb_v2_rec_t& track_info)
     save_search_avoidance(track_info, avoidance);
 }
 
+void search_avoidance_log_search_success(const metadb_v2_rec_t& track_info,
+                                         const std::vector<GUID>& missed_sources,
+                                         const GUID& found_source)
+{
+    // NOTE: We keep the record of which sources missed, because if the lyrics we found don't get saved then we'll
+    //       search again the next time this track is played and we'd like to skip those sources in that case too.
+    lyric_search_avoidance avoidance = load_search_avoidance(track_info);
+    avoidance.failed_searches = 0;
+    avoidance.first_fail_time = 0;
+    avoidance.flags = 0;
+    avoidance.source_misses.erase(std::remove_if(avoidance.source_misses.begin(),
+                                                 avoidance.source_misses.end(),
+                                                 [&found_source](const lyric_source_miss& miss)
+                                                 { return miss.source_id == found_source; }),
+                                  avoidance.source_misses.end());
+    record_source_misses(avoidance,
+                         missed_sources,
+                         preferences::searching::source_config_generation(),
+                         filetimestamp_from_system_timer());
+
+    if(avoidance.source_misses.empty())
+    {
+        clear_search_avoidance(track_info);
+    }
+    else
+    {
+        save_search_avoidance(track_info, avoidance);
+    }
+}
+
 void search_avoidance_force_by_mark_instrumental(metadb_handle_ptr track, const metadb_v2_rec_t& track_info)
 {
     lyric_search_avoidance avoidance = load_search_avoidance(track_info);
@@ -192,3 +343,52 @@ const char* search_avoid_reason_to_string(SearchAvoidanceReason reason)
         default: return "<Unrecognised reason>";
     }
 }
+
+// ============================================================================
+// Tests
+// ============================================================================
+#if MVTF_TESTS_ENABLED
+// clang-format off: GUIDs should be one line
+static const GUID test_source_a = { 0x5c2e8f41, 0x93d7, 0x4b1a, { 0x8e, 0x06, 0x2f, 0x7d, 0x41, 0xb9, 0xc3, 0x58 } };
+static const GUID test_source_b = { 0xa71f3d0e, 0x6b28, 0x4c95, { 0x9d, 0x3a, 0x50, 0xe4, 0x17, 0x8c, 0x2b, 0xf6 } };
+// clang-format on
+
+MVTF_TEST(searchavoidance_source_backoff_doubles_with_each_miss_up_to_a_limit)
+{
+    CHECK(source_miss_backoff_period(0) == system_time_periods::day);
+    CHECK(source_miss_backoff_period(1) == system_time_periods::day);
+    CHECK(source_miss_backoff_period(2) == 2 * system_time_periods::day);
+    CHECK(source_miss_backoff_period(3) == 4 * system_time_periods::day);
+    CHECK(source_miss_backoff_period(7) == 64 * system_time_periods::day);
+    CHECK(source_miss_backoff_period(8) == 64 * system_time_periods::day);
+    CHECK(source_miss_backoff_period(UINT32_MAX) == 64 * system_time_periods::day);
+}
+
+MVTF_TEST(searchavoidance_sources_are_skipped_until_their_backoff_period_expires)
+{
+    const t_filetimestamp now = 1000 * system_time_periods::day;
+
+    lyric_search_avoidance avoidance = {};
+    record_source_misses(avoidance, { test_source_a, test_source_b }, 1, now);
+    record_source_misses(avoidance, { test_source_b }, 1, now);
+
+    const std::vector<GUID> both_sources = { test_source_a, test_source_b };
+    CHECK(sources_to_skip(avoidance, 1, now + system_time_periods::hour) == both_sources);
+    CHECK(sources_to_skip(avoidance, 1, now + system_time_periods::day + 1) == std::vector<GUID> { test_source_b });
+    CHECK(sources_to_skip(avoidance, 1, now + 2 * system_time_periods::day + 1).empty());
+}
+
+MVTF_TEST(searchavoidance_source_misses_from_a_different_config_generation_are_ignored)
+{
+    const t_filetimestamp now = 1000 * system_time_periods::day;
+
+    lyric_search_avoidance avoidance = {};
+    record_source_misses(avoidance, { test_source_a }, 1, now);
+    CHECK(sources_to_skip(avoidance, 2, now).empty());
+
+    // Misses recorded in the new generation replace those from the old one
+    record_source_misses(avoidance, { test_source_b }, 2, now);
+    CHECK(avoidance.search_config_generation == 2);
+    CHECK(sources_to_skip(avoidance, 2, now) == std::vector<GUID> { test_source_b });
+}
+#endif
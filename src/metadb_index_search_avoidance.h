@@ -12,9 +12,16 @@ enum class SearchAvoidanceReason
 };
 
 SearchAvoidanceReason search_avoidance_allows_search(metadb_handle_ptr track, const metadb_v2_rec_t& track_info);
-void search_avoidance_log_search_failure(const metadb_v2_rec_t& track_info);
+void search_avoidance_log_search_failure(const metadb_v2_rec_t& track_info, const std::vector<GUID>& missed_sources);
+void search_avoidance_log_search_success(const metadb_v2_rec_t& track_info,
+                                         const std::vector<GUID>& missed_sources,
+                                         const GUID& found_source);
 void clear_search_avoidance(const metadb_v2_rec_t& track_info);
 
+// Returns the IDs of sources that have recently failed to find lyrics for the given track, and which should
+// therefore not be searched again (yet). The period for which a source is skipped grows with each failure.
+std::vector<GUID> search_avoidance_sources_to_skip(const metadb_v2_rec_t& track_info);
+
 void search_avoidance_force_by_mark_instrumental(metadb_handle_ptr track, const metadb_v2_rec_t& track_info);
 
 const char* search_avoid_reason_to_string(SearchAvoidanceReason reason);
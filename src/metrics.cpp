@@ -17,6 +17,7 @@
 #endif
 
 #include "hash_utils.h"
+#include "http.h"
 #include "logging.h"
 #include "metrics.h"
 #include "sources/lyric_source.h"
@@ -395,23 +396,19 @@ void submit_metrics(std::string metrics)
     // previous (shutting down) instance will still be running.
     abort_callback& abort = async_task_manager::get()->get_aborter();
 
-    http_request_post_v2::ptr request;
-    http_request::ptr request_generic = http_client::get()->create_request("POST");
-    bool cast_success = request_generic->cast(request);
-    assert(cast_success);
+    const std::string metrics_ingest_url = "https://degwclvqbs7p6e24szelk7uxui0jhsxo.lambda-url.eu-west-2.on.aws/";
+    LOG_INFO("Submitting metrics to %s...", metrics_ingest_url.c_str());
 
-    const char* metrics_ingest_url = "https://degwclvqbs7p6e24szelk7uxui0jhsxo.lambda-url.eu-west-2.on.aws/";
-    LOG_INFO("Submitting metrics to %s...", metrics_ingest_url);
-
-    try
+    http::RequestOptions options = {};
+    options.headers.push_back("Content-Type: application/json");
+    const http::Result response = http::post(metrics_ingest_url, metrics, abort, options);
+    if(response.is_success())
     {
-        request->set_post_data(metrics.c_str(), metrics.length(), "application/json");
-        request->run(metrics_ingest_url, abort);
-        LOG_INFO("Successfully submitted metrics to %s", metrics_ingest_url);
+        LOG_INFO("Successfully submitted metrics to %s", metrics_ingest_url.c_str());
     }
-    catch(const std::exception& e)
+    else
     {
-        LOG_WARN("Failed to submit metrics to %s: %s", metrics_ingest_url, e.what());
+        LOG_WARN("Failed to submit metrics to %s: %s", metrics_ingest_url.c_str(), response.error_message.c_str());
     }
 }
 
@@ -0,0 +1,153 @@
+#include "stdafx.h"
+
+#include "lyric_data.h"
+#include "mvtf/mvtf.h"
+#include "openlyrics_algorithms.h"
+#include "test_util.h"
+#include "win32_util.h"
+
+// ============================================================================
+// Tests
+// ============================================================================
+#if MVTF_TESTS_ENABLED
+// Counts how many times values are copied, so that we can check that an algorithm only ever moves values around.
+// Copying a line of lyrics means allocating a copy of its text, so this is also a count of avoidable allocations.
+struct CopyCountingValue
+{
+    int value;
+    int* copy_count;
+
+    CopyCountingValue(int in_value, int* in_copy_count)
+        : value(in_value)
+        , copy_count(in_copy_count)
+    {
+    }
+    CopyCountingValue(const CopyCountingValue& other)
+        : value(other.value)
+        , copy_count(other.copy_count)
+    {
+        (*copy_count)++;
+    }
+    CopyCountingValue(CopyCountingValue&& other) = default;
+
+    CopyCountingValue& operator=(const CopyCountingValue& other)
+    {
+        value = other.value;
+        copy_count = other.copy_count;
+        (*copy_count)++;
+        return *this;
+    }
+    CopyCountingValue& operator=(CopyCountingValue&& other) = default;
+};
+
+static std::vector<LyricDataLine> make_lyric_lines(int line_count, int distinct_line_count)
+{
+    std::vector<LyricDataLine> result;
+    result.reserve(size_t(line_count));
+    for(int i = 0; i < line_count; i++)
+    {
+        const std::string text = "This is one of the lines of lyrics, number "
+                                 + std::to_string(i % distinct_line_count);
+        result.push_back({ to_tstring(text), double(i / 4) });
+    }
+    return result;
+}
+
+MVTF_TEST(alg_collapse_in_place_merges_contiguous_values_without_copying_any)
+{
+    int copy_count = 0;
+    std::vector<CopyCountingValue> values;
+    for(int value : { 1, 1, 2, 3, 3, 3, 1 })
+    {
+        values.emplace_back(value, &copy_count);
+    }
+
+    const auto merge_equal = [](CopyCountingValue& into, CopyCountingValue& value)
+    {
+        if((into.value % 10) != value.value)
+        {
+            return false;
+        }
+        into.value = (into.value * 10) + value.value;
+        return true;
+    };
+    values.erase(alg::collapse_in_place(values.begin(), values.end(), merge_equal), values.end());
+
+    ASSERT(copy_count == 0);
+    ASSERT(values.size() == 4);
+    ASSERT(values[0].value == 11);
+    ASSERT(values[1].value == 2);
+    ASSERT(values[2].value == 333);
+    ASSERT(values[3].value == 1);
+}
+
+MVTF_TEST(alg_collapse_in_place_handles_empty_and_single_value_sequences)
+{
+    const auto merge_all = [](int& into, int& value)
+    {
+        into += value;
+        return true;
+    };
+
+    std::vector<int> empty;
+    ASSERT(alg::collapse_in_place(empty.begin(), empty.end(), merge_all) == empty.end());
+
+    std::vector<int> single = { 5 };
+    ASSERT(alg::collapse_in_place(single.begin(), single.end(), merge_all) == single.end());
+    ASSERT(single[0] == 5);
+}
+
+// Compares collapsing in-place against collapsing by copying, by merging concurrent lines in a typical number of
+// lines of lyrics (but many times over, so that there's enough work to time accurately).
+// This only runs if OPENLYRICS_LRC_BENCHMARK is set.
+MVTF_TEST(alg_benchmark_collapse_in_place_on_lyric_lines)
+{
+    if(GetEnvironmentVariableA("OPENLYRICS_LRC_BENCHMARK", nullptr, 0) == 0)
+    {
+        return;
+    }
+
+    const int iterations = 100;
+    const std::vector<LyricDataLine> input = make_lyric_lines(5000, 50);
+    const double collapse_ms = measure_average_ms(
+        iterations,
+        [&input]()
+        {
+            const auto merge = [](const LyricDataLine& lhs, const LyricDataLine& rhs)
+            {
+                if((lhs.timestamp == DBL_MAX) || (lhs.timestamp != rhs.timestamp))
+                {
+                    return std::pair { lhs, std::optional { rhs } };
+                }
+
+                LyricDataLine combined = { lhs.text + _T('\n') + rhs.text, lhs.timestamp };
+                return std::pair { combined, std::optional<LyricDataLine> {} };
+            };
+            const std::vector<LyricDataLine> result = alg::collapse(input, merge);
+            return result.size();
+        });
+    const double collapse_in_place_ms = measure_average_ms(
+        iterations,
+        [&input]()
+        {
+            std::vector<LyricDataLine> lines = input; // The copying version gets a copy of its input too
+            const auto merge = [](LyricDataLine& into, LyricDataLine& line)
+            {
+                if((into.timestamp == DBL_MAX) || (into.timestamp != line.timestamp))
+                {
+                    return false;
+                }
+                into.text += _T('\n');
+                into.text += line.text;
+                return true;
+            };
+            lines.erase(alg::collapse_in_place(lines.begin(), lines.end(), merge), lines.end());
+            return lines.size();
+        });
+
+    printf("Collapsing %zu lines: %.3fms copying, %.3fms in-place\n",
+           input.size(),
+           collapse_ms,
+           collapse_in_place_ms);
+}
+#endif
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <optional>
 #include <vector>
 
@@ -40,6 +41,31 @@ namespace alg
         return result;
     }
 
+    // Collapses contiguous values in-place, in the same way as `collapse` but without copying any of them.
+    // The operation takes two consecutive values from the sequence and either merges the second into the first
+    // (modifying the first in-place) and returns true, or leaves them both untouched and returns false.
+    // Returns the new end of the sequence. Values after the new end are left in a valid but unspecified state and
+    // should be erased, much like with `std::remove_if`.
+    template<typename TIter, typename TOperation>
+    TIter collapse_in_place(TIter begin, TIter end, TOperation try_merge)
+    {
+        if(begin == end) return end;
+
+        TIter last = begin;
+        for(TIter iter = std::next(begin); iter != end; iter++)
+        {
+            if(!try_merge(*last, *iter))
+            {
+                last++;
+                if(last != iter)
+                {
+                    *last = std::move(*iter);
+                }
+            }
+        }
+        return std::next(last);
+    }
+
     // Extends a vector with indices of the values it contains, much like python's `enumerate()`
     // Returns a vector of pairs, each containing first the index of the value and then the value itself
     template<typename TVal>
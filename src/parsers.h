@@ -19,6 +19,22 @@ namespace parsers
 
         LyricData parse(const LyricDataCommon& metadata, std::string_view text_utf8);
 
+        // A single line of LRC text, parsed without reference to any of the lines around it
+        struct ParsedLine
+        {
+            std::vector<double> timestamps; // Empty if the line does not start with any timestamps
+            std::tstring text; // The text after the timestamps (or the whole line, if it has no timestamps)
+            std::string tag; // The whole line, if it has no timestamps and would be a tag in the tag section
+            std::optional<double> offset; // The offset given by the line, if it would be an offset tag
+            bool is_blank; // True if the line contains nothing at all
+        };
+        ParsedLine parse_line(std::string_view line_utf8);
+
+        // Combines individually-parsed lines (in their original order) into lyrics. This gives the same result as
+        // passing the text of all of those lines to `parse` at once.
+        LyricData combine_lines(const LyricDataCommon& metadata, const std::vector<ParsedLine>& lines);
+        double get_timestamp_offset(const std::vector<ParsedLine>& lines);
+
         std::tstring expand_text(const LyricData& data, bool merge_equivalent_lrc_lines);
     } // namespace lrc
 
@@ -1,11 +1,18 @@
 #include "stdafx.h"
 
+#include <unordered_map>
+#if defined(_M_X64) || defined(_M_IX86)
+#include <emmintrin.h>
+#include <intrin.h>
+#endif
+
 #include "logging.h"
 #include "lyric_data.h"
 #include "mvtf/mvtf.h"
 #include "openlyrics_algorithms.h"
 #include "parsers.h"
 #include "tag_util.h"
+#include "test_util.h"
 #include "win32_util.h"
 
 static bool equals_ignore_case(std::string_view lhs, std::string_view rhs)
@@ -134,60 +141,71 @@ double parsers::lrc::get_line_first_timestamp(std::string_view line)
     return timestamp;
 }
 
-struct ParsedLineContents
-{
-    std::vector<double> timestamps;
-    std::string line;
-};
-
-struct LineTimeParseResult
-{
-    bool success;
-    double timestamp;
-    size_t charsConsumed;
-};
+// Long enough for any timestamp that we print, the longest of which look like "[hh:mm:ss.cc]"
+// (although the hours can have more than two digits for absurdly long tracks)
+static const size_t MAX_TIMESTAMP_LENGTH = 32;
 
-std::string parsers::lrc::print_timestamp(double timestamp)
+// Writes the given timestamp to the output in LRC format, without going through the overhead of snprintf.
+// Returns the number of characters written.
+template<typename TChar>
+static size_t format_timestamp(double timestamp, TChar (&output)[MAX_TIMESTAMP_LENGTH])
 {
     assert(timestamp != DBL_MAX);
-    double total_seconds_flt = std::floor(timestamp);
-    int total_seconds = static_cast<int>(total_seconds_flt);
-    int time_hours = total_seconds / 3600;
-    int time_minutes = (total_seconds - 3600 * time_hours) / 60;
-    int time_seconds = total_seconds - (time_hours * 3600) - (time_minutes * 60);
-    int time_centisec = static_cast<int>(std::round((timestamp - total_seconds_flt) * 100.0));
+    timestamp = std::max(timestamp, 0.0); // Negative timestamps cannot be represented in LRC
+
+    // NOTE: We round to the nearest centisecond, which might round us up to 100 centiseconds, which visually
+    //       should actually be just "the next second". We handle this by counting the total number of centiseconds
+    //       first, so that it carries over into the seconds (and minutes, and hours). In theory we could just
+    //       round down instead and be done but that would cause timestamp parsing and printing to not roundtrip
+    //       cleanly (at least not with the rest of this implementation as it is today).
+    const double total_seconds_flt = std::floor(timestamp);
+    const int64_t total_centisec = static_cast<int64_t>(total_seconds_flt) * 100
+                                   + static_cast<int64_t>(std::round((timestamp - total_seconds_flt) * 100.0));
+    const int64_t time_hours = total_centisec / (3600 * 100);
+    const int time_minutes = static_cast<int>((total_centisec / (60 * 100)) % 60);
+    const int time_seconds = static_cast<int>((total_centisec / 100) % 60);
+    const int time_centisec = static_cast<int>(total_centisec % 100);
+
+    size_t length = 0;
+    const auto write_two_digits = [&output, &length](int value)
+    {
+        output[length++] = static_cast<TChar>('0' + (value / 10));
+        output[length++] = static_cast<TChar>('0' + (value % 10));
+    };
 
-    // NOTE: We need this special case here because the `std::round` call above might round us up
-    //       and give us 100 centiseconds, which visually should actually be just "the next second".
-    //       In theory we could just replace the `round` with a `floor` and be done but that would
-    //       cause timestamp parsing and printing to not roundtrip cleanly (at least not with the
-    //       rest of this implementation as it is today).
-    if(time_centisec == 100)
+    output[length++] = static_cast<TChar>('[');
+    if(time_hours != 0)
     {
-        time_centisec = 0;
-        time_seconds++;
-        if(time_seconds == 60)
+        TChar hour_digits[20] = {};
+        size_t hour_digit_count = 0;
+        for(int64_t remaining_hours = time_hours; remaining_hours != 0; remaining_hours /= 10)
         {
-            time_seconds = 0;
-            time_minutes++;
-            if(time_minutes == 60)
-            {
-                time_minutes = 0;
-                time_hours++;
-            }
+            hour_digits[hour_digit_count++] = static_cast<TChar>('0' + (remaining_hours % 10));
+        }
+        if(hour_digit_count == 1)
+        {
+            output[length++] = static_cast<TChar>('0');
+        }
+        while(hour_digit_count > 0)
+        {
+            output[length++] = hour_digits[--hour_digit_count];
         }
+        output[length++] = static_cast<TChar>(':');
     }
+    write_two_digits(time_minutes);
+    output[length++] = static_cast<TChar>(':');
+    write_two_digits(time_seconds);
+    output[length++] = static_cast<TChar>('.');
+    write_two_digits(time_centisec);
+    output[length++] = static_cast<TChar>(']');
+    return length;
+}
 
-    char temp[32];
-    if(time_hours == 0)
-    {
-        snprintf(temp, sizeof(temp), "[%02d:%02d.%02d]", time_minutes, time_seconds, time_centisec);
-    }
-    else
-    {
-        snprintf(temp, sizeof(temp), "[%02d:%02d:%02d.%02d]", time_hours, time_minutes, time_seconds, time_centisec);
-    }
-    return std::string(temp);
+std::string parsers::lrc::print_timestamp(double timestamp)
+{
+    char output[MAX_TIMESTAMP_LENGTH];
+    const size_t length = format_timestamp(timestamp, output);
+    return std::string(output, length);
 }
 
 bool parsers::lrc::try_parse_timestamp(std::string_view tag, double& out_timestamp)
@@ -250,6 +268,505 @@ bool parsers::lrc::try_parse_timestamp(std::string_view tag, double& out_timesta
     return true;
 }
 
+// Returns the index of the first character at or after `start` that ends a line ('\r', '\n' or '\0'),
+// or the length of the text if there is no such character.
+static size_t find_line_end(std::string_view text, size_t start)
+{
+    size_t index = start;
+#if defined(_M_X64) || defined(_M_IX86)
+    // NOTE: Most lines are short, but we sometimes get given huge amounts of text with no line endings at all
+    //       (e.g a page of HTML that came back from a source instead of lyrics), so check 16 bytes at a time.
+    const __m128i carriage_return = _mm_set1_epi8('\r');
+    const __m128i line_feed = _mm_set1_epi8('\n');
+    const __m128i null = _mm_setzero_si128();
+    while(index + sizeof(__m128i) <= text.length())
+    {
+        const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text.data() + index));
+        const __m128i line_ends = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, carriage_return),
+                                                            _mm_cmpeq_epi8(chunk, line_feed)),
+                                               _mm_cmpeq_epi8(chunk, null));
+        const int line_end_mask = _mm_movemask_epi8(line_ends);
+        if(line_end_mask != 0)
+        {
+            unsigned long first_line_end = 0;
+            _BitScanForward(&first_line_end, static_cast<unsigned long>(line_end_mask));
+            return index + first_line_end;
+        }
+        index += sizeof(__m128i);
+    }
+#endif
+
+    while((index < text.length()) && (text[index] != '\0') && (text[index] != '\n') && (text[index] != '\r'))
+    {
+        index++;
+    }
+    return index;
+}
+
+// Appends the given UTF-8 text to the end of the output and returns the number of characters that were appended.
+// Text that is not valid UTF-8 is dropped, just as it would be by `to_tstring`.
+static size_t append_utf8(std::tstring& output, std::string_view text_utf8)
+{
+    if(text_utf8.empty())
+    {
+        return 0;
+    }
+
+#ifdef UNICODE
+    // NOTE: UTF-8 text never needs more UTF-16 code units than it has bytes, so we can convert straight into the
+    //       output without first asking how much space we need.
+    assert(text_utf8.length() <= INT_MAX);
+    const size_t output_length = output.length();
+    output.resize(output_length + text_utf8.length());
+    const int chars_written = MultiByteToWideChar(CP_UTF8,
+                                                  MB_ERR_INVALID_CHARS,
+                                                  text_utf8.data(),
+                                                  int(text_utf8.length()),
+                                                  output.data() + output_length,
+                                                  int(text_utf8.length()));
+    const size_t chars_appended = size_t(std::max(chars_written, 0));
+    output.resize(output_length + chars_appended);
+    return chars_appended;
+#else // UNICODE
+    output += text_utf8;
+    return text_utf8.length();
+#endif // UNICODE
+}
+
+// Returns the given line without the byte-order mark at the start of it, if it has one.
+// NOTE: We're consuming UTF-8 text here and sometimes files contain byte-order marks.
+//       We don't want to process them so just skip past them. Ordinarily we'd do this
+//       just once at the start of the file but I've seen files with BOMs at the start
+//       of random lines in the file, so just check every line.
+static std::string_view skip_byte_order_mark(std::string_view line)
+{
+    if((line.length() >= 3) && (line[0] == '\u00EF') && (line[1] == '\u00BB') && (line[2] == '\u00BF'))
+    {
+        return line.substr(3);
+    }
+    return line;
+}
+
+// Calls `on_timestamp` with each of the timestamps at the start of the line, stopping at the first tag that isn't a
+// timestamp. Returns the index of the first character after the timestamps.
+template<typename TCallback>
+static size_t parse_leading_timestamps(std::string_view line, TCallback on_timestamp)
+{
+    size_t text_start_index = 0;
+    while((text_start_index < line.length()) && (line[text_start_index] == '['))
+    {
+        const size_t close_index = line.find(']', text_start_index);
+        if(close_index == std::string_view::npos)
+        {
+            break;
+        }
+
+        double timestamp = 0.0;
+        const std::string_view tag = line.substr(text_start_index, close_index - text_start_index + 1);
+        if(!parsers::lrc::try_parse_timestamp(tag, timestamp))
+        {
+            break;
+        }
+        on_timestamp(timestamp);
+        text_start_index = close_index + 1;
+    }
+    return text_start_index;
+}
+
+// Lines with identical timestamps get merged into a single line, with their text separated by newlines
+static bool merge_concurrent_lines(LyricDataLine& into, LyricDataLine& line)
+{
+    if((into.timestamp == DBL_MAX) || (into.timestamp != line.timestamp))
+    {
+        return false;
+    }
+
+    into.text += _T('\n');
+    into.text += line.text;
+    return true;
+}
+
+// One of the timestamps of a line of lyrics, along with the location of that line's text in the parser's arena
+struct TimestampedText
+{
+    double timestamp;
+    size_t text_offset;
+    size_t text_length;
+};
+
+LyricData parsers::lrc::parse(const LyricDataCommon& metadata, std::string_view text) // `text` is assumed to be utf-8
+{
+    LOG_INFO("Parsing LRC lyric text...");
+
+    // NOTE: We make a single pass over the input, converting the text of each line (without its timestamps) into
+    //       one shared arena and recording each timestamp along with where its line's text is in that arena.
+    //       Each line is only copied out of the arena into a string of its own once we know the final line order.
+    std::tstring arena;
+    arena.reserve(text.length());
+    std::vector<TimestampedText> timestamped_text;
+    std::vector<std::string> tags;
+    bool tag_section_passed = false; // We only want to count lines as "tags" if they appear at the top of the file
+    double timestamp_offset = 0.0;
+
+    size_t line_start_index = 0;
+    while(line_start_index < text.length())
+    {
+        const size_t line_end_index = find_line_end(text, line_start_index);
+        const std::string_view line_view = skip_byte_order_mark(
+            text.substr(line_start_index, line_end_index - line_start_index));
+
+        // Consume all of the timestamps at the start of the line, stopping at the first tag that isn't a timestamp
+        const size_t first_timestamp_index = timestamped_text.size();
+        const size_t text_start_index = parse_leading_timestamps(
+            line_view,
+            [&timestamped_text](double timestamp) { timestamped_text.push_back({ timestamp, 0, 0 }); });
+
+        if(timestamped_text.size() > first_timestamp_index)
+        {
+            tag_section_passed = true;
+            const size_t text_offset = arena.length();
+            const size_t text_length = append_utf8(arena, line_view.substr(text_start_index));
+            for(size_t i = first_timestamp_index; i < timestamped_text.size(); i++)
+            {
+                timestamped_text[i].text_offset = text_offset;
+                timestamped_text[i].text_length = text_length;
+            }
+        }
+        else
+        {
+            // We don't have a timestamp, but rather than failing to parse the entire file,
+            // we just keep the line around as "not having a timestamp". We represent this
+            // as a line with a timestamp that is way out of the actual length of the track.
+            // That way the line will never be highlighted and it neatly slots into the rest
+            // of the system without special handling.
+            // NOTE: It is important however, to note that this means we need to stable_sort
+            //       below, to preserve the ordering of the "untimed" lines
+            if(!tag_section_passed && is_tag_line(line_view))
+            {
+                tags.emplace_back(line_view);
+
+                std::optional<double> maybe_offset = try_parse_offset_tag(line_view);
+                if(maybe_offset.has_value())
+                {
+                    timestamp_offset = maybe_offset.value();
+                    LOG_INFO("Found LRC offset: %dms", int(timestamp_offset * 1000.0));
+                }
+            }
+            else
+            {
+                tag_section_passed |= !line_view.empty();
+                const size_t text_offset = arena.length();
+                const size_t text_length = append_utf8(arena, line_view);
+                timestamped_text.push_back({ DBL_MAX, text_offset, text_length });
+            }
+        }
+
+        if((line_end_index + 1 < text.length()) && (text[line_end_index] == '\r') && (text[line_end_index + 1] == '\n'))
+        {
+            line_start_index = line_end_index + 2;
+        }
+        else
+        {
+            line_start_index = line_end_index + 1;
+        }
+    }
+
+    // NOTE: Most lyrics are already in timestamp order, in which case we can skip sorting them entirely
+    const auto timestamp_order = [](const TimestampedText& lhs, const TimestampedText& rhs)
+    { return lhs.timestamp < rhs.timestamp; };
+    if(!std::is_sorted(timestamped_text.begin(), timestamped_text.end(), timestamp_order))
+    {
+        std::stable_sort(timestamped_text.begin(), timestamped_text.end(), timestamp_order);
+    }
+
+    std::vector<LyricDataLine> lines;
+    lines.reserve(timestamped_text.size());
+    for(const TimestampedText& item : timestamped_text)
+    {
+        lines.push_back({ std::tstring(arena.data() + item.text_offset, item.text_length), item.timestamp });
+    }
+
+    lines.erase(alg::collapse_in_place(lines.begin(), lines.end(), merge_concurrent_lines), lines.end());
+
+    LyricData result(metadata);
+    result.tags = std::move(tags);
+    result.lines = std::move(lines);
+    result.timestamp_offset = timestamp_offset;
+    return result;
+}
+
+parsers::lrc::ParsedLine parsers::lrc::parse_line(std::string_view line_utf8)
+{
+    const std::string_view line_view = skip_byte_order_mark(line_utf8);
+
+    ParsedLine result = {};
+    const size_t text_start_index = parse_leading_timestamps(line_view,
+                                                             [&result](double timestamp)
+                                                             { result.timestamps.push_back(timestamp); });
+    append_utf8(result.text, line_view.substr(text_start_index));
+    if(result.timestamps.empty() && is_tag_line(line_view))
+    {
+        result.tag = line_view;
+        result.offset = try_parse_offset_tag(line_view);
+    }
+    result.is_blank = line_view.empty();
+    return result;
+}
+
+LyricData parsers::lrc::combine_lines(const LyricDataCommon& metadata, const std::vector<ParsedLine>& parsed_lines)
+{
+    // NOTE: This must give exactly the same result as `parse` would, given the same lines all at once
+    std::vector<LyricDataLine> lines;
+    lines.reserve(parsed_lines.size());
+    std::vector<std::string> tags;
+    bool tag_section_passed = false;
+    double timestamp_offset = 0.0;
+    for(const ParsedLine& line : parsed_lines)
+    {
+        if(!line.timestamps.empty())
+        {
+            tag_section_passed = true;
+            for(double timestamp : line.timestamps)
+            {
+                lines.push_back({ line.text, timestamp });
+            }
+        }
+        else if(!tag_section_passed && !line.tag.empty())
+        {
+            tags.push_back(line.tag);
+            timestamp_offset = line.offset.value_or(timestamp_offset);
+        }
+        else
+        {
+            tag_section_passed |= !line.is_blank;
+            lines.push_back({ line.text, DBL_MAX });
+        }
+    }
+
+    const auto timestamp_order = [](const LyricDataLine& lhs, const LyricDataLine& rhs)
+    { return lhs.timestamp < rhs.timestamp; };
+    if(!std::is_sorted(lines.begin(), lines.end(), timestamp_order))
+    {
+        std::stable_sort(lines.begin(), lines.end(), timestamp_order);
+    }
+    lines.erase(alg::collapse_in_place(lines.begin(), lines.end(), merge_concurrent_lines), lines.end());
+
+    LyricData result(metadata);
+    result.tags = std::move(tags);
+    result.lines = std::move(lines);
+    result.timestamp_offset = timestamp_offset;
+    return result;
+}
+
+double parsers::lrc::get_timestamp_offset(const std::vector<ParsedLine>& parsed_lines)
+{
+    // NOTE: Only the tag section at the top of the lyrics can contain an offset tag, so we can stop as soon as we
+    //       reach the first line that isn't in it (which is almost always within the first few lines).
+    double timestamp_offset = 0.0;
+    for(const ParsedLine& line : parsed_lines)
+    {
+        if(!line.timestamps.empty() || (line.tag.empty() && !line.is_blank))
+        {
+            break;
+        }
+        timestamp_offset = line.offset.value_or(timestamp_offset);
+    }
+    return timestamp_offset;
+}
+
+// Appends the tags to the output, separated from the lyrics that follow them by a blank line
+static void append_tags(std::tstring& output, const std::vector<std::string>& tags)
+{
+    for(const std::string& tag : tags)
+    {
+        append_utf8(output, tag);
+        output += _T("\r\n");
+    }
+    if(!tags.empty())
+    {
+        output += _T("\r\n");
+    }
+    // NOTE: We specifically do *not* generate a new tag for the offset because all changes to that
+    //       must happen *in the text* (which is the default because you can change it in the editor)
+}
+
+// Returns the number of characters needed for the given tags (and the blank line after them), or slightly more.
+// UTF-8 text never needs more UTF-16 code units than it has bytes, so each tag needs at most as many characters as
+// it has bytes.
+static size_t get_max_tags_length(const std::vector<std::string>& tags)
+{
+    size_t result = 2;
+    for(const std::string& tag : tags)
+    {
+        result += tag.length() + 2;
+    }
+    return result;
+}
+
+// A single line of expanded text. This might be just one part of a line that was merged with others during parsing.
+struct ExpandedLine
+{
+    static constexpr size_t NO_LINE = SIZE_MAX;
+
+    std::tstring_view text;
+    double timestamp;
+
+    // The lines that have been merged into this one (because they have the same text) form a linked list, in order
+    bool is_merged;
+    size_t first_merged;
+    size_t last_merged;
+    size_t next_merged;
+};
+
+std::tstring parsers::lrc::expand_text(const LyricData& data, bool merge_equivalent_lrc_lines)
+{
+    LOG_INFO("Expanding lyric text...");
+
+    // NOTE: We work out how long the text will be before writing any of it, so that it is only ever written once
+    std::tstring expanded_text;
+    if(!data.IsTimestamped())
+    {
+        size_t max_length = get_max_tags_length(data.tags);
+        for(const LyricDataLine& line : data.lines)
+        {
+            max_length += std::max(line.text.length(), size_t(1)) + 2;
+        }
+        expanded_text.reserve(max_length);
+        append_tags(expanded_text, data.tags);
+
+        for(const LyricDataLine& line : data.lines)
+        {
+            assert(line.timestamp == DBL_MAX);
+            if(line.text.empty())
+            {
+                // NOTE: In the lyric editor, we auto-select the next line after synchronising the current one.
+                //       If the new-selected line has no timestamp and is empty then visually there will be no
+                //       selection, which is a little confusing. To avoid this we add a space to such lines when
+                //       loading the lyrics, which will be removed when we shrink the text for saving.
+                expanded_text += _T(" ");
+            }
+            else
+            {
+                expanded_text += line.text;
+            }
+            expanded_text += _T("\r\n");
+        }
+        return expanded_text;
+    }
+
+    // Split lines with the same timestamp
+    std::vector<ExpandedLine> out_lines;
+    out_lines.reserve(data.lines.size());
+    for(const LyricDataLine& in_line : data.lines)
+    {
+        // NOTE: Ordinarily a single line is just a single line and contains no newlines.
+        //       However if two lines in an lrc file have identical timestamps, then we merge them
+        //       during parsing. In that case we need to split them out again here.
+        const std::tstring_view in_text = in_line.text;
+        size_t start_index = 0;
+        while(start_index <= in_text.length()) // This is specifically less-or-equal so that empty lines do
+                                               // not get ignored and show up in the editor
+        {
+            const size_t end_index = std::min(in_text.length(), in_text.find(_T('\n'), start_index));
+            out_lines.push_back({ in_text.substr(start_index, end_index - start_index),
+                                  in_line.timestamp,
+                                  false,
+                                  ExpandedLine::NO_LINE,
+                                  ExpandedLine::NO_LINE,
+                                  ExpandedLine::NO_LINE });
+            start_index = end_index + 1;
+        }
+    }
+
+    if(merge_equivalent_lrc_lines)
+    {
+        // Each line is merged into the first line with the same text (which is then printed with the timestamps of
+        // all of the lines merged into it), except that a line with no timestamp is never merged into another line.
+        // Instead it takes the place of the first line for all of the lines with the same text that come after it.
+        std::unordered_map<std::tstring_view, size_t> first_line_with_text;
+        first_line_with_text.reserve(out_lines.size());
+        for(size_t i = 0; i < out_lines.size(); i++)
+        {
+            ExpandedLine& line = out_lines[i];
+            const auto [first_line_iter, is_first] = first_line_with_text.try_emplace(line.text, i);
+            if(is_first)
+            {
+                continue;
+            }
+            if(line.timestamp == DBL_MAX)
+            {
+                first_line_iter->second = i;
+                continue;
+            }
+
+            ExpandedLine& first_line = out_lines[first_line_iter->second];
+            if(first_line.last_merged == ExpandedLine::NO_LINE)
+            {
+                first_line.first_merged = i;
+            }
+            else
+            {
+                out_lines[first_line.last_merged].next_merged = i;
+            }
+            first_line.last_merged = i;
+            line.is_merged = true;
+        }
+    }
+
+    // NOTE: Every line has at most one timestamp of its own, which will either be printed on that line or on the
+    //       line that it was merged into. Timestamps that need more than 13 characters are rare enough that we
+    //       don't need to reserve space for them.
+    size_t max_length = get_max_tags_length(data.tags);
+    for(const ExpandedLine& line : out_lines)
+    {
+        max_length += 13 + (line.is_merged ? 0 : line.text.length() + 2);
+    }
+    expanded_text.reserve(max_length);
+    append_tags(expanded_text, data.tags);
+
+    TCHAR timestamp_text[MAX_TIMESTAMP_LENGTH];
+    for(const ExpandedLine& line : out_lines)
+    {
+        if(line.is_merged)
+        {
+            continue;
+        }
+
+        // Even timestamped lyrics can still contain untimestamped lines
+        if(line.timestamp != DBL_MAX)
+        {
+            expanded_text.append(timestamp_text, format_timestamp(line.timestamp, timestamp_text));
+        }
+        for(size_t merged = line.first_merged; merged != ExpandedLine::NO_LINE; merged = out_lines[merged].next_merged)
+        {
+            expanded_text.append(timestamp_text, format_timestamp(out_lines[merged].timestamp, timestamp_text));
+        }
+        expanded_text += line.text;
+        expanded_text += _T("\r\n");
+    }
+
+    return expanded_text;
+}
+
+// ============
+// Tests
+// ============
+#if MVTF_TESTS_ENABLED
+// The parser as it was before it was changed to make a single pass over the input, kept so that we can check that
+// both produce the same output and compare their performance.
+struct ParsedLineContents
+{
+    std::vector<double> timestamps;
+    std::string line;
+};
+
+struct LineTimeParseResult
+{
+    bool success;
+    double timestamp;
+    size_t charsConsumed;
+};
+
 static LineTimeParseResult parse_time_from_line(std::string_view line)
 {
     size_t line_length = line.length();
@@ -319,10 +836,8 @@ static std::vector<LyricDataLine> collapse_concurrent_lines(const std::vector<Ly
                          });
 }
 
-LyricData parsers::lrc::parse(const LyricDataCommon& metadata, std::string_view text) // `text` is assumed to be utf-8
+static LyricData parse_line_by_line(const LyricDataCommon& metadata, std::string_view text)
 {
-    LOG_INFO("Parsing LRC lyric text...");
-
     std::vector<LyricDataLine> lines;
     std::vector<std::string> tags;
     bool tag_section_passed = false; // We only want to count lines as "tags" if they appear at the top of the file
@@ -372,7 +887,7 @@ LyricData parsers::lrc::parse(const LyricDataCommon& metadata, std::string_view
             // of the system without special handling.
             // NOTE: It is important however, to note that this means we need to stable_sort
             //       below, to preserve the ordering of the "untimed" lines
-            if(!tag_section_passed && is_tag_line(line_view))
+            if(!tag_section_passed && parsers::lrc::is_tag_line(line_view))
             {
                 tags.emplace_back(line_view);
 
@@ -380,7 +895,6 @@ LyricData parsers::lrc::parse(const LyricDataCommon& metadata, std::string_view
                 if(maybe_offset.has_value())
                 {
                     timestamp_offset = maybe_offset.value();
-                    LOG_INFO("Found LRC offset: %dms", int(timestamp_offset * 1000.0));
                 }
             }
             else
@@ -412,9 +926,51 @@ LyricData parsers::lrc::parse(const LyricDataCommon& metadata, std::string_view
     return result;
 }
 
-std::tstring parsers::lrc::expand_text(const LyricData& data, bool merge_equivalent_lrc_lines)
+static std::string print_timestamp_with_snprintf(double timestamp)
+{
+    assert(timestamp != DBL_MAX);
+    double total_seconds_flt = std::floor(timestamp);
+    int total_seconds = static_cast<int>(total_seconds_flt);
+    int time_hours = total_seconds / 3600;
+    int time_minutes = (total_seconds - 3600 * time_hours) / 60;
+    int time_seconds = total_seconds - (time_hours * 3600) - (time_minutes * 60);
+    int time_centisec = static_cast<int>(std::round((timestamp - total_seconds_flt) * 100.0));
+
+    // NOTE: We need this special case here because the `std::round` call above might round us up
+    //       and give us 100 centiseconds, which visually should actually be just "the next second".
+    //       In theory we could just replace the `round` with a `floor` and be done but that would
+    //       cause timestamp parsing and printing to not roundtrip cleanly (at least not with the
+    //       rest of this implementation as it is today).
+    if(time_centisec == 100)
+    {
+        time_centisec = 0;
+        time_seconds++;
+        if(time_seconds == 60)
+        {
+            time_seconds = 0;
+            time_minutes++;
+            if(time_minutes == 60)
+            {
+                time_minutes = 0;
+                time_hours++;
+            }
+        }
+    }
+
+    char temp[32];
+    if(time_hours == 0)
+    {
+        snprintf(temp, sizeof(temp), "[%02d:%02d.%02d]", time_minutes, time_seconds, time_centisec);
+    }
+    else
+    {
+        snprintf(temp, sizeof(temp), "[%02d:%02d:%02d.%02d]", time_hours, time_minutes, time_seconds, time_centisec);
+    }
+    return std::string(temp);
+}
+
+static std::tstring expand_text_by_sorting(const LyricData& data, bool merge_equivalent_lrc_lines)
 {
-    LOG_INFO("Expanding lyric text...");
     std::tstring expanded_text;
     expanded_text.reserve(data.tags.size() * 64); // NOTE: 64 is an arbitrary "probably longer than most lines" value
     for(const std::string& tag : data.tags)
@@ -445,8 +1001,7 @@ std::tstring parsers::lrc::expand_text(const LyricData& data, bool merge_equival
             {
                 size_t end_index = std::min(in_line.text.length(), in_line.text.find('\n', start_index));
                 size_t length = end_index - start_index;
-                std::tstring out_text(&in_line.text.c_str()[start_index], length);
-                out_lines.push_back({ out_text, in_line.timestamp });
+                out_lines.push_back({ in_line.text.substr(start_index, length), in_line.timestamp });
 
                 start_index = end_index + 1;
             }
@@ -454,36 +1009,50 @@ std::tstring parsers::lrc::expand_text(const LyricData& data, bool merge_equival
 
         if(merge_equivalent_lrc_lines)
         {
-            std::vector<std::pair<size_t, LyricDataLine>> indexed_lines = alg::enumerate(std::move(out_lines));
-
-            const auto lexicographic_sort = [](const auto& lhs, const auto& rhs)
-            { return lhs.second.text < rhs.second.text; };
-            std::stable_sort(indexed_lines.begin(), indexed_lines.end(), lexicographic_sort);
-            decltype(indexed_lines)::iterator equal_begin = indexed_lines.begin();
-
-            while(equal_begin != indexed_lines.end())
+            // NOTE: We visit the lines in order of their text (to find all the lines with the same text) by sorting
+            //       their indices instead of the lines themselves, so that the lines stay in their original order.
+            std::vector<size_t> text_order(out_lines.size());
+            std::iota(text_order.begin(), text_order.end(), size_t(0));
+            std::stable_sort(text_order.begin(),
+                             text_order.end(),
+                             [&out_lines](size_t lhs, size_t rhs)
+                             { return out_lines[lhs].text < out_lines[rhs].text; });
+            std::vector<bool> is_merged(out_lines.size(), false);
+
+            size_t equal_begin = 0;
+            while(equal_begin < text_order.size())
             {
-                decltype(indexed_lines)::iterator equal_end = equal_begin + 1;
-                while((equal_end != indexed_lines.end()) && (equal_begin->second.text == equal_end->second.text)
-                      && (equal_end->second.timestamp != DBL_MAX))
+                LyricDataLine& first_line = out_lines[text_order[equal_begin]];
+                std::tstring merged_timestamps;
+                size_t equal_end = equal_begin + 1;
+                while((equal_end < text_order.size()) && (first_line.text == out_lines[text_order[equal_end]].text)
+                      && (out_lines[text_order[equal_end]].timestamp != DBL_MAX))
                 {
+                    const double merged_timestamp = out_lines[text_order[equal_end]].timestamp;
+                    merged_timestamps += to_tstring(print_timestamp_with_snprintf(merged_timestamp));
+                    is_merged[text_order[equal_end]] = true;
                     equal_end++;
                 }
 
-                // NOTE: We don't need to move equal_begin back one because we don't add
-                //       the first timestamp to the string. That'll happen as part of the
-                //       normal printing below.
-                for(auto iter = equal_end - 1; iter != equal_begin; iter--)
+                // NOTE: We don't add the first line's own timestamp to the string.
+                //       That'll happen as part of the normal printing below.
+                first_line.text.insert(0, merged_timestamps);
+                equal_begin = equal_end;
+            }
+
+            size_t kept_count = 0;
+            for(size_t i = 0; i < out_lines.size(); i++)
+            {
+                if(!is_merged[i])
                 {
-                    equal_begin->second.text = to_tstring(parsers::lrc::print_timestamp(iter->second.timestamp))
-                                               + equal_begin->second.text;
+                    if(kept_count != i)
+                    {
+                        out_lines[kept_count] = std::move(out_lines[i]);
+                    }
+                    kept_count++;
                 }
-                equal_begin = indexed_lines.erase(equal_begin + 1, equal_end);
             }
-
-            const auto index_sort = [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; };
-            std::sort(indexed_lines.begin(), indexed_lines.end(), index_sort);
-            out_lines = alg::denumerate(indexed_lines);
+            out_lines.erase(out_lines.begin() + kept_count, out_lines.end());
         }
 
         for(const LyricDataLine& line : out_lines)
@@ -491,7 +1060,7 @@ std::tstring parsers::lrc::expand_text(const LyricData& data, bool merge_equival
             // Even timestamped lyrics can still contain untimestamped lines
             if(line.timestamp != DBL_MAX)
             {
-                expanded_text += to_tstring(print_timestamp(line.timestamp));
+                expanded_text += to_tstring(print_timestamp_with_snprintf(line.timestamp));
             }
             expanded_text += line.text;
             expanded_text += _T("\r\n");
@@ -522,10 +1091,71 @@ std::tstring parsers::lrc::expand_text(const LyricData& data, bool merge_equival
     return expanded_text;
 }
 
-// ============
-// Tests
-// ============
-#if MVTF_TESTS_ENABLED
+static std::string make_typical_lrc_text(int line_count)
+{
+    std::string result = "[ar:Artist]\n[ti:Title]\n[offset:-150]\n";
+    for(int i = 0; i < line_count; i++)
+    {
+        result += parsers::lrc::print_timestamp(double(i) * 2.5);
+        result += "This is line number " + std::to_string(i) + " of some lyrics that go on\r\n";
+    }
+    return result;
+}
+
+static std::string make_junk_text(size_t length)
+{
+    const std::string_view junk = "<div class=\"lyrics\">[[not a [timestamp] at all] &nbsp; \xEF\xBB\xBF";
+    std::string result;
+    result.reserve(length + junk.length());
+    while(result.length() < length)
+    {
+        result += junk;
+    }
+    return result;
+}
+
+static std::string make_many_timestamps_text(int timestamp_count)
+{
+    std::string result;
+    for(int i = 0; i < timestamp_count; i++)
+    {
+        result += parsers::lrc::print_timestamp(double(i) * 0.5);
+    }
+    result += "chorus";
+    return result;
+}
+
+static std::string make_concurrent_lines_text(int line_count)
+{
+    std::string result;
+    for(int i = 0; i < line_count; i++)
+    {
+        result += "[00:10.00]The same timestamp as every other line\n";
+    }
+    return result;
+}
+
+static LyricData make_song_with_repeated_chorus(int verse_count)
+{
+    LyricData result = {};
+    result.tags = { "[ar:Artist]", "[ti:Title]" };
+    double timestamp = 0.0;
+    for(int verse = 0; verse < verse_count; verse++)
+    {
+        for(int line = 0; line < 4; line++)
+        {
+            const std::string text = "Verse " + std::to_string(verse) + " line " + std::to_string(line);
+            result.lines.push_back({ to_tstring(text), timestamp += 2.5 });
+        }
+        result.lines.push_back({ _T("This is the chorus that everybody knows"), timestamp += 2.5 });
+        result.lines.push_back({ _T("Sing it again\nSing it again"), timestamp += 2.5 });
+        result.lines.push_back({ _T(""), timestamp += 2.5 });
+    }
+    result.lines.push_back({ _T("Sing it again"), DBL_MAX });
+    result.lines.push_back({ _T("Sing it again"), 5000.0 });
+    return result;
+}
+
 MVTF_TEST(lrcparse_title_tag_extracted_from_lyrics)
 {
     const std::string input = "[Ti:thetitle]\n[00:00.00]line1";
@@ -775,4 +1405,148 @@ MVTF_TEST(lrcparse_print_timestamp_correctly_rounds_up_when_given_input_very_nea
     const std::string output = parsers::lrc::print_timestamp(5.999);
     ASSERT(output == "[00:06.00]");
 }
+
+MVTF_TEST(lrcparse_parsing_skips_byte_order_marks_at_the_start_of_any_line)
+{
+    const std::string input = "\xEF\xBB\xBF[00:01.00]line1\r\n\xEF\xBB\xBF[00:02.00]line2";
+    const LyricData parsed = parsers::lrc::parse({}, input);
+
+    ASSERT(parsed.lines.size() == 2);
+    ASSERT(parsed.lines[0].text == _T("line1"));
+    ASSERT(parsed.lines[1].text == _T("line2"));
+}
+
+MVTF_TEST(lrcparse_parsing_gives_the_same_output_as_parsing_line_by_line)
+{
+    const std::string inputs[] = {
+        "",
+        "[ti:title]\n[offset:250]\n\n[00:02.00]b\r\n[00:01.00][00:03.00]a\runtimed\n[00:01.00]c\n[00:01.00]",
+        "[00:01.00][bad tag]text\n[00:01.00\n[00:01.00]\xFF invalid utf-8\n\n\n[]\n]\n[[",
+        std::string("line with a") + '\0' + "null\n[al:tag after the tag section]\n[00:00.00]last line",
+        "multi-byte \xE4\xBD\xA0\xE5\xA5\xBD text \xF0\x9F\x8E\xB5 that spans more than 16 bytes\r\n\r\n",
+        make_typical_lrc_text(100),
+        make_junk_text(1000),
+        make_many_timestamps_text(100),
+        make_concurrent_lines_text(100),
+    };
+
+    for(const std::string& input : inputs)
+    {
+        CHECK(lyrics_are_identical(parsers::lrc::parse({}, input), parse_line_by_line({}, input)));
+    }
+}
+
+// Compares the throughput of the parser against that of the previous (line-by-line) parser, on both typical lyrics
+// and input that is large or unusual enough to take a disproportionate amount of time to parse.
+// This only runs if OPENLYRICS_LRC_BENCHMARK is set.
+MVTF_TEST(lrcparse_benchmark_parsing_throughput)
+{
+    if(GetEnvironmentVariableA("OPENLYRICS_LRC_BENCHMARK", nullptr, 0) == 0)
+    {
+        return;
+    }
+
+    const std::pair<const char*, std::string> inputs[] = {
+        { "typical lyrics", make_typical_lrc_text(100) },
+        { "long lyrics", make_typical_lrc_text(20000) },
+        { "junk with no line endings", make_junk_text(4 * 1024 * 1024) },
+        { "one line with many timestamps", make_many_timestamps_text(20000) },
+        { "many lines with one timestamp", make_concurrent_lines_text(20000) },
+    };
+    const auto measure_throughput = [](const std::string& input, auto parse)
+    {
+        // NOTE: We parse small inputs repeatedly so that there's enough work to time accurately
+        const int iterations = int(std::max(size_t(1), (16 * 1024 * 1024) / input.length()));
+        const auto parse_input = [&input, &parse]() { const LyricData parsed = parse({}, input); };
+        const double ms_per_parse = measure_average_ms(iterations, parse_input);
+        return (double(input.length()) * 1000.0) / (1024.0 * 1024.0 * ms_per_parse);
+    };
+
+    for(const auto& [name, input] : inputs)
+    {
+        const double line_by_line_throughput = measure_throughput(input, parse_line_by_line);
+        const double single_pass_throughput = measure_throughput(input, parsers::lrc::parse);
+        printf("LRC parsing of %s (%zuKB): %.1fMB/s line-by-line, %.1fMB/s single-pass\n",
+               name,
+               input.length() / 1024,
+               line_by_line_throughput,
+               single_pass_throughput);
+    }
+}
+
+MVTF_TEST(lrcparse_print_timestamp_gives_the_same_output_as_snprintf)
+{
+    const double timestamps[] = { 0.0, 0.004, 0.005, 1.0, 59.994, 59.996, 61.25, 599.5, 3599.999, 3600.0, 3723.45,
+                                  36000.0, 359999.995, 360000.0 };
+    for(double timestamp : timestamps)
+    {
+        CHECK(parsers::lrc::print_timestamp(timestamp) == print_timestamp_with_snprintf(timestamp));
+    }
+    for(int centisec = 0; centisec < 100 * 60 * 70; centisec += 7)
+    {
+        const double timestamp = double(centisec) / 100.0;
+        CHECK(parsers::lrc::print_timestamp(timestamp) == print_timestamp_with_snprintf(timestamp));
+    }
+}
+
+MVTF_TEST(lrcparse_expanding_gives_the_same_output_as_expanding_by_sorting)
+{
+    LyricData untimed = {};
+    untimed.tags = { "[ar:Artist]" };
+    untimed.lines.push_back({ _T("line1"), DBL_MAX });
+    untimed.lines.push_back({ _T(""), DBL_MAX });
+    untimed.lines.push_back({ _T("line1"), DBL_MAX });
+
+    LyricData mixed = {};
+    mixed.lines.push_back({ _T("a"), 1.0 });
+    mixed.lines.push_back({ _T("untimed"), DBL_MAX });
+    mixed.lines.push_back({ _T("untimed"), 2.0 });
+    mixed.lines.push_back({ _T("a"), DBL_MAX });
+    mixed.lines.push_back({ _T("a"), 3.0 });
+    mixed.lines.push_back({ _T("a\na\nb"), 4.0 });
+    mixed.lines.push_back({ _T(""), 5.0 });
+    mixed.lines.push_back({ _T("\n"), 6.0 });
+    mixed.lines.push_back({ _T("b"), DBL_MAX });
+
+    const LyricData inputs[] = {
+        LyricData {},
+        untimed,
+        mixed,
+        parsers::lrc::parse({}, make_typical_lrc_text(100)),
+        parsers::lrc::parse({}, make_many_timestamps_text(100)),
+        parsers::lrc::parse({}, make_concurrent_lines_text(100)),
+        make_song_with_repeated_chorus(20),
+    };
+
+    for(const LyricData& input : inputs)
+    {
+        CHECK(parsers::lrc::expand_text(input, true) == expand_text_by_sorting(input, true));
+        CHECK(parsers::lrc::expand_text(input, false) == expand_text_by_sorting(input, false));
+    }
+}
+
+// Compares the time taken to expand (e.g for the editor) long lyrics with many repeated lines against the time taken
+// by the previous (sort-based) implementation. This only runs if OPENLYRICS_LRC_BENCHMARK is set.
+MVTF_TEST(lrcparse_benchmark_expanding_long_lyrics)
+{
+    if(GetEnvironmentVariableA("OPENLYRICS_LRC_BENCHMARK", nullptr, 0) == 0)
+    {
+        return;
+    }
+
+    const int iterations = 20;
+    const LyricData input = make_song_with_repeated_chorus(2000);
+    const auto measure_ms = [iterations, &input](auto expand)
+    {
+        const auto expand_input = [&input, &expand]() { const std::tstring expanded = expand(input, true); };
+        return measure_average_ms(iterations, expand_input);
+    };
+
+    const double sorting_ms = measure_ms(expand_text_by_sorting);
+    const double hashing_ms = measure_ms(parsers::lrc::expand_text);
+    printf("Expanding %zu lines with merging: %.3fms by sorting, %.3fms by hashing\n",
+           input.lines.size(),
+           sorting_ms,
+           hashing_ms);
+}
 #endif
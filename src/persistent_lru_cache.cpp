@@ -0,0 +1,136 @@
+#include "stdafx.h"
+
+#include "mvtf/mvtf.h"
+#include "persistent_lru_cache.h"
+
+uint32_t persistent_lru_cache::read_byte_count(stream_reader_formatter_simple_ref<false>& input)
+{
+    uint32_t byte_count = 0;
+    input >> byte_count;
+    if(byte_count > input.get_remaining())
+    {
+        throw exception_io_data_truncation();
+    }
+    return byte_count;
+}
+
+std::string persistent_lru_cache::read_string(stream_reader_formatter_simple_ref<false>& input)
+{
+    const uint32_t length = read_byte_count(input);
+    std::string result(length, '\0');
+    input.read_raw(result.data(), length);
+    return result;
+}
+
+void persistent_lru_cache::write_string(stream_writer_formatter<false>& output, const std::string& value)
+{
+    output.write_string(value.c_str(), value.size());
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+#if MVTF_TESTS_ENABLED
+struct TestEntry
+{
+    std::string key;
+    std::string value;
+};
+
+static const PersistentLruCache<TestEntry>::Config test_config = {
+    "openlyrics-test-cache.bin",
+    "test cache",
+    1,
+    100,
+    [](const TestEntry& entry) { return entry.key.size() + entry.value.size(); },
+    [](stream_writer_formatter<false>& output, const TestEntry& entry)
+    {
+        persistent_lru_cache::write_string(output, entry.key);
+        persistent_lru_cache::write_string(output, entry.value);
+    },
+    [](stream_reader_formatter_simple_ref<false>& input)
+    {
+        TestEntry entry = {};
+        entry.key = persistent_lru_cache::read_string(input);
+        entry.value = persistent_lru_cache::read_string(input);
+        return entry;
+    },
+    [](const TestEntry& entry, t_filetimestamp /*now*/) { return entry.value != "unwanted"; },
+};
+
+MVTF_TEST(persistentlrucache_evicts_least_recently_used_entries_once_full)
+{
+    PersistentLruCache<TestEntry> cache(test_config);
+    cache.put({ "a", std::string(39, 'x') });
+    cache.put({ "b", std::string(39, 'x') });
+    cache.mark_used("a");
+    cache.put({ "c", std::string(39, 'x') });
+
+    CHECK(cache.size() == 2);
+    CHECK(cache.eviction_count() == 1);
+    CHECK(cache.total_bytes() == 80);
+    CHECK(cache.find("a") != nullptr);
+    CHECK(cache.find("b") == nullptr);
+    CHECK(cache.find("c") != nullptr);
+}
+
+MVTF_TEST(persistentlrucache_remove_least_recently_used_only_considers_matching_entries)
+{
+    PersistentLruCache<TestEntry> cache(test_config);
+    cache.put({ "a1", "a" });
+    cache.put({ "b1", "b" });
+    cache.put({ "a2", "a" });
+
+    CHECK(cache.count_if([](const TestEntry& entry) { return entry.value == "a"; }) == 2);
+    cache.remove_least_recently_used([](const TestEntry& entry) { return entry.value == "b"; });
+    CHECK(cache.size() == 2);
+    CHECK(cache.find("b1") == nullptr);
+}
+
+MVTF_TEST(persistentlrucache_roundtrips_through_serialisation_in_usage_order)
+{
+    PersistentLruCache<TestEntry> cache(test_config);
+    cache.put({ "a", "first" });
+    cache.put({ "b", "unwanted" });
+    cache.put({ "c", "second" });
+    cache.mark_used("a");
+    CHECK(cache.is_dirty());
+
+    stream_writer_formatter_simple<false> writer;
+    cache.write(writer);
+    CHECK(!cache.is_dirty());
+
+    PersistentLruCache<TestEntry> loaded(test_config);
+    stream_reader_formatter_simple<false> reader(writer.m_buffer.get_ptr(), writer.m_buffer.get_size());
+    loaded.read(reader, 0);
+
+    CHECK(loaded.size() == 2);
+    CHECK(loaded.find("b") == nullptr);
+    ASSERT(loaded.find("a") != nullptr);
+    CHECK(loaded.find("a")->value == "first");
+
+    // "c" was less-recently-used than "a" when saved, so it should be evicted first after loading too
+    loaded.put({ "d", std::string(90, 'x') });
+    CHECK(loaded.find("a") != nullptr);
+    CHECK(loaded.find("c") == nullptr);
+}
+
+MVTF_TEST(persistentlrucache_read_string_rejects_lengths_longer_than_the_remaining_input)
+{
+    stream_writer_formatter_simple<false> writer;
+    writer << uint32_t(0xFFFFFFF0);
+    writer.write_raw("abc", 3);
+
+    bool threw = false;
+    try
+    {
+        stream_reader_formatter_simple<false> reader(writer.m_buffer.get_ptr(), writer.m_buffer.get_size());
+        persistent_lru_cache::read_string(reader);
+    }
+    catch(const exception_io_data&)
+    {
+        threw = true;
+    }
+    CHECK(threw);
+}
+#endif
@@ -0,0 +1,294 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "logging.h"
+#include "preferences.h"
+
+namespace persistent_lru_cache
+{
+    // Read a string or byte count from a cache file, checking that the file actually contains that many more bytes
+    // so that a truncated or corrupted file can't make us allocate an arbitrarily large buffer.
+    uint32_t read_byte_count(stream_reader_formatter_simple_ref<false>& input);
+    std::string read_string(stream_reader_formatter_simple_ref<false>& input);
+
+    void write_string(stream_writer_formatter<false>& output, const std::string& value);
+}
+
+// A cache of entries identified by string keys, which evicts the least-recently-used entries once the entries it
+// holds reach a total size limit and which is kept in a file in the profile directory between sessions.
+// The file is only written if the remote-result cache preference is enabled (and is deleted if it is not).
+// `TEntry` must have a `std::string key` member. This class is not thread-safe.
+template<typename TEntry>
+class PersistentLruCache
+{
+public:
+    struct Config
+    {
+        const char* file_name;   // Within the profile directory
+        const char* description; // For log messages
+        uint32_t file_version;   // Must be incremented whenever the layout of the file changes
+        size_t max_total_bytes;  // The (approximate) maximum number of bytes that the cache will hold
+
+        size_t (*compute_size)(const TEntry& entry);
+        void (*write_entry)(stream_writer_formatter<false>& output, const TEntry& entry);
+        TEntry (*read_entry)(stream_reader_formatter_simple_ref<false>& input);
+        bool (*is_worth_loading)(const TEntry& entry, t_filetimestamp now);
+    };
+
+    explicit PersistentLruCache(const Config& config)
+        : m_config(config)
+    {
+    }
+
+    // Returns the entry with the given key (without marking it as used), or null if there is no such entry
+    TEntry* find(const std::string& key)
+    {
+        const auto index_iter = m_index.find(key);
+        if(index_iter == m_index.end())
+        {
+            return nullptr;
+        }
+        return &index_iter->second->entry;
+    }
+
+    void mark_used(const std::string& key)
+    {
+        const auto index_iter = m_index.find(key);
+        if(index_iter != m_index.end())
+        {
+            m_nodes.splice(m_nodes.begin(), m_nodes, index_iter->second);
+        }
+    }
+
+    // Must be called after modifying an entry returned by `find`, so that the change is saved
+    void mark_dirty()
+    {
+        m_dirty = true;
+    }
+
+    // Adds the given entry as the most-recently-used (replacing any existing entry with the same key) and then
+    // evicts the least-recently-used entries until the cache is back within its size limit.
+    void put(TEntry entry)
+    {
+        remove(entry.key);
+
+        insert_least_recent(std::move(entry));
+        m_nodes.splice(m_nodes.begin(), m_nodes, std::prev(m_nodes.end()));
+
+        while((m_total_bytes > m_config.max_total_bytes) && (m_nodes.size() > 1))
+        {
+            const std::string key = m_nodes.back().entry.key;
+            remove(key);
+            m_eviction_count++;
+        }
+        m_dirty = true;
+    }
+
+    void remove(const std::string& key)
+    {
+        const auto index_iter = m_index.find(key);
+        if(index_iter == m_index.end())
+        {
+            return;
+        }
+
+        const typename std::list<Node>::iterator node_iter = index_iter->second;
+        m_total_bytes -= node_iter->size_bytes;
+        m_index.erase(index_iter);
+        m_nodes.erase(node_iter);
+        m_dirty = true;
+    }
+
+    // Removes the least-recently-used entry for which the given predicate returns true, if there is one
+    template<typename TPredicate>
+    void remove_least_recently_used(TPredicate predicate)
+    {
+        for(auto iter = m_nodes.rbegin(); iter != m_nodes.rend(); iter++)
+        {
+            if(predicate(iter->entry))
+            {
+                const std::string key = iter->entry.key;
+                remove(key);
+                return;
+            }
+        }
+    }
+
+    template<typename TPredicate>
+    size_t count_if(TPredicate predicate) const
+    {
+        size_t result = 0;
+        for(const Node& node : m_nodes)
+        {
+            if(predicate(node.entry))
+            {
+                result++;
+            }
+        }
+        return result;
+    }
+
+    void clear()
+    {
+        m_nodes.clear();
+        m_index.clear();
+        m_total_bytes = 0;
+        m_dirty = false;
+    }
+
+    size_t size() const
+    {
+        return m_nodes.size();
+    }
+
+    size_t total_bytes() const
+    {
+        return m_total_bytes;
+    }
+
+    size_t eviction_count() const
+    {
+        return m_eviction_count;
+    }
+
+    bool is_dirty() const
+    {
+        return m_dirty;
+    }
+
+    void write(stream_writer_formatter<false>& output)
+    {
+        output << m_config.file_version;
+        output << uint32_t(m_nodes.size());
+        for(const Node& node : m_nodes) // Written from most- to least-recently used
+        {
+            m_config.write_entry(output, node.entry);
+        }
+        m_dirty = false;
+    }
+
+    void read(stream_reader_formatter_simple_ref<false>& input, t_filetimestamp now)
+    {
+        uint32_t version = 0;
+        input >> version;
+        if(version != m_config.file_version)
+        {
+            LOG_INFO("Ignoring %s with unsupported version %u", m_config.description, version);
+            return;
+        }
+
+        uint32_t entry_count = 0;
+        input >> entry_count;
+        for(uint32_t entry_index = 0; entry_index < entry_count; entry_index++)
+        {
+            TEntry entry = m_config.read_entry(input);
+            if(!m_config.is_worth_loading(entry, now) || (m_index.find(entry.key) != m_index.end()))
+            {
+                continue;
+            }
+            if(m_total_bytes + m_config.compute_size(entry) > m_config.max_total_bytes)
+            {
+                continue;
+            }
+            insert_least_recent(std::move(entry));
+        }
+        m_dirty = false;
+    }
+
+    // Loads the entries saved by a previous session, if that has not already been done
+    void load_if_required()
+    {
+        if(m_loaded)
+        {
+            return;
+        }
+        m_loaded = true;
+
+        const std::string file_path = get_file_path();
+        try
+        {
+            if(!filesystem::g_exists(file_path.c_str(), fb2k::mainAborter()))
+            {
+                return;
+            }
+
+            file_ptr file;
+            filesystem::g_open_read(file, file_path.c_str(), fb2k::mainAborter());
+
+            pfc::array_t<uint8_t> file_bytes;
+            file->read_till_eof(file_bytes, fb2k::mainAborter());
+
+            stream_reader_formatter_simple<false> reader(file_bytes.get_ptr(), file_bytes.get_size());
+            read(reader, filetimestamp_from_system_timer());
+            LOG_INFO("Loaded %zu entries from the %s", m_nodes.size(), m_config.description);
+        }
+        catch(const std::exception& e)
+        {
+            LOG_WARN("Failed to load %s from %s: %s", m_config.description, file_path.c_str(), e.what());
+            clear();
+        }
+    }
+
+    // Saves the entries for the next session. Intended to be called when foobar2000 exits.
+    void save()
+    {
+        const std::string file_path = get_file_path();
+        try
+        {
+            if(!preferences::searching::cache_remote_results())
+            {
+                // NOTE: If the cache has been disabled then we don't want to leave old entries lying around either
+                if(filesystem::g_exists(file_path.c_str(), fb2k::noAbort))
+                {
+                    filesystem::g_remove(file_path.c_str(), fb2k::noAbort);
+                }
+                return;
+            }
+
+            if(!m_dirty)
+            {
+                return;
+            }
+
+            stream_writer_formatter_simple<false> writer;
+            write(writer);
+
+            file_ptr file;
+            filesystem::g_open_write_new(file, file_path.c_str(), fb2k::noAbort);
+            file->write_object(writer.m_buffer.get_ptr(), writer.m_buffer.get_size(), fb2k::noAbort);
+        }
+        catch(const std::exception& e)
+        {
+            LOG_WARN("Failed to save %s to %s: %s", m_config.description, file_path.c_str(), e.what());
+        }
+    }
+
+private:
+    struct Node
+    {
+        TEntry entry;
+        size_t size_bytes;
+    };
+
+    std::string get_file_path() const
+    {
+        return std::string(core_api::get_profile_path()) + "\\" + m_config.file_name;
+    }
+
+    void insert_least_recent(TEntry entry)
+    {
+        const size_t size_bytes = m_config.compute_size(entry);
+        m_total_bytes += size_bytes;
+        m_nodes.push_back({ std::move(entry), size_bytes });
+        m_index[m_nodes.back().entry.key] = std::prev(m_nodes.end());
+    }
+
+    Config m_config;
+    std::list<Node> m_nodes; // Ordered from most- to least-recently used
+    std::unordered_map<std::string, typename std::list<Node>::iterator> m_index;
+    size_t m_total_bytes = 0;
+    size_t m_eviction_count = 0;
+    bool m_dirty = false;
+    bool m_loaded = false;
+};
@@ -4,6 +4,7 @@
 
 extern const GUID GUID_PREFERENCES_PAGE_ROOT;
 extern const GUID GUID_PREFERENCES_PAGE_SEARCH_SOURCES;
+extern const GUID GUID_ADVCONFIG_BRANCH;
 
 // NOTE: These enums must change in a backward-compatible manner.
 //       This means that values can never be removed or re-used.
@@ -106,6 +107,9 @@ namespace preferences
         const pfc::string8& skip_filter();
         LyricType preferred_lyric_type();
         bool should_search_without_panels();
+        bool search_sources_concurrently();
+        bool cache_remote_results();
+        int prefetch_track_count();
 
         std::vector<std::string> tags();
         std::string_view musixmatch_api_key();
@@ -107,6 +107,10 @@
 #define IDC_UPLOAD_STRATEGY 1127
 #define IDC_SEARCH_WITHOUT_PANELS 1128
 #define IDC_SEARCHING_EXCLUDE_HELP 1129
+#define IDC_SEARCH_SOURCES_CONCURRENTLY 1130
+#define IDC_SEARCH_CACHE_REMOTE_RESULTS 1131
+#define IDC_SEARCH_PREFETCH_COUNT 1132
+#define IDC_SOURCE_STATUS 1133
 
 // Next default values for new objects
 //
@@ -114,7 +118,7 @@
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE 129
 #define _APS_NEXT_COMMAND_VALUE 40001
-#define _APS_NEXT_CONTROL_VALUE 1130
+#define _APS_NEXT_CONTROL_VALUE 1134
 #define _APS_NEXT_SYMED_VALUE 101
 #endif
 #endif
@@ -0,0 +1,394 @@
+#include "stdafx.h"
+
+#include "mvtf/mvtf.h"
+#include "persistent_lru_cache.h"
+#include "search_result_cache.h"
+#include "tag_util.h"
+
+// NOTE: This must be incremented whenever the layout of the cache file changes.
+//       Cache files with any other version are discarded when loading.
+static const uint32_t CACHE_FILE_VERSION = 1;
+
+// The maximum (approximate) number of bytes of lyric data that we'll keep in the cache across all sources
+static const size_t CACHE_MAX_TOTAL_BYTES = 16 * 1024 * 1024;
+
+struct CacheEntry
+{
+    std::string key;
+    GUID source_id;
+    t_filetimestamp expiry_time;
+    std::vector<LyricDataRaw> results;
+};
+
+static size_t compute_entry_size(const CacheEntry& entry)
+{
+    size_t result = sizeof(CacheEntry) + entry.key.size();
+    for(const LyricDataRaw& data : entry.results)
+    {
+        result += sizeof(LyricDataRaw);
+        result += data.source_path.size() + data.artist.size() + data.album.size() + data.title.size();
+        result += data.lookup_id.size() + data.text_bytes.size();
+    }
+    return result;
+}
+
+static void write_entry(stream_writer_formatter<false>& output, const CacheEntry& entry)
+{
+    persistent_lru_cache::write_string(output, entry.key);
+    output << entry.source_id;
+    output << entry.expiry_time;
+    output << uint32_t(entry.results.size());
+    for(const LyricDataRaw& data : entry.results)
+    {
+        output << data.source_id;
+        persistent_lru_cache::write_string(output, data.source_path);
+        persistent_lru_cache::write_string(output, data.artist);
+        persistent_lru_cache::write_string(output, data.album);
+        persistent_lru_cache::write_string(output, data.title);
+        output << data.duration_sec.has_value();
+        output << int32_t(data.duration_sec.value_or(0));
+        persistent_lru_cache::write_string(output, data.lookup_id);
+        output << int32_t(data.type);
+        output << uint32_t(data.text_bytes.size());
+        output.write_raw(data.text_bytes.data(), data.text_bytes.size());
+    }
+}
+
+static CacheEntry read_entry(stream_reader_formatter_simple_ref<false>& input)
+{
+    CacheEntry entry = {};
+    entry.key = persistent_lru_cache::read_string(input);
+    input >> entry.source_id;
+    input >> entry.expiry_time;
+
+    // NOTE: We don't reserve space for all of the results up-front because the count has not been validated.
+    //       Each result is read in full before the next is added, so a bad count just runs out of file.
+    uint32_t result_count = 0;
+    input >> result_count;
+    for(uint32_t result_index = 0; result_index < result_count; result_index++)
+    {
+        LyricDataRaw& data = entry.results.emplace_back();
+        bool has_duration = false;
+        int32_t duration_sec = 0;
+        int32_t type = 0;
+
+        input >> data.source_id;
+        data.source_path = persistent_lru_cache::read_string(input);
+        data.artist = persistent_lru_cache::read_string(input);
+        data.album = persistent_lru_cache::read_string(input);
+        data.title = persistent_lru_cache::read_string(input);
+        input >> has_duration;
+        input >> duration_sec;
+        data.lookup_id = persistent_lru_cache::read_string(input);
+        input >> type;
+        const uint32_t text_size = persistent_lru_cache::read_byte_count(input);
+        data.text_bytes.resize(text_size);
+        input.read_raw(data.text_bytes.data(), text_size);
+
+        if(has_duration)
+        {
+            data.duration_sec = duration_sec;
+        }
+        data.type = LyricType(type);
+    }
+    return entry;
+}
+
+static bool is_worth_loading(const CacheEntry& entry, t_filetimestamp now)
+{
+    return entry.expiry_time >= now;
+}
+
+static const PersistentLruCache<CacheEntry>::Config CACHE_CONFIG = {
+    "openlyrics-search-cache.bin",
+    "search result cache",
+    CACHE_FILE_VERSION,
+    CACHE_MAX_TOTAL_BYTES,
+    compute_entry_size,
+    write_entry,
+    read_entry,
+    is_worth_loading,
+};
+
+class ResultCache : public PersistentLruCache<CacheEntry>
+{
+public:
+    ResultCache()
+        : PersistentLruCache(CACHE_CONFIG)
+    {
+    }
+
+    std::optional<std::vector<LyricDataRaw>> get(const std::string& key, t_filetimestamp now)
+    {
+        const CacheEntry* entry = find(key);
+        if(entry == nullptr)
+        {
+            return {};
+        }
+
+        if(entry->expiry_time < now)
+        {
+            remove(key);
+            return {};
+        }
+
+        mark_used(key);
+        return entry->results;
+    }
+
+    void put(std::string key,
+             GUID source_id,
+             t_filetimestamp expiry_time,
+             std::vector<LyricDataRaw> results,
+             size_t max_source_entries)
+    {
+        remove(key);
+        if(max_source_entries == 0)
+        {
+            return;
+        }
+
+        const auto is_from_source = [source_id](const CacheEntry& entry) { return entry.source_id == source_id; };
+        while(count_if(is_from_source) >= max_source_entries)
+        {
+            remove_least_recently_used(is_from_source);
+        }
+
+        CacheEntry entry = {};
+        entry.key = std::move(key);
+        entry.source_id = source_id;
+        entry.expiry_time = expiry_time;
+        entry.results = std::move(results);
+        PersistentLruCache::put(std::move(entry));
+    }
+};
+
+static std::mutex g_cache_mutex;
+static ResultCache g_cache;
+
+static void save_cache_on_quit()
+{
+    std::lock_guard lock(g_cache_mutex);
+    g_cache.save();
+}
+FB2K_RUN_ON_QUIT(save_cache_on_quit);
+
+static void append_normalised_key_part(std::string& key, std::string_view value)
+{
+    // NOTE: We only fold ASCII characters because the key is only used to identify identical requests.
+    //       Sources that treat other characters case-insensitively will just get a few extra cache misses.
+    for(char c : trim_surrounding_whitespace(value))
+    {
+        if((c >= 'A') && (c <= 'Z'))
+        {
+            c = char(c - 'A' + 'a');
+        }
+        key += c;
+    }
+    key += '\x1F'; // ASCII "unit separator", which we do not expect to ever appear in metadata tags
+}
+
+std::string search_result_cache::search_key(const LyricSourceRemote& source, const LyricSearchParams& params)
+{
+    std::string key = "search:";
+    key += pfc::print_guid(source.id()).c_str();
+    key += ':';
+    append_normalised_key_part(key, params.artist);
+    append_normalised_key_part(key, params.album);
+    append_normalised_key_part(key, params.title);
+    if(params.duration_sec.has_value())
+    {
+        key += std::to_string(params.duration_sec.value());
+    }
+    return key;
+}
+
+std::string search_result_cache::lookup_key(const LyricSourceRemote& source, std::string_view lookup_id)
+{
+    std::string key = "lookup:";
+    key += pfc::print_guid(source.id()).c_str();
+    key += ':';
+    key += lookup_id;
+    return key;
+}
+
+static std::optional<std::vector<LyricDataRaw>> get_from_cache(const std::string& key)
+{
+    std::lock_guard lock(g_cache_mutex);
+    g_cache.load_if_required();
+    return g_cache.get(key, filetimestamp_from_system_timer());
+}
+
+static void put_in_cache(const LyricSourceRemote& source, std::string key, std::vector<LyricDataRaw> results)
+{
+    const t_filetimestamp expiry_time = filetimestamp_from_system_timer() + source.result_cache_lifetime();
+
+    std::lock_guard lock(g_cache_mutex);
+    g_cache.load_if_required();
+    g_cache.put(std::move(key), source.id(), expiry_time, std::move(results), source.result_cache_max_entries());
+}
+
+std::optional<std::vector<LyricDataRaw>> search_result_cache::get_search(const LyricSourceRemote& source,
+                                                                         const LyricSearchParams& params)
+{
+    return get_from_cache(search_key(source, params));
+}
+
+void search_result_cache::put_search(const LyricSourceRemote& source,
+                                     const LyricSearchParams& params,
+                                     const std::vector<LyricDataRaw>& results)
+{
+    // NOTE: We don't cache empty results because they're the most likely to change (when somebody adds lyrics
+    //       for a track to the source) and avoiding repeated searches that fail is handled by search avoidance.
+    if(results.empty())
+    {
+        return;
+    }
+    put_in_cache(source, search_key(source, params), results);
+}
+
+void search_result_cache::forget_search(const LyricSourceRemote& source, const LyricSearchParams& params)
+{
+    std::lock_guard lock(g_cache_mutex);
+    g_cache.load_if_required();
+    g_cache.remove(search_key(source, params));
+}
+
+std::optional<LyricDataRaw> search_result_cache::get_lookup(const LyricSourceRemote& source,
+                                                            std::string_view lookup_id)
+{
+    std::optional<std::vector<LyricDataRaw>> results = get_from_cache(lookup_key(source, lookup_id));
+    if(!results.has_value() || results->empty())
+    {
+        return {};
+    }
+    return std::move(results->front());
+}
+
+void search_result_cache::put_lookup(const LyricSourceRemote& source,
+                                     std::string_view lookup_id,
+                                     const LyricDataRaw& result)
+{
+    if(result.text_bytes.empty())
+    {
+        return;
+    }
+    put_in_cache(source, lookup_key(source, lookup_id), { result });
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+#if MVTF_TESTS_ENABLED
+// clang-format off: GUIDs should be one line
+static const GUID test_source_a = { 0x3b0d5ad6, 0x1f0e, 0x4c5b, { 0x9a, 0x41, 0x6d, 0x2e, 0x88, 0x10, 0x7c, 0x05 } };
+static const GUID test_source_b = { 0x8e9f2c47, 0x5d13, 0x4a8e, { 0xb2, 0x6c, 0x01, 0x7f, 0x3a, 0x94, 0xd5, 0x6b } };
+// clang-format on
+
+static std::vector<LyricDataRaw> make_test_results(GUID source_id, std::string_view text)
+{
+    LyricDataRaw data = {};
+    data.source_id = source_id;
+    data.artist = "artist";
+    data.title = "title";
+    data.duration_sec = 123;
+    data.lookup_id = "lookup";
+    data.type = LyricType::Synced;
+    data.text_bytes = std::vector<uint8_t>(text.begin(), text.end());
+    return { data };
+}
+
+MVTF_TEST(searchcache_get_returns_stored_results)
+{
+    ResultCache cache;
+    cache.put("key", test_source_a, 100, make_test_results(test_source_a, "lyrics"), 10);
+
+    const std::optional<std::vector<LyricDataRaw>> result = cache.get("key", 50);
+    ASSERT(result.has_value());
+    ASSERT(result->size() == 1);
+    CHECK(result->front().artist == "artist");
+    CHECK(std::string((const char*)result->front().text_bytes.data(), result->front().text_bytes.size())
+          == "lyrics");
+    CHECK(!cache.get("other_key", 50).has_value());
+}
+
+MVTF_TEST(searchcache_expired_entries_are_not_returned)
+{
+    ResultCache cache;
+    cache.put("key", test_source_a, 100, make_test_results(test_source_a, "lyrics"), 10);
+
+    CHECK(!cache.get("key", 101).has_value());
+    CHECK(cache.size() == 0);
+}
+
+MVTF_TEST(searchcache_source_entry_limit_evicts_least_recently_used_entry_from_that_source)
+{
+    ResultCache cache;
+    cache.put("a1", test_source_a, 100, make_test_results(test_source_a, "1"), 2);
+    cache.put("b1", test_source_b, 100, make_test_results(test_source_b, "2"), 2);
+    cache.put("a2", test_source_a, 100, make_test_results(test_source_a, "3"), 2);
+    CHECK(cache.get("a1", 0).has_value()); // Make a1 more-recently-used than a2
+    cache.put("a3", test_source_a, 100, make_test_results(test_source_a, "4"), 2);
+
+    CHECK(cache.size() == 3);
+    CHECK(cache.get("a1", 0).has_value());
+    CHECK(!cache.get("a2", 0).has_value());
+    CHECK(cache.get("a3", 0).has_value());
+    CHECK(cache.get("b1", 0).has_value());
+}
+
+MVTF_TEST(searchcache_roundtrips_through_serialisation_and_drops_expired_entries)
+{
+    ResultCache cache;
+    cache.put("old", test_source_a, 100, make_test_results(test_source_a, "old lyrics"), 10);
+    cache.put("new", test_source_b, 300, make_test_results(test_source_b, "new lyrics"), 10);
+    CHECK(cache.is_dirty());
+
+    stream_writer_formatter_simple<false> writer;
+    cache.write(writer);
+    CHECK(!cache.is_dirty());
+
+    ResultCache loaded;
+    stream_reader_formatter_simple<false> reader(writer.m_buffer.get_ptr(), writer.m_buffer.get_size());
+    loaded.read(reader, 200);
+
+    CHECK(loaded.size() == 1);
+    CHECK(!loaded.get("old", 200).has_value());
+    const std::optional<std::vector<LyricDataRaw>> result = loaded.get("new", 200);
+    ASSERT(result.has_value());
+    ASSERT(result->size() == 1);
+    CHECK(result->front().source_id == test_source_b);
+    CHECK(result->front().duration_sec == 123);
+    CHECK(result->front().lookup_id == "lookup");
+    CHECK(result->front().type == LyricType::Synced);
+    CHECK(std::string((const char*)result->front().text_bytes.data(), result->front().text_bytes.size())
+          == "new lyrics");
+}
+
+MVTF_TEST(searchcache_rejects_a_corrupted_file_without_allocating_the_sizes_it_contains)
+{
+    ResultCache cache;
+    cache.put("key", test_source_a, 100, make_test_results(test_source_a, "lyrics"), 10);
+
+    stream_writer_formatter_simple<false> writer;
+    cache.write(writer);
+
+    // Overwrite the length of the first entry's key with a huge value
+    const uint32_t huge_length = 0xFFFFFFF0;
+    const size_t key_length_offset = 2 * sizeof(uint32_t); // After the version and the entry count
+    memcpy(writer.m_buffer.get_ptr() + key_length_offset, &huge_length, sizeof(huge_length));
+
+    bool threw = false;
+    try
+    {
+        ResultCache loaded;
+        stream_reader_formatter_simple<false> reader(writer.m_buffer.get_ptr(), writer.m_buffer.get_size());
+        loaded.read(reader, 0);
+    }
+    catch(const exception_io_data&)
+    {
+        threw = true;
+    }
+    CHECK(threw);
+}
+#endif
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include "lyric_data.h"
+#include "sources/lyric_source.h"
+
+// A cache of the search and lookup results returned by remote sources, so that replaying a track whose lyrics
+// were not saved does not require repeating the same requests. Results are held in memory (evicting the
+// least-recently-used entries first) and written to a file in the profile directory on exit so that they remain
+// available in future sessions. Each source specifies how long its results remain valid and how many of its
+// results may be held at once.
+namespace search_result_cache
+{
+    std::optional<std::vector<LyricDataRaw>> get_search(const LyricSourceRemote& source,
+                                                        const LyricSearchParams& params);
+    void put_search(const LyricSourceRemote& source,
+                    const LyricSearchParams& params,
+                    const std::vector<LyricDataRaw>& results);
+    void forget_search(const LyricSourceRemote& source, const LyricSearchParams& params);
+
+    std::optional<LyricDataRaw> get_lookup(const LyricSourceRemote& source, std::string_view lookup_id);
+    void put_lookup(const LyricSourceRemote& source, std::string_view lookup_id, const LyricDataRaw& result);
+
+    // Keys that identify equivalent requests (ignoring case and surrounding whitespace in the search parameters)
+    std::string search_key(const LyricSourceRemote& source, const LyricSearchParams& params);
+    std::string lookup_key(const LyricSourceRemote& source, std::string_view lookup_id);
+}
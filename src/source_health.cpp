@@ -0,0 +1,472 @@
+#include "stdafx.h"
+
+#include <map>
+
+#include "logging.h"
+#include "mvtf/mvtf.h"
+#include "source_health.h"
+#include "sources/lyric_source.h"
+
+using HealthClock = std::chrono::steady_clock;
+using source_health::RequestOutcome;
+using std::chrono::milliseconds;
+
+// NOTE: This is the timeout that we use when we don't yet know how long the source usually takes to respond.
+//       It matches the timeout that we've always used for requests made with curl.
+static const milliseconds DEFAULT_REQUEST_TIMEOUT = std::chrono::seconds(30);
+static const milliseconds MIN_REQUEST_TIMEOUT = std::chrono::seconds(5);
+static const int REQUEST_TIMEOUT_MULTIPLIER = 3;
+static const int MIN_SAMPLES_FOR_ADAPTIVE_TIMEOUT = 20;
+
+// NOTE: Once we have this many samples we halve all the counts, so that the histogram reflects recent behaviour
+static const int MAX_HISTOGRAM_SAMPLES = 200;
+
+static const int FAILURES_BEFORE_SKIPPING = 5;
+static const std::chrono::minutes INITIAL_SKIP_PERIOD(1);
+static const std::chrono::minutes MAX_SKIP_PERIOD(30);
+static const std::chrono::minutes MAX_TRIAL_REQUEST_DURATION(2);
+
+class SourceHealth
+{
+public:
+    enum class State
+    {
+        Healthy,   // Requests are made as normal
+        Skipped,   // The source failed repeatedly, so no requests will be made until the skip period elapses
+        Recovering // The skip period has elapsed, a single trial request will decide if the source has recovered
+    };
+
+    SourceHealth()
+        : m_latency_buckets()
+        , m_request_count(0)
+        , m_failure_count(0)
+        , m_consecutive_failures(0)
+        , m_times_skipped(0)
+        , m_state(State::Healthy)
+        , m_skip_until()
+        , m_trial_started()
+        , m_trial_in_progress(false)
+    {
+    }
+
+    void record(HealthClock::time_point now, milliseconds latency, RequestOutcome outcome)
+    {
+        m_request_count++;
+
+        // NOTE: Requests that time out are included in the latency histogram too (at the time that we gave up on
+        //       them). Otherwise a source that gets slower would only ever be timed out at the same (outdated) limit,
+        //       because none of the slower requests would ever be counted.
+        if(outcome != RequestOutcome::Failed)
+        {
+            m_latency_buckets[get_bucket_index(latency)]++;
+        }
+
+        if(outcome == RequestOutcome::Succeeded)
+        {
+            m_consecutive_failures = 0;
+            if(m_state != State::Healthy)
+            {
+                m_state = State::Healthy;
+                m_times_skipped = 0;
+            }
+        }
+        else
+        {
+            m_failure_count++;
+            m_consecutive_failures++;
+            const bool trial_failed = (m_state == State::Recovering);
+            if(trial_failed || (m_consecutive_failures >= FAILURES_BEFORE_SKIPPING))
+            {
+                const int skip_doublings = std::min(m_times_skipped, 5);
+                const std::chrono::minutes skip_period = std::min<std::chrono::minutes>(
+                    INITIAL_SKIP_PERIOD * (1 << skip_doublings),
+                    MAX_SKIP_PERIOD);
+                m_state = State::Skipped;
+                m_skip_until = now + skip_period;
+                m_times_skipped++;
+
+                // NOTE: Whatever made the source stop responding probably means that its old response times no
+                //       longer apply, so we go back to the default timeout until we know how it behaves now.
+                std::fill(std::begin(m_latency_buckets), std::end(m_latency_buckets), 0);
+            }
+        }
+        m_trial_in_progress = false;
+
+        if(m_request_count >= MAX_HISTOGRAM_SAMPLES)
+        {
+            for(int& count : m_latency_buckets)
+            {
+                count /= 2;
+            }
+            m_request_count /= 2;
+            m_failure_count /= 2;
+        }
+    }
+
+    bool allow_request(HealthClock::time_point now)
+    {
+        if((m_state == State::Skipped) && (now >= m_skip_until))
+        {
+            m_state = State::Recovering;
+            m_trial_in_progress = false;
+        }
+
+        if(m_state == State::Healthy)
+        {
+            return true;
+        }
+        else if(m_state == State::Recovering)
+        {
+            // NOTE: We only let one request through to check if the source has recovered. If that request doesn't
+            //       get as far as making a request to the source then we'll let another one through eventually.
+            const bool trial_expired = m_trial_in_progress && (now - m_trial_started >= MAX_TRIAL_REQUEST_DURATION);
+            if(!m_trial_in_progress || trial_expired)
+            {
+                m_trial_in_progress = true;
+                m_trial_started = now;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Returns the approximate latency within which the given fraction of successful requests received a response
+    std::optional<milliseconds> latency_percentile(double fraction) const
+    {
+        int total = 0;
+        for(int count : m_latency_buckets)
+        {
+            total += count;
+        }
+        if(total < MIN_SAMPLES_FOR_ADAPTIVE_TIMEOUT)
+        {
+            return {};
+        }
+
+        const double target = fraction * double(total);
+        int cumulative = 0;
+        for(size_t i = 0; i < BUCKET_COUNT; i++)
+        {
+            cumulative += m_latency_buckets[i];
+            if(double(cumulative) >= target)
+            {
+                return get_bucket_upper_bound(i);
+            }
+        }
+        return get_bucket_upper_bound(BUCKET_COUNT - 1);
+    }
+
+    milliseconds request_timeout() const
+    {
+        const std::optional<milliseconds> p99 = latency_percentile(0.99);
+        if(!p99.has_value())
+        {
+            return DEFAULT_REQUEST_TIMEOUT;
+        }
+        return std::clamp(p99.value() * REQUEST_TIMEOUT_MULTIPLIER, MIN_REQUEST_TIMEOUT, DEFAULT_REQUEST_TIMEOUT);
+    }
+
+    State state() const
+    {
+        return m_state;
+    }
+    HealthClock::time_point skip_until() const
+    {
+        return m_skip_until;
+    }
+    int request_count() const
+    {
+        return m_request_count;
+    }
+    int failure_count() const
+    {
+        return m_failure_count;
+    }
+
+private:
+    // NOTE: Bucket i holds successful requests that took at most 100ms * 2^i (and the last bucket holds the rest)
+    static constexpr size_t BUCKET_COUNT = 10;
+
+    static size_t get_bucket_index(milliseconds latency)
+    {
+        for(size_t i = 0; i + 1 < BUCKET_COUNT; i++)
+        {
+            if(latency <= get_bucket_upper_bound(i))
+            {
+                return i;
+            }
+        }
+        return BUCKET_COUNT - 1;
+    }
+
+    static milliseconds get_bucket_upper_bound(size_t bucket_index)
+    {
+        if(bucket_index + 1 >= BUCKET_COUNT)
+        {
+            return DEFAULT_REQUEST_TIMEOUT;
+        }
+        return milliseconds(100) * (1 << bucket_index);
+    }
+
+    int m_latency_buckets[BUCKET_COUNT];
+    int m_request_count;
+    int m_failure_count;
+    int m_consecutive_failures;
+    int m_times_skipped;
+
+    State m_state;
+    HealthClock::time_point m_skip_until;
+    HealthClock::time_point m_trial_started;
+    bool m_trial_in_progress;
+};
+
+static std::mutex g_health_mutex;
+static std::map<GUID, SourceHealth, pfc::predicateGUID> g_source_health;
+static thread_local std::optional<GUID> t_request_source;
+
+source_health::RequestScope::RequestScope(GUID source_id)
+    : m_previous_source(t_request_source)
+{
+    t_request_source = source_id;
+}
+
+source_health::RequestScope::~RequestScope()
+{
+    t_request_source = m_previous_source;
+}
+
+std::optional<GUID> source_health::current_request_source()
+{
+    return t_request_source;
+}
+
+std::chrono::milliseconds source_health::request_timeout(GUID source_id)
+{
+    std::lock_guard lock(g_health_mutex);
+    return g_source_health[source_id].request_timeout();
+}
+
+void source_health::record_request(GUID source_id, std::chrono::milliseconds latency, RequestOutcome outcome)
+{
+    std::lock_guard lock(g_health_mutex);
+    SourceHealth& health = g_source_health[source_id];
+    const bool was_skipped = (health.state() == SourceHealth::State::Skipped);
+    health.record(HealthClock::now(), latency, outcome);
+    if(!was_skipped && (health.state() == SourceHealth::State::Skipped))
+    {
+        LyricSourceBase* source = LyricSourceBase::get(source_id);
+        const std::string friendly_name = (source == nullptr) ? "<unknown>" : from_tstring(source->friendly_name());
+        LOG_WARN("Requests to %s have failed repeatedly, it will not be searched for a while", friendly_name.c_str());
+    }
+}
+
+bool source_health::should_skip_source(GUID source_id)
+{
+    std::lock_guard lock(g_health_mutex);
+    return !g_source_health[source_id].allow_request(HealthClock::now());
+}
+
+static std::string format_duration(milliseconds duration)
+{
+    if(duration < std::chrono::seconds(1))
+    {
+        return std::format("{}ms", duration.count());
+    }
+    else if(duration < std::chrono::minutes(1))
+    {
+        return std::format("{:.1f}s", double(duration.count()) / 1000.0);
+    }
+    else
+    {
+        const auto minutes = std::chrono::ceil<std::chrono::minutes>(duration);
+        return std::format("{} minute{}", minutes.count(), (minutes.count() == 1) ? "" : "s");
+    }
+}
+
+std::string source_health::describe_source(GUID source_id)
+{
+    LyricSourceBase* source = LyricSourceBase::get(source_id);
+    if((source == nullptr) || source->is_local())
+    {
+        return "Local sources are always searched.";
+    }
+
+    std::lock_guard lock(g_health_mutex);
+    const auto iter = g_source_health.find(source_id);
+    if((iter == g_source_health.end()) || (iter->second.request_count() == 0))
+    {
+        return "No requests have been made to this source yet.";
+    }
+
+    const SourceHealth& health = iter->second;
+    switch(health.state())
+    {
+        case SourceHealth::State::Skipped:
+        {
+            const auto remaining = std::chrono::duration_cast<milliseconds>(health.skip_until() - HealthClock::now());
+            return std::format("Not responding. Requests have failed repeatedly so this source will be skipped for "
+                               "the next {}.",
+                               format_duration(std::max(remaining, milliseconds(0))));
+        }
+
+        case SourceHealth::State::Recovering:
+            return "Not responding. The next search will check if this source has recovered.";
+
+        case SourceHealth::State::Healthy:
+        default:
+            break;
+    }
+
+    const int failure_percent = (100 * health.failure_count()) / std::max(health.request_count(), 1);
+    const std::optional<milliseconds> median = health.latency_percentile(0.5);
+    if(!median.has_value())
+    {
+        return std::format("Responding normally. {}% of recent requests failed.", failure_percent);
+    }
+    return std::format("Responding normally, usually within {}. {}% of recent requests failed. Requests will time out "
+                       "after {}.",
+                       format_duration(median.value()),
+                       failure_percent,
+                       format_duration(health.request_timeout()));
+}
+
+// ============
+// Tests
+// ============
+#if MVTF_TESTS_ENABLED
+MVTF_TEST(sourcehealth_uses_the_default_timeout_until_enough_requests_have_been_made)
+{
+    SourceHealth health;
+    const HealthClock::time_point now = HealthClock::now();
+    for(int i = 0; i < MIN_SAMPLES_FOR_ADAPTIVE_TIMEOUT - 1; i++)
+    {
+        health.record(now, milliseconds(150), RequestOutcome::Succeeded);
+    }
+    ASSERT(health.request_timeout() == DEFAULT_REQUEST_TIMEOUT);
+
+    health.record(now, milliseconds(150), RequestOutcome::Succeeded);
+    ASSERT(health.request_timeout() < DEFAULT_REQUEST_TIMEOUT);
+}
+
+MVTF_TEST(sourcehealth_timeout_scales_with_the_slowest_requests)
+{
+    SourceHealth health;
+    const HealthClock::time_point now = HealthClock::now();
+    for(int i = 0; i < 98; i++)
+    {
+        health.record(now, milliseconds(50), RequestOutcome::Succeeded);
+    }
+    health.record(now, milliseconds(3000), RequestOutcome::Succeeded);
+    health.record(now, milliseconds(3000), RequestOutcome::Succeeded);
+
+    // The 99th percentile falls in the bucket that holds requests of up to 3200ms
+    ASSERT(health.latency_percentile(0.99) == milliseconds(3200));
+    ASSERT(health.request_timeout() == milliseconds(3200 * REQUEST_TIMEOUT_MULTIPLIER));
+    ASSERT(health.latency_percentile(0.5) == milliseconds(100));
+}
+
+MVTF_TEST(sourcehealth_timeout_never_drops_below_the_minimum)
+{
+    SourceHealth health;
+    const HealthClock::time_point now = HealthClock::now();
+    for(int i = 0; i < 100; i++)
+    {
+        health.record(now, milliseconds(10), RequestOutcome::Succeeded);
+    }
+    ASSERT(health.request_timeout() == MIN_REQUEST_TIMEOUT);
+}
+
+MVTF_TEST(sourcehealth_timeout_relaxes_when_the_source_gets_slower)
+{
+    SourceHealth health;
+    const HealthClock::time_point now = HealthClock::now();
+    for(int i = 0; i < 100; i++)
+    {
+        health.record(now, milliseconds(50), RequestOutcome::Succeeded);
+    }
+    const milliseconds fast_timeout = health.request_timeout();
+    ASSERT(fast_timeout == MIN_REQUEST_TIMEOUT);
+
+    // The source slows down enough that some requests take longer than the timeout
+    for(int i = 0; i < 3; i++)
+    {
+        health.record(now, fast_timeout, RequestOutcome::TimedOut);
+        health.record(now, milliseconds(3000), RequestOutcome::Succeeded);
+    }
+    ASSERT(health.state() == SourceHealth::State::Healthy);
+    ASSERT(health.request_timeout() == milliseconds(6400 * REQUEST_TIMEOUT_MULTIPLIER));
+}
+
+MVTF_TEST(sourcehealth_timeout_is_reset_when_the_source_is_skipped)
+{
+    SourceHealth health;
+    const HealthClock::time_point now = HealthClock::now();
+    for(int i = 0; i < 100; i++)
+    {
+        health.record(now, milliseconds(50), RequestOutcome::Succeeded);
+    }
+    ASSERT(health.request_timeout() == MIN_REQUEST_TIMEOUT);
+
+    for(int i = 0; i < FAILURES_BEFORE_SKIPPING; i++)
+    {
+        health.record(now, MIN_REQUEST_TIMEOUT, RequestOutcome::TimedOut);
+    }
+    ASSERT(health.state() == SourceHealth::State::Skipped);
+    ASSERT(health.request_timeout() == DEFAULT_REQUEST_TIMEOUT);
+}
+
+MVTF_TEST(sourcehealth_source_is_skipped_after_repeated_failures_then_retried)
+{
+    SourceHealth health;
+    const HealthClock::time_point start = HealthClock::now();
+    for(int i = 0; i < FAILURES_BEFORE_SKIPPING - 1; i++)
+    {
+        health.record(start, milliseconds(100), RequestOutcome::Failed);
+        ASSERT(health.allow_request(start));
+    }
+
+    health.record(start, milliseconds(100), RequestOutcome::Failed);
+    ASSERT(health.state() == SourceHealth::State::Skipped);
+    ASSERT(!health.allow_request(start));
+
+    const HealthClock::time_point after_skip = start + INITIAL_SKIP_PERIOD;
+    ASSERT(health.allow_request(after_skip));
+    ASSERT(health.state() == SourceHealth::State::Recovering);
+    ASSERT(!health.allow_request(after_skip)); // Only one trial request at a time
+
+    health.record(after_skip, milliseconds(100), RequestOutcome::Succeeded);
+    ASSERT(health.state() == SourceHealth::State::Healthy);
+    ASSERT(health.allow_request(after_skip));
+}
+
+MVTF_TEST(sourcehealth_failed_trial_request_skips_the_source_for_longer)
+{
+    SourceHealth health;
+    const HealthClock::time_point start = HealthClock::now();
+    for(int i = 0; i < FAILURES_BEFORE_SKIPPING; i++)
+    {
+        health.record(start, milliseconds(100), RequestOutcome::Failed);
+    }
+
+    const HealthClock::time_point after_skip = start + INITIAL_SKIP_PERIOD;
+    ASSERT(health.allow_request(after_skip));
+    health.record(after_skip, milliseconds(100), RequestOutcome::Failed);
+    ASSERT(health.state() == SourceHealth::State::Skipped);
+    ASSERT(health.skip_until() == after_skip + 2 * INITIAL_SKIP_PERIOD);
+}
+
+MVTF_TEST(sourcehealth_expired_trial_request_lets_another_request_through)
+{
+    SourceHealth health;
+    const HealthClock::time_point start = HealthClock::now();
+    for(int i = 0; i < FAILURES_BEFORE_SKIPPING; i++)
+    {
+        health.record(start, milliseconds(100), RequestOutcome::Failed);
+    }
+
+    const HealthClock::time_point after_skip = start + INITIAL_SKIP_PERIOD;
+    ASSERT(health.allow_request(after_skip));
+    ASSERT(!health.allow_request(after_skip + MAX_TRIAL_REQUEST_DURATION / 2));
+    ASSERT(health.allow_request(after_skip + MAX_TRIAL_REQUEST_DURATION));
+}
+#endif
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include <chrono>
+
+// Tracks how quickly (and how reliably) each remote source responds to our requests, so that we can stop waiting
+// on a source that has become unusually slow and temporarily stop searching a source that is not responding at all.
+namespace source_health
+{
+    // Attributes all requests made by the current thread (for as long as this object exists) to the given source.
+    class RequestScope
+    {
+    public:
+        explicit RequestScope(GUID source_id);
+        ~RequestScope();
+        RequestScope(const RequestScope& other) = delete;
+        RequestScope& operator=(const RequestScope& other) = delete;
+
+    private:
+        std::optional<GUID> m_previous_source;
+    };
+
+    // Returns the source on whose behalf the current thread is making requests, if any
+    std::optional<GUID> current_request_source();
+
+    // How long we should wait for a response to a request to the given source before giving up on it
+    std::chrono::milliseconds request_timeout(GUID source_id);
+
+    enum class RequestOutcome
+    {
+        Succeeded,
+        Failed,  // We received no response (e.g because of a network error) or the source reported a server error
+        TimedOut // We gave up waiting for a response because the request took longer than its timeout
+    };
+
+    // Records the outcome of a request made to the given source
+    void record_request(GUID source_id, std::chrono::milliseconds latency, RequestOutcome outcome);
+
+    // Returns true if the source has failed repeatedly and should not be searched again yet
+    bool should_skip_source(GUID source_id);
+
+    // Returns a short human-readable description of the state of the given source, for display in the UI
+    std::string describe_source(GUID source_id);
+}
@@ -3,6 +3,7 @@
 
 #include "pugixml.hpp"
 
+#include "http.h"
 #include "logging.h"
 #include "lyric_data.h"
 #include "lyric_source.h"
@@ -76,26 +77,48 @@ std::vector<LyricDataRaw> AZLyricsComSource::search(const LyricSearchParams& par
              firefox_version,
              firefox_version);
 
-    http_request::ptr request = http_client::get()->create_request("GET");
-    request->add_header("User-Agent", useragent);
+    http::RequestOptions options = {};
+    options.headers.push_back(std::string("User-Agent: ") + useragent);
 
     std::string url_artist = remove_chars_for_url(params.artist);
     std::string url_title = remove_chars_for_url(params.title);
     std::string url = "https://www.azlyrics.com/lyrics/" + url_artist + "/" + url_title + ".html";
     LOG_INFO("Querying for lyrics from %s...", url.c_str());
 
-    pfc::string8 content;
-    try
+    // NOTE: The lyrics are in the first div without a class after the lyrics header, and the rest of the (fairly
+    //       large) page is of no interest to us, so we stop downloading as soon as we've seen the end of that div.
+    //       Each chunk is only searched once, along with the end of the previous chunk in case a marker is split
+    //       across the two.
+    std::string unsearched;
+    size_t marker_index = 0;
+    options.on_body_chunk = [&unsearched, &marker_index](std::string_view chunk)
     {
-        file_ptr response_file = request->run(url.c_str(), abort);
-        response_file->read_string_raw(content, abort);
-        // NOTE: We're assuming here that the response is encoded in UTF-8
-    }
-    catch(const std::exception& e)
+        const std::string_view markers[] = { "class=\"lyricsh\"", "<div>", "</div>" };
+        unsearched.append(chunk);
+        while(marker_index < std::size(markers))
+        {
+            const std::string_view marker = markers[marker_index];
+            const size_t position = unsearched.find(marker);
+            if(position == std::string::npos)
+            {
+                const size_t overlap_length = std::min(unsearched.length(), marker.length() - 1);
+                unsearched.erase(0, unsearched.length() - overlap_length);
+                return true;
+            }
+            unsearched.erase(0, position + marker.length());
+            marker_index++;
+        }
+        return false;
+    };
+
+    // NOTE: We're assuming here that the response is encoded in UTF-8
+    const http::Result response = http::get(url, abort, options);
+    if(!response.is_success())
     {
-        LOG_WARN("Failed to download azlyrics.com page %s: %s", url.c_str(), e.what());
+        LOG_WARN("Failed to download azlyrics.com page %s: %s", url.c_str(), response.error_message.c_str());
         return {};
     }
+    const std::string& content = response.response_content;
 
     std::string lyric_text;
     pugi::xml_document doc;
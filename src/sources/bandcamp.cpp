@@ -3,6 +3,7 @@
 
 #include "pugixml.hpp"
 
+#include "http.h"
 #include "logging.h"
 #include "lyric_source.h"
 #include "mvtf/mvtf.h"
@@ -67,64 +68,83 @@ static std::string remove_title_url_chars(const std::string_view input)
 
 std::vector<LyricDataRaw> BandcampSource::search(const LyricSearchParams& params, abort_callback& abort)
 {
+    // NOTE: Tracks with the same title by the same artist get pages with increasing suffixes ("title", "title-2",
+    //       "title-3" etc), so we keep requesting pages until one doesn't exist. Most tracks don't have a page at
+    //       all, so we request the first page on its own and only request the rest in pairs once it exists. Pages
+    //       beyond the first are rare, so that saves time without requesting many pages that don't exist.
+    const int max_page_index = 7;
+    const int pages_per_batch = 2;
+
+    const std::string url_artist = remove_artist_url_chars(params.artist);
+    const std::string url_title = remove_title_url_chars(params.title);
+    const std::string base_url = "http://" + url_artist + ".bandcamp.com/track/" + url_title;
+
     std::vector<LyricDataRaw> result;
-    for(int page_index = 1; page_index < 8; page_index++)
+    int batch_size = 1;
+    for(int first_page_index = 1; first_page_index <= max_page_index; first_page_index += batch_size)
     {
-        http_request::ptr request = http_client::get()->create_request("GET");
-
-        const std::string url_artist = remove_artist_url_chars(params.artist);
-        const std::string url_title = remove_title_url_chars(params.title);
-        std::string url = "http://" + url_artist + ".bandcamp.com/track/" + url_title;
-        if(page_index > 1)
+        if(first_page_index > 1)
         {
-            url += "-" + std::to_string(page_index);
+            batch_size = pages_per_batch;
         }
-        LOG_INFO("Querying for lyrics from %s...", url.c_str());
 
-        pfc::string8 content;
-        try
+        std::vector<std::string> urls;
+        const int last_page_index = std::min(first_page_index + batch_size - 1, max_page_index);
+        for(int page_index = first_page_index; page_index <= last_page_index; page_index++)
         {
-            file_ptr response_file = request->run(url.c_str(), abort);
-            response_file->read_string_raw(content, abort);
-            // NOTE: We're assuming here that the response is encoded in UTF-8
+            std::string url = base_url;
+            if(page_index > 1)
+            {
+                url += "-" + std::to_string(page_index);
+            }
+            LOG_INFO("Querying for lyrics from %s...", url.c_str());
+            urls.push_back(std::move(url));
         }
-        catch(const std::exception& e)
+
+        // NOTE: We're assuming here that the responses are encoded in UTF-8
+        const std::vector<http::Result> responses = http::get_many(urls, abort);
+        for(size_t url_index = 0; url_index < urls.size(); url_index++)
         {
-            LOG_WARN("Failed to download bandcamp.com page %s: %s", url.c_str(), e.what());
-            break;
-        }
+            const std::string& url = urls[url_index];
+            const http::Result& response = responses[url_index];
+            if(!response.is_success())
+            {
+                LOG_WARN("Failed to download bandcamp.com page %s: %s", url.c_str(), response.error_message.c_str());
+                return result;
+            }
 
-        std::string lyric_text;
-        pugi::xml_document doc;
-        load_html_document(content.c_str(), doc);
+            std::string lyric_text;
+            pugi::xml_document doc;
+            load_html_document(response.response_content.c_str(), doc);
 
-        pugi::xpath_query query_lyricdivs("//div[contains(@class, 'lyricsText')]");
-        pugi::xpath_node_set lyricdivs = query_lyricdivs.evaluate_node_set(doc);
-        if(!lyricdivs.empty())
-        {
-            for(const pugi::xpath_node& node : lyricdivs)
+            pugi::xpath_query query_lyricdivs("//div[contains(@class, 'lyricsText')]");
+            pugi::xpath_node_set lyricdivs = query_lyricdivs.evaluate_node_set(doc);
+            if(!lyricdivs.empty())
             {
-                if(node.node().type() != pugi::node_element) continue;
+                for(const pugi::xpath_node& node : lyricdivs)
+                {
+                    if(node.node().type() != pugi::node_element) continue;
 
-                add_all_text_to_string(lyric_text, node.node());
-                break;
+                    add_all_text_to_string(lyric_text, node.node());
+                    break;
+                }
             }
-        }
 
-        if(!lyric_text.empty())
-        {
-            LOG_INFO("Successfully retrieved lyrics from %s", url.c_str());
-            const std::string_view trimmed_text = trim_surrounding_whitespace(lyric_text);
-
-            LyricDataRaw lyric = {};
-            lyric.source_id = id();
-            lyric.source_path = url;
-            lyric.artist = params.artist;
-            lyric.album = params.album;
-            lyric.title = params.title;
-            lyric.type = LyricType::Unsynced;
-            lyric.text_bytes = string_to_raw_bytes(trimmed_text);
-            result.push_back(lyric);
+            if(!lyric_text.empty())
+            {
+                LOG_INFO("Successfully retrieved lyrics from %s", url.c_str());
+                const std::string_view trimmed_text = trim_surrounding_whitespace(lyric_text);
+
+                LyricDataRaw lyric = {};
+                lyric.source_id = id();
+                lyric.source_path = url;
+                lyric.artist = params.artist;
+                lyric.album = params.album;
+                lyric.title = params.title;
+                lyric.type = LyricType::Unsynced;
+                lyric.text_bytes = string_to_raw_bytes(trimmed_text);
+                result.push_back(lyric);
+            }
         }
     }
     return result;
@@ -3,6 +3,7 @@
 
 #include "pugixml.hpp"
 
+#include "http.h"
 #include "logging.h"
 #include "lyric_source.h"
 #include "mvtf/mvtf.h"
@@ -84,26 +85,20 @@ void DarkLyricsSource::add_subsection_text_to_string(std::string& output, pugi::
 
 std::vector<LyricDataRaw> DarkLyricsSource::search(const LyricSearchParams& params, abort_callback& abort)
 {
-    http_request::ptr request = http_client::get()->create_request("GET");
-
     const std::string url_artist = remove_chars_for_url(params.artist);
     const std::string url_album = remove_chars_for_url(params.album);
     const std::string url_title = remove_chars_for_url(params.title);
     const std::string url = "http://darklyrics.com/lyrics/" + url_artist + "/" + url_album + ".html";
     LOG_INFO("Querying for lyrics from %s...", url.c_str());
 
-    pfc::string8 content;
-    try
-    {
-        file_ptr response_file = request->run(url.c_str(), abort);
-        response_file->read_string_raw(content, abort);
-        // NOTE: We're assuming here that the response is encoded in UTF-8
-    }
-    catch(const std::exception& e)
+    // NOTE: We're assuming here that the response is encoded in UTF-8
+    const http::Result response = http::get(url, abort);
+    if(!response.is_success())
     {
-        LOG_WARN("Failed to download darklyrics.com page %s: %s", url.c_str(), e.what());
+        LOG_WARN("Failed to download darklyrics.com page %s: %s", url.c_str(), response.error_message.c_str());
         return {};
     }
+    const std::string& content = response.response_content;
 
     std::string lyric_text;
     pugi::xml_document doc;
@@ -3,6 +3,7 @@
 
 #include "cJSON.h"
 
+#include "http.h"
 #include "logging.h"
 #include "lyric_source.h"
 
@@ -64,26 +65,24 @@ static std::string remove_chars_for_url(const std::string_view input)
 
 std::vector<LyricDataRaw> GeniusComSource::search(const LyricSearchParams& params, abort_callback& abort)
 {
-    auto request = http_client::get()->create_request("GET");
-    request->add_header(API_KEY_HEADER);
+    http::RequestOptions options = {};
+    options.headers.push_back(API_KEY_HEADER);
 
     std::string url = "https://api.genius.com/search?q=";
     url += remove_chars_for_url(params.artist);
     url += ' ';
     url += remove_chars_for_url(params.title);
 
-    pfc::string8 content;
-    try
+    // NOTE: We're assuming here that the response is encoded in UTF-8
+    const http::Result response = http::get(url, abort, options);
+    if(!response.is_success())
     {
-        file_ptr response_file = request->run(url.c_str(), abort);
-        response_file->read_string_raw(content, abort);
-        // NOTE: We're assuming here that the response is encoded in UTF-8
-    }
-    catch(const std::exception& e)
-    {
-        LOG_WARN("Failed to retrieve genius.com search result from %s: %s", url.c_str(), e.what());
+        LOG_WARN("Failed to retrieve genius.com search result from %s: %s",
+                 url.c_str(),
+                 response.error_message.c_str());
         return {};
     }
+    const std::string& content = response.response_content;
 
     std::vector<LyricDataRaw> song_metadata;
     { // Parser gets its own scope
@@ -147,22 +146,18 @@ std::vector<LyricDataRaw> GeniusComSource::search(const LyricSearchParams& param
 
 bool GeniusComSource::lookup(LyricDataRaw& data, abort_callback& abort)
 {
-    auto request = http_client::get()->create_request("GET");
-    request->add_header(API_KEY_HEADER);
+    http::RequestOptions options = {};
+    options.headers.push_back(API_KEY_HEADER);
 
+    // NOTE: We're assuming here that the response is encoded in UTF-8
     const std::string url = std::format("https://api.genius.com{}?text_format=plain", data.lookup_id);
-    pfc::string8 content;
-    try
-    {
-        file_ptr response_file = request->run(url.c_str(), abort);
-        response_file->read_string_raw(content, abort);
-        // NOTE: We're assuming here that the response is encoded in UTF-8
-    }
-    catch(const std::exception& e)
+    const http::Result response = http::get(url, abort, options);
+    if(!response.is_success())
     {
-        LOG_WARN("Failed to retrieve genius.com song data from %s: %s", url.c_str(), e.what());
+        LOG_WARN("Failed to retrieve genius.com song data from %s: %s", url.c_str(), response.error_message.c_str());
         return false;
     }
+    const std::string& content = response.response_content;
 
     LOG_INFO("Successfully retrieved lyrics from %s", url.c_str());
 
@@ -1,6 +1,8 @@
 #include "stdafx.h"
 
+#include "compiled_lyrics.h"
 #include "logging.h"
+#include "lyric_io.h"
 #include "lyric_source.h"
 #include "preferences.h"
 #include "tag_util.h"
@@ -94,6 +96,21 @@ bool LocalFileSource::lookup(LyricDataRaw& data, abort_callback& abort)
         file_ptr file;
         filesystem::g_open_read(file, file_path.c_str(), abort);
 
+        // NOTE: A compiled copy is only useful if we can tell when the file has changed since it was compiled
+        const t_filestats stats = file->get_stats(abort);
+        const bool use_compiled = compiled_lyrics::is_enabled() && (stats.m_timestamp != filetimestamp_invalid)
+                                  && (stats.m_size != filesize_invalid);
+        if(use_compiled)
+        {
+            std::optional<LyricData> compiled = compiled_lyrics::load(data, file_path, stats.m_timestamp, stats.m_size);
+            if(compiled.has_value())
+            {
+                data.text_bytes.clear();
+                data.parsed = std::make_shared<const LyricData>(std::move(compiled.value()));
+                return true;
+            }
+        }
+
         // NOTE: We need to use `read_till_eof` instead of `read_string_raw` because otherwise on some
         //       encodings it will see a null byte mid-way through and stop reading, dropping the rest
         //       of the string.
@@ -106,6 +123,13 @@ bool LocalFileSource::lookup(LyricDataRaw& data, abort_callback& abort)
 
         data.text_bytes.clear();
         data.text_bytes.insert(data.text_bytes.begin(), file_bytes.begin(), file_bytes.end());
+
+        if(use_compiled)
+        {
+            LyricData parsed = io::parse_raw_lyrics(data);
+            compiled_lyrics::store(file_path, stats.m_timestamp, stats.m_size, parsed);
+            data.parsed = std::make_shared<const LyricData>(std::move(parsed));
+        }
         return true;
     }
     catch(const std::exception& e)
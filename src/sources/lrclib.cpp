@@ -10,6 +10,7 @@
 #endif
 
 #include "hash_utils.h"
+#include "http.h"
 #include "logging.h"
 #include "lyric_data.h"
 #include "lyric_source.h"
@@ -41,6 +42,13 @@ class LrclibLyricsSource : public LyricSourceRemote
     }
     void upload(LyricData lyrics, abort_callback& abort) final;
 
+    t_filetimestamp result_cache_lifetime() const final
+    {
+        // LRCLIB lyrics are added and corrected by users (including via our own uploads) much more
+        // frequently than on other sources, so we don't want to hold on to old results for as long.
+        return system_time_periods::week;
+    }
+
 private:
     bool parse_lyric_result(cJSON* json_result, std::vector<LyricDataRaw>& output); // Returns success
     std::vector<LyricDataRaw> search_for_lyrics(std::string_view artist,
@@ -57,6 +65,14 @@ static const LyricSourceFactory<LrclibLyricsSource> src_factory;
 
 static const char* g_api_url = "https://lrclib.net/api/";
 
+static http::RequestOptions make_request_options()
+{
+    http::RequestOptions options = {};
+    options.headers.push_back("User-Agent: foo_openlyrics v" OPENLYRICS_VERSION
+                              " (https://github.com/jacquesh/foo_openlyrics)");
+    return options;
+}
+
 bool LrclibLyricsSource::parse_lyric_result(cJSON* json_result, std::vector<LyricDataRaw>& output) // Returns success
 {
     if((json_result == nullptr) || (json_result->type != cJSON_Object))
@@ -150,22 +166,15 @@ std::vector<LyricDataRaw> LrclibLyricsSource::search_for_lyrics(std::string_view
     url += "&track_name=" + urlencode(title);
     LOG_INFO("Searching for lyrics from %s", url.c_str());
 
-    pfc::string8 content;
-    try
-    {
-        http_request::ptr request = http_client::get()->create_request("GET");
-        request->add_header("User-Agent",
-                            "foo_openlyrics v" OPENLYRICS_VERSION " (https://github.com/jacquesh/foo_openlyrics)");
-        file_ptr response_file = request->run(url.c_str(), abort);
-        response_file->read_string_raw(content, abort);
-    }
-    catch(const std::exception& e)
+    const http::Result response = http::get(url, abort, make_request_options());
+    if(!response.is_success())
     {
-        LOG_WARN("Failed to make LRCLIB search request to %s: %s", url.c_str(), e.what());
+        LOG_WARN("Failed to make LRCLIB search request to %s: %s", url.c_str(), response.error_message.c_str());
         return {};
     }
+    const std::string& content = response.response_content;
 
-    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.get_length());
+    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.length());
     if((json == nullptr) || (json->type != cJSON_Array))
     {
         LOG_WARN("Received LRCLIB search result but root was malformed: %s", content.c_str());
@@ -204,22 +213,15 @@ std::vector<LyricDataRaw> LrclibLyricsSource::get_lyrics(std::string_view artist
     url += "&duration=" + std::to_string(duration_sec);
     LOG_INFO("Retrieving lyrics from %s", url.c_str());
 
-    pfc::string8 content;
-    try
+    const http::Result response = http::get(url, abort, make_request_options());
+    if(!response.is_success())
     {
-        http_request::ptr request = http_client::get()->create_request("GET");
-        request->add_header("User-Agent",
-                            "foo_openlyrics v" OPENLYRICS_VERSION " (https://github.com/jacquesh/foo_openlyrics)");
-        file_ptr response_file = request->run(url.c_str(), abort);
-        response_file->read_string_raw(content, abort);
-    }
-    catch(const std::exception& e)
-    {
-        LOG_WARN("Failed to make LRCLIB search request to %s: %s", url.c_str(), e.what());
+        LOG_WARN("Failed to make LRCLIB search request to %s: %s", url.c_str(), response.error_message.c_str());
         return {};
     }
+    const std::string& content = response.response_content;
 
-    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.get_length());
+    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.length());
     if((json == nullptr) || (json->type != cJSON_Object))
     {
         LOG_WARN("Received LRCLIB search result but root was malformed: %s", content.c_str());
@@ -262,22 +264,17 @@ static std::optional<UploadChallenge> get_challenge(abort_callback& abort)
 {
     LOG_INFO("Requesting a challenge for LRCLIB upload...");
     std::string url = std::string(g_api_url) + "request-challenge";
-    pfc::string8 content;
-    try
-    {
-        http_request::ptr request = http_client::get()->create_request("POST");
-        request->add_header("User-Agent",
-                            "foo_openlyrics v" OPENLYRICS_VERSION " (https://github.com/jacquesh/foo_openlyrics)");
-        file_ptr response_file = request->run(url.c_str(), abort);
-        response_file->read_string_raw(content, abort);
-    }
-    catch(const std::exception& e)
+    const http::Result response = http::post(url, "", abort, make_request_options());
+    if(!response.is_success())
     {
-        LOG_WARN("Failed to request LRCLIB upload challenge from %s: %s", url.c_str(), e.what());
+        LOG_WARN("Failed to request LRCLIB upload challenge from %s: %s",
+                 url.c_str(),
+                 response.error_message.c_str());
         return {};
     }
+    const std::string& content = response.response_content;
 
-    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.get_length());
+    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.length());
     if((json == nullptr) || (json->type != cJSON_Object))
     {
         LOG_WARN("Received LRCLIB challenge but JSON root was malformed: %s", content.c_str());
@@ -466,36 +463,28 @@ static void upload_lyrics(LyricData lyrics, const UploadChallenge& challenge, ui
 
     LOG_INFO("Uploading lyrics to LRCLIB...");
     std::string url = std::string(g_api_url) + "publish";
-    pfc::string8 content;
-    try
-    {
-        http_request_post_v2::ptr post;
-        http_client::get()->create_request("POST")->cast(post);
-        assert(post.is_valid());
+    http::RequestOptions options = make_request_options();
+    options.headers.push_back(std::string("X-Publish-Token: ") + token_buffer);
+    options.headers.push_back("Content-Type: application/json");
+    const http::Result response = http::post(url, json_str, abort, options);
+    cJSON_free(json_str);
 
-        post->add_header("User-Agent",
-                         "foo_openlyrics v" OPENLYRICS_VERSION " (https://github.com/jacquesh/foo_openlyrics)");
-        post->add_header("X-Publish-Token", token_buffer);
-        post->set_post_data(json_str, strlen(json_str), "application/json");
-        file_ptr response_file = post->run_ex(url.c_str(), abort);
-        response_file->read_string_raw(content, abort);
-    }
-    catch(const std::exception& e)
+    // NOTE: We don't check the response status here because error responses include a description of the error
+    if(!response.completed_successfully)
     {
-        LOG_WARN("Failed to upload to LRCLIB via %s: %s", url.c_str(), e.what());
-        cJSON_free(json_str);
+        LOG_WARN("Failed to upload to LRCLIB via %s: %s", url.c_str(), response.error_message.c_str());
         return;
     }
-    cJSON_free(json_str);
+    const std::string& content = response.response_content;
 
     // This is empty on success, and only populated on error
-    if(content.get_length() == 0)
+    if(content.empty())
     {
         LOG_INFO("Successfully uploaded lyrics for %s - %s to LRCLIB", lyrics.artist.c_str(), lyrics.title.c_str());
         return;
     }
 
-    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.get_length());
+    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.length());
     if((json == nullptr) || (json->type != cJSON_Object))
     {
         LOG_WARN("Received LRCLIB upload error response but JSON root was malformed: %s", content.c_str());
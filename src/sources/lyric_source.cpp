@@ -1,11 +1,18 @@
 #include "stdafx.h"
 
+#include <chrono>
+#ifdef _DEBUG
+#include <crtdbg.h>
+#endif
+
 #include "pugixml.hpp"
 #include "tidy.h"
 #include "tidybuffio.h"
 
+#include "http_fixtures.h"
 #include "logging.h"
 #include "lyric_source.h"
+#include "mvtf/mvtf.h"
 #include "tag_util.h"
 
 LyricSearchParams::LyricSearchParams(const metadb_v2_rec_t& track_info)
@@ -34,11 +41,17 @@ LyricSearchParams::LyricSearchParams(std::string in_artist,
 {
 }
 
-static std::vector<LyricSourceBase*> g_lyric_sources;
+// NOTE: This is a function-local static because sources register themselves during static initialisation,
+//       possibly before any global in this file has been initialised.
+static std::vector<LyricSourceBase*>& get_lyric_sources()
+{
+    static std::vector<LyricSourceBase*> sources;
+    return sources;
+}
 
 LyricSourceBase* LyricSourceBase::get(GUID id)
 {
-    for(LyricSourceBase* src : g_lyric_sources)
+    for(LyricSourceBase* src : get_lyric_sources())
     {
         if(src->id() == id)
         {
@@ -51,18 +64,19 @@ LyricSourceBase* LyricSourceBase::get(GUID id)
 
 std::vector<GUID> LyricSourceBase::get_all_ids()
 {
+    const std::vector<LyricSourceBase*>& sources = get_lyric_sources();
     std::vector<GUID> result;
-    result.reserve(g_lyric_sources.size());
-    for(LyricSourceBase* src : g_lyric_sources)
+    result.reserve(sources.size());
+    for(LyricSourceBase* src : sources)
     {
         result.push_back(src->id());
     }
     return result;
 }
 
-void LyricSourceBase::on_init()
+void LyricSourceBase::register_source(LyricSourceBase* source)
 {
-    g_lyric_sources.push_back(this);
+    get_lyric_sources().push_back(source);
 }
 
 std::string LyricSourceRemote::urlencode(std::string_view input)
@@ -151,6 +165,16 @@ bool LyricSourceRemote::supports_upload() const
     return false;
 }
 
+t_filetimestamp LyricSourceRemote::result_cache_lifetime() const
+{
+    return 4 * system_time_periods::week;
+}
+
+size_t LyricSourceRemote::result_cache_max_entries() const
+{
+    return 500;
+}
+
 void LyricSourceRemote::upload(LyricData /*lyrics*/, abort_callback& /*abort*/)
 {
     LOG_WARN("Cannot upload to a generic remote source (that doesn't support upload)");
@@ -235,3 +259,100 @@ void LyricSourceRemote::add_all_text_to_string(std::string& output, const pugi::
         break;
     }
 }
+
+// ============
+// Tests
+// ============
+#if MVTF_TESTS_ENABLED
+#ifdef _DEBUG
+// NOTE: This counts allocations made on any thread, but nothing else should be running while a benchmark runs
+static std::atomic<uint64_t> g_benchmark_allocation_count = 0;
+static std::atomic<uint64_t> g_benchmark_allocation_bytes = 0;
+static int count_benchmark_allocation(int alloc_type,
+                                      void* /*user_data*/,
+                                      size_t size,
+                                      int /*block_type*/,
+                                      long /*request_number*/,
+                                      const unsigned char* /*filename*/,
+                                      int /*line_number*/)
+{
+    if(alloc_type != _HOOK_FREE)
+    {
+        g_benchmark_allocation_count++;
+        g_benchmark_allocation_bytes += size;
+    }
+    return TRUE;
+}
+#endif
+
+// Measures how long each remote source spends handling responses (parsing HTML or JSON and extracting the lyrics)
+// by searching for a few tracks and looking up all of the results, using previously-recorded responses.
+// This only runs if OPENLYRICS_HTTP_REPLAY_DIR is set (see http_fixtures.h). To record the responses for it to use,
+// run it once with OPENLYRICS_HTTP_RECORD_DIR set instead. Allocations are only counted in debug builds.
+MVTF_TEST(sources_benchmark_search_and_lookup_with_recorded_responses)
+{
+    const http_fixtures::Mode mode = http_fixtures::get_mode();
+    if(mode == http_fixtures::Mode::Disabled)
+    {
+        return;
+    }
+
+    const LyricSearchParams tracks[] = {
+        { "Metallica", "Master of Puppets", "Battery", 312 },
+        { "Daft Punk", "Discovery", "One More Time", 320 },
+        { "ABBA", "Arrival", "Dancing Queen", 231 },
+        { "Caetano Veloso", "Transa", "You Don't Know Me", 229 },
+    };
+    const int iterations = (mode == http_fixtures::Mode::Replay) ? 20 : 1;
+
+    for(GUID source_id : LyricSourceBase::get_all_ids())
+    {
+        LyricSourceRemote* source = dynamic_cast<LyricSourceRemote*>(LyricSourceBase::get(source_id));
+        if(source == nullptr)
+        {
+            continue;
+        }
+
+#ifdef _DEBUG
+        g_benchmark_allocation_count = 0;
+        g_benchmark_allocation_bytes = 0;
+        const _CRT_ALLOC_HOOK previous_hook = _CrtSetAllocHook(count_benchmark_allocation);
+#endif
+
+        size_t lyrics_found = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for(int i = 0; i < iterations; i++)
+        {
+            for(const LyricSearchParams& track : tracks)
+            {
+                for(LyricDataRaw& result : source->search(track, fb2k::noAbort))
+                {
+                    if(!result.lookup_id.empty() && !source->lookup(result, fb2k::noAbort))
+                    {
+                        continue;
+                    }
+                    lyrics_found += result.text_bytes.empty() ? 0 : 1;
+                }
+            }
+        }
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        const double searches = double(iterations) * double(std::size(tracks));
+        const std::string source_name = from_tstring(source->friendly_name());
+
+#ifdef _DEBUG
+        _CrtSetAllocHook(previous_hook);
+        LOG_INFO("Source benchmark for %s: %.3fms per search, %zu lyrics found, %.0f allocations (%.1fKB) per search",
+                 source_name.c_str(),
+                 elapsed.count() / searches,
+                 lyrics_found / size_t(iterations),
+                 double(g_benchmark_allocation_count) / searches,
+                 double(g_benchmark_allocation_bytes) / (1024.0 * searches));
+#else
+        LOG_INFO("Source benchmark for %s: %.3fms per search, %zu lyrics found",
+                 source_name.c_str(),
+                 elapsed.count() / searches,
+                 lyrics_found / size_t(iterations));
+#endif
+    }
+}
+#endif
@@ -35,8 +35,7 @@ class LyricSourceBase : public initquit
 public:
     static LyricSourceBase* get(GUID guid);
     static std::vector<GUID> get_all_ids();
-
-    void on_init() final;
+    static void register_source(LyricSourceBase* source);
 
     virtual const GUID& id() const = 0;
     virtual std::tstring_view friendly_name() const = 0;
@@ -83,6 +82,11 @@ public:
     virtual std::vector<LyricDataRaw> search(const LyricSearchParams& params, abort_callback& abort) = 0;
 
     virtual bool supports_upload() const;
+
+    // How long search & lookup results from this source remain valid in the search result cache,
+    // and the maximum number of results from this source that the cache may hold at once.
+    virtual t_filetimestamp result_cache_lifetime() const;
+    virtual size_t result_cache_max_entries() const;
     virtual void upload(LyricData lyrics,
                         abort_callback& abort); // Take lyrics by value since the upload happens in a task thread
 
@@ -92,9 +96,16 @@ protected:
     static void add_all_text_to_string(std::string& output, const pugi::xml_node& node);
 };
 
+// NOTE: Sources are registered when their factory is constructed (rather than when fb2k initialises them) so that
+//       they can also be found when running tests, where fb2k never initialises anything.
 template<typename T>
 class LyricSourceFactory : public initquit_factory_t<T>
 {
+public:
+    LyricSourceFactory()
+    {
+        LyricSourceBase::register_source(&this->get_static_instance());
+    }
 };
 
 // NOTE: We need access to this one function from outside the normal lyric-source interaction flow
@@ -5,6 +5,7 @@
 #include "cJSON.h"
 #include "pugixml.hpp"
 
+#include "http.h"
 #include "logging.h"
 #include "lyric_source.h"
 #include "mvtf/mvtf.h"
@@ -192,27 +193,22 @@ std::vector<LyricDataRaw> LyricfindSource::search(const LyricSearchParams& param
     url += '-';
     url += transform_chars_for_url(params.title);
 
-    pfc::string8 content;
-    try
-    {
-        auto request = http_client::get()->create_request("GET");
-
-        // Without these we get 403s back
-        request->add_header("User-Agent",
-                            "Mozilla/5.0 (Windows NT 10.0; Win64; x64; rv:128.0) Gecko/20100101 Firefox/128.0");
+    // Without these we get 403s back
+    http::RequestOptions options = {};
+    options.headers.push_back("User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64; rv:128.0) Gecko/20100101 "
+                              "Firefox/128.0");
 
-        file_ptr response_file = request->run(url.c_str(), abort);
-        response_file->read_string_raw(content, abort);
-        // NOTE: We're assuming here that the response is encoded in UTF-8
-    }
-    catch(const std::exception& e)
+    // NOTE: We're assuming here that the response is encoded in UTF-8
+    const http::Result response = http::get(url, abort, options);
+    if(!response.is_success())
     {
-        LOG_WARN("Failed to download lyricfind.com page %s: %s", url.c_str(), e.what());
+        LOG_WARN("Failed to download lyricfind.com page %s: %s", url.c_str(), response.error_message.c_str());
         return {};
     }
+    const std::string& content = response.response_content;
 
     LOG_INFO("Page %s retrieved", url.c_str());
-    std::optional<LyricDataRaw> result = extract_lyrics_from_page(url, content);
+    std::optional<LyricDataRaw> result = extract_lyrics_from_page(url, content.c_str());
     if(!result.has_value())
     {
         throw new std::runtime_error("Failed to parse lyrics, the page format may have changed");
@@ -3,6 +3,7 @@
 
 #include "pugixml.hpp"
 
+#include "http.h"
 #include "logging.h"
 #include "lyric_source.h"
 #include "mvtf/mvtf.h"
@@ -72,31 +73,26 @@ std::string LyricsifySource::extract_lyrics_from_page(pfc::string8 page_content)
 
 std::vector<LyricDataRaw> LyricsifySource::search(const LyricSearchParams& params, abort_callback& abort)
 {
-    http_request::ptr request = http_client::get()->create_request("GET");
-
     // Without a User-Agent we sometimes only get partial lyrics back
-    request->add_header("User-Agent",
-                        "Mozilla/5.0 (Windows NT 10.0; Win64; x64; rv:128.0) Gecko/20100101 Firefox/128.0");
+    http::RequestOptions options = {};
+    options.headers.push_back("User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64; rv:128.0) Gecko/20100101 "
+                              "Firefox/128.0");
 
     const std::string url_artist = transform_tag_for_url(params.artist);
     const std::string url_title = transform_tag_for_url(params.title);
     const std::string url = "http://www.lyricsify.com/lyrics/" + url_artist + "/" + url_title;
     LOG_INFO("Querying for lyrics from %s...", url.c_str());
 
-    pfc::string8 content;
-    try
-    {
-        file_ptr response_file = request->run(url.c_str(), abort);
-        response_file->read_string_raw(content, abort);
-        // NOTE: We're assuming here that the response is encoded in UTF-8
-    }
-    catch(const std::exception& e)
+    // NOTE: We're assuming here that the response is encoded in UTF-8
+    const http::Result response = http::get(url, abort, options);
+    if(!response.is_success())
     {
-        LOG_WARN("Failed to download lyricsify.com page %s: %s", url.c_str(), e.what());
+        LOG_WARN("Failed to download lyricsify.com page %s: %s", url.c_str(), response.error_message.c_str());
         return {};
     }
+    const std::string& content = response.response_content;
 
-    const std::string lyric_text = extract_lyrics_from_page(content);
+    const std::string lyric_text = extract_lyrics_from_page(content.c_str());
     if(lyric_text.empty())
     {
         throw new std::runtime_error("Failed to parse lyrics, the page format may have changed");
@@ -139,7 +139,7 @@ std::vector<LyricDataRaw> MetalArchivesSource::search(const LyricSearchParams& p
     LOG_INFO("Querying for lyrics from %s...", url.c_str());
 
     // NOTE: We're assuming here that the response is encoded in UTF-8
-    const http::Result result = http::get_http2(url, abort);
+    const http::Result result = http::get(url, abort);
     if(!result.is_success())
     {
         LOG_WARN("Failed to download metal-archives.com page %s: %s", url.c_str(), result.error_message.c_str());
@@ -166,7 +166,7 @@ bool MetalArchivesSource::lookup(LyricDataRaw& data, abort_callback& abort)
     LOG_INFO("Looking up lyrics at %s...", url.c_str());
 
     // NOTE: We're assuming here that the response is encoded in UTF-8
-    const http::Result result = http::get_http2(url, abort);
+    const http::Result result = http::get(url, abort);
     if(!result.is_success())
     {
         LOG_WARN("Failed to download metal-archives.com page %s: %s", url.c_str(), result.error_message.c_str());
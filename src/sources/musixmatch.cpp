@@ -2,6 +2,7 @@
 
 #include "cJSON.h"
 
+#include "http.h"
 #include "logging.h"
 #include "lyric_data.h"
 #include "lyric_source.h"
@@ -39,6 +40,21 @@ static const LyricSourceFactory<MusixmatchLyricsSource> src_factory;
 static const char* g_api_url = "https://apic-desktop.musixmatch.com/ws/1.1/";
 static const char* g_common_params = "user_language=en&app_id=web-desktop-app-v1.0";
 
+static http::RequestOptions make_request_options()
+{
+    http::RequestOptions options = {};
+
+    // NOTE: Our first request gets a 301 (permanent redirect back to the same URL) with a header instructing us to
+    //       set the AWSELB and AWSELBCORS cookies. If we followed the redirect without them then it would just
+    //       redirect again until the request failed. The cookie engine (see http.cpp) stores them for us and
+    //       sends them with the redirected request (and with later requests, while cookies are being shared).
+
+    // NOTE: Our requests either include the user's token in the URL or are a request for a new token,
+    //       neither of which should be cached.
+    options.allow_caching = false;
+    return options;
+}
+
 std::vector<LyricDataRaw> MusixmatchLyricsSource::get_song_ids(const LyricSearchParams& params,
                                                                abort_callback& abort) const
 {
@@ -51,31 +67,15 @@ std::vector<LyricDataRaw> MusixmatchLyricsSource::get_song_ids(const LyricSearch
     LOG_INFO("Querying for track ID from %s", url.c_str());
     url += apikey; // Add this after logging so we don't log sensitive info
 
-    pfc::string8 content;
-    try
-    {
-        http_request::ptr request = http_client::get()->create_request("GET");
-
-        // NOTE: Without adding the AWSELB and AWSELBCORS headers, we get a 301 (permanent redirect back)
-        //       with a header instructing us to set those cookies to the given hash.
-        //       The fb2k http API automatically follows the redirect but does not honour the Set-Cookie headers.
-        //       The redirect goes to the same URL and the request then fails after a while (presumably because
-        //       ELB thinks we're DoS'ing them and kills the connection).
-        //       Setting the headers here to just *some* value (even if its not a useful one) seems to make it work.
-        //       We may need to upgrade this in future to actually set the cookies that we're asked to set.
-        request->add_header("cookie", "AWSELBCORS=0; AWSELB=0");
-
-        file_ptr response_file = request->run(url.c_str(), abort);
-
-        response_file->read_string_raw(content, abort);
-    }
-    catch(const std::exception& e)
+    const http::Result response = http::get(url, abort, make_request_options());
+    if(!response.is_success())
     {
-        LOG_WARN("Failed to make Musixmatch search request: %s", e.what());
+        LOG_WARN("Failed to make Musixmatch search request: %s", response.error_message.c_str());
         return {};
     }
+    const std::string& content = response.response_content;
 
-    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.get_length());
+    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.length());
     cJSON* json_message = cJSON_GetObjectItem(json, "message");
     cJSON* json_body = cJSON_GetObjectItem(json_message, "body");
     cJSON* json_tracklist = cJSON_GetObjectItem(json_body, "track_list");
@@ -149,24 +149,15 @@ bool MusixmatchLyricsSource::get_lyrics(LyricDataRaw& data,
     url += apikey; // Add this after logging so we don't log sensitive info
     data.source_path = url;
 
-    pfc::string8 content;
-    try
-    {
-        http_request::ptr request = http_client::get()->create_request("GET");
-        request->add_header("cookie",
-                            "AWSELBCORS=0; AWSELB=0"); // NOTE: See the comment on the cookie in the track ID query
-
-        file_ptr response_file = request->run(url.c_str(), abort);
-
-        response_file->read_string_raw(content, abort);
-    }
-    catch(const std::exception& e)
+    const http::Result response = http::get(url, abort, make_request_options());
+    if(!response.is_success())
     {
-        LOG_WARN("Failed to make Musixmatch %s request: %s", method, e.what());
+        LOG_WARN("Failed to make Musixmatch %s request: %s", method, response.error_message.c_str());
         return false;
     }
+    const std::string& content = response.response_content;
 
-    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.get_length());
+    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.length());
     cJSON* json_message = cJSON_GetObjectItem(json, "message");
     cJSON* json_body = cJSON_GetObjectItem(json_message, "body");
     cJSON* json_lyrics = cJSON_GetObjectItem(json_body, body_entry_name);
@@ -235,24 +226,15 @@ std::string musixmatch_get_token(abort_callback& abort)
     std::string url = std::string(g_api_url) + "token.get?" + g_common_params;
     LOG_INFO("Attempting to get Musixmatch token from %s...", url.c_str());
 
-    pfc::string8 content;
-    try
-    {
-        http_request::ptr request = http_client::get()->create_request("GET");
-        request->add_header("cookie",
-                            "AWSELBCORS=0; AWSELB=0"); // NOTE: See the comment on the cookie in the track ID query
-
-        file_ptr response_file = request->run(url.c_str(), abort);
-
-        response_file->read_string_raw(content, abort);
-    }
-    catch(const std::exception& e)
+    const http::Result response = http::get(url, abort, make_request_options());
+    if(!response.is_success())
     {
-        LOG_WARN("Failed to get Musixmatch token from %s: %s", url.c_str(), e.what());
+        LOG_WARN("Failed to get Musixmatch token from %s: %s", url.c_str(), response.error_message.c_str());
         return "";
     }
+    const std::string& content = response.response_content;
 
-    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.get_length());
+    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.length());
     if((json == nullptr) || (json->type != cJSON_Object))
     {
         LOG_WARN("Received musixmatch token response but root was malformed: %s", content.c_str());
@@ -2,6 +2,7 @@
 
 #include "cJSON.h"
 
+#include "http.h"
 #include "logging.h"
 #include "lyric_data.h"
 #include "lyric_source.h"
@@ -30,20 +31,20 @@ static const LyricSourceFactory<NetEaseLyricsSource> src_factory;
 
 static const char* BASE_URL = "https://music.163.com/api";
 
-static http_request::ptr make_post_request()
+static http::RequestOptions make_request_options()
 {
-    http_request::ptr request = http_client::get()->create_request("POST");
-    request->add_header("Referer", "https://music.163.com");
-    request->add_header("Cookie", "appver=2.0.2");
-    request->add_header("charset", "utf-8");
-    request->add_header("Content-Type", "application/x-www-form-urlencoded");
+    http::RequestOptions options = {};
+    options.headers.push_back("Referer: https://music.163.com");
+    options.headers.push_back("Cookie: appver=2.0.2");
+    options.headers.push_back("charset: utf-8");
+    options.headers.push_back("Content-Type: application/x-www-form-urlencoded");
 
     // For some reason, passing this header (which gives an IP in China's IP range,
     // seemingly to suggest that the requester is in China) causes NetEase to return
     // significantly more sensible results in some cases.
-    request->add_header("X-Real-IP", "202.96.0.0");
+    options.headers.push_back("X-Real-IP: 202.96.0.0");
 
-    return request;
+    return options;
 }
 
 std::vector<LyricDataRaw> NetEaseLyricsSource::parse_song_ids(cJSON* json)
@@ -156,21 +157,15 @@ std::vector<LyricDataRaw> NetEaseLyricsSource::search(const LyricSearchParams& p
                             + urlencode(params.title) + "&type=1&offset=0&sub=false&limit=5";
     LOG_INFO("Querying for song ID from %s...", url.c_str());
 
-    pfc::string8 content;
-    try
+    const http::Result response = http::post(url, "", abort, make_request_options());
+    if(!response.is_success())
     {
-        http_request::ptr request = make_post_request();
-        file_ptr response_file = request->run(url.c_str(), abort);
-
-        response_file->read_string_raw(content, abort);
-    }
-    catch(const std::exception& e)
-    {
-        LOG_WARN("Failed to download netease page %s: %s", url.c_str(), e.what());
+        LOG_WARN("Failed to download netease page %s: %s", url.c_str(), response.error_message.c_str());
         return {};
     }
+    const std::string& content = response.response_content;
 
-    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.get_length());
+    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.length());
     std::vector<LyricDataRaw> song_ids = parse_song_ids(json);
     cJSON_Delete(json);
 
@@ -189,22 +184,16 @@ bool NetEaseLyricsSource::lookup(LyricDataRaw& data, abort_callback& abort)
     data.source_path = url;
     LOG_INFO("Get NetEase lyrics for song ID %s from %s...", data.lookup_id.c_str(), url.c_str());
 
-    pfc::string8 content;
-    try
-    {
-        http_request::ptr request = make_post_request();
-        file_ptr response_file = request->run(url.c_str(), abort);
-
-        response_file->read_string_raw(content, abort);
-    }
-    catch(const std::exception& e)
+    const http::Result response = http::post(url, "", abort, make_request_options());
+    if(!response.is_success())
     {
-        LOG_WARN("Failed to download NetEase page %s: %s", url.c_str(), e.what());
+        LOG_WARN("Failed to download NetEase page %s: %s", url.c_str(), response.error_message.c_str());
         return false;
     }
+    const std::string& content = response.response_content;
 
     bool success = false;
-    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.get_length());
+    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.length());
     if((json != nullptr) && (json->type == cJSON_Object))
     {
         cJSON* lrc_item = cJSON_GetObjectItem(json, "lrc");
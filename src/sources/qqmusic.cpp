@@ -2,6 +2,7 @@
 
 #include "cJSON.h"
 
+#include "http.h"
 #include "logging.h"
 #include "lyric_data.h"
 #include "lyric_source.h"
@@ -27,11 +28,11 @@ private:
 };
 static const LyricSourceFactory<QQMusicLyricsSource> src_factory;
 
-static http_request::ptr make_get_request()
+static http::RequestOptions make_request_options()
 {
-    http_request::ptr request = http_client::get()->create_request("GET");
-    request->add_header("Referer", "http://y.qq.com/portal/player.html");
-    return request;
+    http::RequestOptions options = {};
+    options.headers.push_back("Referer: http://y.qq.com/portal/player.html");
+    return options;
 }
 
 std::vector<LyricDataRaw> QQMusicLyricsSource::parse_song_ids(cJSON* json) const
@@ -119,21 +120,15 @@ std::vector<LyricDataRaw> QQMusicLyricsSource::search(const LyricSearchParams& p
                       + urlencode(params.artist) + '+' + urlencode(params.title);
     LOG_INFO("Querying for song ID from %s...", url.c_str());
 
-    pfc::string8 content;
-    try
+    const http::Result response = http::get(url, abort, make_request_options());
+    if(!response.is_success())
     {
-        http_request::ptr request = make_get_request();
-        file_ptr response_file = request->run(url.c_str(), abort);
-
-        response_file->read_string_raw(content, abort);
-    }
-    catch(const std::exception& e)
-    {
-        LOG_WARN("Failed to download QQMusic page %s: %s", url.c_str(), e.what());
+        LOG_WARN("Failed to download QQMusic page %s: %s", url.c_str(), response.error_message.c_str());
         return {};
     }
+    const std::string& content = response.response_content;
 
-    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.get_length());
+    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.length());
     std::vector<LyricDataRaw> song_ids = parse_song_ids(json);
     cJSON_Delete(json);
 
@@ -154,22 +149,16 @@ bool QQMusicLyricsSource::lookup(LyricDataRaw& data, abort_callback& abort)
     data.source_path = url;
     LOG_INFO("Get QQMusic lyrics for song ID %s from %s...", data.lookup_id.c_str(), url.c_str());
 
-    pfc::string8 content;
-    try
-    {
-        http_request::ptr request = make_get_request();
-        file_ptr response_file = request->run(url.c_str(), abort);
-
-        response_file->read_string_raw(content, abort);
-    }
-    catch(const std::exception& e)
+    const http::Result response = http::get(url, abort, make_request_options());
+    if(!response.is_success())
     {
-        LOG_WARN("Failed to download QQMusic page %s: %s", url.c_str(), e.what());
+        LOG_WARN("Failed to download QQMusic page %s: %s", url.c_str(), response.error_message.c_str());
         return false;
     }
+    const std::string& content = response.response_content;
 
     bool success = false;
-    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.get_length());
+    cJSON* json = cJSON_ParseWithLength(content.c_str(), content.length());
     if((json != nullptr) && (json->type == cJSON_Object))
     {
         cJSON* lyric_item = cJSON_GetObjectItem(json, "lyric");
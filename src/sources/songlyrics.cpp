@@ -3,6 +3,7 @@
 
 #include "pugixml.hpp"
 
+#include "http.h"
 #include "logging.h"
 #include "lyric_source.h"
 #include "mvtf/mvtf.h"
@@ -65,26 +66,20 @@ static bool is_text_placeholder(std::string_view lyrics_text, const LyricSearchP
 
 std::vector<LyricDataRaw> SonglyricsSource::search(const LyricSearchParams& params, abort_callback& abort)
 {
-    auto request = http_client::get()->create_request("GET");
-
     std::string url = "https://songlyrics.com/";
     url += remove_chars_for_url(params.artist);
     url += '/';
     url += remove_chars_for_url(params.title);
     url += "-lyrics";
 
-    pfc::string8 content;
-    try
-    {
-        file_ptr response_file = request->run(url.c_str(), abort);
-        response_file->read_string_raw(content, abort);
-        // NOTE: We're assuming here that the response is encoded in UTF-8
-    }
-    catch(const std::exception& e)
+    // NOTE: We're assuming here that the response is encoded in UTF-8
+    const http::Result response = http::get(url, abort);
+    if(!response.is_success())
     {
-        LOG_WARN("Failed to download songlyrics.com page %s: %s", url.c_str(), e.what());
+        LOG_WARN("Failed to download songlyrics.com page %s: %s", url.c_str(), response.error_message.c_str());
         return {};
     }
+    const std::string& content = response.response_content;
 
     LOG_INFO("Page %s retrieved", url.c_str());
     std::string lyric_text;
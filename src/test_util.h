@@ -0,0 +1,42 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include <chrono>
+
+#include "lyric_data.h"
+#include "mvtf/mvtf.h"
+
+// Helpers shared between the tests and benchmarks in different files
+#if MVTF_TESTS_ENABLED
+inline bool lyrics_are_identical(const LyricData& lhs, const LyricData& rhs)
+{
+    if((lhs.tags != rhs.tags) || (lhs.timestamp_offset != rhs.timestamp_offset)
+       || (lhs.lines.size() != rhs.lines.size()))
+    {
+        return false;
+    }
+
+    for(size_t i = 0; i < lhs.lines.size(); i++)
+    {
+        if((lhs.lines[i].text != rhs.lines[i].text) || (lhs.lines[i].timestamp != rhs.lines[i].timestamp))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Runs the given function the given number of times and returns the average time taken by each run, in milliseconds
+template<typename TFunction>
+double measure_average_ms(int iterations, TFunction run)
+{
+    const auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < iterations; i++)
+    {
+        run();
+    }
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / double(iterations);
+}
+#endif
@@ -103,7 +103,7 @@ public:
                     }
 
                     LyricSearchHandle handle(LyricUpdate::Type::InternalSearch, track, track_info, abort);
-                    io::search_for_lyrics(handle, true);
+                    io::search_for_local_lyrics_inline(handle);
                     bool success = handle.wait_for_complete(30'000);
                     if(success)
                     {
@@ -168,7 +168,7 @@ public:
                 {
                     const metadb_v2_rec_t track_info = get_full_metadata(track);
                     LyricSearchHandle search_handle(LyricUpdate::Type::InternalSearch, track, track_info, abort);
-                    io::search_for_lyrics(search_handle, true);
+                    io::search_for_local_lyrics_inline(search_handle);
                     bool success = search_handle.wait_for_complete(30'000);
                     if(success)
                     {
@@ -271,7 +271,7 @@ public:
                         const metadb_v2_rec_t& track_info = all_track_info[i];
 
                         LyricSearchHandle handle(LyricUpdate::Type::InternalSearch, track, track_info, abort);
-                        io::search_for_lyrics(handle, true);
+                        io::search_for_local_lyrics_inline(handle);
                         bool success = handle.wait_for_complete(30'000);
                         if(success && handle.has_result())
                         {
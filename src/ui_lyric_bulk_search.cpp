@@ -32,7 +32,7 @@ public:
     MSG_WM_INITDIALOG(OnInitDialog)
     MSG_WM_DESTROY(OnDestroyDialog)
     MSG_WM_CLOSE(OnClose)
-    MSG_WM_TIMER(OnTimer)
+    MESSAGE_HANDLER_EX(WM_BULK_SEARCH_UPDATE, OnSearchUpdate)
     COMMAND_HANDLER_EX(IDC_BULKSEARCH_CLOSE, BN_CLICKED, OnCancel)
     END_MSG_MAP()
 
@@ -45,28 +45,52 @@ private:
         metadb_v2_rec_t track_info;
     };
 
+    struct ChildSearch
+    {
+        ChildSearch(int index, const TrackAndInfo& track, abort_callback& abort)
+            : track_index(index)
+            , handle(LyricUpdate::Type::ManualSearch, track.track, track.track_info, abort)
+        {
+        }
+
+        const int track_index;
+        LyricSearchHandle handle;
+    };
+
     BOOL OnInitDialog(CWindow parent, LPARAM clientData);
     void OnDestroyDialog();
     void OnClose();
-    LRESULT OnTimer(WPARAM);
+    LRESULT OnSearchUpdate(UINT, WPARAM, LPARAM);
     void OnCancel(UINT btn_id, int notify_code, CWindow btn);
 
+    void start_searches();
+    void process_search_completion(ChildSearch& search);
+    void set_track_status(int track_index, const TCHAR* status);
     void update_status_text();
     void add_tracks_to_ui(const std::vector<TrackAndInfo>& new_tracks);
 
-    std::optional<LyricSearchHandle> m_child_search;
+    // NOTE: It is crucial that this is a std::list so that inserting new items or removing old ones does not
+    //       move the other handles, which the search tasks hold references to until they complete.
+    std::list<ChildSearch> m_child_searches;
     abort_callback_impl m_child_abort;
 
     std::vector<TrackAndInfo> m_tracks_to_search;
     int m_next_search_index;
+    int m_completed_search_count;
 
     fb2k::CCoreDarkModeHooks m_dark;
 };
 
-static const UINT_PTR BULK_SEARCH_UPDATE_TIMER = 290110919;
+// Posted to the dialog (from the search thread) whenever one of the searches has a new result or completes
+static const UINT WM_BULK_SEARCH_UPDATE = WM_APP + 1;
+
+// NOTE: We don't need to limit concurrent searches to be polite to the lyric servers, because every request to a
+//       remote source is rate-limited per-site (see http::get). This just limits how many threads we tie up.
+static const size_t BULK_SEARCH_MAX_CONCURRENT_SEARCHES = 4;
 
 BulkLyricSearch::BulkLyricSearch(const std::vector<metadb_handle_ptr>& tracks_to_search)
     : m_next_search_index(0)
+    , m_completed_search_count(0)
 {
     add_tracks(tracks_to_search);
 }
@@ -108,12 +132,7 @@ BOOL BulkLyricSearch::OnInitDialog(CWindow /*parent*/, LPARAM /*clientData*/)
     SendDlgItemMessage(IDC_BULKSEARCH_PROGRESS, PBM_SETSTEP, 1, 0);
 
     add_tracks_to_ui(m_tracks_to_search);
-
-    UINT_PTR result = SetTimer(BULK_SEARCH_UPDATE_TIMER, 0, nullptr);
-    if(result != BULK_SEARCH_UPDATE_TIMER)
-    {
-        LOG_WARN("Unexpected timer result when starting bulk search update timer");
-    }
+    start_searches();
 
     ShowWindow(SW_SHOW);
     return TRUE;
@@ -125,18 +144,17 @@ void BulkLyricSearch::OnDestroyDialog()
     assert(g_active_bulk_search_panel == this);
     g_active_bulk_search_panel = nullptr;
 
-    if(m_child_search.has_value())
+    for(ChildSearch& search : m_child_searches)
     {
-        bool completed = m_child_search.value().wait_for_complete(10'000);
+        bool completed = search.handle.wait_for_complete(10'000);
         if(!completed)
         {
             LOG_WARN("Failed to complete custom lyric search before closing the window");
         }
 
-        OnTimer(0); // Process the result, if we have one
+        process_search_completion(search); // Process the result, if we have one
     }
-
-    KillTimer(BULK_SEARCH_UPDATE_TIMER);
+    m_child_searches.clear();
 }
 
 void BulkLyricSearch::OnClose()
@@ -182,34 +200,11 @@ void BulkLyricSearch::add_tracks(const std::vector<metadb_handle_ptr>& tracks_to
     }
 
     assert(m_tracks_to_search.size() + new_tracks.size() <= INT_MAX);
-    const bool had_finished = (m_next_search_index >= int(m_tracks_to_search.size()));
     m_tracks_to_search.insert(m_tracks_to_search.end(), new_tracks.begin(), new_tracks.end());
     if(m_hWnd != nullptr)
     {
         add_tracks_to_ui(new_tracks);
-
-        // Only start the timer if we were still busy searching for a track.
-        // This prevents users from skipping the 10 second extra wait time between remote
-        // searches by adding tracks one-by-one.
-        if(had_finished)
-        {
-            LVITEM subitem_status = {};
-            subitem_status.mask = LVIF_TEXT;
-            subitem_status.iItem = m_next_search_index;
-            subitem_status.iSubItem = 2;
-            subitem_status.pszText = _T("Searching...");
-            LRESULT status_success = SendDlgItemMessageW(IDC_BULKSEARCH_LIST,
-                                                         LVM_SETITEMTEXT,
-                                                         m_next_search_index,
-                                                         (LPARAM)&subitem_status);
-            assert(status_success);
-
-            UINT_PTR result = SetTimer(BULK_SEARCH_UPDATE_TIMER, 0, nullptr);
-            if(result != BULK_SEARCH_UPDATE_TIMER)
-            {
-                LOG_WARN("Unexpected timer result when starting bulk search update timer");
-            }
-        }
+        start_searches();
     }
 }
 
@@ -241,18 +236,6 @@ void BulkLyricSearch::add_tracks_to_ui(const std::vector<TrackAndInfo>& new_trac
                                                      item_index,
                                                      (LPARAM)&subitem_artist);
         assert(artist_success);
-
-        const TCHAR* status_string = ((item_index == 0) ? _T("Searching...") : _T(""));
-        LVITEM subitem_status = {};
-        subitem_status.mask = LVIF_TEXT;
-        subitem_status.iItem = int(item_index);
-        subitem_status.iSubItem = 2;
-        subitem_status.pszText = const_cast<TCHAR*>(status_string);
-        LRESULT status_success = SendDlgItemMessageW(IDC_BULKSEARCH_LIST,
-                                                     LVM_SETITEMTEXT,
-                                                     item_index,
-                                                     (LPARAM)&subitem_status);
-        assert(status_success);
     }
 
     update_status_text();
@@ -260,39 +243,86 @@ void BulkLyricSearch::add_tracks_to_ui(const std::vector<TrackAndInfo>& new_trac
     SetDlgItemText(IDC_BULKSEARCH_CLOSE, _T("Cancel"));
 }
 
+void BulkLyricSearch::set_track_status(int track_index, const TCHAR* status)
+{
+    LVITEM subitem_status = {};
+    subitem_status.mask = LVIF_TEXT;
+    subitem_status.iItem = track_index;
+    subitem_status.iSubItem = 2;
+    subitem_status.pszText = const_cast<TCHAR*>(status);
+    LRESULT status_success = SendDlgItemMessageW(IDC_BULKSEARCH_LIST,
+                                                 LVM_SETITEMTEXT,
+                                                 track_index,
+                                                 (LPARAM)&subitem_status);
+    assert(status_success);
+}
+
 void BulkLyricSearch::update_status_text()
 {
+    if(m_completed_search_count >= int(m_tracks_to_search.size()))
+    {
+        SetDlgItemText(IDC_BULKSEARCH_STATUS, _T("Done"));
+        SetDlgItemText(IDC_BULKSEARCH_CLOSE, _T("Close"));
+        return;
+    }
+
     TCHAR buffer[64] = {};
     const size_t buffer_len = sizeof(buffer) / sizeof(buffer[0]);
-    _sntprintf_s(buffer, buffer_len, _T("Searching %d/%zu"), m_next_search_index + 1, m_tracks_to_search.size());
+    _sntprintf_s(buffer,
+                 buffer_len,
+                 _T("Searching %d/%zu"),
+                 m_completed_search_count + 1,
+                 m_tracks_to_search.size());
     SetDlgItemText(IDC_BULKSEARCH_STATUS, buffer);
 }
 
-LRESULT BulkLyricSearch::OnTimer(WPARAM)
+LRESULT BulkLyricSearch::OnSearchUpdate(UINT, WPARAM, LPARAM)
 {
-    if(!m_child_search.has_value())
+    // NOTE: We get notified for every result, not just the final one, so we need to check which have finished
+    for(auto iter = m_child_searches.begin(); iter != m_child_searches.end(); /*omitted*/)
     {
-        assert((m_next_search_index >= 0) && (m_next_search_index < int(m_tracks_to_search.size())));
-
-        const TrackAndInfo& track = m_tracks_to_search[m_next_search_index];
-        m_child_search.emplace(LyricUpdate::Type::ManualSearch, track.track, track.track_info, m_child_abort);
-
-        io::search_for_lyrics(m_child_search.value(), false);
-
-        UINT_PTR result = SetTimer(BULK_SEARCH_UPDATE_TIMER, 16, nullptr);
-        if(result != BULK_SEARCH_UPDATE_TIMER)
+        if(iter->handle.is_complete())
         {
-            LOG_WARN("Unexpected timer result when starting bulk search update timer to check for results");
+            process_search_completion(*iter);
+            iter = m_child_searches.erase(iter);
+        }
+        else
+        {
+            iter++;
         }
-        return 0;
     }
 
-    assert(m_child_search.has_value());
-    LyricSearchHandle& update = m_child_search.value();
-    bool were_remote_sources_searched = update.has_searched_remote_sources();
+    start_searches();
+    return 0;
+}
+
+void BulkLyricSearch::start_searches()
+{
+    while((m_child_searches.size() < BULK_SEARCH_MAX_CONCURRENT_SEARCHES)
+          && (m_next_search_index < int(m_tracks_to_search.size())))
+    {
+        const int track_index = m_next_search_index++;
+        m_child_searches.emplace_back(track_index, m_tracks_to_search[track_index], m_child_abort);
+        LyricSearchHandle& handle = m_child_searches.back().handle;
+        set_track_status(track_index, _T("Searching..."));
+
+        // NOTE: The window handle will be invalid if the dialog is closed before the search thread notifies us,
+        //       in which case posting the message will just fail. That's fine because we process the final results
+        //       when the dialog is destroyed anyway.
+        const HWND dialog_handle = m_hWnd;
+        handle.set_update_callback([dialog_handle]() { ::PostMessage(dialog_handle, WM_BULK_SEARCH_UPDATE, 0, 0); });
+        io::search_for_lyrics(handle, WorkPriority::Bulk, false, false);
+    }
+
+    update_status_text();
+}
+
+void BulkLyricSearch::process_search_completion(ChildSearch& search)
+{
+    LyricSearchHandle& update = search.handle;
     if(!update.is_complete())
     {
-        return 0;
+        return;
     }
 
     std::optional<LyricData> lyrics;
@@ -301,80 +331,16 @@ LRESULT BulkLyricSearch::OnTimer(WPARAM)
         lyrics = io::process_available_lyric_update(
             { update.get_result(), update.get_track(), update.get_track_info(), update.get_type() });
     }
-    m_child_search.reset();
 
     if(lyrics.has_value())
     {
         lyric_metadata_log_retrieved(update.get_track_info(), lyrics.value());
     }
 
+    const bool lyrics_found = lyrics.has_value() && !lyrics.value().IsEmpty();
+    set_track_status(search.track_index, lyrics_found ? _T("Found") : _T("Not found"));
     SendDlgItemMessage(IDC_BULKSEARCH_PROGRESS, PBM_STEPIT, 0, 0);
-    if(m_next_search_index < int(m_tracks_to_search.size()))
-    {
-        const bool lyrics_found = lyrics.has_value() && !lyrics.value().IsEmpty();
-        const TCHAR* status_text = lyrics_found ? _T("Found") : _T("Not found");
-        LVITEM subitem_status = {};
-        subitem_status.mask = LVIF_TEXT;
-        subitem_status.iItem = m_next_search_index;
-        subitem_status.iSubItem = 2;
-        subitem_status.pszText = const_cast<TCHAR*>(status_text);
-        LRESULT status_success = SendDlgItemMessageW(IDC_BULKSEARCH_LIST,
-                                                     LVM_SETITEMTEXT,
-                                                     m_next_search_index,
-                                                     (LPARAM)&subitem_status);
-        assert(status_success);
-
-        m_next_search_index++;
-    }
-
-    if(m_next_search_index >= int(m_tracks_to_search.size()))
-    {
-        WIN32_OP(KillTimer(BULK_SEARCH_UPDATE_TIMER))
-        SetDlgItemText(IDC_BULKSEARCH_STATUS, _T("Done"));
-        SetDlgItemText(IDC_BULKSEARCH_CLOSE, _T("Close"));
-    }
-    else
-    {
-        // We mark the row as "Searching" here, rather than when we start the actual search so
-        // that there is always one row that says it's searching, even during the extra delay
-        // time between searches of online sources.
-        // This is just to make it look better to the user, who might easily think it's broken
-        // if it visibly just sits for several seconds between searches (which...admittedly it
-        // does do, but it's by design, it's not a bug).
-        LVITEM subitem_status = {};
-        subitem_status.mask = LVIF_TEXT;
-        subitem_status.iItem = m_next_search_index;
-        subitem_status.iSubItem = 2;
-        subitem_status.pszText = _T("Searching...");
-        LRESULT status_success = SendDlgItemMessageW(IDC_BULKSEARCH_LIST,
-                                                     LVM_SETITEMTEXT,
-                                                     m_next_search_index,
-                                                     (LPARAM)&subitem_status);
-        assert(status_success);
-
-        update_status_text();
-
-        // NOTE: We wait for 10 seconds between every search so as to not generate huge quantities of network
-        //       traffic for the lyric servers in a very short time when we're searching for many tracks.
-        //       When this timer expires, the callback will see that there is no child update active and
-        //       will start a new search for the next track.
-        DWORD sleep_ms = 0;
-        if(!were_remote_sources_searched)
-        {
-            // NOTE: If we found lyrics did not need to search a remote source in the process,
-            //       then we need not add the extra delay since we aren't worried about flooding a website.
-            sleep_ms = 1;
-        }
-
-        assert(!m_child_search.has_value());
-        UINT_PTR result = SetTimer(BULK_SEARCH_UPDATE_TIMER, sleep_ms, nullptr);
-        if(result != BULK_SEARCH_UPDATE_TIMER)
-        {
-            LOG_WARN("Unexpected timer result when starting bulk search update timer to check for results");
-        }
-    }
-
-    return 0;
+    m_completed_search_count++;
 }
 
 HWND SpawnBulkLyricSearch(std::vector<metadb_handle_ptr> tracks_to_search)
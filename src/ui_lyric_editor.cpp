@@ -8,6 +8,7 @@
 #pragma warning(pop)
 
 #include "logging.h"
+#include "lyric_editor_document.h"
 #include "lyric_io.h"
 #include "lyric_metadata.h"
 #include "metrics.h"
@@ -68,16 +69,16 @@ private:
 
     void update_play_button();
     void update_time_text(double time);
-    bool HasContentChanged(size_t* new_length);
     void ApplyLyricEdits();
 
     void SelectLineWithTimestampGreaterOrEqual(double threshold_timestamp);
     void SetEditorContents(const LyricData& lyrics);
-    std::tstring GetEditorContents();
+    void UpdateDocument();
     LyricData ParseEditorContents();
 
     LyricDataCommon m_common_data;
-    std::tstring m_input_text;
+    LyricEditorDocument m_document;
+    std::tstring m_edit_text_buffer;
     metadb_handle_ptr m_track;
     metadb_v2_rec_t m_track_info;
 
@@ -92,7 +93,7 @@ LyricEditor::LyricEditor(LyricDataCommon common_data,
                          metadb_handle_ptr track,
                          metadb_v2_rec_t& track_info)
     : m_common_data(common_data)
-    , m_input_text(text)
+    , m_document(text)
     , m_track(track)
     , m_track_info(track_info)
 {
@@ -158,9 +159,9 @@ BOOL LyricEditor::OnInitDialog(CWindow /*parent*/, LPARAM /*clientData*/)
 
     GotoDlgCtrl(GetDlgItem(IDC_LYRIC_TEXT));
 
-    if(!m_input_text.empty())
+    if(!m_document.get_text().empty())
     {
-        SetDlgItemText(IDC_LYRIC_TEXT, m_input_text.c_str());
+        SetDlgItemText(IDC_LYRIC_TEXT, m_document.get_text().c_str());
 
         bool editing_now_playing = (now_playing == m_track);
         double playback_time = playback->playback_get_position();
@@ -206,9 +207,9 @@ void LyricEditor::OnClose()
 
 void LyricEditor::OnEditChange(UINT, int, CWindow)
 {
-    size_t new_length = 0;
-    bool changed = HasContentChanged(&new_length);
-    bool is_empty = (new_length == 0);
+    UpdateDocument();
+    bool changed = m_document.has_changed_since_saved();
+    bool is_empty = m_document.get_text().empty();
 
     CWindow apply_btn = GetDlgItem(ID_LYRIC_EDIT_APPLY);
     assert(apply_btn != nullptr);
@@ -271,9 +272,8 @@ void LyricEditor::OnLineSync(UINT /*btn_id*/, int /*notification_type*/, CWindow
         }
     }
 
-    LyricData parsed = ParseEditorContents();
     service_ptr_t<playback_control> playback = playback_control::get();
-    double timestamp = playback->playback_get_position() + parsed.timestamp_offset;
+    double timestamp = playback->playback_get_position() + m_document.get_timestamp_offset();
     std::string timestamp_str = parsers::lrc::print_timestamp(timestamp);
     std::tstring timestamp_tstr = to_tstring(timestamp_str);
 
@@ -295,7 +295,8 @@ void LyricEditor::OnLineSync(UINT /*btn_id*/, int /*notification_type*/, CWindow
 
 void LyricEditor::OnEditReset(UINT /*btn_id*/, int /*notification_type*/, CWindow /*btn*/)
 {
-    SetDlgItemText(IDC_LYRIC_TEXT, m_input_text.c_str());
+    SetDlgItemText(IDC_LYRIC_TEXT, m_document.get_saved_text().c_str());
+    UpdateDocument(); // Setting the text of a multi-line edit control does not send EN_CHANGE
 }
 
 void LyricEditor::SelectLineWithTimestampGreaterOrEqual(double threshold_timestamp)
@@ -360,6 +361,7 @@ void LyricEditor::SetEditorContents(const LyricData& lyrics)
 {
     std::tstring new_contents = parsers::lrc::expand_text(lyrics, false);
     SetDlgItemText(IDC_LYRIC_TEXT, new_contents.c_str());
+    UpdateDocument(); // Setting the text of a multi-line edit control does not send EN_CHANGE
     SendDlgItemMessage(IDC_LYRIC_TEXT, EM_SCROLLCARET, 0, 0);
 }
 
@@ -436,13 +438,13 @@ void LyricEditor::OnCancel(UINT /*btn_id*/, int /*notification_type*/, CWindow /
 
 void LyricEditor::OnApply(UINT /*btn_id*/, int /*notify_code*/, CWindow /*btn*/)
 {
-    assert(HasContentChanged(nullptr));
+    assert(m_document.has_changed_since_saved());
     ApplyLyricEdits();
 }
 
 void LyricEditor::OnOK(UINT /*btn_id*/, int /*notify_code*/, CWindow /*btn*/)
 {
-    if(HasContentChanged(nullptr))
+    if(m_document.has_changed_since_saved())
     {
         ApplyLyricEdits();
     }
@@ -530,43 +532,6 @@ void LyricEditor::update_play_button()
     btn.SetWindowText(newText);
 }
 
-bool LyricEditor::HasContentChanged(size_t* new_length)
-{
-    const LRESULT lyric_length_result = SendDlgItemMessage(IDC_LYRIC_TEXT, WM_GETTEXTLENGTH, 0, 0);
-    assert(lyric_length_result >= 0);
-    assert(lyric_length_result <= INT_MAX);
-
-    const size_t lyric_length = static_cast<size_t>(lyric_length_result);
-    if(new_length)
-    {
-        *new_length = lyric_length;
-    }
-
-    if(lyric_length != m_input_text.size())
-    {
-        return true;
-    }
-
-    if(lyric_length > 0)
-    {
-        TCHAR* lyric_buffer = new TCHAR[lyric_length + 1]; // +1 for the null-terminator
-        UINT chars_copied = GetDlgItemText(IDC_LYRIC_TEXT, lyric_buffer, int(lyric_length) + 1);
-        if(chars_copied != lyric_length)
-        {
-            LOG_WARN("Dialog character count mismatch. Expected %ju, got %u", lyric_length, chars_copied);
-        }
-
-        bool changed = (_tcscmp(lyric_buffer, m_input_text.c_str()) != 0);
-        delete[] lyric_buffer;
-
-        return changed;
-    }
-    else
-    {
-        return false; // The new length is zero and it matches the old length
-    }
-}
-
 void LyricEditor::ApplyLyricEdits()
 {
     LOG_INFO("Saving lyrics from editor...");
@@ -584,41 +549,34 @@ void LyricEditor::ApplyLyricEdits()
     });
     lyric_metadata_log_edit(m_track_info);
 
-    // Update m_input_text so that HasContentChanged() will return the correct value after the same
-    m_input_text = GetEditorContents();
+    // Mark the current text as saved so that we can tell whether it changes again after this
+    m_document.mark_saved();
 
-    // We know that if we ran HasContentChanged() now, it would return false.
+    // We know that if we checked whether the document has changed now, it would return false.
     // So short-circuit it and just disable the apply button directly
     CWindow apply_btn = GetDlgItem(ID_LYRIC_EDIT_APPLY);
     apply_btn.EnableWindow(FALSE);
 }
 
-std::tstring LyricEditor::GetEditorContents()
+void LyricEditor::UpdateDocument()
 {
-    LRESULT lyric_length = SendDlgItemMessage(IDC_LYRIC_TEXT, WM_GETTEXTLENGTH, 0, 0);
-    if(lyric_length <= 0)
-    {
-        return _T("");
-    }
-    assert(lyric_length <= INT_MAX);
+    const LRESULT lyric_length = SendDlgItemMessage(IDC_LYRIC_TEXT, WM_GETTEXTLENGTH, 0, 0);
+    assert((lyric_length >= 0) && (lyric_length <= INT_MAX));
 
-    TCHAR* lyric_buffer = new TCHAR[lyric_length + 1]; // +1 for the null-terminator
-    UINT chars_copied = GetDlgItemText(IDC_LYRIC_TEXT, lyric_buffer, int(lyric_length) + 1);
+    // NOTE: We re-use the same buffer every time, so that we don't need to allocate a new one for every edit
+    m_edit_text_buffer.resize(size_t(lyric_length) + 1); // +1 for the null-terminator
+    UINT chars_copied = GetDlgItemText(IDC_LYRIC_TEXT, m_edit_text_buffer.data(), int(lyric_length) + 1);
     if(chars_copied != UINT(lyric_length))
     {
-        LOG_WARN("Dialog character count mismatch while saving. Expected %u, got %u", lyric_length, chars_copied);
+        LOG_WARN("Dialog character count mismatch. Expected %u, got %u", UINT(lyric_length), chars_copied);
     }
 
-    std::tstring result = std::tstring { lyric_buffer, chars_copied };
-    delete[] lyric_buffer;
-
-    return result;
+    m_document.update(std::tstring_view { m_edit_text_buffer.data(), chars_copied });
 }
 
 LyricData LyricEditor::ParseEditorContents()
 {
-    std::string lyrics = from_tstring(GetEditorContents());
-    return parsers::lrc::parse(m_common_data, lyrics);
+    return m_document.get_lyrics(m_common_data);
 }
 
 HWND SpawnLyricEditor(const LyricData& lyrics, metadb_handle_ptr track, metadb_v2_rec_t track_info)
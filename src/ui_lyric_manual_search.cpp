@@ -50,8 +50,8 @@ public:
     MSG_WM_INITDIALOG(OnInitDialog)
     MSG_WM_DESTROY(OnDestroyDialog)
     MSG_WM_CLOSE(OnClose)
-    MSG_WM_TIMER(OnTimer)
     MSG_WM_NOTIFY(OnNotify)
+    MESSAGE_HANDLER_EX(WM_MANUAL_SEARCH_UPDATE, OnSearchUpdate)
     COMMAND_HANDLER_EX(IDC_MANUALSEARCH_SEARCH, BN_CLICKED, OnSearchRequested)
     COMMAND_HANDLER_EX(IDC_MANUALSEARCH_CANCEL, BN_CLICKED, OnCancel)
     COMMAND_HANDLER_EX(IDC_MANUALSEARCH_OK, BN_CLICKED, OnOK)
@@ -62,7 +62,7 @@ private:
     BOOL OnInitDialog(CWindow parent, LPARAM clientData);
     void OnDestroyDialog();
     void OnClose();
-    LRESULT OnTimer(WPARAM);
+    LRESULT OnSearchUpdate(UINT, WPARAM, LPARAM);
     LRESULT OnNotify(int idCtrl, LPNMHDR pnmh);
     void OnCancel(UINT btn_id, int notify_code, CWindow btn);
     void OnOK(UINT btn_id, int notify_code, CWindow btn);
@@ -84,7 +84,8 @@ private:
     fb2k::CCoreDarkModeHooks m_dark;
 };
 
-static const UINT_PTR MANUAL_SEARCH_UPDATE_TIMER = 7917213;
+// Posted to the dialog (from the search thread) whenever the search has a new result or completes
+static const UINT WM_MANUAL_SEARCH_UPDATE = WM_APP + 1;
 
 ManualLyricSearch::ManualLyricSearch(metadb_handle_ptr track, metadb_v2_rec_t track_info)
     : m_track(track)
@@ -204,8 +205,6 @@ void ManualLyricSearch::OnDestroyDialog()
             LOG_WARN("Failed to complete custom lyric search before closing the window");
         }
     }
-
-    KillTimer(MANUAL_SEARCH_UPDATE_TIMER);
 }
 
 void ManualLyricSearch::OnClose()
@@ -367,14 +366,14 @@ void ManualLyricSearch::start_search()
     std::string artist = from_tstring(std::tstring_view { ui_artist, ui_artist_len });
     std::string album = from_tstring(std::tstring_view { ui_album, ui_album_len });
     std::string title = from_tstring(std::tstring_view { ui_title, ui_title_len });
+    // NOTE: The window handle will be invalid if the dialog is closed before the search thread notifies us,
+    //       in which case posting the message will just fail and that's fine because there's nothing to update.
+    const HWND dialog_handle = m_hWnd;
+    m_child_search.value().set_update_callback([dialog_handle]()
+                                               { ::PostMessage(dialog_handle, WM_MANUAL_SEARCH_UPDATE, 0, 0); });
     io::search_for_all_lyrics(m_child_search.value(), artist, album, title);
 
     GetDlgItem(IDC_MANUALSEARCH_SEARCH).EnableWindow(false);
-    UINT_PTR result = SetTimer(MANUAL_SEARCH_UPDATE_TIMER, 16, nullptr);
-    if(result != MANUAL_SEARCH_UPDATE_TIMER)
-    {
-        LOG_WARN("Unexpected timer result when starting manual search update timer");
-    }
 
     SetDlgItemText(IDC_MANUALSEARCH_PROGRESS, _T("Searching..."));
 }
@@ -435,26 +434,16 @@ void ManualLyricSearch::OnSearchRequested(UINT /*btn_id*/, int /*notify_code*/,
     start_search();
 }
 
-LRESULT ManualLyricSearch::OnTimer(WPARAM)
+LRESULT ManualLyricSearch::OnSearchUpdate(UINT, WPARAM, LPARAM)
 {
     if(!m_child_search.has_value())
     {
-        GetDlgItem(IDC_MANUALSEARCH_SEARCH).EnableWindow(true);
-        WIN32_OP(KillTimer(MANUAL_SEARCH_UPDATE_TIMER))
+        // We may still receive notifications that were posted before we processed the search completion
         return 0;
     }
 
     assert(m_child_search.has_value());
     LyricSearchHandle& child_search = m_child_search.value();
-    if(child_search.is_complete() && !child_search.has_result())
-    {
-        GetDlgItem(IDC_MANUALSEARCH_SEARCH).EnableWindow(true);
-        m_child_search.reset();
-        SetDlgItemText(IDC_MANUALSEARCH_PROGRESS, _T("Search complete"));
-        WIN32_OP(KillTimer(MANUAL_SEARCH_UPDATE_TIMER))
-        return 0;
-    }
-
     while(child_search.has_result())
     {
         m_all_lyrics.push_back(child_search.get_result());
@@ -539,6 +528,17 @@ LRESULT ManualLyricSearch::OnTimer(WPARAM)
         }
     }
 
+    // NOTE: We check for completion only after taking all the available results because we might not get another
+    //       notification once the search is complete (if the final result and the completion were both
+    //       already available by the time we handled this one).
+    if(child_search.is_complete() && !child_search.has_result())
+    {
+        GetDlgItem(IDC_MANUALSEARCH_SEARCH).EnableWindow(true);
+        m_child_search.reset();
+        SetDlgItemText(IDC_MANUALSEARCH_PROGRESS, _T("Search complete"));
+        return 0;
+    }
+
     // Stop all the background search tasks if we're shutting down
     if(fb2k::mainAborter().is_aborting())
     {
@@ -8,7 +8,10 @@
 #include "mvtf/mvtf.h"
 #include "win32_util.h"
 
-size_t wide_to_narrow_string(unsigned int codepage, std::wstring_view wide, std::vector<char>& out_buffer)
+size_t wide_to_narrow_string(unsigned int codepage,
+                             std::wstring_view wide,
+                             std::vector<char>& out_buffer,
+                             bool replace_invalid_chars)
 {
     if(wide.empty())
     {
@@ -26,8 +29,9 @@ size_t wide_to_narrow_string(unsigned int codepage, std::wstring_view wide, std:
         start_index = 1;
     }
 
+    const DWORD flags = replace_invalid_chars ? 0 : WC_ERR_INVALID_CHARS;
     int bytes_required = WideCharToMultiByte(codepage,
-                                             WC_ERR_INVALID_CHARS,
+                                             flags,
                                              &wide[start_index],
                                              int(wide.length() - start_index),
                                              nullptr,
@@ -42,7 +46,7 @@ size_t wide_to_narrow_string(unsigned int codepage, std::wstring_view wide, std:
     assert(bytes_required > 0);
     out_buffer.resize((size_t)bytes_required);
     int bytes_written = WideCharToMultiByte(codepage,
-                                            WC_ERR_INVALID_CHARS,
+                                            flags,
                                             &wide[start_index],
                                             int(wide.length() - start_index),
                                             out_buffer.data(),
@@ -53,11 +57,15 @@ size_t wide_to_narrow_string(unsigned int codepage, std::wstring_view wide, std:
     return (size_t)bytes_written;
 }
 
-size_t narrow_to_wide_string(unsigned int codepage, std::string_view narrow, std::vector<wchar_t>& out_buffer)
+size_t narrow_to_wide_string(unsigned int codepage,
+                             std::string_view narrow,
+                             std::vector<wchar_t>& out_buffer,
+                             bool replace_invalid_chars)
 {
     assert(narrow.length() <= INT_MAX);
+    const DWORD flags = replace_invalid_chars ? 0 : MB_ERR_INVALID_CHARS;
     int chars_required = MultiByteToWideChar(codepage,
-                                             MB_ERR_INVALID_CHARS,
+                                             flags,
                                              narrow.data(),
                                              int(narrow.length()),
                                              nullptr,
@@ -70,7 +78,7 @@ size_t narrow_to_wide_string(unsigned int codepage, std::string_view narrow, std
     assert(chars_required > 0);
     out_buffer.resize((size_t)chars_required);
     int chars_written = MultiByteToWideChar(codepage,
-                                            MB_ERR_INVALID_CHARS,
+                                            flags,
                                             narrow.data(),
                                             int(narrow.length()),
                                             out_buffer.data(),
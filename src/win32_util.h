@@ -13,12 +13,16 @@ namespace std
 #endif
 }
 
+// NOTE: Both of these fail (returning 0) if the input contains characters that are invalid in the given codepage,
+//       unless `replace_invalid_chars` is set, in which case such characters are replaced with a placeholder instead.
 size_t wide_to_narrow_string(unsigned int codepage,
                              std::wstring_view wide,
-                             std::vector<char>& out_buffer); // Returns bytes written to out_buffer
+                             std::vector<char>& out_buffer,
+                             bool replace_invalid_chars = false); // Returns bytes written to out_buffer
 size_t narrow_to_wide_string(unsigned int codepage,
                              std::string_view narrow,
-                             std::vector<wchar_t>& out_buffer); // Returns characters written to out_buffer
+                             std::vector<wchar_t>& out_buffer,
+                             bool replace_invalid_chars = false); // Returns characters written to out_buffer
 
 std::tstring to_tstring(std::string_view string);
 std::tstring to_tstring(const std::string& string);
@@ -0,0 +1,498 @@
+#include "stdafx.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+#include "logging.h"
+#include "mvtf/mvtf.h"
+#include "work_scheduler.h"
+
+using WorkClock = std::chrono::steady_clock;
+
+// NOTE: Almost all of our background work is waiting on network requests, so we want more workers than we have
+//       cores, but not so many that we send a flood of requests to the same sites at once.
+static const size_t WORKER_COUNT = 8;
+
+// NOTE: One worker is kept free for now-playing searches, so that they never need to wait for other work to finish
+static const size_t MAX_BACKGROUND_WORKERS = WORKER_COUNT - 1;
+
+// Work that waits at least this long before starting gets logged, so that we can tell when the pool is saturated
+static const std::chrono::milliseconds SLOW_START_LOG_THRESHOLD(1000);
+
+static const size_t PRIORITY_COUNT = size_t(WorkPriority::Count);
+
+static const char* priority_to_string(WorkPriority priority)
+{
+    switch(priority)
+    {
+        case WorkPriority::NowPlaying: return "now-playing";
+        case WorkPriority::Manual: return "manual";
+        case WorkPriority::Bulk: return "bulk";
+        case WorkPriority::Prefetch: return "prefetch";
+        case WorkPriority::Upload: return "upload";
+        default: return "<unknown>";
+    }
+}
+
+struct QueueStats
+{
+    size_t queued;                        // The number of items currently waiting to start
+    size_t peak_queued;                   // The largest number of items that have been waiting at the same time
+    uint64_t started;                     // The number of items that have started running
+    std::chrono::milliseconds total_wait; // The total time that all started items spent waiting to start
+};
+
+struct QueuedWork
+{
+    work_scheduler::WorkId id;
+    std::function<void()> run;
+    WorkPriority priority;
+    WorkClock::time_point queued_at;
+};
+
+// The work queues of every worker. Each worker has its own queue for each priority, which it works through first
+// and which other workers take from (in priority order) when they run out of work of their own.
+class WorkQueues
+{
+public:
+    WorkQueues(size_t worker_count, size_t max_background_workers)
+        : m_workers(worker_count)
+        , m_max_background_workers(max_background_workers)
+        , m_busy_background_workers(0)
+    {
+    }
+
+    void push(size_t worker_index, QueuedWork work)
+    {
+        WorkerQueues& worker = m_workers[worker_index % m_workers.size()];
+        std::lock_guard lock(worker.mutex);
+        worker.queues[size_t(work.priority)].push_back(std::move(work));
+    }
+
+    // Moves the given work to the back of the queue for the given priority, if it has not been taken yet.
+    // Returns the priority that the work was queued with, if it was found.
+    std::optional<WorkPriority> reprioritise(work_scheduler::WorkId id, WorkPriority new_priority)
+    {
+        for(WorkerQueues& worker : m_workers)
+        {
+            std::lock_guard lock(worker.mutex);
+            for(std::deque<QueuedWork>& queue : worker.queues)
+            {
+                const auto iter = std::find_if(queue.begin(),
+                                               queue.end(),
+                                               [id](const QueuedWork& work) { return work.id == id; });
+                if(iter == queue.end())
+                {
+                    continue;
+                }
+
+                QueuedWork work = std::move(*iter);
+                queue.erase(iter);
+                const WorkPriority old_priority = work.priority;
+                work.priority = new_priority;
+                worker.queues[size_t(new_priority)].push_back(std::move(work));
+                return old_priority;
+            }
+        }
+        return {};
+    }
+
+    // Takes the highest-priority work available to the given worker, preferring its own queues over those of
+    // other workers. Work other than now-playing searches is only taken if there is a background worker slot free
+    // (or if `ignore_background_limit` is set), in which case the caller must call `finish_background_work` once
+    // that work is complete.
+    std::optional<QueuedWork> try_take(size_t worker_index, bool ignore_background_limit)
+    {
+        for(size_t priority = 0; priority < PRIORITY_COUNT; priority++)
+        {
+            const bool is_background = (priority != size_t(WorkPriority::NowPlaying));
+            if(is_background && !try_reserve_background_worker(ignore_background_limit))
+            {
+                break; // All lower priorities are also background work
+            }
+
+            for(size_t offset = 0; offset < m_workers.size(); offset++)
+            {
+                std::optional<QueuedWork> work = try_pop(m_workers[(worker_index + offset) % m_workers.size()],
+                                                         priority);
+                if(work.has_value())
+                {
+                    return work;
+                }
+            }
+
+            if(is_background)
+            {
+                m_busy_background_workers--;
+            }
+        }
+        return {};
+    }
+
+    void finish_background_work()
+    {
+        m_busy_background_workers--;
+    }
+
+private:
+    struct WorkerQueues
+    {
+        std::mutex mutex;
+        std::deque<QueuedWork> queues[PRIORITY_COUNT];
+    };
+
+    bool try_reserve_background_worker(bool ignore_background_limit)
+    {
+        size_t busy = m_busy_background_workers.load();
+        while(ignore_background_limit || (busy < m_max_background_workers))
+        {
+            if(m_busy_background_workers.compare_exchange_weak(busy, busy + 1))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static std::optional<QueuedWork> try_pop(WorkerQueues& worker, size_t priority)
+    {
+        std::lock_guard lock(worker.mutex);
+        std::deque<QueuedWork>& queue = worker.queues[priority];
+        if(queue.empty())
+        {
+            return {};
+        }
+
+        QueuedWork result = std::move(queue.front());
+        queue.pop_front();
+        return result;
+    }
+
+    std::vector<WorkerQueues> m_workers;
+    const size_t m_max_background_workers;
+    std::atomic<size_t> m_busy_background_workers;
+};
+
+static thread_local size_t g_current_worker_index = SIZE_MAX;
+static thread_local std::optional<WorkPriority> t_current_priority;
+
+class WorkScheduler
+{
+public:
+    WorkScheduler()
+        : m_queues(WORKER_COUNT, MAX_BACKGROUND_WORKERS)
+        , m_threads()
+        , m_started()
+        , m_wake_mutex()
+        , m_wake()
+        , m_generation(0)
+        , m_stopping(false)
+        , m_next_worker(0)
+        , m_next_id(1)
+        , m_stats_mutex()
+        , m_stats()
+    {
+    }
+
+    work_scheduler::WorkId submit(WorkPriority priority, std::function<void()> work)
+    {
+        assert(priority < WorkPriority::Count);
+        std::call_once(m_started, [this]() { start(); });
+
+        {
+            std::lock_guard lock(m_stats_mutex);
+            QueueStats& stats = m_stats[size_t(priority)];
+            stats.queued++;
+            stats.peak_queued = std::max(stats.peak_queued, stats.queued);
+        }
+
+        // NOTE: Work submitted by a worker goes into that worker's own queues, since it is likely to be related to
+        //       whatever that worker is doing now. Everything else is spread evenly across the workers.
+        const size_t worker_index = (g_current_worker_index != SIZE_MAX) ? g_current_worker_index : m_next_worker++;
+        const work_scheduler::WorkId id = m_next_id++;
+        m_queues.push(worker_index, { id, std::move(work), priority, WorkClock::now() });
+        wake_workers();
+        return id;
+    }
+
+    bool reprioritise(work_scheduler::WorkId id, WorkPriority priority)
+    {
+        assert(priority < WorkPriority::Count);
+        std::lock_guard lock(m_stats_mutex);
+        const std::optional<WorkPriority> old_priority = m_queues.reprioritise(id, priority);
+        if(!old_priority.has_value())
+        {
+            return false;
+        }
+
+        // NOTE: We hold the stats lock throughout so that the work can't start (and be counted as such) before
+        //       we've moved its queued count to the new priority.
+        m_stats[size_t(old_priority.value())].queued--;
+        QueueStats& stats = m_stats[size_t(priority)];
+        stats.queued++;
+        stats.peak_queued = std::max(stats.peak_queued, stats.queued);
+        wake_workers();
+        return true;
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard lock(m_wake_mutex);
+            m_stopping = true;
+            m_generation++;
+        }
+        m_wake.notify_all();
+
+        // NOTE: Workers finish all of the work that has already been queued before they stop, because whoever
+        //       queued it may be waiting for it to complete. By now everything should have been aborted though,
+        //       so it should not take long.
+        for(std::thread& thread : m_threads)
+        {
+            thread.join();
+        }
+        m_threads.clear();
+
+        for(size_t i = 0; i < PRIORITY_COUNT; i++)
+        {
+            const QueueStats& stats = m_stats[i];
+            if(stats.started == 0)
+            {
+                continue;
+            }
+
+            LOG_INFO("Ran %d items of %s work, with a peak queue depth of %d and an average wait of %dms",
+                     int(stats.started),
+                     priority_to_string(WorkPriority(i)),
+                     int(stats.peak_queued),
+                     int(stats.total_wait.count() / stats.started));
+        }
+    }
+
+private:
+    void start()
+    {
+        m_threads.reserve(WORKER_COUNT);
+        for(size_t i = 0; i < WORKER_COUNT; i++)
+        {
+            m_threads.emplace_back([this, i]() { run_worker(i); });
+        }
+    }
+
+    void wake_workers()
+    {
+        {
+            std::lock_guard lock(m_wake_mutex);
+            m_generation++;
+        }
+        m_wake.notify_all();
+    }
+
+    void run_worker(size_t worker_index)
+    {
+        g_current_worker_index = worker_index;
+        while(true)
+        {
+            uint64_t seen_generation = 0;
+            bool stopping = false;
+            {
+                std::lock_guard lock(m_wake_mutex);
+                seen_generation = m_generation;
+                stopping = m_stopping;
+            }
+
+            std::optional<QueuedWork> work = m_queues.try_take(worker_index, stopping);
+            if(work.has_value())
+            {
+                run_work(std::move(work.value()));
+                continue;
+            }
+
+            std::unique_lock lock(m_wake_mutex);
+            if(m_stopping && stopping)
+            {
+                return;
+            }
+            m_wake.wait(lock, [this, seen_generation]() { return m_generation != seen_generation; });
+        }
+    }
+
+    void run_work(QueuedWork work)
+    {
+        const std::chrono::milliseconds wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+            WorkClock::now() - work.queued_at);
+        size_t still_queued = 0;
+        {
+            std::lock_guard lock(m_stats_mutex);
+            QueueStats& stats = m_stats[size_t(work.priority)];
+            stats.queued--;
+            stats.started++;
+            stats.total_wait += wait;
+            still_queued = stats.queued;
+        }
+        if(wait >= SLOW_START_LOG_THRESHOLD)
+        {
+            LOG_INFO("Queued %s work waited %dms to start, with %d more still waiting",
+                     priority_to_string(work.priority),
+                     int(wait.count()),
+                     int(still_queued));
+        }
+
+        try
+        {
+            work_scheduler::PriorityScope priority_scope(work.priority);
+            work.run();
+        }
+        catch(const std::exception& e)
+        {
+            LOG_ERROR("Unhandled exception in %s work: %s", priority_to_string(work.priority), e.what());
+        }
+
+        if(work.priority != WorkPriority::NowPlaying)
+        {
+            // NOTE: A background worker slot just became free, so other workers might be able to take work that
+            //       they previously couldn't.
+            m_queues.finish_background_work();
+            wake_workers();
+        }
+    }
+
+    WorkQueues m_queues;
+    std::vector<std::thread> m_threads;
+    std::once_flag m_started;
+
+    std::mutex m_wake_mutex;
+    std::condition_variable m_wake;
+    uint64_t m_generation; // Incremented whenever there might be new work available for a worker to take
+    bool m_stopping;
+
+    std::atomic<size_t> m_next_worker;
+    std::atomic<work_scheduler::WorkId> m_next_id;
+
+    std::mutex m_stats_mutex;
+    QueueStats m_stats[PRIORITY_COUNT];
+};
+static WorkScheduler g_scheduler;
+
+work_scheduler::WorkId work_scheduler::submit(WorkPriority priority, std::function<void()> work)
+{
+    return g_scheduler.submit(priority, std::move(work));
+}
+
+bool work_scheduler::reprioritise(WorkId id, WorkPriority priority)
+{
+    return g_scheduler.reprioritise(id, priority);
+}
+
+work_scheduler::PriorityScope::PriorityScope(std::optional<WorkPriority> priority)
+    : m_previous_priority(t_current_priority)
+{
+    t_current_priority = priority;
+}
+
+work_scheduler::PriorityScope::~PriorityScope()
+{
+    t_current_priority = m_previous_priority;
+}
+
+std::optional<WorkPriority> work_scheduler::current_priority()
+{
+    return t_current_priority;
+}
+
+static void stop_scheduler_on_quit()
+{
+    g_scheduler.stop();
+}
+FB2K_RUN_ON_QUIT(stop_scheduler_on_quit);
+
+// ============
+// Tests
+// ============
+#if MVTF_TESTS_ENABLED
+static QueuedWork make_test_work(WorkPriority priority, work_scheduler::WorkId id = 0)
+{
+    return { id, []() {}, priority, WorkClock::now() };
+}
+
+MVTF_TEST(scheduler_takes_higher_priority_work_first)
+{
+    WorkQueues queues(1, 1);
+    queues.push(0, make_test_work(WorkPriority::Upload));
+    queues.push(0, make_test_work(WorkPriority::Bulk));
+    queues.push(0, make_test_work(WorkPriority::NowPlaying));
+
+    const std::optional<QueuedWork> first = queues.try_take(0, false);
+    ASSERT(first.has_value());
+    ASSERT(first->priority == WorkPriority::NowPlaying);
+
+    const std::optional<QueuedWork> second = queues.try_take(0, false);
+    ASSERT(second.has_value());
+    ASSERT(second->priority == WorkPriority::Bulk);
+    queues.finish_background_work();
+
+    const std::optional<QueuedWork> third = queues.try_take(0, false);
+    ASSERT(third.has_value());
+    ASSERT(third->priority == WorkPriority::Upload);
+}
+
+MVTF_TEST(scheduler_takes_work_from_other_workers_when_it_has_none_of_its_own)
+{
+    WorkQueues queues(3, 3);
+    queues.push(2, make_test_work(WorkPriority::Manual));
+
+    const std::optional<QueuedWork> work = queues.try_take(0, false);
+    ASSERT(work.has_value());
+    ASSERT(work->priority == WorkPriority::Manual);
+    ASSERT(!queues.try_take(1, false).has_value());
+}
+
+MVTF_TEST(scheduler_prefers_higher_priority_work_from_other_workers_over_its_own)
+{
+    WorkQueues queues(2, 2);
+    queues.push(0, make_test_work(WorkPriority::Prefetch));
+    queues.push(1, make_test_work(WorkPriority::NowPlaying));
+
+    const std::optional<QueuedWork> work = queues.try_take(0, false);
+    ASSERT(work.has_value());
+    ASSERT(work->priority == WorkPriority::NowPlaying);
+}
+
+MVTF_TEST(scheduler_keeps_workers_free_for_now_playing_searches)
+{
+    WorkQueues queues(2, 1);
+    queues.push(0, make_test_work(WorkPriority::Bulk));
+    queues.push(0, make_test_work(WorkPriority::Bulk));
+
+    ASSERT(queues.try_take(0, false).has_value());
+    ASSERT(!queues.try_take(1, false).has_value());
+
+    queues.push(0, make_test_work(WorkPriority::NowPlaying));
+    const std::optional<QueuedWork> work = queues.try_take(1, false);
+    ASSERT(work.has_value());
+    ASSERT(work->priority == WorkPriority::NowPlaying);
+
+    queues.finish_background_work();
+    ASSERT(queues.try_take(0, false).has_value());
+}
+
+MVTF_TEST(scheduler_takes_reprioritised_work_at_its_new_priority)
+{
+    WorkQueues queues(2, 1);
+    queues.push(0, make_test_work(WorkPriority::Bulk, 1));
+    queues.push(1, make_test_work(WorkPriority::Prefetch, 2));
+
+    const std::optional<WorkPriority> old_priority = queues.reprioritise(2, WorkPriority::NowPlaying);
+    ASSERT(old_priority.has_value());
+    ASSERT(old_priority.value() == WorkPriority::Prefetch);
+    ASSERT(!queues.reprioritise(3, WorkPriority::NowPlaying).has_value());
+
+    const std::optional<QueuedWork> work = queues.try_take(0, false);
+    ASSERT(work.has_value());
+    ASSERT(work->id == 2);
+    ASSERT(work->priority == WorkPriority::NowPlaying);
+    ASSERT(!queues.reprioritise(2, WorkPriority::Bulk).has_value());
+}
+#endif
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "stdafx.h"
+
+#include <functional>
+
+// The classes of background work that we do, in order from most to least urgent
+enum class WorkPriority
+{
+    NowPlaying, // Searching for lyrics for the track that is playing right now
+    Manual,     // Work that the user explicitly asked for and is waiting on (e.g a manual search)
+    Bulk,       // Searches for the tracks in a bulk search
+    Prefetch,   // Searches for the lyrics of tracks that are expected to play soon
+    Upload,     // Uploading lyrics to remote sources
+
+    Count
+};
+
+// Runs background work on a small, fixed pool of worker threads. Queued work is always started in order of priority
+// so that (for example) a large bulk search can't delay the search for the track that is playing right now.
+// Work that has already started is never interrupted, but one worker is always kept free for now-playing searches.
+namespace work_scheduler
+{
+    // Identifies a single item of submitted work
+    using WorkId = uint64_t;
+    WorkId submit(WorkPriority priority, std::function<void()> work);
+
+    // Changes the priority of the given work, if it has not started yet. Returns true if it had not.
+    bool reprioritise(WorkId id, WorkPriority priority);
+
+    // Attributes everything that the current thread does (for as long as this object exists) to work of the given
+    // priority. Workers do this automatically for the work that they run, but tasks that do part of some scheduled
+    // work on other threads (e.g searching each of several sources at once) need to pass their priority along.
+    class PriorityScope
+    {
+    public:
+        explicit PriorityScope(std::optional<WorkPriority> priority);
+        ~PriorityScope();
+        PriorityScope(const PriorityScope& other) = delete;
+        PriorityScope& operator=(const PriorityScope& other) = delete;
+
+    private:
+        std::optional<WorkPriority> m_previous_priority;
+    };
+
+    // Returns the priority of the work that the current thread is doing, if it is doing any scheduled work
+    std::optional<WorkPriority> current_priority();
+}